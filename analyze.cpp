@@ -0,0 +1,78 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include "index/index.h"
+
+static void usage(const char* program);
+
+static uint64_t now();
+
+int main(int argc, const char** argv)
+{
+  if ((argc < 2) || (argc > 3)) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  unsigned nthreads = 0;
+  if (argc == 3) {
+    char* endptr;
+    unsigned long n = strtoul(argv[2], &endptr, 10);
+    if ((*endptr) || (n == 0) || (n > UINT_MAX)) {
+      usage(argv[0]);
+      return -1;
+    }
+
+    nthreads = static_cast<unsigned>(n);
+  }
+
+  // The index is created by open() if it doesn't exist.
+  if (access(argv[1], R_OK | W_OK) != 0) {
+    fprintf(stderr, "Error accessing '%s'.\n", argv[1]);
+    return -1;
+  }
+
+  db::index::index index;
+  if (!index.open(argv[1])) {
+    fprintf(stderr, "Error opening index '%s'.\n", argv[1]);
+    return -1;
+  }
+
+  uint64_t start = now();
+
+  db::index::analysis a;
+  if (!index.analyze(a, nthreads)) {
+    fprintf(stderr, "Error analyzing index '%s'.\n", argv[1]);
+    return -1;
+  }
+
+  uint64_t elapsed = now() - start;
+
+  uint64_t size = 0;
+  if (!index.size(size)) {
+    fprintf(stderr, "Error counting the keys of index '%s'.\n", argv[1]);
+    return -1;
+  }
+
+  printf("# of keys: %lu.\n", size);
+  a.print();
+  printf("Analyzed in %lu ms.\n", elapsed / 1000000);
+
+  return 0;
+}
+
+void usage(const char* program)
+{
+  printf("Usage: %s <filename> [<number-threads>]\n", program);
+  printf("<number-threads> ::= 1 .. %u (default: one per CPU)\n", UINT_MAX);
+}
+
+uint64_t now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (static_cast<uint64_t>(ts.tv_sec) * 1000000000ull) + ts.tv_nsec;
+}
@@ -0,0 +1,301 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <limits.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "index/index.h"
+
+static const char* kFilename = "benchfilter.idx";
+static const char* kFilterFilename = "benchfilter.idx.flt";
+static const keylen_t kKeyMinLength = 20;
+static const unsigned kDefaultBitsPerKey = 10;
+
+static void usage(const char* program);
+
+static uint64_t now();
+
+static uint64_t random_number(uint64_t& state);
+
+static bool drop_cache(const char* filename);
+
+static bool lookup(const db::index::index& index,
+                   keylen_t keylen,
+                   uint64_t nkeys,
+                   uint64_t nlookups,
+                   uint64_t& elapsed,
+                   uint64_t& positives);
+
+static int comp(const void* key1,
+                keylen_t keylen1,
+                const void* key2,
+                keylen_t keylen2);
+
+int main(int argc, const char** argv)
+{
+  if ((argc < 4) || (argc > 6)) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  char* endptr;
+  uint64_t nkeys = strtoull(argv[1], &endptr, 10);
+  if ((*endptr) || (nkeys == 0)) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  unsigned long n = strtoul(argv[2], &endptr, 10);
+  if ((*endptr) || (n < kKeyMinLength) || (n > kKeyMaxLen)) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  uint64_t nlookups = strtoull(argv[3], &endptr, 10);
+  if ((*endptr) || (nlookups == 0)) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  keylen_t keylen = static_cast<keylen_t>(n);
+
+  unsigned bits_per_key = kDefaultBitsPerKey;
+  bool cold = false;
+
+  for (int i = 4; i < argc; i++) {
+    if (strcasecmp(argv[i], "--cold") == 0) {
+      cold = true;
+    } else {
+      n = strtoul(argv[i], &endptr, 10);
+      if ((*endptr) || (n == 0) || (n > 64)) {
+        usage(argv[0]);
+        return -1;
+      }
+
+      bits_per_key = static_cast<unsigned>(n);
+    }
+  }
+
+  unlink(kFilename);
+  unlink(kFilterFilename);
+
+  // Add keys (even numbers).
+  {
+    printf("Adding %lu keys...\n", nkeys);
+
+    db::index::index index;
+    if (!index.open(kFilename)) {
+      fprintf(stderr, "Error opening index.\n");
+      return -1;
+    }
+
+    for (uint64_t i = 0; i < nkeys; i++) {
+      char key[kKeyMaxLen + 1];
+      keylen_t len = snprintf(key, sizeof(key), "%0*lu", keylen, 2 * i);
+
+      if (!index.add(key, len, i, comp)) {
+        fprintf(stderr, "Error adding key '%s'.\n", key);
+        return -1;
+      }
+    }
+  }
+
+  uint64_t elapsed1, elapsed2, positives;
+
+  // Search keys which are not in the index (without filter).
+  {
+    if ((cold) && (!drop_cache(kFilename))) {
+      fprintf(stderr, "Error dropping the page cache.\n");
+      return -1;
+    }
+
+    db::index::index index;
+    if (!index.open(kFilename)) {
+      fprintf(stderr, "Error opening index.\n");
+      return -1;
+    }
+
+    printf("Searching keys (without filter)...\n");
+
+    if (!lookup(index, keylen, nkeys, nlookups, elapsed1, positives)) {
+      return -1;
+    }
+  }
+
+  // Search keys which are not in the index (with filter).
+  {
+    db::index::index::options opts;
+    opts.filter_bits_per_key = bits_per_key;
+
+    // Build the filter.
+    db::index::index index;
+    if (!index.open(kFilename, opts)) {
+      fprintf(stderr, "Error opening index.\n");
+      return -1;
+    }
+
+    index.close();
+
+    if ((cold) && (!drop_cache(kFilename))) {
+      fprintf(stderr, "Error dropping the page cache.\n");
+      return -1;
+    }
+
+    if (!index.open(kFilename, opts)) {
+      fprintf(stderr, "Error opening index.\n");
+      return -1;
+    }
+
+    printf("Searching keys (with filter)...\n");
+
+    if (!lookup(index, keylen, nkeys, nlookups, elapsed2, positives)) {
+      return -1;
+    }
+
+    const db::index::filter* filter = index.key_filter();
+
+    printf("\nFilter:\n");
+    printf("\tBits per key: %u.\n", filter->bits_per_key());
+    printf("\tMemory per key: %.2f bytes.\n",
+           static_cast<double>(filter->size()) / nkeys);
+
+    printf("\tEstimated false positive rate: %.4f%%.\n",
+           filter->false_positive_rate() * 100.0);
+
+    printf("\tMeasured false positive rate: %.4f%%.\n",
+           (static_cast<double>(positives) / nlookups) * 100.0);
+  }
+
+  printf("\nLookups of missing keys (%s page cache):\n",
+         cold ? "cold" : "warm");
+
+  printf("\tWithout filter: %.0f lookups/s (%.1f ns/lookup).\n",
+         nlookups / (elapsed1 / 1e9),
+         static_cast<double>(elapsed1) / nlookups);
+
+  printf("\tWith filter: %.0f lookups/s (%.1f ns/lookup).\n",
+         nlookups / (elapsed2 / 1e9),
+         static_cast<double>(elapsed2) / nlookups);
+
+  unlink(kFilename);
+  unlink(kFilterFilename);
+
+  return 0;
+}
+
+void usage(const char* program)
+{
+  printf("Usage: %s <number-keys> <key-length> <number-lookups> "
+         "[<bits-per-key>] [--cold]\n",
+         program);
+
+  printf("<number-keys> ::= 1 .. %llu\n", ULLONG_MAX);
+  printf("<key-length> ::= %u .. %u\n", kKeyMinLength, kKeyMaxLen);
+  printf("<number-lookups> ::= 1 .. %llu\n", ULLONG_MAX);
+  printf("<bits-per-key> ::= 1 .. 64 (default: %u)\n", kDefaultBitsPerKey);
+  printf("--cold: drop the index from the page cache before searching.\n");
+}
+
+uint64_t now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (static_cast<uint64_t>(ts.tv_sec) * 1000000000ull) + ts.tv_nsec;
+}
+
+uint64_t random_number(uint64_t& state)
+{
+  // xorshift64*.
+  state ^= state >> 12;
+  state ^= state << 25;
+  state ^= state >> 27;
+
+  return state * 0x2545f4914f6cdd1dull;
+}
+
+bool drop_cache(const char* filename)
+{
+  int fd;
+  if ((fd = open(filename, O_RDONLY)) != -1) {
+    bool ret = ((fdatasync(fd) == 0) &&
+                (posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0));
+
+    close(fd);
+
+    return ret;
+  }
+
+  return false;
+}
+
+bool lookup(const db::index::index& index,
+            keylen_t keylen,
+            uint64_t nkeys,
+            uint64_t nlookups,
+            uint64_t& elapsed,
+            uint64_t& positives)
+{
+  uint64_t state = 88172645463325252ull;
+
+  uint64_t start = now();
+
+  for (uint64_t i = 0; i < nlookups; i++) {
+    // Odd numbers are not in the index.
+    char key[kKeyMaxLen + 1];
+    keylen_t len = snprintf(key,
+                            sizeof(key),
+                            "%0*lu",
+                            keylen,
+                            (2 * (random_number(state) % nkeys)) + 1);
+
+    uint64_t dataoff;
+    if (index.find(key, len, comp, dataoff)) {
+      fprintf(stderr, "Key '%s' shouldn't have been found.\n", key);
+      return false;
+    }
+  }
+
+  elapsed = now() - start;
+
+  // Count the keys for which the filter gives a false positive.
+  positives = 0;
+
+  const db::index::filter* filter = index.key_filter();
+  if (filter) {
+    state = 88172645463325252ull;
+
+    for (uint64_t i = 0; i < nlookups; i++) {
+      char key[kKeyMaxLen + 1];
+      keylen_t len = snprintf(key,
+                              sizeof(key),
+                              "%0*lu",
+                              keylen,
+                              (2 * (random_number(state) % nkeys)) + 1);
+
+      if (filter->may_contain(key, len)) {
+        positives++;
+      }
+    }
+  }
+
+  return true;
+}
+
+int comp(const void* key1,
+         keylen_t keylen1,
+         const void* key2,
+         keylen_t keylen2)
+{
+  keylen_t len = (keylen1 < keylen2) ? keylen1 : keylen2;
+
+  int ret;
+  if ((ret = memcmp(key1, key2, len)) < 0) {
+    return -1;
+  } else if (ret > 0) {
+    return +1;
+  } else {
+    return (keylen1 - keylen2);
+  }
+}
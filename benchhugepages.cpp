@@ -0,0 +1,261 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "index/index.h"
+
+static const char* kFilename = "benchhugepages.idx";
+
+// Modes measured.
+static const struct {
+  const char* name;
+  db::index::index::huge_page_mode mode;
+} kModes[] = {
+  {"none", db::index::index::huge_page_mode::kNone},
+  {"file", db::index::index::huge_page_mode::kFile},
+  {"anonymous", db::index::index::huge_page_mode::kAnonymous}
+};
+
+static void usage(const char* program);
+
+static uint64_t now();
+
+static uint64_t random_number(uint64_t& state);
+
+// Encode key (big-endian, compared with memcmp()).
+static void encode(uint64_t n, uint8_t* key);
+
+// Open a counter of the dTLB load misses of the process (user space). Returns
+// -1 if the counter is not available (no PMU, e.g. in a virtual machine, or
+// restricted by /proc/sys/kernel/perf_event_paranoid).
+static int open_dtlb_counter();
+
+// Get the memory of the process backed by huge pages (bytes).
+static uint64_t huge_page_memory();
+
+// Search random keys with the huge page mode.
+static bool search(const uint64_t* keys,
+                   uint64_t nkeys,
+                   uint64_t nlookups,
+                   const char* name,
+                   db::index::index::huge_page_mode mode);
+
+int main(int argc, const char** argv)
+{
+  if (argc != 3) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  char* endptr;
+  uint64_t nkeys = strtoull(argv[1], &endptr, 10);
+  if ((*endptr) || (nkeys == 0)) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  uint64_t nlookups = strtoull(argv[2], &endptr, 10);
+  if ((*endptr) || (nlookups == 0)) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  uint64_t* keys;
+  if ((keys = static_cast<uint64_t*>(malloc(nkeys * sizeof(uint64_t)))) ==
+      NULL) {
+    fprintf(stderr, "Error allocating memory.\n");
+    return -1;
+  }
+
+  uint64_t state = 88172645463325252ull;
+  for (uint64_t i = 0; i < nkeys; i++) {
+    keys[i] = random_number(state);
+  }
+
+  unlink(kFilename);
+
+  bool ret = true;
+
+  {
+    db::index::index index;
+    if (!index.open(kFilename)) {
+      fprintf(stderr, "Error opening index.\n");
+      ret = false;
+    }
+
+    for (uint64_t i = 0; (ret) && (i < nkeys); i++) {
+      uint8_t key[sizeof(uint64_t)];
+      encode(keys[i], key);
+
+      if (!index.add(key, sizeof(key), i, NULL)) {
+        fprintf(stderr, "Error adding key %lu.\n", keys[i]);
+        ret = false;
+      }
+    }
+  }
+
+  for (size_t i = 0; (ret) && (i < sizeof(kModes) / sizeof(kModes[0])); i++) {
+    ret = search(keys, nkeys, nlookups, kModes[i].name, kModes[i].mode);
+  }
+
+  free(keys);
+
+  unlink(kFilename);
+
+  return ret ? 0 : -1;
+}
+
+void usage(const char* program)
+{
+  printf("Usage: %s <number-keys> <number-lookups>\n", program);
+  printf("<number-keys> ::= 1 .. %llu\n", ULLONG_MAX);
+  printf("<number-lookups> ::= 1 .. %llu\n", ULLONG_MAX);
+}
+
+uint64_t now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (static_cast<uint64_t>(ts.tv_sec) * 1000000000ull) + ts.tv_nsec;
+}
+
+uint64_t random_number(uint64_t& state)
+{
+  // xorshift64*.
+  state ^= state >> 12;
+  state ^= state << 25;
+  state ^= state >> 27;
+
+  return state * 0x2545f4914f6cdd1dull;
+}
+
+void encode(uint64_t n, uint8_t* key)
+{
+  for (size_t j = 0; j < sizeof(uint64_t); j++) {
+    key[j] = static_cast<uint8_t>(n >> (56 - (j * 8)));
+  }
+}
+
+int open_dtlb_counter()
+{
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+
+  attr.type = PERF_TYPE_HW_CACHE;
+  attr.size = sizeof(attr);
+  attr.config = PERF_COUNT_HW_CACHE_DTLB |
+                (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+
+  return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+uint64_t huge_page_memory()
+{
+  FILE* file;
+  if ((file = fopen("/proc/self/smaps_rollup", "r")) == NULL) {
+    return 0;
+  }
+
+  uint64_t total = 0;
+
+  char line[256];
+  while (fgets(line, sizeof(line), file)) {
+    unsigned long long kb;
+    if ((sscanf(line, "AnonHugePages: %llu kB", &kb) == 1) ||
+        (sscanf(line, "FilePmdMapped: %llu kB", &kb) == 1) ||
+        (sscanf(line, "ShmemPmdMapped: %llu kB", &kb) == 1)) {
+      total += kb * 1024;
+    }
+  }
+
+  fclose(file);
+
+  return total;
+}
+
+bool search(const uint64_t* keys,
+            uint64_t nkeys,
+            uint64_t nlookups,
+            const char* name,
+            db::index::index::huge_page_mode mode)
+{
+  db::index::index index;
+
+  // The whole index is loaded, so that the page faults are not measured.
+  db::index::index::options opts;
+  opts.prefault_inner_nodes = true;
+  opts.prefault_leaf_nodes = true;
+  opts.huge_pages = mode;
+
+  if (!index.open(kFilename, opts)) {
+    fprintf(stderr, "Error opening index.\n");
+    return false;
+  }
+
+  int fd = open_dtlb_counter();
+  if (fd != -1) {
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+
+  uint64_t state = 0x9e3779b97f4a7c15ull;
+
+  uint64_t start = now();
+
+  for (uint64_t i = 0; i < nlookups; i++) {
+    uint8_t key[sizeof(uint64_t)];
+    encode(keys[random_number(state) % nkeys], key);
+
+    uint64_t dataoff;
+    if (!index.find(key, sizeof(key), NULL, dataoff)) {
+      fprintf(stderr, "Error finding key.\n");
+
+      if (fd != -1) {
+        close(fd);
+      }
+
+      return false;
+    }
+  }
+
+  uint64_t elapsed = now() - start;
+
+  uint64_t misses;
+  if (fd != -1) {
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+
+    if (read(fd, &misses, sizeof(misses)) != sizeof(misses)) {
+      close(fd);
+      fd = -1;
+    }
+  }
+
+  printf("Huge pages: %s.\n", name);
+  printf("\t%.1f ns/lookup (%.0f lookups/s).\n",
+         static_cast<double>(elapsed) / nlookups,
+         (elapsed > 0) ? (nlookups * 1e9) / elapsed : 0.0);
+
+  if (fd != -1) {
+    printf("\t%.2f dTLB misses/lookup.\n",
+           static_cast<double>(misses) / nlookups);
+
+    close(fd);
+  } else {
+    printf("\tdTLB misses: n/a.\n");
+  }
+
+  printf("\t%lu MB in huge pages.\n", huge_page_memory() / (1024 * 1024));
+
+  return true;
+}
@@ -0,0 +1,298 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include "key/encoder.h"
+#include "index/index.h"
+
+static const char* kFieldsFilename = "benchkey-fields.idx";
+static const char* kEncodedFilename = "benchkey-encoded.idx";
+static const size_t kStringLen = 12;
+
+// Tuple (a: signed integer, b: string, c: double in descending order).
+struct tuple {
+  int64_t a;
+  char b[kStringLen];
+  double c;
+};
+
+static void usage(const char* program);
+
+static uint64_t now();
+
+static uint64_t random_number(uint64_t& state);
+
+static void random_tuple(uint64_t& state, uint64_t ntuples, struct tuple& t);
+
+// Key with the fields stored as is: a, length of b, b, c.
+static keylen_t encode_fields(const struct tuple& t, uint8_t* key);
+
+// Key built by the encoder.
+static keylen_t encode(const struct tuple& t, uint8_t* key);
+
+// Comparator which decodes the fields.
+static int comp_fields(const void* key1,
+                       keylen_t keylen1,
+                       const void* key2,
+                       keylen_t keylen2);
+
+static bool lookup(const db::index::index& index,
+                   const struct tuple* tuples,
+                   uint64_t ntuples,
+                   uint64_t nlookups,
+                   keylen_t (*encode_key)(const struct tuple&, uint8_t*),
+                   comparator_t comp,
+                   uint64_t& elapsed);
+
+int main(int argc, const char** argv)
+{
+  if (argc != 3) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  char* endptr;
+  uint64_t ntuples = strtoull(argv[1], &endptr, 10);
+  if ((*endptr) || (ntuples == 0)) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  uint64_t nlookups = strtoull(argv[2], &endptr, 10);
+  if ((*endptr) || (nlookups == 0)) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  struct tuple* tuples;
+  if ((tuples = reinterpret_cast<struct tuple*>(
+                  malloc(ntuples * sizeof(struct tuple))
+                )) == NULL) {
+    fprintf(stderr, "Error allocating memory.\n");
+    return -1;
+  }
+
+  uint64_t state = 88172645463325252ull;
+
+  for (uint64_t i = 0; i < ntuples; i++) {
+    random_tuple(state, ntuples, tuples[i]);
+  }
+
+  unlink(kFieldsFilename);
+  unlink(kEncodedFilename);
+
+  db::index::index fields;
+  db::index::index encoded;
+  if ((!fields.open(kFieldsFilename)) || (!encoded.open(kEncodedFilename))) {
+    fprintf(stderr, "Error opening index.\n");
+    return -1;
+  }
+
+  // Add keys.
+  printf("Adding %lu keys...\n", ntuples);
+
+  uint64_t fields_len = 0;
+  uint64_t encoded_len = 0;
+
+  for (uint64_t i = 0; i < ntuples; i++) {
+    uint8_t key[kKeyMaxLen];
+    keylen_t keylen = encode_fields(tuples[i], key);
+
+    if (!fields.add(key, keylen, i, comp_fields)) {
+      fprintf(stderr, "Error adding tuple %lu.\n", i);
+      return -1;
+    }
+
+    fields_len += keylen;
+
+    keylen = encode(tuples[i], key);
+
+    if (!encoded.add(key, keylen, i, NULL)) {
+      fprintf(stderr, "Error adding tuple %lu.\n", i);
+      return -1;
+    }
+
+    encoded_len += keylen;
+  }
+
+  // Search keys.
+  printf("Searching keys...\n");
+
+  uint64_t elapsed1, elapsed2;
+  if ((!lookup(fields,
+               tuples,
+               ntuples,
+               nlookups,
+               encode_fields,
+               comp_fields,
+               elapsed1)) ||
+      (!lookup(encoded, tuples, ntuples, nlookups, encode, NULL, elapsed2))) {
+    return -1;
+  }
+
+  printf("\nField-wise comparator:\n");
+  printf("\tAverage key length: %.1f bytes.\n",
+         static_cast<double>(fields_len) / ntuples);
+  printf("\t%.0f lookups/s (%.1f ns/lookup).\n",
+         nlookups / (elapsed1 / 1e9),
+         static_cast<double>(elapsed1) / nlookups);
+
+  printf("\nEncoded keys (memcmp):\n");
+  printf("\tAverage key length: %.1f bytes.\n",
+         static_cast<double>(encoded_len) / ntuples);
+  printf("\t%.0f lookups/s (%.1f ns/lookup).\n",
+         nlookups / (elapsed2 / 1e9),
+         static_cast<double>(elapsed2) / nlookups);
+
+  fields.close();
+  encoded.close();
+
+  unlink(kFieldsFilename);
+  unlink(kEncodedFilename);
+
+  free(tuples);
+
+  return 0;
+}
+
+void usage(const char* program)
+{
+  printf("Usage: %s <number-keys> <number-lookups>\n", program);
+  printf("<number-keys> ::= 1 .. %llu\n", ULLONG_MAX);
+  printf("<number-lookups> ::= 1 .. %llu\n", ULLONG_MAX);
+}
+
+uint64_t now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (static_cast<uint64_t>(ts.tv_sec) * 1000000000ull) + ts.tv_nsec;
+}
+
+uint64_t random_number(uint64_t& state)
+{
+  // xorshift64*.
+  state ^= state >> 12;
+  state ^= state << 25;
+  state ^= state >> 27;
+
+  return state * 0x2545f4914f6cdd1dull;
+}
+
+void random_tuple(uint64_t& state, uint64_t ntuples, struct tuple& t)
+{
+  // Few distinct values of the first columns, so that all the columns are
+  // compared.
+  t.a = static_cast<int64_t>(random_number(state) % ((ntuples / 256) + 1));
+
+  for (size_t i = 0; i < kStringLen; i++) {
+    t.b[i] = 'a' + (random_number(state) % 4);
+  }
+
+  t.c = static_cast<double>(random_number(state) % 1000000) / 100.0;
+}
+
+keylen_t encode_fields(const struct tuple& t, uint8_t* key)
+{
+  keylen_t len = 0;
+
+  memcpy(key + len, &t.a, sizeof(int64_t));
+  len += sizeof(int64_t);
+
+  key[len++] = kStringLen;
+
+  memcpy(key + len, t.b, kStringLen);
+  len += kStringLen;
+
+  memcpy(key + len, &t.c, sizeof(double));
+  len += sizeof(double);
+
+  return len;
+}
+
+keylen_t encode(const struct tuple& t, uint8_t* key)
+{
+  db::key::encoder encoder(key, kKeyMaxLen);
+
+  encoder.add_int(t.a);
+  encoder.add_string(t.b, kStringLen);
+  encoder.add_double(t.c, db::key::order::kDescending);
+
+  return encoder.length();
+}
+
+int comp_fields(const void* key1,
+                keylen_t keylen1,
+                const void* key2,
+                keylen_t keylen2)
+{
+  const uint8_t* k1 = reinterpret_cast<const uint8_t*>(key1);
+  const uint8_t* k2 = reinterpret_cast<const uint8_t*>(key2);
+
+  int64_t a1, a2;
+  memcpy(&a1, k1, sizeof(int64_t));
+  memcpy(&a2, k2, sizeof(int64_t));
+
+  if (a1 != a2) {
+    return (a1 < a2) ? -1 : +1;
+  }
+
+  k1 += sizeof(int64_t);
+  k2 += sizeof(int64_t);
+
+  uint8_t len1 = *k1++;
+  uint8_t len2 = *k2++;
+
+  int ret;
+  if ((ret = memcmp(k1, k2, (len1 < len2) ? len1 : len2)) != 0) {
+    return (ret < 0) ? -1 : +1;
+  } else if (len1 != len2) {
+    return (len1 < len2) ? -1 : +1;
+  }
+
+  k1 += len1;
+  k2 += len2;
+
+  double c1, c2;
+  memcpy(&c1, k1, sizeof(double));
+  memcpy(&c2, k2, sizeof(double));
+
+  if (c1 != c2) {
+    return (c1 > c2) ? -1 : +1;
+  }
+
+  return 0;
+}
+
+bool lookup(const db::index::index& index,
+            const struct tuple* tuples,
+            uint64_t ntuples,
+            uint64_t nlookups,
+            keylen_t (*encode_key)(const struct tuple&, uint8_t*),
+            comparator_t comp,
+            uint64_t& elapsed)
+{
+  uint64_t state = 88172645463325252ull;
+
+  uint64_t start = now();
+
+  for (uint64_t i = 0; i < nlookups; i++) {
+    const struct tuple& t = tuples[random_number(state) % ntuples];
+
+    uint8_t key[kKeyMaxLen];
+    keylen_t keylen = encode_key(t, key);
+
+    uint64_t dataoff;
+    if (!index.find(key, keylen, comp, dataoff)) {
+      fprintf(stderr, "Error finding tuple.\n");
+      return false;
+    }
+  }
+
+  elapsed = now() - start;
+
+  return true;
+}
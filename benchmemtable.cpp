@@ -0,0 +1,182 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "index/index.h"
+
+static const char* kDirectFilename = "benchmemtable-direct.idx";
+static const char* kBufferedFilename = "benchmemtable-buffered.idx";
+
+static void usage(const char* program);
+
+static uint64_t now();
+
+static uint64_t random_number(uint64_t& state);
+
+// Compare keys byte by byte (the memtable needs the comparator).
+static int comp(const void* key1,
+                keylen_t keylen1,
+                const void* key2,
+                keylen_t keylen2);
+
+// Add random keys and sync the index to disk.
+static bool insert(const char* filename,
+                   uint64_t memtable_size,
+                   uint64_t nkeys,
+                   uint64_t& elapsed,
+                   uint64_t& filesize);
+
+int main(int argc, const char** argv)
+{
+  if (argc != 3) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  char* endptr;
+  uint64_t nkeys = strtoull(argv[1], &endptr, 10);
+  if ((*endptr) || (nkeys == 0)) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  uint64_t memtable_size = strtoull(argv[2], &endptr, 10);
+  if ((*endptr) || (memtable_size == 0)) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  memtable_size *= 1024 * 1024;
+
+  printf("Adding %lu random keys...\n", nkeys);
+
+  uint64_t elapsed1, elapsed2;
+  uint64_t filesize1, filesize2;
+  if ((!insert(kDirectFilename, 0, nkeys, elapsed1, filesize1)) ||
+      (!insert(kBufferedFilename,
+               memtable_size,
+               nkeys,
+               elapsed2,
+               filesize2))) {
+    return -1;
+  }
+
+  printf("\nWithout memtable:\n");
+  printf("\tIndex size: %lu MB.\n", filesize1 / (1024 * 1024));
+  printf("\t%.0f inserts/s (%.1f ns/insert).\n",
+         nkeys / (elapsed1 / 1e9),
+         static_cast<double>(elapsed1) / nkeys);
+
+  printf("\nWith a memtable of %lu MB:\n", memtable_size / (1024 * 1024));
+  printf("\tIndex size: %lu MB.\n", filesize2 / (1024 * 1024));
+  printf("\t%.0f inserts/s (%.1f ns/insert).\n",
+         nkeys / (elapsed2 / 1e9),
+         static_cast<double>(elapsed2) / nkeys);
+
+  unlink(kDirectFilename);
+  unlink(kBufferedFilename);
+
+  return 0;
+}
+
+void usage(const char* program)
+{
+  printf("Usage: %s <number-keys> <memtable-size>\n", program);
+  printf("<number-keys> ::= 1 .. %llu\n", ULLONG_MAX);
+  printf("<memtable-size> ::= 1 .. %llu (MB)\n", ULLONG_MAX);
+  printf("\nThe benefit of the memtable shows when the index doesn't fit in "
+         "the page cache\n(e.g. run it with a memory limit lower than the "
+         "size of the index).\n");
+}
+
+uint64_t now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (static_cast<uint64_t>(ts.tv_sec) * 1000000000ull) + ts.tv_nsec;
+}
+
+uint64_t random_number(uint64_t& state)
+{
+  // xorshift64*.
+  state ^= state >> 12;
+  state ^= state << 25;
+  state ^= state >> 27;
+
+  return state * 0x2545f4914f6cdd1dull;
+}
+
+int comp(const void* key1,
+         keylen_t keylen1,
+         const void* key2,
+         keylen_t keylen2)
+{
+  keylen_t len = (keylen1 < keylen2) ? keylen1 : keylen2;
+
+  int ret;
+  if ((ret = memcmp(key1, key2, len)) < 0) {
+    return -1;
+  } else if (ret > 0) {
+    return +1;
+  } else {
+    return (keylen1 - keylen2);
+  }
+}
+
+bool insert(const char* filename,
+            uint64_t memtable_size,
+            uint64_t nkeys,
+            uint64_t& elapsed,
+            uint64_t& filesize)
+{
+  unlink(filename);
+
+  db::index::index index;
+
+  db::index::index::options opts;
+  opts.memtable_size = memtable_size;
+  opts.comparator = comp;
+
+  if (!index.open(filename, opts)) {
+    fprintf(stderr, "Error opening index.\n");
+    return false;
+  }
+
+  uint64_t state = 88172645463325252ull;
+
+  uint64_t start = now();
+
+  for (uint64_t i = 0; i < nkeys; i++) {
+    // Big-endian random number (compared with memcmp()).
+    uint64_t n = random_number(state);
+
+    uint8_t key[sizeof(uint64_t)];
+    for (size_t j = 0; j < sizeof(uint64_t); j++) {
+      key[j] = static_cast<uint8_t>(n >> (56 - (j * 8)));
+    }
+
+    if (!index.add(key, sizeof(key), i, comp)) {
+      fprintf(stderr, "Error adding key %lu.\n", i);
+      return false;
+    }
+  }
+
+  // Apply the memtable and write the dirty pages.
+  if (!index.checkpoint()) {
+    fprintf(stderr, "Error syncing index.\n");
+    return false;
+  }
+
+  elapsed = now() - start;
+
+  index.close();
+
+  struct stat sbuf;
+  filesize = (stat(filename, &sbuf) == 0) ? sbuf.st_size : 0;
+
+  return true;
+}
@@ -0,0 +1,257 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "index/index.h"
+
+static const char* kFilename = "benchmodel.idx";
+
+// Maximum error of the model (in leaf nodes).
+static const unsigned kModelError = 4;
+
+// Key distributions.
+enum class distribution {
+  kUniform,
+  kLognormal,
+  kSequential
+};
+
+static void usage(const char* program);
+
+static uint64_t now();
+
+static uint64_t random_number(uint64_t& state);
+
+// Generate the keys of the distribution.
+static void generate(distribution d, uint64_t* keys, uint64_t nkeys);
+
+// Encode key (big-endian, compared with memcmp()).
+static void encode(uint64_t n, uint8_t* key);
+
+// Add the keys and measure the lookups with and without the model.
+static bool run(const char* name,
+                distribution d,
+                uint64_t* keys,
+                uint64_t nkeys,
+                uint64_t nlookups);
+
+// Search random keys.
+static bool search(const uint64_t* keys,
+                   uint64_t nkeys,
+                   uint64_t nlookups,
+                   unsigned model_error,
+                   uint64_t& elapsed,
+                   size_t& segments,
+                   size_t& memory);
+
+int main(int argc, const char** argv)
+{
+  if (argc != 3) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  char* endptr;
+  uint64_t nkeys = strtoull(argv[1], &endptr, 10);
+  if ((*endptr) || (nkeys == 0)) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  uint64_t nlookups = strtoull(argv[2], &endptr, 10);
+  if ((*endptr) || (nlookups == 0)) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  uint64_t* keys;
+  if ((keys = static_cast<uint64_t*>(malloc(nkeys * sizeof(uint64_t)))) ==
+      NULL) {
+    fprintf(stderr, "Error allocating memory.\n");
+    return -1;
+  }
+
+  bool ret = ((run("uniform",
+                   distribution::kUniform,
+                   keys,
+                   nkeys,
+                   nlookups)) &&
+              (run("lognormal",
+                   distribution::kLognormal,
+                   keys,
+                   nkeys,
+                   nlookups)) &&
+              (run("sequential",
+                   distribution::kSequential,
+                   keys,
+                   nkeys,
+                   nlookups)));
+
+  free(keys);
+
+  unlink(kFilename);
+
+  return ret ? 0 : -1;
+}
+
+void usage(const char* program)
+{
+  printf("Usage: %s <number-keys> <number-lookups>\n", program);
+  printf("<number-keys> ::= 1 .. %llu\n", ULLONG_MAX);
+  printf("<number-lookups> ::= 1 .. %llu\n", ULLONG_MAX);
+}
+
+uint64_t now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (static_cast<uint64_t>(ts.tv_sec) * 1000000000ull) + ts.tv_nsec;
+}
+
+uint64_t random_number(uint64_t& state)
+{
+  // xorshift64*.
+  state ^= state >> 12;
+  state ^= state << 25;
+  state ^= state >> 27;
+
+  return state * 0x2545f4914f6cdd1dull;
+}
+
+void generate(distribution d, uint64_t* keys, uint64_t nkeys)
+{
+  uint64_t state = 88172645463325252ull;
+
+  for (uint64_t i = 0; i < nkeys; i++) {
+    switch (d) {
+      case distribution::kUniform:
+        keys[i] = random_number(state);
+        break;
+      case distribution::kLognormal:
+        {
+          // Box-Muller (mu = 0, sigma = 2), scaled.
+          double u1 = (random_number(state) >> 11) / 9007199254740992.0;
+          double u2 = (random_number(state) >> 11) / 9007199254740992.0;
+
+          double z = sqrt(-2 * log(1 - u1)) * cos(2 * M_PI * u2);
+
+          double x = exp(2 * z) * 1e12;
+
+          keys[i] = (x < 1.8e19) ? static_cast<uint64_t>(x) :
+                                   18000000000000000000ull;
+        }
+
+        break;
+      case distribution::kSequential:
+        keys[i] = i;
+        break;
+    }
+  }
+}
+
+void encode(uint64_t n, uint8_t* key)
+{
+  for (size_t j = 0; j < sizeof(uint64_t); j++) {
+    key[j] = static_cast<uint8_t>(n >> (56 - (j * 8)));
+  }
+}
+
+bool run(const char* name,
+         distribution d,
+         uint64_t* keys,
+         uint64_t nkeys,
+         uint64_t nlookups)
+{
+  generate(d, keys, nkeys);
+
+  unlink(kFilename);
+
+  {
+    db::index::index index;
+    if (!index.open(kFilename)) {
+      fprintf(stderr, "Error opening index.\n");
+      return false;
+    }
+
+    for (uint64_t i = 0; i < nkeys; i++) {
+      uint8_t key[sizeof(uint64_t)];
+      encode(keys[i], key);
+
+      if (!index.add(key, sizeof(key), i, NULL)) {
+        fprintf(stderr, "Error adding key %lu.\n", keys[i]);
+        return false;
+      }
+    }
+  }
+
+  uint64_t elapsed1, elapsed2;
+  size_t segments, memory;
+  if ((!search(keys, nkeys, nlookups, 0, elapsed1, segments, memory)) ||
+      (!search(keys,
+               nkeys,
+               nlookups,
+               kModelError,
+               elapsed2,
+               segments,
+               memory))) {
+    return false;
+  }
+
+  printf("\n%s keys:\n", name);
+  printf("\tTree: %.1f ns/lookup.\n",
+         static_cast<double>(elapsed1) / nlookups);
+  printf("\tModel (error %u): %.1f ns/lookup, %zu segments, %zu KB.\n",
+         kModelError,
+         static_cast<double>(elapsed2) / nlookups,
+         segments,
+         memory / 1024);
+
+  return true;
+}
+
+bool search(const uint64_t* keys,
+            uint64_t nkeys,
+            uint64_t nlookups,
+            unsigned model_error,
+            uint64_t& elapsed,
+            size_t& segments,
+            size_t& memory)
+{
+  db::index::index index;
+
+  db::index::index::options opts;
+  opts.model_error = model_error;
+
+  if (!index.open(kFilename, opts)) {
+    fprintf(stderr, "Error opening index.\n");
+    return false;
+  }
+
+  if (index.model()) {
+    segments = index.model()->segments();
+    memory = index.model()->memory();
+  }
+
+  uint64_t state = 0x9e3779b97f4a7c15ull;
+
+  uint64_t start = now();
+
+  for (uint64_t i = 0; i < nlookups; i++) {
+    uint8_t key[sizeof(uint64_t)];
+    encode(keys[random_number(state) % nkeys], key);
+
+    uint64_t dataoff;
+    if (!index.find(key, sizeof(key), NULL, dataoff)) {
+      fprintf(stderr, "Error finding key.\n");
+      return false;
+    }
+  }
+
+  elapsed = now() - start;
+
+  return true;
+}
@@ -0,0 +1,512 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <new>
+#if defined(__x86_64__) || defined(__i386__)
+  #include <x86intrin.h>
+#endif
+#include "index/leaf_node.h"
+#include "index/inner_node.h"
+
+// Number of operations of the cache-warm runs.
+static const uint64_t kOperations = 200000;
+
+// Number of nodes of the cache-cold runs (128 MB, larger than the caches):
+// each operation uses a different node.
+static const size_t kPoolSize = 32768;
+
+// Key lengths.
+static const keylen_t kKeyLengths[] = {8, 16, 64, 256};
+
+// Fill levels of the searched nodes (percentage of the entries which fit).
+static const unsigned kFillLevels[] = {25, 50, 100};
+
+// Benchmarked operation.
+enum class operation {
+  kSearch, // Search a random key of a leaf node.
+  kInnerSearch, // Search the child of a random key in an inner node.
+  kAdd, // Add key to a half-full leaf node.
+  kLeafSplit, // Add key to a full leaf node.
+  kInnerSplit, // Add key to a full inner node.
+  kDefrag // Add key to a leaf node whose free space is fragmented.
+};
+
+struct benchmark {
+  operation op;
+
+  keylen_t keylen;
+
+  // Node before each operation.
+  const uint8_t* node;
+
+  // Number of keys of the node.
+  nodeoff_t nentries;
+
+  // Key to add (odd number, between the keys of the node).
+  uint64_t key;
+};
+
+static void usage(const char* program);
+
+static uint64_t random_number(uint64_t& state);
+
+// Read the time stamp counter (the clock in ns if there is none).
+static uint64_t ticks();
+
+// Build key (the number with leading zeros).
+static void make_key(uint64_t n, keylen_t keylen, char* key);
+
+// Fill leaf node with the keys 0, 2, 4... (up to `nentries` keys, 0: as
+// many as fit). Returns the number of keys.
+static nodeoff_t fill_leaf(uint8_t* data, keylen_t keylen, nodeoff_t nentries);
+
+static nodeoff_t fill_inner(uint8_t* data, keylen_t keylen, nodeoff_t nentries);
+
+// Get the free space between the entries and the keys of the leaf node.
+static size_t available(const db::index::leaf_node* leaf);
+
+// Run operation on the node (`right` is the memory of the right node of the
+// splits). Returns the ticks of the operation.
+static uint64_t run_operation(const struct benchmark& b,
+                              uint8_t* node,
+                              uint8_t* right,
+                              uint64_t& state);
+
+// Run benchmark. Returns the ticks per operation.
+static double run(const struct benchmark& b,
+                  bool cold,
+                  uint8_t* pool,
+                  uint8_t* evict);
+
+// Print the result of the benchmark (cache warm and cold).
+static void print(const char* name,
+                  const struct benchmark& b,
+                  uint8_t* pool,
+                  uint8_t* evict);
+
+// Ticks of an empty measure.
+static double overhead = 0;
+
+int main(int argc, const char** argv)
+{
+  if (argc != 1) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  uint8_t* pool;
+  uint8_t* evict;
+  if ((pool = static_cast<uint8_t*>(malloc(2 * kPoolSize * kNodeSize))) ==
+      NULL) {
+    fprintf(stderr, "Error allocating memory.\n");
+    return -1;
+  }
+
+  if ((evict = static_cast<uint8_t*>(malloc(kPoolSize * kNodeSize))) ==
+      NULL) {
+    fprintf(stderr, "Error allocating memory.\n");
+    free(pool);
+    return -1;
+  }
+
+  // Touch the memory.
+  memset(pool, 0, 2 * kPoolSize * kNodeSize);
+  memset(evict, 0, kPoolSize * kNodeSize);
+
+  // Measure the overhead of ticks().
+  uint64_t total = 0;
+  for (uint64_t i = 0; i < kOperations; i++) {
+    uint64_t t = ticks();
+    total += ticks() - t;
+  }
+
+  overhead = static_cast<double>(total) / kOperations;
+
+#if defined(__x86_64__) || defined(__i386__)
+  printf("Cycles (time stamp counter) per operation, cache warm / cold.\n");
+#else
+  printf("Nanoseconds per operation, cache warm / cold.\n");
+#endif
+
+  for (size_t k = 0; k < sizeof(kKeyLengths) / sizeof(kKeyLengths[0]); k++) {
+    keylen_t keylen = kKeyLengths[k];
+
+    printf("\nKey length: %u bytes.\n", keylen);
+
+    uint8_t node[kNodeSize];
+
+    struct benchmark b;
+    b.keylen = keylen;
+    b.node = node;
+
+    // Number of keys which fit in a leaf node.
+    nodeoff_t capacity = fill_leaf(node, keylen, 0);
+
+    char name[64];
+
+    // Search.
+    b.op = operation::kSearch;
+
+    for (size_t f = 0; f < sizeof(kFillLevels) / sizeof(kFillLevels[0]); f++) {
+      b.nentries = fill_leaf(node,
+                             keylen,
+                             (capacity * kFillLevels[f] + 99) / 100);
+
+      snprintf(name,
+               sizeof(name),
+               "leaf search (%u%% full, %u keys)",
+               kFillLevels[f],
+               b.nentries);
+
+      print(name, b, pool, evict);
+    }
+
+    b.op = operation::kInnerSearch;
+    b.nentries = fill_inner(node, keylen, 0);
+
+    snprintf(name, sizeof(name), "inner search (%u keys)", b.nentries);
+    print(name, b, pool, evict);
+
+    // Add at the front, in the middle and at the end (the entries after the
+    // position are moved).
+    b.op = operation::kAdd;
+    b.nentries = fill_leaf(node, keylen, capacity / 2);
+
+    b.key = 1;
+    print("add (front)", b, pool, evict);
+
+    b.key = b.nentries + 1;
+    print("add (middle)", b, pool, evict);
+
+    b.key = (2 * b.nentries) + 1;
+    print("add (end)", b, pool, evict);
+
+    // Split (the new key goes to the left or to the right node).
+    static const unsigned kSplitPositions[] = {0, 25, 50, 75, 100};
+
+    b.op = operation::kLeafSplit;
+    b.nentries = fill_leaf(node, keylen, 0);
+
+    for (size_t p = 0;
+         p < sizeof(kSplitPositions) / sizeof(kSplitPositions[0]);
+         p++) {
+      b.key = (2 * ((b.nentries * kSplitPositions[p]) / 100)) + 1;
+
+      snprintf(name,
+               sizeof(name),
+               "leaf split (key at %u%%)",
+               kSplitPositions[p]);
+
+      print(name, b, pool, evict);
+    }
+
+    b.op = operation::kInnerSplit;
+    b.nentries = fill_inner(node, keylen, 0);
+
+    for (size_t p = 0;
+         p < sizeof(kSplitPositions) / sizeof(kSplitPositions[0]);
+         p++) {
+      b.key = (2 * ((b.nentries * kSplitPositions[p]) / 100)) + 1;
+
+      snprintf(name,
+               sizeof(name),
+               "inner split (key at %u%%)",
+               kSplitPositions[p]);
+
+      print(name, b, pool, evict);
+    }
+
+    // Defragmentation: half of the entries of a full node are removed (the
+    // space of their keys is reclaimed when a key doesn't fit) and the free
+    // space is filled.
+    b.op = operation::kDefrag;
+    b.nentries = fill_leaf(node, keylen, 0);
+
+    db::index::leaf_node* leaf = reinterpret_cast<db::index::leaf_node*>(node);
+    for (nodeoff_t i = b.nentries; i > 0; i--) {
+      if ((i % 2) == 0) {
+        leaf->remove(i - 1);
+      }
+    }
+
+    for (uint64_t n = (2 * b.nentries) + 1;
+         available(leaf) >= sizeof(db::index::leaf_node::entry) + keylen;
+         n += 2) {
+      char key[kKeyMaxLen];
+      make_key(n, keylen, key);
+
+      leaf->add(key, keylen, n, NULL);
+    }
+
+    b.nentries = leaf->nentries;
+    b.key = 3;
+    print("defrag (add to fragmented node)", b, pool, evict);
+  }
+
+  free(evict);
+  free(pool);
+
+  return 0;
+}
+
+void usage(const char* program)
+{
+  printf("Usage: %s\n", program);
+  printf("\nMeasures the primitives of the leaf and inner nodes: search at "
+         "several fill\nlevels, add at the front, middle and end, split at "
+         "several positions and\ndefragmentation, with the node in the cache "
+         "and not.\n");
+}
+
+uint64_t random_number(uint64_t& state)
+{
+  // xorshift64*.
+  state ^= state >> 12;
+  state ^= state << 25;
+  state ^= state >> 27;
+
+  return state * 0x2545f4914f6cdd1dull;
+}
+
+uint64_t ticks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (static_cast<uint64_t>(ts.tv_sec) * 1000000000ull) + ts.tv_nsec;
+#endif
+}
+
+void make_key(uint64_t n, keylen_t keylen, char* key)
+{
+  // The number is right aligned, padded with zeros.
+  memset(key, '0', keylen);
+
+  for (keylen_t i = keylen; (i > 0) && (n > 0); i--) {
+    key[i - 1] = '0' + (n % 10);
+    n /= 10;
+  }
+}
+
+nodeoff_t fill_leaf(uint8_t* data, keylen_t keylen, nodeoff_t nentries)
+{
+  db::index::leaf_node* node = new (data) db::index::leaf_node();
+
+  nodeoff_t i;
+  for (i = 0; (nentries == 0) || (i < nentries); i++) {
+    char key[kKeyMaxLen];
+    make_key(2 * i, keylen, key);
+
+    // Add at the end.
+    if (!node->add(key,
+                   keylen,
+                   db::index::leaf_node::value_type::kExternal,
+                   NULL,
+                   i,
+                   i)) {
+      break;
+    }
+  }
+
+  return i;
+}
+
+nodeoff_t fill_inner(uint8_t* data, keylen_t keylen, nodeoff_t nentries)
+{
+  db::index::inner_node* node = new (data) db::index::inner_node();
+
+  node->left = kNodeSize;
+  node->leftcount = 1;
+
+  nodeoff_t i;
+  for (i = 0; (nentries == 0) || (i < nentries); i++) {
+    char key[kKeyMaxLen];
+    make_key(2 * i, keylen, key);
+
+    // Add at the end.
+    if (!node->add(key, keylen, (i + 2) * kNodeSize, 1, i)) {
+      break;
+    }
+  }
+
+  return i;
+}
+
+size_t available(const db::index::leaf_node* leaf)
+{
+  const uint8_t* end = reinterpret_cast<const uint8_t*>(
+                         &leaf->entries[leaf->nentries]
+                       );
+
+  return leaf->nextoff - (end - reinterpret_cast<const uint8_t*>(leaf));
+}
+
+uint64_t run_operation(const struct benchmark& b,
+                       uint8_t* node,
+                       uint8_t* right,
+                       uint64_t& state)
+{
+  char key[kKeyMaxLen];
+
+  switch (b.op) {
+    case operation::kSearch:
+      {
+        make_key(2 * (random_number(state) % b.nentries), b.keylen, key);
+
+        nodeoff_t pos;
+
+        uint64_t t = ticks();
+        reinterpret_cast<db::index::leaf_node*>(node)->search(key,
+                                                              b.keylen,
+                                                              NULL,
+                                                              pos);
+        return ticks() - t;
+      }
+
+    case operation::kInnerSearch:
+      {
+        make_key(2 * (random_number(state) % b.nentries), b.keylen, key);
+
+        uint64_t t = ticks();
+        reinterpret_cast<db::index::inner_node*>(node)->search_child(key,
+                                                                     b.keylen,
+                                                                     NULL);
+        return ticks() - t;
+      }
+
+    case operation::kAdd:
+    case operation::kDefrag:
+      {
+        make_key(b.key, b.keylen, key);
+
+        uint64_t t = ticks();
+        reinterpret_cast<db::index::leaf_node*>(node)->add(key,
+                                                           b.keylen,
+                                                           b.key,
+                                                           NULL);
+        return ticks() - t;
+      }
+
+    case operation::kLeafSplit:
+      {
+        make_key(b.key, b.keylen, key);
+
+        db::index::leaf_node* leaf = reinterpret_cast<db::index::leaf_node*>(
+                                       node
+                                     );
+
+        // Position of the key (one of the positions of a real split).
+        nodeoff_t pos;
+        leaf->search(key, b.keylen, NULL, pos);
+
+        uint64_t t = ticks();
+        leaf->split(kNodeSize,
+                    2 * kNodeSize,
+                    new (right) db::index::leaf_node(),
+                    pos,
+                    key,
+                    b.keylen,
+                    db::index::leaf_node::value_type::kExternal,
+                    NULL,
+                    b.key);
+        return ticks() - t;
+      }
+
+    case operation::kInnerSplit:
+      {
+        make_key(b.key, b.keylen, key);
+
+        db::index::inner_node* inner =
+                                   reinterpret_cast<db::index::inner_node*>(
+                                     node
+                                   );
+
+        nodeoff_t pos;
+        inner->search(key, b.keylen, NULL, pos);
+
+        uint8_t upkey[kKeyMaxLen];
+        keylen_t upkeylen;
+
+        uint64_t t = ticks();
+        inner->split(new (right) db::index::inner_node(),
+                     pos,
+                     key,
+                     b.keylen,
+                     3 * kNodeSize,
+                     1,
+                     upkey,
+                     upkeylen);
+        return ticks() - t;
+      }
+  }
+
+  return 0;
+}
+
+double run(const struct benchmark& b, bool cold, uint8_t* pool, uint8_t* evict)
+{
+  // Does the operation modify the node?
+  bool modifies = ((b.op != operation::kSearch) &&
+                   (b.op != operation::kInnerSearch));
+
+  uint64_t state = 88172645463325252ull;
+  uint64_t total = 0;
+  uint64_t noperations;
+
+  if (!cold) {
+    uint8_t node[kNodeSize];
+    uint8_t right[kNodeSize];
+
+    memcpy(node, b.node, kNodeSize);
+
+    for (noperations = 0; noperations < kOperations; noperations++) {
+      if (modifies) {
+        memcpy(node, b.node, kNodeSize);
+      }
+
+      total += run_operation(b, node, right, state);
+    }
+  } else {
+    // Copy the node to the pool and evict it from the caches.
+    for (size_t i = 0; i < kPoolSize; i++) {
+      memcpy(pool + (i * kNodeSize), b.node, kNodeSize);
+    }
+
+    memset(evict, static_cast<int>(state), kPoolSize * kNodeSize);
+
+    // Each operation uses a random node of the pool (and a node of the
+    // second half of the pool as right node).
+    for (noperations = 0; noperations < kPoolSize; noperations++) {
+      size_t i = random_number(state) % kPoolSize;
+
+      total += run_operation(b,
+                             pool + (i * kNodeSize),
+                             pool + ((kPoolSize + i) * kNodeSize),
+                             state);
+
+      // Restore the node (it might be used again).
+      if (modifies) {
+        memcpy(pool + (i * kNodeSize), b.node, kNodeSize);
+      }
+    }
+  }
+
+  double t = (static_cast<double>(total) / noperations) - overhead;
+
+  return (t > 0) ? t : 0;
+}
+
+void print(const char* name,
+           const struct benchmark& b,
+           uint8_t* pool,
+           uint8_t* evict)
+{
+  printf("\t%-36s %8.0f / %8.0f\n",
+         name,
+         run(b, false, pool, evict),
+         run(b, true, pool, evict));
+}
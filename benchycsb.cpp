@@ -0,0 +1,577 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "index/index.h"
+
+static const char* kFilename = "benchycsb.idx";
+
+// Size of the segments of the value log (values longer than
+// kInlineValueMaxLen).
+static const uint64_t kValueLogSegmentSize = 64 * 1024 * 1024;
+
+// Skew of the zipfian distribution (as in YCSB).
+static const double kZipfianConstant = 0.99;
+
+// Maximum length of a scan (workload E).
+static const uint64_t kMaxScanLength = 100;
+
+// Mix of operations of a workload (percentages).
+struct workload {
+  char name;
+  unsigned read;
+  unsigned update;
+  unsigned insert;
+  unsigned scan;
+  unsigned read_modify_write;
+
+  // Read the latest records?
+  bool latest;
+};
+
+static const struct workload kWorkloads[] = {
+  {'a', 50, 50, 0, 0, 0, false}, // Update heavy.
+  {'b', 95, 5, 0, 0, 0, false}, // Read mostly.
+  {'c', 100, 0, 0, 0, 0, false}, // Read only.
+  {'d', 95, 0, 5, 0, 0, true}, // Read latest.
+  {'e', 0, 0, 5, 95, 0, false}, // Short ranges.
+  {'f', 50, 0, 0, 0, 50, false} // Read-modify-write.
+};
+
+// Distribution of the keys.
+enum class distribution {
+  kUniform,
+  kZipfian,
+  kSequential
+};
+
+// Zipfian generator (Gray et al., "Quickly generating billion-record
+// synthetic databases").
+struct zipfian {
+  uint64_t n;
+  double theta;
+  double alpha;
+  double zetan;
+  double eta;
+};
+
+static void usage(const char* program);
+
+static uint64_t now();
+
+static uint64_t random_number(uint64_t& state);
+
+// Random number in [0, 1).
+static double random_double(uint64_t& state);
+
+// Hash (FNV-1a of the bytes of the number).
+static uint64_t hash(uint64_t n);
+
+static void init_zipfian(struct zipfian& z, uint64_t n, double theta);
+
+static uint64_t next_zipfian(const struct zipfian& z, uint64_t& state);
+
+// Build the key of the record: 8 bytes (the number of the record for the
+// sequential distribution, its hash otherwise) padded to `keylen`.
+static void make_key(distribution d, uint64_t n, keylen_t keylen, uint8_t* key);
+
+// Add or update record.
+static bool write_record(db::index::index& index,
+                         const uint8_t* key,
+                         keylen_t keylen,
+                         uint64_t n,
+                         uint8_t* value,
+                         uint32_t valuelen);
+
+// Read record.
+static bool read_record(const db::index::index& index,
+                        const uint8_t* key,
+                        keylen_t keylen,
+                        uint32_t valuelen,
+                        uint64_t& checksum);
+
+// Drop the pages of the file from the page cache.
+static void drop_cache(const char* filename);
+
+// Remove the index and its value log.
+static void remove_index();
+
+// Get the size of the index and its value log.
+static uint64_t index_size();
+
+// Get the resident set size (KB).
+static uint64_t rss();
+
+static int compare_latencies(const void* l1, const void* l2);
+
+int main(int argc, const char** argv)
+{
+  if (argc != 8) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  const struct workload* w = NULL;
+  for (size_t i = 0; i < sizeof(kWorkloads) / sizeof(kWorkloads[0]); i++) {
+    if ((strlen(argv[1]) == 1) && ((argv[1][0] | 0x20) == kWorkloads[i].name)) {
+      w = &kWorkloads[i];
+    }
+  }
+
+  if (!w) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  distribution d;
+  if (strcasecmp(argv[2], "uniform") == 0) {
+    d = distribution::kUniform;
+  } else if (strcasecmp(argv[2], "zipfian") == 0) {
+    d = distribution::kZipfian;
+  } else if (strcasecmp(argv[2], "sequential") == 0) {
+    d = distribution::kSequential;
+  } else {
+    usage(argv[0]);
+    return -1;
+  }
+
+  char* endptr;
+  uint64_t nrecords = strtoull(argv[3], &endptr, 10);
+  if ((*endptr) || (nrecords == 0)) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  uint64_t noperations = strtoull(argv[4], &endptr, 10);
+  if ((*endptr) || (noperations == 0)) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  unsigned long n = strtoul(argv[5], &endptr, 10);
+  if ((*endptr) || (n < sizeof(uint64_t)) || (n > kKeyMaxLen)) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  keylen_t keylen = static_cast<keylen_t>(n);
+
+  n = strtoul(argv[6], &endptr, 10);
+  if ((*endptr) || (n > UINT_MAX)) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  uint32_t valuelen = static_cast<uint32_t>(n);
+
+  bool cold;
+  if (strcasecmp(argv[7], "warm") == 0) {
+    cold = false;
+  } else if (strcasecmp(argv[7], "cold") == 0) {
+    cold = true;
+  } else {
+    usage(argv[0]);
+    return -1;
+  }
+
+  uint8_t* value = NULL;
+  if ((valuelen > 0) &&
+      ((value = static_cast<uint8_t*>(malloc(valuelen))) == NULL)) {
+    fprintf(stderr, "Error allocating memory.\n");
+    return -1;
+  }
+
+  uint64_t* latencies;
+  if ((latencies = static_cast<uint64_t*>(
+                     malloc(noperations * sizeof(uint64_t))
+                   )) == NULL) {
+    fprintf(stderr, "Error allocating memory.\n");
+    free(value);
+    return -1;
+  }
+
+  db::index::index::options opts;
+  if (valuelen > kInlineValueMaxLen) {
+    opts.value_log_segment_size = kValueLogSegmentSize;
+  }
+
+  remove_index();
+
+  db::index::index index;
+
+  // Load the records.
+  {
+    if (!index.open(kFilename, opts)) {
+      fprintf(stderr, "Error opening index.\n");
+      return -1;
+    }
+
+    for (uint64_t i = 0; i < nrecords; i++) {
+      uint8_t key[kKeyMaxLen];
+      make_key(d, i, keylen, key);
+
+      if (!write_record(index, key, keylen, i, value, valuelen)) {
+        fprintf(stderr, "Error adding record %lu.\n", i);
+        return -1;
+      }
+    }
+
+    index.close();
+
+    if (cold) {
+      drop_cache(kFilename);
+    }
+  }
+
+  if (!index.open(kFilename, opts)) {
+    fprintf(stderr, "Error opening index.\n");
+    return -1;
+  }
+
+  struct zipfian z;
+  init_zipfian(z, nrecords, kZipfianConstant);
+
+  uint64_t state = 88172645463325252ull;
+  uint64_t next = 0;
+  uint64_t count = nrecords;
+  uint64_t checksum = 0;
+
+  uint64_t start = now();
+
+  for (uint64_t i = 0; i < noperations; i++) {
+    // Choose the operation.
+    unsigned r = random_number(state) % 100;
+
+    // Choose the record.
+    uint64_t rec;
+    if (w->latest) {
+      uint64_t k = next_zipfian(z, state);
+      rec = (k < count) ? count - 1 - k : 0;
+    } else {
+      switch (d) {
+        case distribution::kUniform:
+          rec = random_number(state) % count;
+          break;
+        case distribution::kZipfian:
+          // Scrambled: the popular records are spread over the key space.
+          rec = hash(next_zipfian(z, state)) % count;
+          break;
+        default:
+          rec = next++ % count;
+      }
+    }
+
+    uint8_t key[kKeyMaxLen];
+
+    uint64_t t = now();
+
+    bool ret;
+    if (r < w->read) {
+      make_key(d, rec, keylen, key);
+      ret = read_record(index, key, keylen, valuelen, checksum);
+    } else if (r < w->read + w->update) {
+      make_key(d, rec, keylen, key);
+      ret = write_record(index, key, keylen, rec, value, valuelen);
+    } else if (r < w->read + w->update + w->insert) {
+      make_key(d, count, keylen, key);
+      ret = write_record(index, key, keylen, count, value, valuelen);
+
+      count++;
+    } else if (r < w->read + w->update + w->insert + w->scan) {
+      make_key(d, rec, keylen, key);
+
+      uint64_t len = 1 + (random_number(state) % kMaxScanLength);
+
+      db::index::index::iterator it;
+      ret = index.lower_bound(key, keylen, NULL, it);
+      for (uint64_t j = 1; (ret) && (j < len) && (index.next(it)); j++) {
+        checksum += it.data_offset();
+      }
+    } else {
+      make_key(d, rec, keylen, key);
+      ret = ((read_record(index, key, keylen, valuelen, checksum)) &&
+             (write_record(index, key, keylen, rec, value, valuelen)));
+    }
+
+    latencies[i] = now() - t;
+
+    if (!ret) {
+      fprintf(stderr, "Error running operation %lu.\n", i);
+      return -1;
+    }
+  }
+
+  uint64_t elapsed = now() - start;
+
+  // Percentiles.
+  qsort(latencies, noperations, sizeof(uint64_t), compare_latencies);
+
+  uint64_t filesize = index_size();
+
+  printf("{\"workload\":\"%c\",\"distribution\":\"%s\",\"records\":%lu,"
+         "\"operations\":%lu,\"key_length\":%u,\"value_size\":%u,"
+         "\"cache\":\"%s\",\"throughput\":%.0f,\"p50_ns\":%lu,"
+         "\"p99_ns\":%lu,\"p999_ns\":%lu,\"file_size\":%lu,\"rss_kb\":%lu,"
+         "\"checksum\":%lu}\n",
+         w->name,
+         argv[2],
+         nrecords,
+         noperations,
+         keylen,
+         valuelen,
+         cold ? "cold" : "warm",
+         noperations / (elapsed / 1e9),
+         latencies[noperations / 2],
+         latencies[(noperations * 99) / 100],
+         latencies[(noperations * 999) / 1000],
+         filesize,
+         rss(),
+         checksum);
+
+  index.close();
+
+  remove_index();
+
+  free(latencies);
+  free(value);
+
+  return 0;
+}
+
+void usage(const char* program)
+{
+  printf("Usage: %s <workload> <distribution> <number-records> "
+         "<number-operations> <key-length> <value-size> <cache>\n",
+         program);
+
+  printf("<workload> ::= a | b | c | d | e | f\n");
+  printf("<distribution> ::= uniform | zipfian | sequential\n");
+  printf("<number-records> ::= 1 .. %llu\n", ULLONG_MAX);
+  printf("<number-operations> ::= 1 .. %llu\n", ULLONG_MAX);
+  printf("<key-length> ::= %zu .. %u\n", sizeof(uint64_t), kKeyMaxLen);
+  printf("<value-size> ::= 0 .. %u (0: data offset)\n", UINT_MAX);
+  printf("<cache> ::= warm | cold\n");
+  printf("\nWorkloads (YCSB): a: 50%% reads, 50%% updates; b: 95%% reads, "
+         "5%% updates;\nc: reads; d: 95%% reads of the latest records, 5%% "
+         "inserts;\ne: 95%% scans, 5%% inserts; f: 50%% reads, 50%% "
+         "read-modify-writes.\n");
+}
+
+uint64_t now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (static_cast<uint64_t>(ts.tv_sec) * 1000000000ull) + ts.tv_nsec;
+}
+
+uint64_t random_number(uint64_t& state)
+{
+  // xorshift64*.
+  state ^= state >> 12;
+  state ^= state << 25;
+  state ^= state >> 27;
+
+  return state * 0x2545f4914f6cdd1dull;
+}
+
+double random_double(uint64_t& state)
+{
+  return (random_number(state) >> 11) / 9007199254740992.0;
+}
+
+uint64_t hash(uint64_t n)
+{
+  uint64_t h = 0xcbf29ce484222325ull;
+
+  for (size_t i = 0; i < sizeof(uint64_t); i++) {
+    h ^= (n >> (i * 8)) & 0xff;
+    h *= 0x100000001b3ull;
+  }
+
+  return h;
+}
+
+void init_zipfian(struct zipfian& z, uint64_t n, double theta)
+{
+  z.n = n;
+  z.theta = theta;
+  z.alpha = 1 / (1 - theta);
+
+  z.zetan = 0;
+  for (uint64_t i = 1; i <= n; i++) {
+    z.zetan += 1 / pow(i, theta);
+  }
+
+  double zeta2 = 1 + (1 / pow(2, theta));
+
+  z.eta = (1 - pow(2.0 / n, 1 - theta)) / (1 - (zeta2 / z.zetan));
+}
+
+uint64_t next_zipfian(const struct zipfian& z, uint64_t& state)
+{
+  double u = random_double(state);
+  double uz = u * z.zetan;
+
+  if (uz < 1) {
+    return 0;
+  }
+
+  if (uz < 1 + pow(0.5, z.theta)) {
+    return 1;
+  }
+
+  uint64_t k = static_cast<uint64_t>(z.n * pow((z.eta * u) - z.eta + 1,
+                                               z.alpha));
+
+  return (k < z.n) ? k : z.n - 1;
+}
+
+void make_key(distribution d, uint64_t n, keylen_t keylen, uint8_t* key)
+{
+  uint64_t k = (d == distribution::kSequential) ? n : hash(n);
+
+  // Big-endian (compared with memcmp()).
+  for (size_t i = 0; i < sizeof(uint64_t); i++) {
+    key[i] = static_cast<uint8_t>(k >> (56 - (i * 8)));
+  }
+
+  memset(key + sizeof(uint64_t), 'k', keylen - sizeof(uint64_t));
+}
+
+bool write_record(db::index::index& index,
+                  const uint8_t* key,
+                  keylen_t keylen,
+                  uint64_t n,
+                  uint8_t* value,
+                  uint32_t valuelen)
+{
+  if (valuelen == 0) {
+    return index.add(key, keylen, n, NULL);
+  }
+
+  // The value starts with the number of the record.
+  memset(value, static_cast<int>(n), valuelen);
+
+  return index.add(key, keylen, value, valuelen, NULL);
+}
+
+bool read_record(const db::index::index& index,
+                 const uint8_t* key,
+                 keylen_t keylen,
+                 uint32_t valuelen,
+                 uint64_t& checksum)
+{
+  db::index::index::iterator it;
+  if (!index.find(key, keylen, NULL, it)) {
+    return false;
+  }
+
+  if (valuelen == 0) {
+    checksum += it.data_offset();
+  } else {
+    // Read the value.
+    const uint8_t* value = static_cast<const uint8_t*>(it.value());
+    if (!value) {
+      return false;
+    }
+
+    for (uint32_t i = 0; i < it.value_len(); i += 64) {
+      checksum += value[i];
+    }
+  }
+
+  return true;
+}
+
+void drop_cache(const char* filename)
+{
+  char path[PATH_MAX];
+
+  for (unsigned i = 0; ; i++) {
+    if (i == 0) {
+      snprintf(path, sizeof(path), "%s", filename);
+    } else {
+      snprintf(path, sizeof(path), "%s.vlog.%u", filename, i - 1);
+    }
+
+    int fd;
+    if ((fd = open(path, O_RDWR)) == -1) {
+      if (i > 0) {
+        return;
+      }
+
+      continue;
+    }
+
+    // Write the dirty pages, then drop them.
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+
+    close(fd);
+  }
+}
+
+void remove_index()
+{
+  char path[PATH_MAX];
+
+  unlink(kFilename);
+
+  snprintf(path, sizeof(path), "%s.vlog", kFilename);
+  unlink(path);
+
+  for (unsigned i = 0; ; i++) {
+    snprintf(path, sizeof(path), "%s.vlog.%u", kFilename, i);
+    if (unlink(path) != 0) {
+      return;
+    }
+  }
+}
+
+uint64_t index_size()
+{
+  struct stat sbuf;
+  uint64_t size = (stat(kFilename, &sbuf) == 0) ? sbuf.st_size : 0;
+
+  // Segments of the value log (sparse files).
+  char path[PATH_MAX];
+  for (unsigned i = 0; ; i++) {
+    snprintf(path, sizeof(path), "%s.vlog.%u", kFilename, i);
+    if (stat(path, &sbuf) != 0) {
+      return size;
+    }
+
+    size += sbuf.st_blocks * 512;
+  }
+}
+
+uint64_t rss()
+{
+  uint64_t size = 0;
+  uint64_t resident = 0;
+
+  FILE* file;
+  if ((file = fopen("/proc/self/statm", "r")) != NULL) {
+    if (fscanf(file, "%lu %lu", &size, &resident) != 2) {
+      resident = 0;
+    }
+
+    fclose(file);
+  }
+
+  return (resident * sysconf(_SC_PAGESIZE)) / 1024;
+}
+
+int compare_latencies(const void* l1, const void* l2)
+{
+  uint64_t t1 = *static_cast<const uint64_t*>(l1);
+  uint64_t t2 = *static_cast<const uint64_t*>(l2);
+
+  return (t1 < t2) ? -1 : ((t1 > t2) ? 1 : 0);
+}
@@ -6,6 +6,7 @@
 static const nodeoff_t kNodeSize = 4 * 1024;
 static const keylen_t kKeyMinLen = 1;
 static const keylen_t kKeyMaxLen = 512;
+static const nodeoff_t kInlineValueMaxLen = 256;
 static const size_t kMaxDepth = 1024;
 
 #endif // DB_CONSTANTS_H
@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <string.h>
+#include "index/analysis.h"
+#include "constants.h"
+
+// Print histogram (percentage of the total in each bucket).
+static void print_histogram(const uint64_t* buckets,
+                            size_t nbuckets,
+                            uint64_t total);
+
+void db::index::analysis::clear()
+{
+  memset(this, 0, sizeof(analysis));
+}
+
+void db::index::analysis::add(const analysis& other)
+{
+  for (size_t i = 0; i < kMaxLevels; i++) {
+    level& l = levels[i];
+    const level& o = other.levels[i];
+
+    l.nodes += o.nodes;
+    l.entries += o.entries;
+    l.key_bytes += o.key_bytes;
+    l.used_bytes += o.used_bytes;
+    l.reclaimable_bytes += o.reclaimable_bytes;
+
+    for (size_t j = 0; j < kBuckets; j++) {
+      l.fill[j] += o.fill[j];
+    }
+  }
+
+  if (other.height > height) {
+    height = other.height;
+  }
+
+  deleted += other.deleted;
+  value_bytes += other.value_bytes;
+
+  for (size_t j = 0; j < kBuckets; j++) {
+    tombstones[j] += other.tombstones[j];
+  }
+
+  forward_leaves += other.forward_leaves;
+  adjacent_leaves += other.adjacent_leaves;
+  leaf_distance += other.leaf_distance;
+
+  pages += other.pages;
+  buffer_pages += other.buffer_pages;
+  posting_pages += other.posting_pages;
+  free_posting_pages += other.free_posting_pages;
+  unused_pages += other.unused_pages;
+}
+
+void db::index::analysis::print() const
+{
+  printf("Height: %zu.\n", height);
+
+  for (size_t i = (height < kMaxLevels) ? height : kMaxLevels; i > 0; i--) {
+    const level& l = levels[i - 1];
+
+    if (l.nodes == 0) {
+      continue;
+    }
+
+    printf("Level %zu (%s nodes):\n", i, (i == 1) ? "leaf" : "inner");
+    printf("\t# of nodes: %lu.\n", l.nodes);
+    printf("\t# of %s: %lu (%.1f per node).\n",
+           (i == 1) ? "keys" : "separators",
+           l.entries,
+           static_cast<double>(l.entries) / l.nodes);
+    printf("\tAverage key length: %.1f bytes.\n",
+           (l.entries > 0) ?
+           static_cast<double>(l.key_bytes) / l.entries :
+           0.0);
+    printf("\tFill factor: %.1f%%.\n",
+           (100.0 * l.used_bytes) / (l.nodes * kNodeSize));
+
+    printf("\tFill factor histogram:");
+    print_histogram(l.fill, kBuckets, l.nodes);
+
+    printf("\tReclaimable by defragmentation: %lu bytes (%.1f%%).\n",
+           l.reclaimable_bytes,
+           (100.0 * l.reclaimable_bytes) / (l.nodes * kNodeSize));
+  }
+
+  const level& leaves = levels[0];
+
+  if (leaves.nodes > 0) {
+    uint64_t nentries = leaves.entries;
+
+    printf("Entries marked as deleted: %lu (%.1f%%).\n",
+           deleted,
+           (nentries > 0) ? (100.0 * deleted) / nentries : 0.0);
+
+    printf("Deleted ratio histogram:");
+    print_histogram(tombstones, kBuckets, leaves.nodes);
+
+    printf("Bytes after the keys (values, pointers, postings): %lu.\n",
+           value_bytes);
+
+    // Number of links between leaf nodes.
+    uint64_t nlinks = leaves.nodes - 1;
+
+    if (nlinks > 0) {
+      printf("Leaf order: %.1f%% forward, %.1f%% adjacent, "
+             "%.1f pages between consecutive leaf nodes.\n",
+             (100.0 * forward_leaves) / nlinks,
+             (100.0 * adjacent_leaves) / nlinks,
+             static_cast<double>(leaf_distance) / nlinks);
+    }
+  }
+
+  printf("# of pages: %lu.\n", pages);
+  printf("\tMessage buffers: %lu.\n", buffer_pages);
+  printf("\tPosting nodes: %lu (+ %lu free).\n",
+         posting_pages,
+         free_posting_pages);
+  printf("\tUnused: %lu.\n", unused_pages);
+}
+
+void print_histogram(const uint64_t* buckets, size_t nbuckets, uint64_t total)
+{
+  for (size_t i = 0; i < nbuckets; i++) {
+    printf(" %.0f",
+           (total > 0) ? (100.0 * buckets[i]) / total : 0.0);
+  }
+
+  printf(" (%% in buckets of %zu%%).\n", 100 / nbuckets);
+}
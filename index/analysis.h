@@ -0,0 +1,95 @@
+#ifndef DB_INDEX_ANALYSIS_H
+#define DB_INDEX_ANALYSIS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace db {
+  namespace index {
+    // Structure of the tree of an index (see index::analyze()).
+    struct analysis {
+      // Number of buckets of the histograms (10% each).
+      static const size_t kBuckets = 10;
+
+      // Maximum number of levels (the nodes of the higher levels are added
+      // to the last one).
+      static const size_t kMaxLevels = 16;
+
+      struct level {
+        // Number of nodes.
+        uint64_t nodes;
+
+        // Number of entries (keys of the leaf nodes, separators of the inner
+        // nodes).
+        uint64_t entries;
+
+        // Bytes of the keys.
+        uint64_t key_bytes;
+
+        // Bytes used by the header, the entries, the keys and the values.
+        uint64_t used_bytes;
+
+        // Bytes which would be reclaimed by defragmenting the nodes.
+        uint64_t reclaimable_bytes;
+
+        // Histogram of the fill factor (used bytes / node size).
+        uint64_t fill[kBuckets];
+      };
+
+      // Levels (levels[0]: leaf nodes).
+      level levels[kMaxLevels];
+
+      // Number of levels of the tree.
+      size_t height;
+
+      // Entries of the leaf nodes marked as deleted.
+      uint64_t deleted;
+
+      // Bytes stored after the keys of the leaf nodes (inline values,
+      // pointers to the value log and posting lists).
+      uint64_t value_bytes;
+
+      // Histogram of the ratio of entries marked as deleted per leaf node.
+      uint64_t tombstones[kBuckets];
+
+      // Order of the leaf nodes in the file, which a scan follows: leaf
+      // nodes whose next leaf node is at a higher offset, is the next page,
+      // and sum of the distances (in pages) to the next leaf node.
+      uint64_t forward_leaves;
+      uint64_t adjacent_leaves;
+      uint64_t leaf_distance;
+
+      // Pages of the file (without the header).
+      uint64_t pages;
+
+      // Pages of the message buffers.
+      uint64_t buffer_pages;
+
+      // Posting nodes in use and free.
+      uint64_t posting_pages;
+      uint64_t free_posting_pages;
+
+      // Pages allocated but not used yet.
+      uint64_t unused_pages;
+
+      // Constructor.
+      analysis();
+
+      // Reset.
+      void clear();
+
+      // Add the nodes of another part of the tree.
+      void add(const analysis& other);
+
+      // Print.
+      void print() const;
+    };
+
+    inline analysis::analysis()
+    {
+      clear();
+    }
+  }
+}
+
+#endif // DB_INDEX_ANALYSIS_H
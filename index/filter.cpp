@@ -0,0 +1,205 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "index/filter.h"
+
+const uint8_t db::index::filter::kMagic[8] = {
+  'F',
+  'I',
+  'L',
+  'T',
+  'E',
+  'R',
+  'I',
+  'X'
+};
+
+// The blocks start at the first cache line after the header.
+static const uint64_t kHeaderSize = 64;
+
+bool db::index::filter::open(const char* filename,
+                             uint64_t nkeys,
+                             unsigned bits_per_key)
+{
+  // If the file exists...
+  struct stat sbuf;
+  if (stat(filename, &sbuf) == 0) {
+    // Open file for reading/writing.
+    if ((fd_ = ::open(filename, O_RDWR)) != -1) {
+      if ((static_cast<uint64_t>(sbuf.st_size) >= kHeaderSize) &&
+          (map(sbuf.st_size))) {
+        // Check header.
+        return ((memcmp(header_->magic, kMagic, sizeof(kMagic)) == 0) &&
+                (header_->nblocks > 0) &&
+                (kHeaderSize +
+                 (header_->nblocks * kBlockWords * sizeof(uint64_t)) <=
+                 filesize_));
+      }
+    }
+  } else {
+    // Create file.
+    if ((fd_ = ::open(filename, O_CREAT | O_RDWR, 0644)) != -1) {
+      return reset(nkeys, bits_per_key);
+    }
+  }
+
+  return false;
+}
+
+void db::index::filter::close()
+{
+  if (data_ != MAP_FAILED) {
+    munmap(data_, filesize_);
+    data_ = MAP_FAILED;
+  }
+
+  if (fd_ != -1) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+}
+
+bool db::index::filter::reset(uint64_t nkeys, unsigned bits_per_key)
+{
+  if (bits_per_key == 0) {
+    return false;
+  }
+
+  // Calculate the number of blocks.
+  uint64_t nblocks = ((nkeys * bits_per_key) + kBlockBits - 1) / kBlockBits;
+  if (nblocks == 0) {
+    nblocks = 1;
+  } else if (nblocks > 0xffffffffu) {
+    nblocks = 0xffffffffu;
+  }
+
+  uint64_t size = kHeaderSize + (nblocks * kBlockWords * sizeof(uint64_t));
+
+  // Resize file.
+  if (ftruncate(fd_, size) == 0) {
+    if (map(size)) {
+      // Clear blocks.
+      memset(blocks_, 0, size - kHeaderSize);
+
+      // Fill header.
+      memcpy(header_->magic, kMagic, sizeof(kMagic));
+
+      header_->nblocks = nblocks;
+      header_->nkeys = 0;
+
+      header_->bits_per_key = bits_per_key;
+
+      // Optimal number of probes: bits per key * ln(2).
+      header_->nprobes = static_cast<uint32_t>((bits_per_key * 69) / 100);
+      if (header_->nprobes < 1) {
+        header_->nprobes = 1;
+      } else if (header_->nprobes > 30) {
+        header_->nprobes = 30;
+      }
+
+      header_->clean = 0;
+
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void db::index::filter::add(const void* key, keylen_t keylen)
+{
+  uint64_t h = hash(key, keylen);
+
+  uint64_t* block = blocks_ +
+                    (((h >> 32) * header_->nblocks) >> 32) * kBlockWords;
+
+  uint32_t h2 = static_cast<uint32_t>(h);
+  uint32_t delta = (h2 >> 17) | (h2 << 15);
+
+  for (uint32_t i = header_->nprobes; i > 0; i--) {
+    uint32_t bit = h2 & (kBlockBits - 1);
+    block[bit >> 6] |= (static_cast<uint64_t>(1) << (bit & 63));
+
+    h2 += delta;
+  }
+
+  header_->nkeys++;
+}
+
+double db::index::filter::false_positive_rate() const
+{
+  // (1 - e^(-k * n / m)) ^ k
+  double m = static_cast<double>(header_->nblocks) * kBlockBits;
+  double k = header_->nprobes;
+
+  return pow(1.0 - exp(-k * header_->nkeys / m), k);
+}
+
+bool db::index::filter::map(uint64_t size)
+{
+  void* data;
+  if (data_ == MAP_FAILED) {
+    data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  } else {
+    data = mremap(data_, filesize_, size, MREMAP_MAYMOVE);
+  }
+
+  if (data != MAP_FAILED) {
+    data_ = data;
+    filesize_ = size;
+
+    header_ = reinterpret_cast<header*>(data_);
+
+    blocks_ = reinterpret_cast<uint64_t*>(
+                reinterpret_cast<uint8_t*>(data_) + kHeaderSize
+              );
+
+    return true;
+  }
+
+  return false;
+}
+
+uint64_t db::index::filter::hash(const void* key, keylen_t keylen)
+{
+  // MurmurHash64A.
+  static const uint64_t m = 0xc6a4a7935bd1e995ull;
+  static const int r = 47;
+
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(key);
+  const uint8_t* end = data + (keylen & ~7);
+
+  uint64_t h = 0x5bd1e9955bd1e995ull ^ (keylen * m);
+
+  for (; data < end; data += 8) {
+    uint64_t k;
+    memcpy(&k, data, sizeof(uint64_t));
+
+    k *= m;
+    k ^= k >> r;
+    k *= m;
+
+    h ^= k;
+    h *= m;
+  }
+
+  switch (keylen & 7) {
+    case 7: h ^= static_cast<uint64_t>(data[6]) << 48; // Fall through.
+    case 6: h ^= static_cast<uint64_t>(data[5]) << 40; // Fall through.
+    case 5: h ^= static_cast<uint64_t>(data[4]) << 32; // Fall through.
+    case 4: h ^= static_cast<uint64_t>(data[3]) << 24; // Fall through.
+    case 3: h ^= static_cast<uint64_t>(data[2]) << 16; // Fall through.
+    case 2: h ^= static_cast<uint64_t>(data[1]) << 8; // Fall through.
+    case 1: h ^= static_cast<uint64_t>(data[0]);
+            h *= m;
+  }
+
+  h ^= h >> r;
+  h *= m;
+  h ^= h >> r;
+
+  return h;
+}
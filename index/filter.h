@@ -0,0 +1,152 @@
+#ifndef DB_INDEX_FILTER_H
+#define DB_INDEX_FILTER_H
+
+#include <stddef.h>
+#include <sys/mman.h>
+#include "types.h"
+
+namespace db {
+  namespace index {
+    // Blocked Bloom filter stored in its own file (each key sets bits in a
+    // single 64-byte block, so a lookup touches one cache line).
+    //
+    // Keys are hashed byte by byte, so the filter can only be used with
+    // comparators for which equal keys have the same bytes.
+    class filter {
+      public:
+        // Constructor.
+        filter();
+
+        // Destructor.
+        ~filter();
+
+        // Open (creates the filter if the file doesn't exist).
+        bool open(const char* filename, uint64_t nkeys, unsigned bits_per_key);
+
+        // Close.
+        void close();
+
+        // Clear the filter and resize it for `nkeys` keys.
+        bool reset(uint64_t nkeys, unsigned bits_per_key);
+
+        // Add key.
+        void add(const void* key, keylen_t keylen);
+
+        // Might the filter contain the key?
+        bool may_contain(const void* key, keylen_t keylen) const;
+
+        // Has the filter been closed properly the last time?
+        bool clean() const;
+
+        // Mark the filter as clean / dirty.
+        void clean(bool c);
+
+        // Get number of keys added to the filter.
+        uint64_t nkeys() const;
+
+        // Get size of the filter in bytes.
+        uint64_t size() const;
+
+        // Get bits per key.
+        unsigned bits_per_key() const;
+
+        // Get estimated false positive rate.
+        double false_positive_rate() const;
+
+      private:
+        static const uint8_t kMagic[8];
+
+        // Block size (in 64-bit words).
+        static const size_t kBlockWords = 8;
+        static const uint32_t kBlockBits = kBlockWords * 64;
+
+        struct header {
+          uint8_t magic[8];
+
+          uint64_t nblocks;
+          uint64_t nkeys;
+
+          uint32_t bits_per_key;
+          uint32_t nprobes;
+
+          uint32_t clean;
+        };
+
+        int fd_;
+        void* data_;
+
+        uint64_t filesize_;
+
+        header* header_;
+        uint64_t* blocks_;
+
+        // Map file.
+        bool map(uint64_t size);
+
+        // Hash key.
+        static uint64_t hash(const void* key, keylen_t keylen);
+    };
+
+    inline filter::filter()
+      : fd_(-1),
+        data_(MAP_FAILED)
+    {
+    }
+
+    inline filter::~filter()
+    {
+      close();
+    }
+
+    inline bool filter::may_contain(const void* key, keylen_t keylen) const
+    {
+      uint64_t h = hash(key, keylen);
+
+      const uint64_t* block = blocks_ +
+                              (((h >> 32) * header_->nblocks) >> 32) *
+                              kBlockWords;
+
+      uint32_t h2 = static_cast<uint32_t>(h);
+      uint32_t delta = (h2 >> 17) | (h2 << 15);
+
+      for (uint32_t i = header_->nprobes; i > 0; i--) {
+        uint32_t bit = h2 & (kBlockBits - 1);
+        if ((block[bit >> 6] & (static_cast<uint64_t>(1) << (bit & 63))) ==
+            0) {
+          return false;
+        }
+
+        h2 += delta;
+      }
+
+      return true;
+    }
+
+    inline bool filter::clean() const
+    {
+      return (header_->clean != 0);
+    }
+
+    inline void filter::clean(bool c)
+    {
+      header_->clean = c;
+    }
+
+    inline uint64_t filter::nkeys() const
+    {
+      return header_->nkeys;
+    }
+
+    inline uint64_t filter::size() const
+    {
+      return header_->nblocks * kBlockWords * sizeof(uint64_t);
+    }
+
+    inline unsigned filter::bits_per_key() const
+    {
+      return header_->bits_per_key;
+    }
+  }
+}
+
+#endif // DB_INDEX_FILTER_H
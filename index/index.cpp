@@ -3,10 +3,54 @@
 #include <stdio.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <limits.h>
+#include <time.h>
 #include <sys/stat.h>
+#include <pthread.h>
 #include <memory>
 #include "index/index.h"
 #include "index/inner_node.h"
+#include "index/posting_node.h"
+
+// Counters exported by export_stats().
+static const struct {
+  const char* name;
+  uint64_t db::index::statistics::* counter;
+  const char* help;
+} kCounters[] = {
+  {"lookups", &db::index::statistics::lookups, "Lookups of a key in the tree."},
+  {"descents", &db::index::statistics::descents, "Searches of a leaf node."},
+  {"node_visits", &db::index::statistics::node_visits, "Nodes read."},
+  {"comparisons", &db::index::statistics::comparisons, "Key comparisons."},
+  {"cache_hits",
+   &db::index::statistics::cache_hits,
+   "Descents started in the cache of the upper levels."},
+  {"model_hits",
+   &db::index::statistics::model_hits,
+   "Lookups answered by the learned model."},
+  {"leaf_splits", &db::index::statistics::leaf_splits, "Leaf node splits."},
+  {"inner_splits", &db::index::statistics::inner_splits, "Inner node splits."},
+  {"defrags", &db::index::statistics::defrags, "Node defragmentations."},
+  {"remaps", &db::index::statistics::remaps, "Remappings of the file."},
+  {"remapped_bytes",
+   &db::index::statistics::remapped_bytes,
+   "Bytes of the mappings remapped."},
+  {"deleted_skipped",
+   &db::index::statistics::deleted_skipped,
+   "Deleted entries skipped by the iterators."},
+  {"buffer_flushes",
+   &db::index::statistics::buffer_flushes,
+   "Message buffers pushed down to the leaf nodes."}
+};
+
+// Quantiles of the latencies exported by export_stats().
+static const double kQuantiles[] = {0.5, 0.9, 0.99, 0.999, 1};
+
+// Get the time of the clock (ns).
+static uint64_t now(clockid_t clock);
+
+// Compare offsets (for qsort()).
+static int compare_offsets(const void* p1, const void* p2);
 
 const uint8_t db::index::index::kMagic[8] = {
   'I',
@@ -19,42 +63,89 @@ const uint8_t db::index::index::kMagic[8] = {
   'X'
 };
 
-bool db::index::index::open(const char* filename)
+const uint8_t db::index::index::kHotPagesMagic[8] = {
+  'H',
+  'O',
+  'T',
+  'P',
+  'A',
+  'G',
+  'E',
+  'S'
+};
+
+bool db::index::index::open(const char* filename, const options& opts)
 {
+  stats_.clear();
+
+  for (size_t i = 0; i < statistics::kOperations; i++) {
+    latencies_[i].clear();
+  }
+
+  trace_.clear();
+  slow_op_threshold_ = opts.slow_op_threshold;
+
+  huge_pages_ = opts.huge_pages;
+
+  // The memtable is sorted with the comparator.
+  if ((opts.memtable_size > 0) && (opts.comparator == NULL)) {
+    return false;
+  }
+
+  // Buffer the operations in a memtable?
+  has_memtable_ = (opts.memtable_size > 0);
+  memtable_size_ = opts.memtable_size;
+
+  memtable_.comparator(opts.comparator);
+
+  comp_ = opts.comparator;
+
+  // Cache the upper levels of the tree?
+  has_cache_ = (opts.node_cache_size > 0);
+  cache_size_ = opts.node_cache_size;
+
+  // Learned model?
+  has_model_ = (opts.model_error > 0);
+  model_error_ = opts.model_error;
+
   // If the file exists...
   struct stat sbuf;
   if (stat(filename, &sbuf) == 0) {
     // Open file for reading/writing.
     if ((fd_ = ::open(filename, O_RDWR)) != -1) {
       // Map file into memory.
-      if ((data_ = mmap(NULL,
-                        sbuf.st_size,
-                        PROT_READ | PROT_WRITE,
-                        MAP_SHARED,
-                        fd_,
-                        0)) != MAP_FAILED) {
-        filesize_ = sbuf.st_size;
-
+      if (map(sbuf.st_size)) {
         header_ = reinterpret_cast<header*>(data_);
 
-        // Check that header_->nnodes is not too big.
-        return (((header_->nnodes + 1) * kNodeSize) <= filesize_);
+        // Check header (the format of the nodes differs between versions)
+        // and that header_->nnodes is not too big.
+        if ((memcmp(header_->magic, kMagic, sizeof(kMagic)) == 0) &&
+            (header_->version == kVersion) &&
+            (((header_->nnodes + 1) * kNodeSize) <= filesize_)) {
+          has_buffers_ = ((header_->flags & kFlagMessageBuffers) != 0);
+          has_messages_ = has_buffers_;
+
+          // The message buffers are sorted with the comparator.
+          if ((has_buffers_) && (opts.comparator == NULL)) {
+            return false;
+          }
+
+          return ((advise(opts.access)) &&
+                  (warm_up(filename, opts)) &&
+                  (open_filter(filename, opts)) &&
+                  (open_value_log(filename, opts)) &&
+                  (open_write_ahead_log(filename, opts)) &&
+                  ((!has_model_) || (train_model())));
+        }
       }
     }
-  } else {
+  } else if ((opts.message_buffer_pages == 0) || (opts.comparator != NULL)) {
     // Create file.
     if ((fd_ = ::open(filename, O_CREAT | O_RDWR, 0644)) != -1) {
       // Grow file.
       if (ftruncate(fd_, kAllocate) == 0) {
         // Map file into memory.
-        if ((data_ = mmap(NULL,
-                          kAllocate,
-                          PROT_READ | PROT_WRITE,
-                          MAP_SHARED,
-                          fd_,
-                          0)) != MAP_FAILED) {
-          filesize_ = kAllocate;
-
+        if (map(kAllocate)) {
           header_ = reinterpret_cast<header*>(data_);
 
           // Fill header.
@@ -65,7 +156,26 @@ bool db::index::index::open(const char* filename)
 
           header_->root = 0;
 
-          return true;
+          header_->flags = 0;
+
+          header_->free_posting_nodes = 0;
+
+          header_->height = 0;
+
+          // Message buffers?
+          header_->buffer_pages = opts.message_buffer_pages;
+          if (opts.message_buffer_pages > 0) {
+            header_->flags |= kFlagMessageBuffers;
+            has_buffers_ = true;
+          }
+
+          header_->version = kVersion;
+
+          return ((advise(opts.access)) &&
+                  (warm_up(filename, opts)) &&
+                  (open_filter(filename, opts)) &&
+                  (open_value_log(filename, opts)) &&
+                  (open_write_ahead_log(filename, opts)));
         }
       }
     }
@@ -76,7 +186,61 @@ bool db::index::index::open(const char* filename)
 
 void db::index::index::close()
 {
+  stop_recording();
+
+  if (has_memtable_) {
+    drain_memtable();
+
+    has_memtable_ = false;
+  }
+
+  if (has_wal_) {
+    checkpoint();
+    wal_.close();
+
+    has_wal_ = false;
+  }
+
+  has_buffers_ = false;
+  has_messages_ = false;
+
+  if (has_cache_) {
+    cache_.clear();
+    has_cache_ = false;
+  }
+
+  if (has_model_) {
+    model_.clear();
+    has_model_ = false;
+  }
+
+  if (has_filter_) {
+    filter_.clean(true);
+    filter_.close();
+
+    has_filter_ = false;
+  }
+
+  if (has_vlog_) {
+    free(gc_segments_);
+    gc_segments_ = NULL;
+
+    vlog_.close();
+
+    has_vlog_ = false;
+  }
+
   if (data_ != MAP_FAILED) {
+    if (hot_pages_[0]) {
+      save_hot_pages();
+      hot_pages_[0] = 0;
+    }
+
+    // The anonymous memory has to be written to the file.
+    if (huge_pages_ == huge_page_mode::kAnonymous) {
+      sync();
+    }
+
     munmap(data_, filesize_);
     data_ = MAP_FAILED;
   }
@@ -89,20 +253,90 @@ void db::index::index::close()
 
 bool db::index::index::add(const void* key,
                            keylen_t keylen,
-                           uint64_t dataoff,
+                           const void* value,
+                           uint32_t valuelen,
                            comparator_t comp)
 {
-  struct level {
-    uint64_t off;
-    nodeoff_t pos;
-  };
+  DB_INDEX_PROBE2(add_entry, key, keylen);
+
+  bool ret = add_value(key, keylen, value, valuelen, comp);
+
+  DB_INDEX_PROBE1(add_return, ret);
+
+  record(operation_trace::op_type::kAddValue, ret, key, keylen, valuelen);
+
+  return ret;
+}
+
+bool db::index::index::add_value(const void* key,
+                                 keylen_t keylen,
+                                 const void* value,
+                                 uint32_t valuelen,
+                                 comparator_t comp)
+{
+  DB_INDEX_SCOPE(kAdd);
+
+  // The key might have a buffered operation (the write is not logged).
+  if ((!apply_pending(key, keylen, comp)) || (!prepare_unlogged_write())) {
+    return false;
+  }
+
+  // If the value fits in the leaf node...
+  if (valuelen <= kInlineValueMaxLen) {
+    return insert(key,
+                  keylen,
+                  leaf_node::value_type::kInline,
+                  value,
+                  valuelen,
+                  comp);
+  }
+
+  // If the index has a value log...
+  if (has_vlog_) {
+    // Append value to the value log.
+    value_log::pointer ptr;
+    if (vlog_.append(value, valuelen, ptr)) {
+      // Add key with a pointer to the value.
+      if (insert(key,
+                 keylen,
+                 leaf_node::value_type::kValueLog,
+                 &ptr,
+                 sizeof(value_log::pointer),
+                 comp)) {
+        return true;
+      }
+
+      vlog_.release(ptr);
+    }
+  }
+
+  return false;
+}
+
+bool db::index::index::insert(const void* key,
+                              keylen_t keylen,
+                              leaf_node::value_type type,
+                              const void* value,
+                              uint64_t dataoff,
+                              comparator_t comp,
+                              update_function_t fn,
+                              void* arg)
+{
+  DB_INDEX_SCOPE(kAdd);
 
   // If the key is neither too short nor too long...
   if ((keylen >= kKeyMinLen) && (keylen <= kKeyMaxLen)) {
+    // Add key to the filter.
+    if ((has_filter_) && (!filter_.may_contain(key, keylen))) {
+      filter_.add(key, keylen);
+    }
+
     // If there is root...
     if (header_->root != 0) {
       struct level levels[kMaxDepth];
 
+      DB_INDEX_COUNT(descents, 1);
+
       uint64_t off = header_->root;
       nodeoff_t pos;
 
@@ -110,6 +344,8 @@ bool db::index::index::add(const void* key,
 
       struct node* n;
 
+      uint8_t keybuf[kKeyMaxLen];
+
       do {
         // Read node.
         if ((n = read_node(off)) != NULL) {
@@ -117,19 +353,12 @@ bool db::index::index::add(const void* key,
           if (n->t == node::type::kInnerNode) {
             levels[depth].off = off;
 
-            // Search key in the node.
-            if (!static_cast<const struct inner_node*>(n)->search(key,
-                                                                  keylen,
-                                                                  comp,
-                                                                  pos)) {
-              off = (pos != 0) ?
-                static_cast<const struct inner_node*>(n)->
-                  entries[pos - 1].child :
-                static_cast<const struct inner_node*>(n)->left;
-            } else {
-              off = static_cast<const struct inner_node*>(n)->
-                      entries[pos].child;
-            }
+            // Search child which might contain the key.
+            pos = static_cast<const struct inner_node*>(n)->search_child(key,
+                                                                        keylen,
+                                                                        comp);
+
+            off = static_cast<const struct inner_node*>(n)->child(pos);
 
             levels[depth].pos = pos;
 
@@ -147,18 +376,54 @@ bool db::index::index::add(const void* key,
               break;
             } else {
               // Key is already in the node.
+              struct leaf_node* leaf = static_cast<struct leaf_node*>(n);
 
-              // If the key had been deleted...
-              if (static_cast<const struct leaf_node*>(n)->erased(pos)) {
-                static_cast<struct leaf_node*>(n)->entries[pos].deleted = 0;
+              bool erased = leaf->erased(pos);
 
-                header_->nkeys++;
+              // Upsert?
+              if (fn) {
+                // The value of the key is stored in the index?
+                if ((!erased) &&
+                    (leaf->type(pos) != leaf_node::value_type::kExternal)) {
+                  return false;
+                }
+
+                dataoff = fn(!erased, leaf->data_offset(pos), arg);
+                fn = NULL;
               }
 
-              // Update data offset.
-              static_cast<struct leaf_node*>(n)->entries[pos].dataoff = dataoff;
+              // The previous value is no longer referenced.
+              release_value(leaf, pos);
 
-              return true;
+              // Replace value (if it fits in the node).
+              if (leaf->replace(pos, type, value, dataoff)) {
+                // If the key had been deleted...
+                if (erased) {
+                  leaf->entries[pos].deleted = 0;
+                  leaf->nlive++;
+
+                  header_->nkeys++;
+
+                  update_counts(levels, depth, 1);
+                }
+
+                return true;
+              }
+
+              // The new value doesn't fit in the node: remove the entry and
+              // add it again.
+              memcpy(keybuf, key, keylen);
+              key = keybuf;
+
+              if (!erased) {
+                header_->nkeys--;
+
+                update_counts(levels, depth, -1);
+              }
+
+              leaf->remove(pos);
+
+              break;
             }
           }
         } else {
@@ -166,17 +431,34 @@ bool db::index::index::add(const void* key,
         }
       } while (true);
 
+      // Upsert of a key which is not in the index?
+      if (fn) {
+        dataoff = fn(false, 0, arg);
+      }
+
       // Insert key in the node (if it fits).
-      if (static_cast<struct leaf_node*>(n)->add(key, keylen, dataoff, pos)) {
+      if (static_cast<struct leaf_node*>(n)->add(key,
+                                                 keylen,
+                                                 type,
+                                                 value,
+                                                 dataoff,
+                                                 pos)) {
         header_->nkeys++;
 
+        update_counts(levels, depth, 1);
+
         return true;
       } else {
         // Node is full.
 
-        // Create right node.
+        // Create right node, reserving the nodes of the worst case: a split
+        // per level, a new root and one message buffer (only the level above
+        // the leaf nodes is buffered).
         uint64_t rightoff;
-        if (create_node(depth, rightoff) != 0) {
+        if (create_node(depth +
+                        2 +
+                        (has_buffers_ ? header_->buffer_pages : 0),
+                        rightoff) != 0) {
           // Memory mapping might have been relocated.
           n = read_node(off);
 
@@ -198,6 +480,9 @@ bool db::index::index::add(const void* key,
 
           struct leaf_node* right_leaf = new (mem) leaf_node();
 
+          DB_INDEX_COUNT(leaf_splits, 1);
+          DB_INDEX_PROBE3(leaf_split, off, rightoff, depth);
+
           // Split leaf node.
           static_cast<struct leaf_node*>(n)->split(off,
                                                    rightoff,
@@ -205,6 +490,8 @@ bool db::index::index::add(const void* key,
                                                    pos,
                                                    key,
                                                    keylen,
+                                                   type,
+                                                   value,
                                                    dataoff);
 
           header_->nkeys++;
@@ -213,10 +500,17 @@ bool db::index::index::add(const void* key,
           key = right_leaf->key(0);
           keylen = right_leaf->keylen(0);
 
+          // Number of keys in the left and in the right node.
+          uint64_t leftcount = static_cast<const struct leaf_node*>(n)->nlive;
+          uint64_t rightcount = right_leaf->nlive;
+
           uint8_t upkey[kKeyMaxLen];
 
           struct node* r = right_leaf;
 
+          // Depth of the leaf node.
+          size_t leafdepth = depth;
+
           while (depth > 0) {
             depth--;
 
@@ -225,14 +519,26 @@ bool db::index::index::add(const void* key,
             n = read_node(levels[depth].off);
             pos = levels[depth].pos;
 
-            if (static_cast<struct inner_node*>(n)->add(key,
-                                                        keylen,
-                                                        child,
-                                                        pos)) {
+            struct inner_node* inner = static_cast<struct inner_node*>(n);
+
+            // The child which has been split keeps the smaller keys.
+            inner->set_child_count(pos, leftcount);
+
+            if (inner->add(key, keylen, child, rightcount, pos)) {
+              update_counts(levels, depth, 1);
+
               return true;
             } else {
+              // The cached upper levels change.
+              cache_.invalidate();
+
+              // Does the node have a message buffer?
+              bool buffered = ((has_buffers_) && (depth + 1 == leafdepth));
+
               // Create right node.
-              if (create_node(depth, rightoff) != 0) {
+              if (create_node(0,
+                              rightoff,
+                              buffered ? 1 + header_->buffer_pages : 1) != 0) {
                 void* mem = reinterpret_cast<void*>(
                               reinterpret_cast<uint8_t*>(data_) + rightoff
                             );
@@ -240,53 +546,108 @@ bool db::index::index::add(const void* key,
                 struct inner_node* right_inner = new (mem) inner_node();
                 r = right_inner;
 
+                DB_INDEX_COUNT(inner_splits, 1);
+                DB_INDEX_PROBE3(inner_split,
+                                levels[depth].off,
+                                rightoff,
+                                depth);
+
                 // Split inner node.
-                static_cast<struct inner_node*>(n)->split(right_inner,
-                                                          pos,
-                                                          key,
-                                                          keylen,
-                                                          child,
-                                                          upkey,
-                                                          keylen);
+                inner->split(right_inner,
+                             pos,
+                             key,
+                             keylen,
+                             child,
+                             rightcount,
+                             upkey,
+                             keylen);
+
+                // The children moved to the right node have a new parent.
+                for (nodeoff_t i = 0; i <= right_inner->nentries; i++) {
+                  read_node(right_inner->child(i))->parent = rightoff;
+                }
+
+                // The messages of the keys which go to the right node are
+                // moved to its buffer.
+                if (buffered) {
+                  get_buffer(levels[depth].off)->split(
+                    new (get_buffer(rightoff)) message_buffer(
+                      header_->buffer_pages * kNodeSize
+                    ),
+                    upkey,
+                    keylen,
+                    comp
+                  );
+                }
 
                 key = upkey;
+
+                leftcount = inner->total_count();
+                rightcount = right_inner->total_count();
               } else {
                 return false;
               }
             }
           }
 
+          // Does the new root have a message buffer (the old root is a
+          // leaf node)?
+          bool buffered = ((has_buffers_) && (leafdepth == 0));
+
           // Create new root node.
-          if (create_node(0, off) != 0) {
+          if (create_node(0, off, buffered ? 1 + header_->buffer_pages : 1)
+              != 0) {
             void* mem = reinterpret_cast<void*>(
                           reinterpret_cast<uint8_t*>(data_) + off
                         );
 
             struct inner_node* root = new (mem) inner_node();
 
+            if (buffered) {
+              new (get_buffer(off)) message_buffer(
+                header_->buffer_pages * kNodeSize
+              );
+            }
+
             root->t = node::type::kInnerNode;
             root->parent = 0;
 
-            root->add(key, keylen, rightoff, static_cast<nodeoff_t>(0));
+            root->add(key,
+                      keylen,
+                      rightoff,
+                      rightcount,
+                      static_cast<nodeoff_t>(0));
 
             root->left = header_->root;
+            root->leftcount = leftcount;
 
             n->parent = off;
             r->parent = off;
 
             header_->root = off;
+            header_->height++;
+
+            DB_INDEX_PROBE2(new_root, off, header_->height);
+
+            cache_.invalidate();
 
             return true;
           }
         }
       }
     } else {
+      // Upsert of a key which is not in the index?
+      if (fn) {
+        dataoff = fn(false, 0, arg);
+      }
+
       // Create root node.
       uint64_t off;
       if (create_node(0, off)) {
         header_->nnodes = 1;
         header_->nkeys = 1;
         header_->root = off;
+        header_->height = 1;
 
         void* mem = reinterpret_cast<void*>(
                       reinterpret_cast<uint8_t*>(data_) + header_->root
@@ -300,7 +661,14 @@ bool db::index::index::add(const void* key,
         root->prev = 0;
         root->next = 0;
 
-        root->add(key, keylen, dataoff, static_cast<nodeoff_t>(0));
+        root->add(key,
+                  keylen,
+                  type,
+                  value,
+                  dataoff,
+                  static_cast<nodeoff_t>(0));
+
+        DB_INDEX_PROBE2(new_root, off, header_->height);
 
         return true;
       }
@@ -314,38 +682,86 @@ bool db::index::index::erase(const void* key,
                              keylen_t keylen,
                              comparator_t comp)
 {
+  DB_INDEX_PROBE2(erase_entry, key, keylen);
+
+  bool ret = erase_key(key, keylen, comp);
+
+  DB_INDEX_PROBE1(erase_return, ret);
+
+  record(operation_trace::op_type::kErase, ret, key, keylen);
+
+  return ret;
+}
+
+bool db::index::index::erase_key(const void* key,
+                                 keylen_t keylen,
+                                 comparator_t comp)
+{
+  DB_INDEX_SCOPE(kErase);
+
+  // If there is a memtable, the operation is buffered; with a write-ahead
+  // log, it is logged.
+  if ((has_memtable_) || (has_wal_)) {
+    single_.clear();
+    return ((single_.erase(key, keylen)) && (write(single_, comp)));
+  }
+
+  // If there are message buffers...
+  if (has_buffers_) {
+    return buffer(write_batch::op_type::kErase, key, keylen, 0, comp);
+  }
+
   // If the key is neither too short nor too long...
   if ((keylen >= kKeyMinLen) && (keylen <= kKeyMaxLen)) {
     // If there is root...
     if (header_->root != 0) {
+      struct level levels[kMaxDepth];
+
+      DB_INDEX_COUNT(descents, 1);
+
       uint64_t off = header_->root;
 
+      size_t depth = 0;
+
       do {
         // Read node.
         struct node* n;
         if ((n = read_node(off)) != NULL) {
           // Inner node?
           if (n->t == node::type::kInnerNode) {
-            // Search key in the node.
+            levels[depth].off = off;
+
+            // Search child which might contain the key.
             nodeoff_t pos;
-            if (!static_cast<const struct inner_node*>(n)->search(key,
-                                                                  keylen,
-                                                                  comp,
-                                                                  pos)) {
-              off = (pos != 0) ?
-                static_cast<const struct inner_node*>(n)->
-                  entries[pos - 1].child :
-                static_cast<const struct inner_node*>(n)->left;
-            } else {
-              off = static_cast<const struct inner_node*>(n)->
-                      entries[pos].child;
+            pos = static_cast<const struct inner_node*>(n)->search_child(key,
+                                                                        keylen,
+                                                                        comp);
+
+            off = static_cast<const struct inner_node*>(n)->child(pos);
+
+            levels[depth].pos = pos;
+
+            if (++depth == kMaxDepth) {
+              return false;
             }
           } else {
             // Leaf node.
+            struct leaf_node* leaf = static_cast<struct leaf_node*>(n);
+
+            // If the key is in the node...
+            nodeoff_t pos;
+            if ((leaf->search(key, keylen, comp, pos)) &&
+                (!leaf->erased(pos))) {
+              // The value is no longer referenced.
+              release_value(leaf, pos);
+
+              // Mark the key as deleted.
+              leaf->entries[pos].deleted = 1;
+              leaf->nlive--;
 
-            // Erase key.
-            if (static_cast<struct leaf_node*>(n)->erase(key, keylen, comp)) {
               header_->nkeys--;
+
+              update_counts(levels, depth, -1);
             }
 
             return true;
@@ -362,326 +778,3336 @@ bool db::index::index::erase(const void* key,
   return false;
 }
 
-bool db::index::index::begin(iterator& it) const
+bool db::index::index::upsert(const void* key,
+                              keylen_t keylen,
+                              update_function_t fn,
+                              void* arg,
+                              comparator_t comp)
 {
-  // If there is root...
-  if (header_->root != 0) {
-    uint64_t off = header_->root;
+  DB_INDEX_SCOPE(kUpdate);
 
-    const struct node* n;
+  // The key might have a buffered operation (the write is not logged).
+  if ((!apply_pending(key, keylen, comp)) || (!prepare_unlogged_write())) {
+    return false;
+  }
 
-    do {
-      // Read node.
-      if ((n = read_node(off)) != NULL) {
-        // Inner node?
-        if (n->t == node::type::kInnerNode) {
-          off = static_cast<const struct inner_node*>(n)->left;
-        } else {
-          // Leaf node.
-          break;
-        }
-      } else {
-        return false;
-      }
-    } while (true);
+  return insert(key,
+                keylen,
+                leaf_node::value_type::kExternal,
+                NULL,
+                0,
+                comp,
+                fn,
+                arg);
+}
 
-    do {
-      const struct leaf_node* leaf =
-                              reinterpret_cast<const struct leaf_node*>(n);
+bool db::index::index::update(iterator& it, uint64_t dataoff)
+{
+  DB_INDEX_SCOPE(kUpdate);
 
-      for (nodeoff_t i = 0; i < leaf->nentries; i++) {
-        if (!leaf->erased(i)) {
-          it.off_ = off;
-          it.node_ = leaf;
-          it.pos_ = i;
+  // Apply the buffered operations of the key first (in place: the iterator
+  // stays valid).
+  uint8_t key[kKeyMaxLen];
+  keylen_t keylen = it.keylen();
+  memcpy(key, it.key(), keylen);
 
-          return true;
-        }
-      }
+  if (!apply_pending(key, keylen, comp_)) {
+    return false;
+  }
 
-      off = leaf->next;
+  struct leaf_node* leaf = static_cast<struct leaf_node*>(read_node(it.off_));
 
-    } while ((n = read_node(off)) != NULL);
+  // If the key has been erased...
+  if (leaf->erased(it.pos_)) {
+    return false;
   }
 
-  return false;
+  if (!log_write(write_batch::op_type::kAdd, key, keylen, dataoff)) {
+    return false;
+  }
+
+  // The previous value is no longer referenced.
+  release_value(leaf, it.pos_);
+
+  // Nothing is stored after the key, so it fits.
+  return leaf->replace(it.pos_,
+                       leaf_node::value_type::kExternal,
+                       NULL,
+                       dataoff);
 }
 
-bool db::index::index::end(iterator& it) const
+bool db::index::index::erase(iterator& it)
 {
-  // If there is root...
-  if (header_->root != 0) {
-    uint64_t off = header_->root;
+  DB_INDEX_SCOPE(kErase);
 
-    const struct node* n;
+  // Apply the buffered operations of the key first (in place: the iterator
+  // stays valid).
+  uint8_t key[kKeyMaxLen];
+  keylen_t keylen = it.keylen();
+  memcpy(key, it.key(), keylen);
 
-    do {
-      // Read node.
-      if ((n = read_node(off)) != NULL) {
-        // Inner node?
-        if (n->t == node::type::kInnerNode) {
-          off = static_cast<const struct inner_node*>(n)->
-                entries[n->nentries - 1].child;
-        } else {
-          // Leaf node.
-          break;
-        }
-      } else {
-        return false;
-      }
-    } while (true);
+  if ((!apply_pending(key, keylen, comp_)) ||
+      (!log_write(write_batch::op_type::kErase, key, keylen, 0))) {
+    return false;
+  }
 
-    do {
-      const struct leaf_node* leaf =
-                              reinterpret_cast<const struct leaf_node*>(n);
+  struct leaf_node* leaf = static_cast<struct leaf_node*>(read_node(it.off_));
 
-      for (nodeoff_t i = leaf->nentries; i > 0; i--) {
-        if (!leaf->erased(i - 1)) {
-          it.off_ = off;
-          it.node_ = leaf;
-          it.pos_ = i - 1;
+  // If the key has not been erased yet...
+  if (!leaf->erased(it.pos_)) {
+    // The value is no longer referenced.
+    release_value(leaf, it.pos_);
 
-          return true;
-        }
-      }
+    // Mark the key as deleted.
+    leaf->entries[it.pos_].deleted = 1;
+    leaf->nlive--;
 
-      off = leaf->prev;
+    header_->nkeys--;
 
-    } while ((n = read_node(off)) != NULL);
+    update_parent_counts(it.off_, -1);
   }
 
-  return false;
+  return true;
 }
 
-bool db::index::index::previous(iterator& it) const
+bool db::index::index::add_posting(const void* key,
+                                   keylen_t keylen,
+                                   uint64_t posting,
+                                   comparator_t comp)
 {
-  const struct node* n = it.node_;
-  uint64_t off = it.off_;
-  nodeoff_t i = it.pos_;
+  DB_INDEX_SCOPE(kPosting);
 
-  do {
-    for (; i > 0; i--) {
-      if (!reinterpret_cast<const struct leaf_node*>(n)->erased(i - 1)) {
-        it.off_ = off;
-        it.node_ = static_cast<const struct leaf_node*>(n);
-        it.pos_ = i - 1;
+  // The key might have a buffered operation (the write is not logged).
+  if ((!apply_pending(key, keylen, comp)) || (!prepare_unlogged_write())) {
+    return false;
+  }
 
-        return true;
-      }
-    }
+  uint8_t buf[kInlineValueMaxLen];
+  buf[0] = kPostingsInline;
 
-    off = static_cast<const struct leaf_node*>(n)->prev;
+  // If the key is not in the index...
+  iterator it;
+  if (!find_key(key, keylen, comp, it)) {
+    size_t len = posting_node::encode(&posting, 1, buf + 1, sizeof(buf) - 1);
 
-    if ((n = read_node(off)) != NULL) {
-      i = n->nentries;
-    } else {
-      break;
-    }
-  } while (true);
+    return insert(key,
+                  keylen,
+                  leaf_node::value_type::kPostings,
+                  buf,
+                  1 + len,
+                  comp);
+  }
 
-  return false;
-}
+  // If the key doesn't have a posting list...
+  if (it.node_->type(it.pos_) != leaf_node::value_type::kPostings) {
+    return false;
+  }
 
-bool db::index::index::next(iterator& it) const
-{
-  const struct node* n = it.node_;
-  uint64_t off = it.off_;
-  nodeoff_t i = it.pos_ + 1;
+  const uint8_t* value = reinterpret_cast<const uint8_t*>(
+                           it.node_->value(it.pos_)
+                         );
 
-  do {
-    for (; i < n->nentries; i++) {
-      if (!reinterpret_cast<const struct leaf_node*>(n)->erased(i)) {
-        it.off_ = off;
-        it.node_ = static_cast<const struct leaf_node*>(n);
-        it.pos_ = i;
+  // If the postings are stored in the leaf node...
+  if (value[0] == kPostingsInline) {
+    uint64_t postings[kInlineValueMaxLen];
+    size_t count = posting_node::decode(value + 1,
+                                        it.node_->value_length(it.pos_) - 1,
+                                        postings,
+                                        kInlineValueMaxLen);
 
-        return true;
-      }
+    // Search the position of the posting.
+    size_t i;
+    for (i = 0; (i < count) && (postings[i] < posting); i++);
+
+    // If the posting is already in the list...
+    if ((i < count) && (postings[i] == posting)) {
+      return true;
     }
 
-    off = static_cast<const struct leaf_node*>(n)->next;
-    i = 0;
-  } while ((n = read_node(off)) != NULL);
+    memmove(&postings[i + 1], &postings[i], (count - i) * sizeof(uint64_t));
+    postings[i] = posting;
+    count++;
 
-  return false;
+    // If the postings still fit in the leaf node...
+    size_t len;
+    if ((count < kInlineValueMaxLen) &&
+        ((len = posting_node::encode(postings,
+                                     count,
+                                     buf + 1,
+                                     sizeof(buf) - 1)) > 0)) {
+      return insert(key,
+                    keylen,
+                    leaf_node::value_type::kPostings,
+                    buf,
+                    1 + len,
+                    comp);
+    }
+
+    // Move the postings to posting nodes.
+    uint64_t first;
+    if (!write_postings(postings, count, first)) {
+      return false;
+    }
+
+    posting_list list;
+    list.format = kPostingsNodes;
+    list.first = first;
+    list.count = count;
+
+    if (insert(key,
+               keylen,
+               leaf_node::value_type::kPostings,
+               &list,
+               sizeof(posting_list),
+               comp)) {
+      return true;
+    }
+
+    free_postings(list.first);
+
+    return false;
+  }
+
+  // The postings are stored in posting nodes.
+  posting_list list;
+  memcpy(&list, value, sizeof(posting_list));
+
+  bool added;
+  if (!add_posting(list.first, posting, added)) {
+    return false;
+  }
+
+  if (added) {
+    list.count++;
+
+    // Memory mapping might have been relocated.
+    struct leaf_node* leaf = static_cast<struct leaf_node*>(
+                               read_node(it.off_)
+                             );
+
+    // The list has the same size: it is replaced in place.
+    leaf->replace(it.pos_,
+                  leaf_node::value_type::kPostings,
+                  &list,
+                  sizeof(posting_list));
+  }
+
+  return true;
 }
 
-bool db::index::index::find(const void* key,
-                            keylen_t keylen,
-                            comparator_t comp,
-                            iterator& it) const
+bool db::index::index::remove_posting(const void* key,
+                                      keylen_t keylen,
+                                      uint64_t posting,
+                                      comparator_t comp)
 {
-  // If the key is neither too short nor too long...
-  if ((keylen >= kKeyMinLen) && (keylen <= kKeyMaxLen)) {
-    // If there is root...
-    if (header_->root != 0) {
-      uint64_t off = header_->root;
+  DB_INDEX_SCOPE(kPosting);
 
-      do {
-        // Read node.
-        const struct node* n;
-        if ((n = read_node(off)) != NULL) {
-          // Inner node?
-          if (n->t == node::type::kInnerNode) {
-            // Search key in the node.
-            nodeoff_t pos;
-            if (!static_cast<const struct inner_node*>(n)->search(key,
-                                                                  keylen,
-                                                                  comp,
-                                                                  pos)) {
-              off = (pos != 0) ?
-                static_cast<const struct inner_node*>(n)->
-                  entries[pos - 1].child :
-                static_cast<const struct inner_node*>(n)->left;
-            } else {
-              off = static_cast<const struct inner_node*>(n)->
-                      entries[pos].child;
-            }
-          } else {
-            // Leaf node.
+  // The key might have a buffered operation (the write is not logged).
+  if ((!apply_pending(key, keylen, comp)) || (!prepare_unlogged_write())) {
+    return false;
+  }
 
-            nodeoff_t pos;
-            if ((static_cast<const struct leaf_node*>(n)->search(key,
-                                                                 keylen,
-                                                                 comp,
-                                                                 pos)) &&
-                (!static_cast<const struct leaf_node*>(n)->erased(pos))) {
-              it.off_ = off;
-              it.node_ = static_cast<const struct leaf_node*>(n);
-              it.pos_ = pos;
+  // If the key is not in the index...
+  iterator it;
+  if (!find_key(key, keylen, comp, it)) {
+    return true;
+  }
 
-              return true;
-            } else {
-              return false;
-            }
-          }
-        } else {
-          return false;
-        }
-      } while (true);
+  // If the key doesn't have a posting list...
+  if (it.node_->type(it.pos_) != leaf_node::value_type::kPostings) {
+    return false;
+  }
+
+  struct leaf_node* leaf = static_cast<struct leaf_node*>(read_node(it.off_));
+
+  const uint8_t* value = reinterpret_cast<const uint8_t*>(
+                           leaf->value(it.pos_)
+                         );
+
+  uint64_t postings[kInlineValueMaxLen];
+  size_t count;
+
+  // First posting node of the list moved back to the leaf node (0: the
+  // postings were already stored in the leaf node).
+  uint64_t first = 0;
+
+  // If the postings are stored in the leaf node...
+  if (value[0] == kPostingsInline) {
+    count = posting_node::decode(value + 1,
+                                 leaf->value_length(it.pos_) - 1,
+                                 postings,
+                                 kInlineValueMaxLen);
+
+    // Search the posting.
+    size_t i;
+    for (i = 0; (i < count) && (postings[i] < posting); i++);
+
+    // If the posting is not in the list...
+    if ((i == count) || (postings[i] != posting)) {
+      return true;
+    }
+
+    // If it is the last posting...
+    if (count == 1) {
+      return erase_key(key, keylen, comp);
+    }
+
+    memmove(&postings[i], &postings[i + 1], (count - i - 1) * sizeof(uint64_t));
+    count--;
+  } else {
+    // The postings are stored in posting nodes.
+    posting_list list;
+    memcpy(&list, value, sizeof(posting_list));
+
+    first = list.first;
+
+    bool removed;
+    remove_posting(first, posting, removed);
+
+    if (!removed) {
+      return true;
     }
+
+    list.first = first;
+    list.count--;
+
+    // The list has the same size: it is replaced in place (the first
+    // posting node might have been freed).
+    leaf->replace(it.pos_,
+                  leaf_node::value_type::kPostings,
+                  &list,
+                  sizeof(posting_list));
+
+    // If it was the last posting...
+    if (list.count == 0) {
+      return erase_key(key, keylen, comp);
+    }
+
+    // If the list is still long...
+    if (list.count >= kInlinePostings) {
+      return true;
+    }
+
+    // Move the postings back to the leaf node.
+    posting_iterator pit;
+    pit.index_ = this;
+    pit.size_ = list.count;
+    pit.node_ = static_cast<const struct posting_node*>(read_node(first));
+    pit.pos_ = 0;
+
+    count = pit.next_batch(postings, kInlineValueMaxLen);
   }
 
-  return false;
+  uint8_t buf[kInlineValueMaxLen];
+  buf[0] = kPostingsInline;
+
+  size_t len = posting_node::encode(postings, count, buf + 1, sizeof(buf) - 1);
+
+  // Replace the value in place if it fits in the leaf node (the encoded
+  // postings are longer than a posting list).
+  if (!leaf->replace(it.pos_,
+                     leaf_node::value_type::kPostings,
+                     buf,
+                     1 + len)) {
+    // Remove the entry (keeping its posting nodes) and add it again, which
+    // splits the leaf node.
+    leaf->remove(it.pos_);
+
+    header_->nkeys--;
+
+    update_parent_counts(it.off_, -1);
+
+    if (!insert(key,
+                keylen,
+                leaf_node::value_type::kPostings,
+                buf,
+                1 + len,
+                comp)) {
+      free_postings(first);
+      return false;
+    }
+  }
+
+  // The postings are no longer stored in posting nodes.
+  free_postings(first);
+
+  return true;
 }
 
-bool db::index::index::print() const
+bool db::index::index::begin(iterator& it) const
+{
+  DB_INDEX_PROBE1(begin_entry, header_->root);
+
+  bool ret = ((prepare_read()) && (first(it)));
+
+  DB_INDEX_PROBE2(begin_return, ret, ret ? it.off_ : 0);
+
+  record(operation_trace::op_type::kBegin, ret);
+
+  return ret;
+}
+
+bool db::index::index::first(iterator& it) const
 {
+  DB_INDEX_SCOPE(kScan);
+
   // If there is root...
   if (header_->root != 0) {
+    DB_INDEX_COUNT(descents, 1);
+
     uint64_t off = header_->root;
 
     const struct node* n;
-    uint64_t nkeys = 0;
-    size_t depth = 1;
 
     do {
       // Read node.
       if ((n = read_node(off)) != NULL) {
         // Inner node?
         if (n->t == node::type::kInnerNode) {
-          off = static_cast<const struct inner_node*>(n)->left;
+          const struct inner_node* inner =
+                                   static_cast<const struct inner_node*>(n);
 
-          depth++;
+          // Skip the subtrees without keys.
+          nodeoff_t i;
+          for (i = 0; (i <= inner->nentries) && (inner->child_count(i) == 0);
+               i++);
+
+          if (i > inner->nentries) {
+            return false;
+          }
+
+          off = inner->child(i);
         } else {
           // Leaf node.
           break;
         }
       } else {
-        printf("Error reading node at offset %lu.\n", off);
         return false;
       }
     } while (true);
 
-    const struct leaf_node* leaf =
-                            reinterpret_cast<const struct leaf_node*>(n);
+    do {
+      const struct leaf_node* leaf =
+                              reinterpret_cast<const struct leaf_node*>(n);
+
+      // Leaf nodes without live entries are skipped.
+      nodeoff_t i = 0;
+      if (leaf->next_live(i)) {
+        it.vlog_ = &vlog_;
+        it.off_ = off;
+        it.node_ = leaf;
+        it.pos_ = i;
+
+        return true;
+      }
+
+      off = leaf->next;
+
+    } while ((n = read_node(off)) != NULL);
+  }
+
+  return false;
+}
+
+bool db::index::index::end(iterator& it) const
+{
+  if (!prepare_read()) {
+    return false;
+  }
+
+  DB_INDEX_SCOPE(kScan);
+
+  // If there is root...
+  if (header_->root != 0) {
+    DB_INDEX_COUNT(descents, 1);
+
+    uint64_t off = header_->root;
+
+    const struct node* n;
 
     do {
-      printf("Node:\n");
-      leaf->print();
-      printf("==========================================================\n");
+      // Read node.
+      if ((n = read_node(off)) != NULL) {
+        // Inner node?
+        if (n->t == node::type::kInnerNode) {
+          const struct inner_node* inner =
+                                   static_cast<const struct inner_node*>(n);
 
-      nkeys += leaf->nentries;
+          // Skip the subtrees without keys.
+          nodeoff_t i;
+          for (i = inner->nentries + 1;
+               (i > 0) && (inner->child_count(i - 1) == 0);
+               i--);
 
-      // If there is next node...
-      if (leaf->next != 0) {
-        // Read node.
-        if ((leaf = static_cast<const struct leaf_node*>(
-                      read_node(leaf->next)
-                    )) == NULL) {
-          printf("Error reading node at offset %lu.\n", off);
-          return false;
+          if (i == 0) {
+            return false;
+          }
+
+          off = inner->child(i - 1);
+        } else {
+          // Leaf node.
+          break;
         }
       } else {
-        break;
+        return false;
       }
     } while (true);
 
-    if (nkeys != header_->nkeys) {
-      printf("Unexpected number of keys %lu, expected %lu.\n",
-             nkeys,
-             header_->nkeys);
-    } else {
-      printf("# of keys: %lu.\n", nkeys);
-    }
+    do {
+      const struct leaf_node* leaf =
+                              reinterpret_cast<const struct leaf_node*>(n);
 
-    printf("# of nodes: %lu.\n", header_->nnodes);
-    printf("Depth: %zu.\n", depth);
+      // Leaf nodes without live entries are skipped.
+      nodeoff_t i = leaf->nentries;
+      if (leaf->previous_live(i)) {
+        it.vlog_ = &vlog_;
+        it.off_ = off;
+        it.node_ = leaf;
+        it.pos_ = i;
+
+        return true;
+      }
+
+      off = leaf->prev;
+
+    } while ((n = read_node(off)) != NULL);
   }
 
-  return true;
+  return false;
 }
 
-bool db::index::index::create_node(size_t depth, uint64_t& off)
+bool db::index::index::previous(iterator& it) const
 {
-  // Allocate nodes (if needed).
-  if (allocate(depth + 2)) {
-    // Calculate the offset of the new node.
-    off = (1 + header_->nnodes) * kNodeSize;
+  DB_INDEX_SCOPE(kScan);
 
-    header_->nnodes++;
-
-    return true;
+  // If the iterator has been exhausted by next_batch()...
+  if (!it.node_) {
+    return false;
   }
 
+  const struct node* n = it.node_;
+  uint64_t off = it.off_;
+  nodeoff_t i = it.pos_;
+
+  do {
+    if (static_cast<const struct leaf_node*>(n)->previous_live(i)) {
+      it.off_ = off;
+      it.node_ = static_cast<const struct leaf_node*>(n);
+      it.pos_ = i;
+
+      return true;
+    }
+
+    off = static_cast<const struct leaf_node*>(n)->prev;
+
+    if ((n = read_node(off)) != NULL) {
+      i = n->nentries;
+    } else {
+      break;
+    }
+  } while (true);
+
   return false;
 }
 
-bool db::index::index::allocate(size_t count)
+bool db::index::index::next(iterator& it) const
 {
-  // Calculate the needed size.
-  uint64_t size = (1 + header_->nnodes + count) * kNodeSize;
+  DB_INDEX_SCOPE(kScan);
 
-  // If there is space enough...
-  if (size <= filesize_) {
-    return true;
-  }
+  DB_INDEX_PROBE1(next_entry, it.off_);
 
-  // We have to allocate more nodes.
+  // The iterator might have been exhausted by next_batch().
+  bool ret = ((it.node_) && (forward(it.off_, it.node_, it.pos_ + 1, it)));
 
-  size_t n = kAllocate;
-  while (n < count) {
-    n *= 2;
-  }
+  DB_INDEX_PROBE2(next_return, ret, it.off_);
 
-  size = (1 + header_->nnodes + n) * kNodeSize;
+  record(operation_trace::op_type::kNext, ret);
 
-  // Grow file.
-  if (ftruncate(fd_, size) == 0) {
-    // Remap file into memory.
-    void* data;
-    if ((data = mremap(data_,
-                       filesize_,
-                       size,
-                       MREMAP_MAYMOVE)) != MAP_FAILED) {
-      data_ = data;
-      filesize_ = size;
+  return ret;
+}
 
-      header_ = reinterpret_cast<header*>(data_);
+size_t db::index::index::next_batch(iterator& it,
+                                   ref* refs,
+                                   size_t max) const
+{
+  DB_INDEX_SCOPE(kScan);
 
-      return true;
-    }
+  // If the iterator has been exhausted...
+  if (!it.node_) {
+    return 0;
   }
 
-  return false;
+  const struct leaf_node* leaf = it.node_;
+  uint64_t off = it.off_;
+  nodeoff_t i = it.pos_;
+
+  size_t count = 0;
+
+  do {
+    if ((it.readahead_ != 0) && (off != it.ahead_leaf_)) {
+      read_ahead(it, off, leaf);
+    }
+
+    const struct leaf_node::entry* entries = leaf->entries;
+    nodeoff_t nentries = (leaf->nlive > 0) ? leaf->nentries : 0;
+
+    for (; i < nentries; i++) {
+      if (!entries[i].deleted) {
+        // If the array is full...
+        if (count == max) {
+          it.off_ = off;
+          it.node_ = leaf;
+          it.pos_ = i;
+
+          return count;
+        }
+
+        refs[count].key = reinterpret_cast<const uint8_t*>(leaf) +
+                          entries[i].keyoff;
+
+        refs[count].keylen = entries[i].keylen;
+        refs[count].value = get_value(&vlog_,
+                                      leaf,
+                                      i,
+                                      refs[count].valuelen);
+        refs[count].dataoff = entries[i].dataoff;
+
+        count++;
+      } else {
+        DB_INDEX_COUNT(deleted_skipped, 1);
+      }
+    }
+
+    off = leaf->next;
+    i = 0;
+  } while ((leaf = static_cast<const struct leaf_node*>(read_node(off))) !=
+           NULL);
+
+  // No more entries.
+  it.node_ = NULL;
+
+  return count;
+}
+
+bool db::index::index::write(write_batch& batch, comparator_t comp)
+{
+  DB_INDEX_SCOPE(kWrite);
+
+  if (batch.count() == 0) {
+    return true;
+  }
+
+  // Once the batch is in the log, it is applied again when the index is
+  // opened (if the process crashes while applying it).
+  if ((has_wal_) && (!wal_.append(batch))) {
+    return false;
+  }
+
+  // If there is a memtable...
+  if (has_memtable_) {
+    // Buffer the operations (in order, so the last one wins).
+    for (size_t i = 0; i < batch.count(); i++) {
+      if (batch.type(i) == write_batch::op_type::kErase) {
+        if (!memtable_.erase(batch.key(i), batch.keylen(i))) {
+          return false;
+        }
+      } else if (!memtable_.add(batch.key(i),
+                                batch.keylen(i),
+                                batch.data_offset(i))) {
+        return false;
+      }
+    }
+
+    // If the memtable is full...
+    if ((memtable_.memory() >= memtable_size_) && (!flush())) {
+      return false;
+    }
+  } else {
+    batch.sort(comp);
+
+    if (!apply(batch, comp)) {
+      return false;
+    }
+  }
+
+  // If the log is too big...
+  if ((has_wal_) && (wal_.size() >= kCheckpointSize)) {
+    return checkpoint();
+  }
+
+  return true;
+}
+
+bool db::index::index::checkpoint()
+{
+  DB_INDEX_SCOPE(kFlush);
+
+  // The operations of the memtable are in the log (the message buffers are
+  // stored in the index).
+  return ((drain_memtable()) &&
+          (sync()) &&
+          ((!has_wal_) || (wal_.truncate())));
+}
+
+bool db::index::index::log_write(write_batch::op_type type,
+                                 const void* key,
+                                 keylen_t keylen,
+                                 uint64_t dataoff)
+{
+  if (!has_wal_) {
+    return true;
+  }
+
+  single_.clear();
+
+  return (((type == write_batch::op_type::kErase) ?
+             single_.erase(key, keylen) :
+             single_.add(key, keylen, dataoff)) &&
+          (wal_.append(single_)));
+}
+
+bool db::index::index::prepare_unlogged_write()
+{
+  // If the log has batches...
+  if ((has_wal_) && (wal_.size() > 0)) {
+    return checkpoint();
+  }
+
+  return true;
+}
+
+bool db::index::index::prepare_read() const
+{
+  // If the memtable is not empty or the message buffers might hold
+  // messages...
+  if (((has_memtable_) && (memtable_.first() != NULL)) || (has_messages_)) {
+    // The contents of the index don't change (like the node cache).
+    return const_cast<index*>(this)->flush();
+  }
+
+  return true;
+}
+
+bool db::index::index::prepare_read(const void* key,
+                                    keylen_t keylen,
+                                    comparator_t comp) const
+{
+  // If the memtable or a message buffer has an operation on the key...
+  uint8_t type;
+  uint64_t dataoff;
+  if (((has_memtable_) && (memtable_.find(key, keylen) != NULL)) ||
+      ((has_buffers_) && (find_message(key, keylen, comp, type, dataoff)))) {
+    return const_cast<index*>(this)->apply_pending(key, keylen, comp);
+  }
+
+  return true;
+}
+
+bool db::index::index::flush()
+{
+  DB_INDEX_SCOPE(kFlush);
+
+  return ((drain_memtable()) && (flush_buffers()));
+}
+
+bool db::index::index::drain_memtable()
+{
+  if (has_memtable_) {
+    // Leaf node of the previous operation (0: none).
+    uint64_t off = 0;
+
+    // Apply the operations in key order.
+    for (const memtable::entry* e = memtable_.first(); e; e = e->next[0]) {
+      if (!apply(static_cast<write_batch::op_type>(e->type),
+                 e->key(),
+                 e->keylen,
+                 e->dataoff,
+                 comp_,
+                 off)) {
+        return false;
+      }
+    }
+
+    memtable_.clear();
+  }
+
+  return true;
+}
+
+bool db::index::index::find(const void* key,
+                            keylen_t keylen,
+                            comparator_t comp,
+                            iterator& it) const
+{
+  DB_INDEX_PROBE2(find_entry, key, keylen);
+
+  bool ret = ((prepare_read(key, keylen, comp)) &&
+              (find_key(key, keylen, comp, it)));
+
+  DB_INDEX_PROBE2(find_return, ret, ret ? it.off_ : 0);
+
+  record(operation_trace::op_type::kFind, ret, key, keylen);
+
+  return ret;
+}
+
+bool db::index::index::find_key(const void* key,
+                                keylen_t keylen,
+                                comparator_t comp,
+                                iterator& it) const
+{
+  DB_INDEX_SCOPE(kFind);
+
+  // If the key is neither too short nor too long...
+  if ((keylen >= kKeyMinLen) && (keylen <= kKeyMaxLen)) {
+    DB_INDEX_COUNT(lookups, 1);
+
+    // If the filter says that the key is not in the index...
+    if ((has_filter_) && (!filter_.may_contain(key, keylen))) {
+      return false;
+    }
+
+    // If the learned model predicts a leaf node which has the key (it only
+    // knows the leaf nodes which existed when it was fitted, so the tree is
+    // searched otherwise)...
+    uint64_t off;
+    const struct node* n;
+    nodeoff_t pos;
+    if ((has_model_) &&
+        (!comp) &&
+        (model_.find(key_prefix(key, keylen), off)) &&
+        ((n = read_node(off)) != NULL) &&
+        (n->t == node::type::kLeafNode) &&
+        (static_cast<const struct leaf_node*>(n)->search(key,
+                                                         keylen,
+                                                         comp,
+                                                         pos)) &&
+        (!static_cast<const struct leaf_node*>(n)->erased(pos))) {
+      DB_INDEX_COUNT(model_hits, 1);
+
+      it.vlog_ = &vlog_;
+      it.off_ = off;
+      it.node_ = static_cast<const struct leaf_node*>(n);
+      it.pos_ = pos;
+
+      return true;
+    }
+
+    // If there is root...
+    if (header_->root != 0) {
+      uint64_t level;
+      off = first_node(key, keylen, comp, level);
+
+      do {
+        // Read node.
+        const struct node* n;
+        if ((n = read_node(off)) != NULL) {
+          // Inner node?
+          if (n->t == node::type::kInnerNode) {
+            // Search child which might contain the key.
+            nodeoff_t pos;
+            pos = static_cast<const struct inner_node*>(n)->search_child(key,
+                                                                        keylen,
+                                                                        comp);
+
+            off = static_cast<const struct inner_node*>(n)->child(pos);
+          } else {
+            // Leaf node.
+
+            nodeoff_t pos;
+            if ((static_cast<const struct leaf_node*>(n)->search(key,
+                                                                 keylen,
+                                                                 comp,
+                                                                 pos)) &&
+                (!static_cast<const struct leaf_node*>(n)->erased(pos))) {
+              it.vlog_ = &vlog_;
+              it.off_ = off;
+              it.node_ = static_cast<const struct leaf_node*>(n);
+              it.pos_ = pos;
+
+              return true;
+            } else {
+              return false;
+            }
+          }
+        } else {
+          return false;
+        }
+      } while (true);
+    }
+  }
+
+  return false;
+}
+
+bool db::index::index::rank(const void* key,
+                            keylen_t keylen,
+                            comparator_t comp,
+                            uint64_t& rank) const
+{
+  if (!prepare_read()) {
+    return false;
+  }
+
+  DB_INDEX_SCOPE(kFind);
+
+  rank = 0;
+
+  // If the key is neither too short nor too long...
+  if ((keylen >= kKeyMinLen) && (keylen <= kKeyMaxLen)) {
+    // If there is root...
+    if (header_->root != 0) {
+      DB_INDEX_COUNT(descents, 1);
+
+      uint64_t off = header_->root;
+
+      do {
+        // Read node.
+        const struct node* n;
+        if ((n = read_node(off)) != NULL) {
+          // Inner node?
+          if (n->t == node::type::kInnerNode) {
+            const struct inner_node* inner =
+                                     static_cast<const struct inner_node*>(n);
+
+            // Search child which might contain the key.
+            nodeoff_t pos = inner->search_child(key, keylen, comp);
+
+            // Add the keys of the children at the left.
+            rank += inner->count_before(pos);
+
+            off = inner->child(pos);
+          } else {
+            // Leaf node.
+            const struct leaf_node* leaf =
+                                    static_cast<const struct leaf_node*>(n);
+
+            nodeoff_t pos;
+            leaf->search(key, keylen, comp, pos);
+
+            rank += leaf->count_live(pos);
+
+            return true;
+          }
+        } else {
+          return false;
+        }
+      } while (true);
+    } else {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool db::index::index::select(uint64_t rank, iterator& it) const
+{
+  if (!prepare_read()) {
+    return false;
+  }
+
+  DB_INDEX_SCOPE(kFind);
+
+  // If there are enough keys...
+  if (rank < header_->nkeys) {
+    DB_INDEX_COUNT(descents, 1);
+
+    uint64_t off = header_->root;
+
+    do {
+      // Read node.
+      const struct node* n;
+      if ((n = read_node(off)) != NULL) {
+        // Inner node?
+        if (n->t == node::type::kInnerNode) {
+          const struct inner_node* inner =
+                                   static_cast<const struct inner_node*>(n);
+
+          // Search the child which contains the key.
+          nodeoff_t i;
+          uint64_t count;
+          for (i = 0;
+               (i <= inner->nentries) && ((count = inner->child_count(i)) <=
+                                          rank);
+               i++) {
+            rank -= count;
+          }
+
+          if (i > inner->nentries) {
+            return false;
+          }
+
+          off = inner->child(i);
+        } else {
+          // Leaf node.
+          const struct leaf_node* leaf =
+                                  static_cast<const struct leaf_node*>(n);
+
+          nodeoff_t pos;
+          if (leaf->select_live(rank, pos)) {
+            it.vlog_ = &vlog_;
+            it.off_ = off;
+            it.node_ = leaf;
+            it.pos_ = pos;
+
+            return true;
+          }
+
+          return false;
+        }
+      } else {
+        return false;
+      }
+    } while (true);
+  }
+
+  return false;
+}
+
+bool db::index::index::lower_bound(const void* key,
+                                   keylen_t keylen,
+                                   comparator_t comp,
+                                   iterator& it) const
+{
+  if (!prepare_read()) {
+    return false;
+  }
+
+  DB_INDEX_SCOPE(kScan);
+
+  // If the key is neither too short nor too long...
+  if ((keylen >= kKeyMinLen) && (keylen <= kKeyMaxLen)) {
+    // If there is root...
+    if (header_->root != 0) {
+      DB_INDEX_COUNT(descents, 1);
+
+      uint64_t off = header_->root;
+
+      do {
+        // Read node.
+        const struct node* n;
+        if ((n = read_node(off)) != NULL) {
+          // Inner node?
+          if (n->t == node::type::kInnerNode) {
+            // Search child which might contain the key.
+            nodeoff_t pos;
+            pos = static_cast<const struct inner_node*>(n)->search_child(key,
+                                                                        keylen,
+                                                                        comp);
+
+            off = static_cast<const struct inner_node*>(n)->child(pos);
+          } else {
+            // Leaf node.
+            const struct leaf_node* leaf =
+                                    static_cast<const struct leaf_node*>(n);
+
+            nodeoff_t pos;
+            leaf->search(key, keylen, comp, pos);
+
+            it.vlog_ = &vlog_;
+
+            return forward(off, leaf, pos, it);
+          }
+        } else {
+          return false;
+        }
+      } while (true);
+    }
+  }
+
+  return false;
+}
+
+bool db::index::index::seek(const void* key,
+                            keylen_t keylen,
+                            comparator_t comp,
+                            iterator& it) const
+{
+  DB_INDEX_SCOPE(kScan);
+
+  // If the iterator has been exhausted by next_batch()...
+  if (!it.node_) {
+    return false;
+  }
+
+  // If the iterator is already at a key >= key...
+  if (compare(comp, it.key(), it.keylen(), key, keylen) >= 0) {
+    return true;
+  }
+
+  const struct leaf_node* leaf = it.node_;
+
+  // If the key is not greater than the last key of the leaf node...
+  nodeoff_t pos;
+  if (compare(comp,
+              key,
+              keylen,
+              leaf->key(leaf->nentries - 1),
+              leaf->keylen(leaf->nentries - 1)) <= 0) {
+    leaf->search(key, keylen, comp, pos);
+
+    return forward(it.off_, leaf, pos, it);
+  }
+
+  // If the key is not greater than the last key of the next leaf node...
+  uint64_t off = leaf->next;
+  if (((leaf = static_cast<const struct leaf_node*>(read_node(off))) !=
+       NULL) &&
+      (leaf->nentries > 0) &&
+      (compare(comp,
+               key,
+               keylen,
+               leaf->key(leaf->nentries - 1),
+               leaf->keylen(leaf->nentries - 1)) <= 0)) {
+    leaf->search(key, keylen, comp, pos);
+
+    return forward(off, leaf, pos, it);
+  }
+
+  // Search from the root.
+  return lower_bound(key, keylen, comp, it);
+}
+
+bool db::index::index::find_postings(const void* key,
+                                     keylen_t keylen,
+                                     comparator_t comp,
+                                     posting_iterator& pit) const
+{
+  DB_INDEX_SCOPE(kPosting);
+
+  iterator it;
+  return ((prepare_read(key, keylen, comp)) &&
+          (find_key(key, keylen, comp, it)) &&
+          (postings(it.node_, it.pos_, pit)));
+}
+
+bool db::index::index::postings(const iterator& it,
+                                posting_iterator& pit) const
+{
+  return postings(it.node_, it.pos_, pit);
+}
+
+size_t db::index::index::posting_iterator::next_batch(uint64_t* postings,
+                                                      size_t max)
+{
+  size_t count = 0;
+
+  // Postings stored in posting nodes?
+  if (node_) {
+    while (count < max) {
+      if (pos_ == node_->nentries) {
+        if ((node_ = static_cast<const struct posting_node*>(
+                       index_->read_node(node_->next)
+                     )) == NULL) {
+          break;
+        }
+
+        pos_ = 0;
+      }
+
+      size_t n = node_->nentries - pos_;
+      if (n > max - count) {
+        n = max - count;
+      }
+
+      memcpy(postings + count, node_->postings + pos_, n * sizeof(uint64_t));
+
+      count += n;
+      pos_ += n;
+    }
+  } else {
+    while ((count < max) && (posting_node::decode_next(ptr_, end_, last_))) {
+      postings[count++] = last_;
+    }
+  }
+
+  return count;
+}
+
+bool db::index::index::print() const
+{
+  // If there is root...
+  if (header_->root != 0) {
+    uint64_t off = header_->root;
+
+    const struct node* n;
+    uint64_t nkeys = 0;
+    size_t depth = 1;
+
+    do {
+      // Read node.
+      if ((n = read_node(off)) != NULL) {
+        // Inner node?
+        if (n->t == node::type::kInnerNode) {
+          off = static_cast<const struct inner_node*>(n)->left;
+
+          depth++;
+        } else {
+          // Leaf node.
+          break;
+        }
+      } else {
+        printf("Error reading node at offset %lu.\n", off);
+        return false;
+      }
+    } while (true);
+
+    const struct leaf_node* leaf =
+                            reinterpret_cast<const struct leaf_node*>(n);
+
+    do {
+      printf("Node:\n");
+      leaf->print();
+      printf("==========================================================\n");
+
+      nkeys += leaf->nlive;
+
+      // If there is next node...
+      if (leaf->next != 0) {
+        // Read node.
+        if ((leaf = static_cast<const struct leaf_node*>(
+                      read_node(leaf->next)
+                    )) == NULL) {
+          printf("Error reading node at offset %lu.\n", off);
+          return false;
+        }
+      } else {
+        break;
+      }
+    } while (true);
+
+    if (nkeys != header_->nkeys) {
+      printf("Unexpected number of keys %lu, expected %lu.\n",
+             nkeys,
+             header_->nkeys);
+    } else {
+      printf("# of keys: %lu.\n", nkeys);
+    }
+
+    printf("# of nodes: %lu.\n", header_->nnodes);
+    printf("Depth: %zu.\n", depth);
+  }
+
+#ifdef DB_INDEX_STATS
+  stats().print();
+#endif
+
+  return true;
+}
+
+bool db::index::index::analyze(analysis& a, unsigned nthreads) const
+{
+  a.clear();
+
+  a.pages = (filesize_ / kNodeSize) - 1;
+  a.unused_pages = a.pages - header_->nnodes;
+
+  // Free posting nodes.
+  uint64_t off = header_->free_posting_nodes;
+  while (off != 0) {
+    const struct posting_node* n;
+    if ((n = static_cast<const struct posting_node*>(read_node(off))) ==
+        NULL) {
+      return false;
+    }
+
+    a.free_posting_pages++;
+
+    off = n->next;
+  }
+
+  // If there is no root...
+  if (header_->root == 0) {
+    return true;
+  }
+
+  a.height = header_->height;
+
+  if (nthreads == 0) {
+    long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    nthreads = (ncpus > 0) ? static_cast<unsigned>(ncpus) : 1;
+  }
+
+  // Split the tree into subtrees: the upper levels are analyzed here until
+  // there are enough subtrees to keep the threads busy.
+  size_t size = 1024;
+  uint64_t* subtrees;
+  if ((subtrees = static_cast<uint64_t*>(malloc(size * sizeof(uint64_t)))) ==
+      NULL) {
+    return false;
+  }
+
+  subtrees[0] = header_->root;
+  size_t nsubtrees = 1;
+
+  size_t level = header_->height;
+
+  while ((nsubtrees < 4 * nthreads) && (level > 1)) {
+    uint64_t* children = NULL;
+    size_t nchildren = 0;
+    size_t children_size = 0;
+
+    for (size_t i = 0; i < nsubtrees; i++) {
+      const struct node* n;
+      if (((n = read_node(subtrees[i])) == NULL) ||
+          (n->t != node::type::kInnerNode) ||
+          (!analyze_node(subtrees[i], level, a))) {
+        free(children);
+        free(subtrees);
+        return false;
+      }
+
+      const struct inner_node* inner = static_cast<const struct inner_node*>(n);
+
+      // If the array is full...
+      if (nchildren + inner->nentries + 1 > children_size) {
+        children_size = (children_size > 0) ? children_size * 2 : size;
+        while (nchildren + inner->nentries + 1 > children_size) {
+          children_size *= 2;
+        }
+
+        uint64_t* tmp;
+        if ((tmp = static_cast<uint64_t*>(
+                     realloc(children, children_size * sizeof(uint64_t))
+                   )) == NULL) {
+          free(children);
+          free(subtrees);
+          return false;
+        }
+
+        children = tmp;
+      }
+
+      for (nodeoff_t j = 0; j <= inner->nentries; j++) {
+        children[nchildren++] = inner->child(j);
+      }
+    }
+
+    free(subtrees);
+
+    subtrees = children;
+    nsubtrees = nchildren;
+
+    level--;
+  }
+
+  // Analyze the subtrees in parallel.
+  analyze_task task;
+  task.idx = this;
+  task.subtrees = subtrees;
+  task.nsubtrees = nsubtrees;
+  task.level = level;
+  task.next = 0;
+  task.failed = false;
+
+  if (nthreads > nsubtrees) {
+    nthreads = nsubtrees;
+  }
+
+  analyze_worker* workers;
+  pthread_t* threads;
+  if ((workers = static_cast<analyze_worker*>(
+                   malloc(nthreads * sizeof(analyze_worker))
+                 )) == NULL) {
+    free(subtrees);
+    return false;
+  }
+
+  if ((threads = static_cast<pthread_t*>(
+                   malloc(nthreads * sizeof(pthread_t))
+                 )) == NULL) {
+    free(workers);
+    free(subtrees);
+    return false;
+  }
+
+  for (unsigned i = 0; i < nthreads; i++) {
+    workers[i].task = &task;
+    workers[i].a.clear();
+  }
+
+  // The calling thread is the first worker (if a thread cannot be created,
+  // the subtrees are shared by the threads which are running).
+  unsigned nstarted;
+  for (nstarted = 1; nstarted < nthreads; nstarted++) {
+    if (pthread_create(&threads[nstarted],
+                       NULL,
+                       analyze_subtrees,
+                       &workers[nstarted]) != 0) {
+      break;
+    }
+  }
+
+  analyze_subtrees(&workers[0]);
+
+  a.add(workers[0].a);
+
+  for (unsigned i = 1; i < nstarted; i++) {
+    pthread_join(threads[i], NULL);
+    a.add(workers[i].a);
+  }
+
+  free(threads);
+  free(workers);
+  free(subtrees);
+
+  return !task.failed;
+}
+
+void* db::index::index::analyze_subtrees(void* arg)
+{
+  analyze_worker* worker = static_cast<analyze_worker*>(arg);
+  analyze_task* task = worker->task;
+
+  do {
+    size_t i = __atomic_fetch_add(&task->next, 1, __ATOMIC_RELAXED);
+    if (i >= task->nsubtrees) {
+      return NULL;
+    }
+
+    if (!task->idx->analyze_subtree(task->subtrees[i],
+                                    task->level,
+                                    worker->a)) {
+      __atomic_store_n(&task->failed, true, __ATOMIC_RELAXED);
+    }
+  } while (true);
+}
+
+bool db::index::index::analyze_subtree(uint64_t off,
+                                       size_t level,
+                                       analysis& a) const
+{
+  if (!analyze_node(off, level, a)) {
+    return false;
+  }
+
+  // Leaf node?
+  if (level == 1) {
+    return true;
+  }
+
+  const struct inner_node* inner =
+                           static_cast<const struct inner_node*>(
+                             read_node(off)
+                           );
+
+  for (nodeoff_t i = 0; i <= inner->nentries; i++) {
+    if (!analyze_subtree(inner->child(i), level - 1, a)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool db::index::index::analyze_node(uint64_t off,
+                                    size_t level,
+                                    analysis& a) const
+{
+  const struct node* n;
+  if (((n = read_node(off)) == NULL) ||
+      ((level == 1) != (n->t == node::type::kLeafNode)) ||
+      ((level > 1) && (n->t != node::type::kInnerNode))) {
+    return false;
+  }
+
+  analysis::level& l = a.levels[((level < analysis::kMaxLevels) ?
+                                 level :
+                                 analysis::kMaxLevels) - 1];
+
+  l.nodes++;
+  l.entries += n->nentries;
+
+  // Bytes of the keys (and of what is stored after them).
+  uint64_t used = 0;
+
+  if (level > 1) {
+    const struct inner_node* inner = static_cast<const struct inner_node*>(n);
+
+    for (nodeoff_t i = 0; i < inner->nentries; i++) {
+      used += inner->entries[i].keylen;
+    }
+
+    l.key_bytes += used;
+    l.reclaimable_bytes += (kNodeSize - inner->nextoff) - used;
+
+    used += offsetof(inner_node, entries) +
+            (inner->nentries * sizeof(inner_node::entry));
+
+    // The inner nodes above the leaf nodes might have a message buffer.
+    if ((level == 2) && (has_buffers_)) {
+      a.buffer_pages += header_->buffer_pages;
+    }
+  } else {
+    const struct leaf_node* leaf = static_cast<const struct leaf_node*>(n);
+
+    for (nodeoff_t i = 0; i < leaf->nentries; i++) {
+      keylen_t keylen = leaf->keylen(i);
+      nodeoff_t valuelen = leaf->value_length(i);
+
+      l.key_bytes += keylen;
+      a.value_bytes += valuelen;
+
+      used += keylen + valuelen;
+
+      // Posting list stored in posting nodes?
+      if ((leaf->type(i) == leaf_node::value_type::kPostings) &&
+          (*static_cast<const uint8_t*>(leaf->value(i)) == kPostingsNodes)) {
+        posting_list list;
+        memcpy(&list, leaf->value(i), sizeof(posting_list));
+
+        const struct posting_node* p;
+        for (uint64_t poff = list.first; poff != 0; poff = p->next) {
+          if ((p = static_cast<const struct posting_node*>(
+                     read_node(poff)
+                   )) == NULL) {
+            return false;
+          }
+
+          a.posting_pages++;
+        }
+      }
+    }
+
+    l.reclaimable_bytes += leaf->reclaimable();
+
+    used += offsetof(leaf_node, entries) +
+            (leaf->nentries * sizeof(leaf_node::entry));
+
+    nodeoff_t deleted = leaf->nentries - leaf->nlive;
+    a.deleted += deleted;
+
+    size_t bucket = (leaf->nentries > 0) ?
+                    (deleted * analysis::kBuckets) / leaf->nentries :
+                    0;
+
+    a.tombstones[(bucket < analysis::kBuckets) ?
+                 bucket :
+                 analysis::kBuckets - 1]++;
+
+    // Position of the next leaf node in the file.
+    if (leaf->next != 0) {
+      if (leaf->next > off) {
+        a.forward_leaves++;
+        a.leaf_distance += (leaf->next - off) / kNodeSize;
+
+        if (leaf->next == off + kNodeSize) {
+          a.adjacent_leaves++;
+        }
+      } else {
+        a.leaf_distance += (off - leaf->next) / kNodeSize;
+      }
+    }
+  }
+
+  l.used_bytes += used;
+
+  size_t bucket = (used * analysis::kBuckets) / kNodeSize;
+
+  l.fill[(bucket < analysis::kBuckets) ? bucket : analysis::kBuckets - 1]++;
+
+  return true;
+}
+
+bool db::index::index::apply(const write_batch& batch, comparator_t comp)
+{
+  // Leaf node of the previous operation (0: none).
+  uint64_t off = 0;
+
+  size_t count = batch.count();
+  for (size_t i = 0; i < count; i++) {
+    const void* key = batch.key(i);
+    keylen_t keylen = batch.keylen(i);
+
+    // Only the last operation on a key is applied.
+    if ((i + 1 < count) &&
+        (compare(comp, key, keylen, batch.key(i + 1), batch.keylen(i + 1)) ==
+         0)) {
+      continue;
+    }
+
+    if (!apply(batch.type(i), key, keylen, batch.data_offset(i), comp, off)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool db::index::index::apply(write_batch::op_type type,
+                             const void* key,
+                             keylen_t keylen,
+                             uint64_t dataoff,
+                             comparator_t comp,
+                             uint64_t& off)
+{
+  return has_buffers_ ? buffer(type, key, keylen, dataoff, comp) :
+                        apply_to_leaf(type, key, keylen, dataoff, comp, off);
+}
+
+bool db::index::index::apply_to_leaf(write_batch::op_type type,
+                                     const void* key,
+                                     keylen_t keylen,
+                                     uint64_t dataoff,
+                                     comparator_t comp,
+                                     uint64_t& off)
+{
+  struct leaf_node* leaf = (off != 0) ?
+                           static_cast<struct leaf_node*>(read_node(off)) :
+                           NULL;
+
+  // If the key is not between the first and the last key of the leaf node
+  // of the previous operation...
+  if ((leaf == NULL) ||
+      (compare(comp, key, keylen, leaf->key(0), leaf->keylen(0)) < 0) ||
+      (compare(comp,
+               key,
+               keylen,
+               leaf->key(leaf->nentries - 1),
+               leaf->keylen(leaf->nentries - 1)) > 0)) {
+    // Search from the root.
+    if (find_leaf(key, keylen, comp, off)) {
+      leaf = static_cast<struct leaf_node*>(read_node(off));
+    } else {
+      leaf = NULL;
+    }
+  }
+
+  nodeoff_t pos;
+  if (type == write_batch::op_type::kErase) {
+    // If the key is in the index...
+    if ((leaf) &&
+        (leaf->search(key, keylen, comp, pos)) &&
+        (!leaf->erased(pos))) {
+      // The value is no longer referenced.
+      release_value(leaf, pos);
+
+      // Mark the key as deleted.
+      leaf->entries[pos].deleted = 1;
+      leaf->nlive--;
+
+      header_->nkeys--;
+
+      update_parent_counts(off, -1);
+    }
+  } else if (leaf == NULL) {
+    // The index is empty.
+    if (!insert(key,
+                keylen,
+                leaf_node::value_type::kExternal,
+                NULL,
+                dataoff,
+                comp)) {
+      return false;
+    }
+
+    off = 0;
+  } else {
+    // Add key to the filter.
+    if ((has_filter_) && (!filter_.may_contain(key, keylen))) {
+      filter_.add(key, keylen);
+    }
+
+    if (leaf->search(key, keylen, comp, pos)) {
+      bool erased = leaf->erased(pos);
+
+      // The previous value is no longer referenced.
+      release_value(leaf, pos);
+
+      // Nothing is stored after the key, so it fits.
+      leaf->replace(pos, leaf_node::value_type::kExternal, NULL, dataoff);
+
+      // If the key had been deleted...
+      if (erased) {
+        leaf->entries[pos].deleted = 0;
+        leaf->nlive++;
+
+        header_->nkeys++;
+
+        update_parent_counts(off, 1);
+      }
+    } else if (leaf->add(key,
+                         keylen,
+                         leaf_node::value_type::kExternal,
+                         NULL,
+                         dataoff,
+                         pos)) {
+      header_->nkeys++;
+
+      update_parent_counts(off, 1);
+    } else {
+      // The leaf node is full: add the key from the root (the node is
+      // split).
+      if (!insert(key,
+                  keylen,
+                  leaf_node::value_type::kExternal,
+                  NULL,
+                  dataoff,
+                  comp)) {
+        return false;
+      }
+
+      off = 0;
+    }
+  }
+
+  return true;
+}
+
+bool db::index::index::apply_pending(const void* key,
+                                     keylen_t keylen,
+                                     comparator_t comp)
+{
+  // The message of the key is older than its operation in the memtable (the
+  // memtable is drained into the message buffers).
+
+  // If the tree has message buffers...
+  if ((has_buffers_) && (header_->height >= 2)) {
+    message_buffer* b = get_buffer(find_buffered_node(key, keylen, comp));
+
+    // If the key has a message...
+    uint32_t pos;
+    if (b->search(key, keylen, comp, pos)) {
+      write_batch::op_type type = static_cast<write_batch::op_type>(
+                                    b->messages[pos].type
+                                  );
+
+      uint64_t dataoff = b->messages[pos].dataoff;
+
+      uint64_t off = 0;
+      if (!apply_to_leaf(type, key, keylen, dataoff, comp, off)) {
+        return false;
+      }
+
+      // Remove the message (the node might have been split).
+      b = get_buffer(find_buffered_node(key, keylen, comp));
+      if (b->search(key, keylen, comp, pos)) {
+        b->remove(pos, 1);
+      }
+    }
+  }
+
+  // If the memtable has an operation on the key...
+  const memtable::entry* e;
+  if ((has_memtable_) && ((e = memtable_.find(key, keylen)) != NULL)) {
+    uint64_t off = 0;
+    if (!apply_to_leaf(static_cast<write_batch::op_type>(e->type),
+                       key,
+                       keylen,
+                       e->dataoff,
+                       comp,
+                       off)) {
+      return false;
+    }
+
+    memtable_.remove(key, keylen);
+  }
+
+  return true;
+}
+
+uint64_t db::index::index::find_buffered_node(const void* key,
+                                              keylen_t keylen,
+                                              comparator_t comp) const
+{
+  // Level of the node (1: leaf nodes).
+  uint64_t level;
+  uint64_t off = first_node(key, keylen, comp, level);
+
+  for (; level > 2; level--) {
+    const struct inner_node* inner = static_cast<const struct inner_node*>(
+                                       read_node(off)
+                                     );
+
+    off = inner->child(inner->search_child(key, keylen, comp));
+  }
+
+  return off;
+}
+
+bool db::index::index::find_message(const void* key,
+                                    keylen_t keylen,
+                                    comparator_t comp,
+                                    uint8_t& type,
+                                    uint64_t& dataoff) const
+{
+  DB_INDEX_SCOPE(kFind);
+
+  // If the key is neither too short nor too long and the tree has inner
+  // nodes...
+  if ((keylen >= kKeyMinLen) &&
+      (keylen <= kKeyMaxLen) &&
+      (header_->height >= 2)) {
+    const message_buffer* b = get_buffer(find_buffered_node(key,
+                                                            keylen,
+                                                            comp));
+
+    uint32_t pos;
+    if (b->search(key, keylen, comp, pos)) {
+      type = b->messages[pos].type;
+      dataoff = b->messages[pos].dataoff;
+
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool db::index::index::buffer(write_batch::op_type type,
+                              const void* key,
+                              keylen_t keylen,
+                              uint64_t dataoff,
+                              comparator_t comp)
+{
+  DB_INDEX_SCOPE(kAdd);
+
+  // If the key is too short or too long...
+  if ((keylen < kKeyMinLen) || (keylen > kKeyMaxLen)) {
+    return false;
+  }
+
+  // If the tree has no inner nodes yet...
+  if (header_->height < 2) {
+    uint64_t off = 0;
+    return apply_to_leaf(type, key, keylen, dataoff, comp, off);
+  }
+
+  // Add key to the filter.
+  if ((type == write_batch::op_type::kAdd) &&
+      (has_filter_) &&
+      (!filter_.may_contain(key, keylen))) {
+    filter_.add(key, keylen);
+  }
+
+  do {
+    uint64_t off = find_buffered_node(key, keylen, comp);
+
+    if (get_buffer(off)->put(key,
+                             keylen,
+                             static_cast<uint8_t>(type),
+                             dataoff,
+                             comp)) {
+      has_messages_ = true;
+      return true;
+    }
+
+    // The buffer is full: push the messages down (the node might be split,
+    // so it is searched again).
+    if (!flush_buffer(off, comp)) {
+      return false;
+    }
+  } while (true);
+}
+
+bool db::index::index::flush_buffer(uint64_t off, comparator_t comp)
+{
+  message_buffer* b = get_buffer(off);
+
+  if (b->nmessages == 0) {
+    return true;
+  }
+
+  DB_INDEX_COUNT(buffer_flushes, 1);
+
+  // Copy the messages (applying them might split the node).
+  write_batch batch;
+  for (uint32_t i = 0; i < b->nmessages; i++) {
+    if (b->messages[i].type ==
+        static_cast<uint8_t>(write_batch::op_type::kErase)) {
+      if (!batch.erase(b->key(i), b->messages[i].keylen)) {
+        return false;
+      }
+    } else if (!batch.add(b->key(i),
+                          b->messages[i].keylen,
+                          b->messages[i].dataoff)) {
+      return false;
+    }
+  }
+
+  // Apply the messages to the leaf nodes in key order (if it fails, the
+  // messages stay in the buffer).
+  uint64_t leaf = 0;
+  for (size_t i = 0; i < batch.count(); i++) {
+    if (!apply_to_leaf(batch.type(i),
+                       batch.key(i),
+                       batch.keylen(i),
+                       batch.data_offset(i),
+                       comp,
+                       leaf)) {
+      return false;
+    }
+  }
+
+  // Remove the messages. If the node has been split, each part holds a run
+  // of consecutive messages of the batch.
+  size_t i = 0;
+  while (i < batch.count()) {
+    b = get_buffer(find_buffered_node(batch.key(i), batch.keylen(i), comp));
+
+    uint32_t pos;
+    if (!b->search(batch.key(i), batch.keylen(i), comp, pos)) {
+      return false;
+    }
+
+    uint32_t count = 0;
+    do {
+      count++;
+      i++;
+    } while ((i < batch.count()) &&
+             (pos + count < b->nmessages) &&
+             (compare(comp,
+                      b->key(pos + count),
+                      b->messages[pos + count].keylen,
+                      batch.key(i),
+                      batch.keylen(i)) == 0));
+
+    b->remove(pos, count);
+  }
+
+  return true;
+}
+
+bool db::index::index::flush_buffers()
+{
+  // If no message has been buffered since the last flush...
+  if ((!has_buffers_) || (!has_messages_)) {
+    return true;
+  }
+
+  // The inner nodes above the leaf nodes are visited in key order: `cursor`
+  // is a key of the next one (none: the first one).
+  uint8_t cursor[kKeyMaxLen];
+  keylen_t cursorlen = 0;
+
+  do {
+    if (header_->height < 2) {
+      has_messages_ = false;
+      return true;
+    }
+
+    uint64_t off = header_->root;
+
+    // Smallest key greater than the keys of the node.
+    const void* upper = NULL;
+    keylen_t upperlen = 0;
+
+    // Level of the node (1: leaf nodes).
+    for (uint64_t level = header_->height; level > 2; level--) {
+      const struct inner_node* inner = static_cast<const struct inner_node*>(
+                                         read_node(off)
+                                       );
+
+      nodeoff_t pos = (cursorlen > 0) ?
+                      inner->search_child(cursor, cursorlen, comp_) :
+                      0;
+
+      if (pos < inner->nentries) {
+        upper = reinterpret_cast<const uint8_t*>(inner) +
+                inner->entries[pos].keyoff;
+
+        upperlen = inner->entries[pos].keylen;
+      }
+
+      off = inner->child(pos);
+    }
+
+    // If the node has messages...
+    if (get_buffer(off)->nmessages > 0) {
+      // Push them down and search the node again (it might have been split).
+      if (!flush_buffer(off, comp_)) {
+        return false;
+      }
+    } else if (upper) {
+      memcpy(cursor, upper, upperlen);
+      cursorlen = upperlen;
+    } else {
+      has_messages_ = false;
+      return true;
+    }
+  } while (true);
+}
+
+bool db::index::index::find_leaf(const void* key,
+                                 keylen_t keylen,
+                                 comparator_t comp,
+                                 uint64_t& off) const
+{
+  if (header_->root == 0) {
+    return false;
+  }
+
+  uint64_t level;
+  off = first_node(key, keylen, comp, level);
+
+  do {
+    // Read node.
+    const struct node* n;
+    if ((n = read_node(off)) == NULL) {
+      return false;
+    }
+
+    // Leaf node?
+    if (n->t != node::type::kInnerNode) {
+      return true;
+    }
+
+    // Search child which might contain the key.
+    nodeoff_t pos;
+    pos = static_cast<const struct inner_node*>(n)->search_child(key,
+                                                                keylen,
+                                                                comp);
+
+    off = static_cast<const struct inner_node*>(n)->child(pos);
+  } while (true);
+}
+
+uint64_t db::index::index::first_node(const void* key,
+                                      keylen_t keylen,
+                                      comparator_t comp,
+                                      uint64_t& level) const
+{
+  if (has_cache_) {
+    // If an inner node has been split since the cache was built...
+    if (!cache_.valid()) {
+      cache_.build(data_, header_->root, header_->height, cache_size_);
+    }
+
+    uint64_t off;
+    if ((cache_.valid()) && (cache_.find(key, keylen, comp, off, level))) {
+      DB_INDEX_COUNT(descents, 1);
+      DB_INDEX_COUNT(cache_hits, 1);
+
+      return off;
+    }
+  }
+
+  DB_INDEX_COUNT(descents, 1);
+
+  level = header_->height;
+
+  return header_->root;
+}
+
+void db::index::index::release_value(struct leaf_node* leaf, nodeoff_t pos)
+{
+  switch (leaf->type(pos)) {
+    case leaf_node::value_type::kValueLog:
+      // The value is in the value log.
+      {
+        value_log::pointer ptr;
+        memcpy(&ptr, leaf->value(pos), sizeof(value_log::pointer));
+
+        vlog_.release(ptr);
+      }
+
+      break;
+    case leaf_node::value_type::kPostings:
+      // If the postings are stored in posting nodes...
+      if (*reinterpret_cast<const uint8_t*>(leaf->value(pos)) ==
+          kPostingsNodes) {
+        posting_list list;
+        memcpy(&list, leaf->value(pos), sizeof(posting_list));
+
+        free_postings(list.first);
+      }
+
+      break;
+    default:
+      return;
+  }
+
+  // Drop what is stored after the key (nothing is stored, so it fits).
+  leaf->replace(pos, leaf_node::value_type::kExternal, NULL, 0);
+}
+
+bool db::index::index::forward(uint64_t off,
+                               const struct leaf_node* leaf,
+                               nodeoff_t pos,
+                               iterator& it) const
+{
+  do {
+    if ((it.readahead_ != 0) && (off != it.ahead_leaf_)) {
+      read_ahead(it, off, leaf);
+    }
+
+    if (leaf->next_live(pos)) {
+      it.off_ = off;
+      it.node_ = leaf;
+      it.pos_ = pos;
+
+      return true;
+    }
+
+    off = leaf->next;
+    pos = 0;
+  } while ((leaf = static_cast<const struct leaf_node*>(read_node(off))) !=
+           NULL);
+
+  return false;
+}
+
+void db::index::index::read_ahead(iterator& it,
+                                  uint64_t off,
+                                  const struct leaf_node* leaf) const
+{
+  // If the iterator has moved to the next leaf node, there is one leaf node
+  // fewer read ahead; otherwise (new position), start again from this one.
+  if ((off == it.ahead_next_) && (it.nahead_ > 0)) {
+    it.nahead_--;
+  } else {
+    it.ahead_off_ = off;
+    it.nahead_ = 0;
+  }
+
+  it.ahead_leaf_ = off;
+  it.ahead_next_ = leaf->next;
+
+  // Advance at most two leaf nodes per leaf node visited: the next offset of
+  // the last leaf node read ahead is only read once it had time to arrive.
+  for (unsigned i = 0; (i < 2) && (it.nahead_ < it.readahead_); i++) {
+    const struct leaf_node* last = (it.ahead_off_ == off) ?
+                                   leaf :
+                                   reinterpret_cast<const struct leaf_node*>(
+                                     reinterpret_cast<const uint8_t*>(data_) +
+                                     it.ahead_off_
+                                   );
+
+    uint64_t next;
+    if ((next = last->next) == 0) {
+      break;
+    }
+
+    madvise(reinterpret_cast<uint8_t*>(data_) + next,
+            kNodeSize,
+            MADV_WILLNEED);
+
+    it.ahead_off_ = next;
+    it.nahead_++;
+  }
+}
+
+bool db::index::index::postings(const struct leaf_node* leaf,
+                                nodeoff_t pos,
+                                posting_iterator& pit) const
+{
+  // If the key doesn't have a posting list...
+  if (leaf->type(pos) != leaf_node::value_type::kPostings) {
+    return false;
+  }
+
+  const uint8_t* value = reinterpret_cast<const uint8_t*>(leaf->value(pos));
+
+  pit.index_ = this;
+  pit.last_ = 0;
+
+  // If the postings are stored in the leaf node...
+  if (value[0] == kPostingsInline) {
+    pit.ptr_ = value + 1;
+    pit.end_ = value + leaf->value_length(pos);
+
+    pit.size_ = posting_node::count(pit.ptr_, pit.end_ - pit.ptr_);
+
+    pit.node_ = NULL;
+    pit.pos_ = 0;
+  } else {
+    posting_list list;
+    memcpy(&list, value, sizeof(posting_list));
+
+    pit.ptr_ = NULL;
+    pit.end_ = NULL;
+
+    pit.size_ = list.count;
+
+    if ((pit.node_ = static_cast<const struct posting_node*>(
+                       read_node(list.first)
+                     )) == NULL) {
+      return false;
+    }
+
+    pit.pos_ = 0;
+  }
+
+  return true;
+}
+
+bool db::index::index::write_postings(const uint64_t* postings,
+                                      size_t count,
+                                      uint64_t& first)
+{
+  first = 0;
+
+  // Fill the nodes from the last one, so that each node is linked to the
+  // next one when it is created.
+  nodeoff_t capacity = posting_node::capacity();
+  size_t nnodes = (count + capacity - 1) / capacity;
+
+  uint64_t next = 0;
+  for (size_t i = nnodes; i > 0; i--) {
+    uint64_t off;
+    if (!create_posting_node(off)) {
+      free_postings(next);
+      return false;
+    }
+
+    void* mem = reinterpret_cast<void*>(
+                  reinterpret_cast<uint8_t*>(data_) + off
+                );
+
+    struct posting_node* n = new (mem) posting_node();
+
+    size_t start = (i - 1) * capacity;
+    size_t end = (start + capacity < count) ? start + capacity : count;
+
+    memcpy(n->postings, postings + start, (end - start) * sizeof(uint64_t));
+    n->nentries = static_cast<nodeoff_t>(end - start);
+
+    n->next = next;
+    next = off;
+  }
+
+  first = next;
+
+  return true;
+}
+
+bool db::index::index::add_posting(uint64_t first,
+                                   uint64_t posting,
+                                   bool& added)
+{
+  added = false;
+
+  // Search the node which should contain the posting.
+  uint64_t off = first;
+
+  struct posting_node* n;
+  if ((n = static_cast<struct posting_node*>(read_node(off))) == NULL) {
+    return false;
+  }
+
+  while ((n->next != 0) && (posting > n->last())) {
+    off = n->next;
+
+    if ((n = static_cast<struct posting_node*>(read_node(off))) == NULL) {
+      return false;
+    }
+  }
+
+  // If the posting is already in the list...
+  nodeoff_t pos;
+  if (n->search(posting, pos)) {
+    return true;
+  }
+
+  // Add posting (if it fits in the node).
+  if (n->add(posting, pos)) {
+    added = true;
+    return true;
+  }
+
+  // Node is full.
+
+  // Create right node.
+  uint64_t rightoff;
+  if (!create_posting_node(rightoff)) {
+    return false;
+  }
+
+  // Memory mapping might have been relocated.
+  n = static_cast<struct posting_node*>(read_node(off));
+
+  void* mem = reinterpret_cast<void*>(
+                reinterpret_cast<uint8_t*>(data_) + rightoff
+              );
+
+  struct posting_node* right = new (mem) posting_node();
+
+  // If the posting goes at the end of the list, it starts a new node
+  // (postings added in order fill the nodes).
+  if ((pos == n->nentries) && (n->next == 0)) {
+    n->next = rightoff;
+    right->add(posting, 0);
+  } else {
+    n->split(rightoff, right);
+
+    if (pos <= n->nentries) {
+      n->add(posting, pos);
+    } else {
+      right->add(posting, pos - n->nentries);
+    }
+  }
+
+  added = true;
+
+  return true;
+}
+
+void db::index::index::remove_posting(uint64_t& first,
+                                      uint64_t posting,
+                                      bool& removed)
+{
+  removed = false;
+
+  // Search the node which should contain the posting.
+  uint64_t prevoff = 0;
+  uint64_t off = first;
+
+  struct posting_node* n;
+  if ((n = static_cast<struct posting_node*>(read_node(off))) == NULL) {
+    return;
+  }
+
+  while ((n->next != 0) && (posting > n->last())) {
+    prevoff = off;
+    off = n->next;
+
+    if ((n = static_cast<struct posting_node*>(read_node(off))) == NULL) {
+      return;
+    }
+  }
+
+  // If the posting is not in the list...
+  nodeoff_t pos;
+  if (!n->search(posting, pos)) {
+    return;
+  }
+
+  n->remove(pos);
+
+  removed = true;
+
+  // If the node is empty...
+  if (n->nentries == 0) {
+    // Unlink node.
+    if (prevoff != 0) {
+      static_cast<struct posting_node*>(read_node(prevoff))->next = n->next;
+    } else {
+      first = n->next;
+    }
+
+    n->next = 0;
+
+    free_postings(off);
+  }
+}
+
+bool db::index::index::create_posting_node(uint64_t& off)
+{
+  // If there are free posting nodes...
+  if (header_->free_posting_nodes != 0) {
+    off = header_->free_posting_nodes;
+
+    const struct posting_node* n;
+    if ((n = static_cast<const struct posting_node*>(read_node(off))) ==
+        NULL) {
+      return false;
+    }
+
+    header_->free_posting_nodes = n->next;
+
+    return true;
+  }
+
+  return create_node(0, off);
+}
+
+void db::index::index::free_postings(uint64_t first)
+{
+  // Add the nodes to the list of free posting nodes.
+  struct posting_node* n;
+  while ((n = static_cast<struct posting_node*>(read_node(first))) != NULL) {
+    uint64_t next = n->next;
+
+    n->next = header_->free_posting_nodes;
+    header_->free_posting_nodes = first;
+
+    first = next;
+  }
+}
+
+void db::index::index::update_counts(const struct level* levels,
+                                     size_t depth,
+                                     int64_t delta)
+{
+  for (size_t i = 0; i < depth; i++) {
+    static_cast<struct inner_node*>(
+      read_node(levels[i].off)
+    )->add_child_count(levels[i].pos, delta);
+  }
+}
+
+void db::index::index::update_parent_counts(uint64_t off, int64_t delta)
+{
+  const struct node* n = read_node(off);
+
+  while (n->parent != 0) {
+    struct inner_node* parent = static_cast<struct inner_node*>(
+                                  read_node(n->parent)
+                                );
+
+    // Search the child in the parent.
+    nodeoff_t i;
+    for (i = 0; (i <= parent->nentries) && (parent->child(i) != off); i++);
+
+    if (i > parent->nentries) {
+      return;
+    }
+
+    parent->add_child_count(i, delta);
+
+    off = n->parent;
+    n = parent;
+  }
+}
+
+bool db::index::index::rebuild_filter(uint64_t nkeys)
+{
+  DB_INDEX_SCOPE(kMaintenance);
+
+  if (has_filter_) {
+    if (nkeys < header_->nkeys) {
+      nkeys = header_->nkeys;
+    }
+
+    if (filter_.reset(nkeys, filter_.bits_per_key())) {
+      // Add the keys which are not marked as deleted.
+      iterator it;
+      if (first(it)) {
+        do {
+          filter_.add(it.key(), it.keylen());
+        } while (next(it));
+      }
+
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool db::index::index::train_model()
+{
+  DB_INDEX_SCOPE(kMaintenance);
+
+  if (!has_model_) {
+    return false;
+  }
+
+  model_.clear();
+
+  if (header_->root != 0) {
+    // Search the first leaf node.
+    uint64_t off = header_->root;
+
+    const struct node* n;
+    while (((n = read_node(off)) != NULL) &&
+           (n->t == node::type::kInnerNode)) {
+      off = static_cast<const struct inner_node*>(n)->left;
+    }
+
+    // Add the leaf nodes which have keys.
+    while ((n = read_node(off)) != NULL) {
+      const struct leaf_node* leaf = static_cast<const struct leaf_node*>(n);
+
+      if ((leaf->nentries > 0) &&
+          (!model_.add(key_prefix(leaf->key(0), leaf->keylen(0)), off))) {
+        return false;
+      }
+
+      off = leaf->next;
+    }
+  }
+
+  return model_.fit(model_error_);
+}
+
+bool db::index::index::open_filter(const char* filename, const options& opts)
+{
+  // If the index has a filter or a filter has been requested...
+  if (((header_->flags & kFlagFilter) != 0) || (opts.filter_bits_per_key > 0)) {
+    char path[PATH_MAX];
+    if (snprintf(path, sizeof(path), "%s.flt", filename) >=
+        static_cast<int>(sizeof(path))) {
+      return false;
+    }
+
+    // If the filter has to be created...
+    struct stat sbuf;
+    bool create = (stat(path, &sbuf) != 0);
+
+    uint64_t nkeys = (opts.filter_keys > header_->nkeys) ? opts.filter_keys :
+                                                           header_->nkeys;
+
+    unsigned bits_per_key = (opts.filter_bits_per_key > 0) ?
+                            opts.filter_bits_per_key :
+                            kFilterBitsPerKey;
+
+    if (filter_.open(path, nkeys, bits_per_key)) {
+      has_filter_ = true;
+
+      header_->flags |= kFlagFilter;
+
+      // If the filter has just been created or it was not closed properly...
+      if ((create) || (!filter_.clean())) {
+        if (!rebuild_filter(nkeys)) {
+          return false;
+        }
+      }
+
+      filter_.clean(false);
+
+      return true;
+    }
+
+    return false;
+  }
+
+  return true;
+}
+
+bool db::index::index::open_value_log(const char* filename,
+                                      const options& opts)
+{
+  // If the index has a value log or a value log has been requested...
+  if (((header_->flags & kFlagValueLog) != 0) ||
+      (opts.value_log_segment_size > 0)) {
+    char path[PATH_MAX];
+    if (snprintf(path, sizeof(path), "%s.vlog", filename) >=
+        static_cast<int>(sizeof(path))) {
+      return false;
+    }
+
+    // The segment size of an existing value log is kept.
+    uint64_t segment_size = (opts.value_log_segment_size > 0) ?
+                            opts.value_log_segment_size :
+                            kValueLogSegmentSize;
+
+    if (vlog_.open(path, segment_size)) {
+      has_vlog_ = true;
+
+      header_->flags |= kFlagValueLog;
+
+      return true;
+    }
+
+    vlog_.close();
+
+    return false;
+  }
+
+  return true;
+}
+
+bool db::index::index::open_write_ahead_log(const char* filename,
+                                            const options& opts)
+{
+  // If the index has a write-ahead log or one has been requested...
+  if (((header_->flags & kFlagWriteAheadLog) != 0) || (opts.log_writes)) {
+    // The batches are sorted with the comparator.
+    if (opts.comparator == NULL) {
+      return false;
+    }
+
+    char path[PATH_MAX];
+    if (snprintf(path, sizeof(path), "%s.wal", filename) >=
+        static_cast<int>(sizeof(path))) {
+      return false;
+    }
+
+    if (!wal_.open(path)) {
+      wal_.close();
+      return false;
+    }
+
+    has_wal_ = true;
+
+    header_->flags |= kFlagWriteAheadLog;
+
+    // If the log is not empty...
+    if (wal_.size() > 0) {
+      // The index might not contain all the operations of the logged
+      // batches: apply them again (a batch which is incomplete in the log
+      // was not applied and is dropped).
+      write_batch batch;
+      uint64_t off = 0;
+      while (wal_.read(off, batch)) {
+        batch.sort(opts.comparator);
+
+        if (!apply(batch, opts.comparator)) {
+          return false;
+        }
+      }
+
+      return checkpoint();
+    }
+  }
+
+  return true;
+}
+
+bool db::index::index::warm_up(const char* filename, const options& opts)
+{
+  if ((opts.prefault_inner_nodes || opts.prefault_leaf_nodes) &&
+      (!prefault(opts.prefault_leaf_nodes,
+                 opts.lock_prefaulted,
+                 opts.prefault_threads))) {
+    return false;
+  }
+
+  if (opts.hot_pages) {
+    if (snprintf(hot_pages_, sizeof(hot_pages_), "%s.hot", filename) >=
+        static_cast<int>(sizeof(hot_pages_))) {
+      hot_pages_[0] = 0;
+      return false;
+    }
+
+    return load_hot_pages(opts.prefault_threads);
+  }
+
+  return true;
+}
+
+bool db::index::index::load_hot_pages(unsigned nthreads)
+{
+  int fd;
+  if ((fd = ::open(hot_pages_, O_RDONLY)) == -1) {
+    // The index has not been closed with a list yet.
+    return true;
+  }
+
+  // The list is only a hint: if it is invalid, no pages are loaded.
+  page_populator populator;
+
+  hot_pages_header header;
+  if ((read(fd, &header, sizeof(hot_pages_header)) ==
+       static_cast<ssize_t>(sizeof(hot_pages_header))) &&
+      (memcmp(header.magic, kHotPagesMagic, sizeof(kHotPagesMagic)) == 0)) {
+    uint64_t range[2];
+    for (uint64_t i = 0;
+         (i < header.nranges) &&
+         (read(fd, range, sizeof(range)) ==
+          static_cast<ssize_t>(sizeof(range)));
+         i++) {
+      if (!populator.add(range[0], range[1])) {
+        ::close(fd);
+        return false;
+      }
+    }
+  }
+
+  ::close(fd);
+
+  return populator.populate(data_, filesize_, nthreads, false);
+}
+
+bool db::index::index::save_hot_pages() const
+{
+  long pagesize = sysconf(_SC_PAGESIZE);
+  if (pagesize <= 0) {
+    return false;
+  }
+
+  size_t npages = (filesize_ + pagesize - 1) / pagesize;
+
+  unsigned char* resident;
+  if ((resident = static_cast<unsigned char*>(malloc(npages))) == NULL) {
+    return false;
+  }
+
+  if (mincore(data_, filesize_, resident) != 0) {
+    free(resident);
+    return false;
+  }
+
+  // The file is written next to its final name and renamed.
+  char tmpname[PATH_MAX];
+  if (snprintf(tmpname, sizeof(tmpname), "%s.tmp", hot_pages_) >=
+      static_cast<int>(sizeof(tmpname))) {
+    free(resident);
+    return false;
+  }
+
+  FILE* file;
+  if ((file = fopen(tmpname, "w")) == NULL) {
+    free(resident);
+    return false;
+  }
+
+  hot_pages_header header;
+  memcpy(header.magic, kHotPagesMagic, sizeof(kHotPagesMagic));
+  header.nranges = 0;
+
+  bool ret = (fwrite(&header, sizeof(hot_pages_header), 1, file) == 1);
+
+  // Ranges of resident pages (in nodes).
+  uint64_t nodes_per_page = (pagesize > kNodeSize) ? pagesize / kNodeSize : 1;
+  for (size_t i = 0; (ret) && (i < npages); ) {
+    if ((resident[i] & 1) == 0) {
+      i++;
+      continue;
+    }
+
+    size_t first = i;
+    while ((i < npages) && ((resident[i] & 1) != 0)) {
+      i++;
+    }
+
+    uint64_t range[2] = {
+      (first * pagesize) / kNodeSize,
+      (i - first) * nodes_per_page
+    };
+
+    ret = (fwrite(range, sizeof(range), 1, file) == 1);
+    header.nranges++;
+  }
+
+  free(resident);
+
+  // Write the number of ranges.
+  if ((ret) &&
+      ((fseek(file, 0, SEEK_SET) != 0) ||
+       (fwrite(&header, sizeof(hot_pages_header), 1, file) != 1))) {
+    ret = false;
+  }
+
+  if ((fclose(file) != 0) || (!ret) || (rename(tmpname, hot_pages_) != 0)) {
+    unlink(tmpname);
+    return false;
+  }
+
+  return true;
+}
+
+bool db::index::index::collect_garbage(double threshold)
+{
+  // Abandon the pass in progress (the values already moved stay moved).
+  free(gc_segments_);
+  gc_segments_ = NULL;
+
+  // Visit all the leaf nodes in a single step.
+  bool done;
+  return collect_garbage_step(static_cast<size_t>(-1), done, threshold);
+}
+
+bool db::index::index::collect_garbage_step(size_t max_leaves,
+                                            bool& done,
+                                            double threshold)
+{
+  DB_INDEX_SCOPE(kMaintenance);
+
+  done = false;
+
+  if (!has_vlog_) {
+    return false;
+  }
+
+  // If there is no pass in progress...
+  if (gc_segments_ == NULL) {
+    uint32_t nsegments = vlog_.nsegments();
+
+    // Select the segments to garbage collect.
+    bool* collect;
+    if ((collect = reinterpret_cast<bool*>(malloc(nsegments + 1))) == NULL) {
+      return false;
+    }
+
+    bool any = false;
+    for (uint32_t i = 0; i < nsegments; i++) {
+      if ((collect[i] = vlog_.collectable(i, threshold))) {
+        any = true;
+      }
+    }
+
+    if (!any) {
+      free(collect);
+
+      done = true;
+      return true;
+    }
+
+    gc_segments_ = collect;
+    gc_nsegments_ = nsegments;
+
+    // Search the first leaf node.
+    uint64_t off = header_->root;
+
+    const struct node* n;
+    while (((n = read_node(off)) != NULL) &&
+           (n->t == node::type::kInnerNode)) {
+      off = static_cast<const struct inner_node*>(n)->left;
+    }
+
+    gc_leaf_ = off;
+  }
+
+  // Move the live values of the segments to the end of the value log. The
+  // leaf nodes split to the right, so the entries which were not visited yet
+  // are at or after gc_leaf_.
+  struct node* n;
+  for (size_t count = 0;
+       (count < max_leaves) && ((n = read_node(gc_leaf_)) != NULL);
+       count++) {
+    struct leaf_node* leaf = static_cast<struct leaf_node*>(n);
+
+    for (nodeoff_t i = 0; i < leaf->nentries; i++) {
+      if (leaf->type(i) == leaf_node::value_type::kValueLog) {
+        value_log::pointer ptr;
+        memcpy(&ptr, leaf->value(i), sizeof(value_log::pointer));
+
+        if ((ptr.segment < gc_nsegments_) && (gc_segments_[ptr.segment])) {
+          value_log::pointer newptr;
+          const void* value;
+          if (((value = vlog_.get(ptr)) == NULL) ||
+              (!vlog_.append(value, ptr.length, newptr))) {
+            // The leaf node is visited again by the next step.
+            return false;
+          }
+
+          // The pointer has the same size: it is replaced in place.
+          leaf->replace(i,
+                        leaf_node::value_type::kValueLog,
+                        &newptr,
+                        sizeof(value_log::pointer));
+
+          vlog_.release(ptr);
+        }
+      }
+    }
+
+    gc_leaf_ = leaf->next;
+  }
+
+  // If there are leaf nodes left...
+  if (read_node(gc_leaf_) != NULL) {
+    return true;
+  }
+
+  // Remove the segments.
+  bool ret = true;
+  for (uint32_t i = 0; i < gc_nsegments_; i++) {
+    if ((gc_segments_[i]) && (!vlog_.remove(i))) {
+      ret = false;
+    }
+  }
+
+  free(gc_segments_);
+  gc_segments_ = NULL;
+
+  done = ret;
+
+  return ret;
+}
+
+bool db::index::index::create_node(size_t reserve,
+                                   uint64_t& off,
+                                   size_t count)
+{
+  // Allocate nodes (if needed): the first split of an insert reserves the
+  // nodes for all the splits which might follow, so the memory mapping is
+  // not relocated while the nodes being split are referenced.
+  if (allocate((reserve > count) ? reserve : count)) {
+    // Calculate the offset of the new node.
+    off = (1 + header_->nnodes) * kNodeSize;
+
+    header_->nnodes += count;
+
+    return true;
+  }
+
+  return false;
+}
+
+bool db::index::index::allocate(size_t count)
+{
+  // Calculate the needed size.
+  uint64_t size = (1 + header_->nnodes + count) * kNodeSize;
+
+  // If there is space enough...
+  if (size <= filesize_) {
+    return true;
+  }
+
+  // We have to allocate more nodes.
+
+  size_t n = kAllocate;
+  while (n < count) {
+    n *= 2;
+  }
+
+  size = (1 + header_->nnodes + n) * kNodeSize;
+
+  // With huge pages, the file grows by whole huge pages.
+  if (huge_pages_ != huge_page_mode::kNone) {
+    size = ((size + kHugePageSize - 1) / kHugePageSize) * kHugePageSize;
+  }
+
+  DB_INDEX_PROBE2(grow, filesize_, size);
+
+  // Grow file and remap it into memory.
+  if ((ftruncate(fd_, size) == 0) && (remap(size))) {
+    header_ = reinterpret_cast<header*>(data_);
+
+    // The new pages are accessed like the others.
+    return advise(access_);
+  }
+
+  return false;
+}
+
+bool db::index::index::map(uint64_t size)
+{
+  if (huge_pages_ == huge_page_mode::kNone) {
+    if ((data_ = mmap(NULL,
+                      size,
+                      PROT_READ | PROT_WRITE,
+                      MAP_SHARED,
+                      fd_,
+                      0)) == MAP_FAILED) {
+      return false;
+    }
+
+    filesize_ = size;
+
+    return true;
+  }
+
+  // A huge page is only used for an aligned range of the mapping.
+  void* addr;
+  if ((addr = reserve(size)) == MAP_FAILED) {
+    return false;
+  }
+
+  if (huge_pages_ == huge_page_mode::kFile) {
+    data_ = mmap(addr,
+                 size,
+                 PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_FIXED,
+                 fd_,
+                 0);
+  } else {
+    data_ = mmap(addr,
+                 size,
+                 PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED,
+                 -1,
+                 0);
+  }
+
+  if (data_ == MAP_FAILED) {
+    munmap(addr, size);
+    return false;
+  }
+
+  filesize_ = size;
+
+  // Without transparent huge pages (or for a file system which doesn't
+  // support them), the advice fails and the mapping uses small pages.
+  madvise(data_, size, MADV_HUGEPAGE);
+
+  if (huge_pages_ == huge_page_mode::kAnonymous) {
+    // Read the index.
+    uint8_t* data = static_cast<uint8_t*>(data_);
+    uint64_t off = 0;
+    while (off < size) {
+      ssize_t ret;
+      if ((ret = pread(fd_, data + off, size - off, off)) <= 0) {
+        munmap(data_, size);
+        data_ = MAP_FAILED;
+
+        return false;
+      }
+
+      off += ret;
+    }
+  }
+
+  return true;
+}
+
+bool db::index::index::remap(uint64_t size)
+{
+  void* data;
+  if (huge_pages_ == huge_page_mode::kNone) {
+    if ((data = mremap(data_,
+                       filesize_,
+                       size,
+                       MREMAP_MAYMOVE)) == MAP_FAILED) {
+      return false;
+    }
+  } else {
+    // Grow the mapping in place if the following addresses are free (it
+    // keeps its alignment), otherwise move it to an aligned range (the
+    // mapping keeps the MADV_HUGEPAGE advice).
+    if ((data = mremap(data_, filesize_, size, 0)) == MAP_FAILED) {
+      void* addr;
+      if ((addr = reserve(size)) == MAP_FAILED) {
+        return false;
+      }
+
+      if ((data = mremap(data_,
+                         filesize_,
+                         size,
+                         MREMAP_MAYMOVE | MREMAP_FIXED,
+                         addr)) == MAP_FAILED) {
+        munmap(addr, size);
+        return false;
+      }
+    }
+  }
+
+  DB_INDEX_COUNT(remaps, 1);
+  DB_INDEX_COUNT(remapped_bytes, filesize_);
+  DB_INDEX_PROBE3(remap, data_, data, size);
+
+  data_ = data;
+  filesize_ = size;
+
+  return true;
+}
+
+void* db::index::index::reserve(uint64_t size)
+{
+  // Reserve a huge page more than needed and release the unaligned ends.
+  uint64_t len = size + kHugePageSize;
+
+  void* addr;
+  if ((addr = mmap(NULL,
+                   len,
+                   PROT_NONE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                   -1,
+                   0)) == MAP_FAILED) {
+    return MAP_FAILED;
+  }
+
+  uint8_t* begin = static_cast<uint8_t*>(addr);
+  uint8_t* end = begin + len;
+
+  uintptr_t n = reinterpret_cast<uintptr_t>(begin) + kHugePageSize - 1;
+  uint8_t* aligned = reinterpret_cast<uint8_t*>(n - (n % kHugePageSize));
+
+  // End of the pages of the range.
+  uint8_t* last = aligned + (((size + kNodeSize - 1) / kNodeSize) * kNodeSize);
+
+  if (aligned > begin) {
+    munmap(begin, aligned - begin);
+  }
+
+  if (end > last) {
+    munmap(last, end - last);
+  }
+
+  return aligned;
+}
+
+bool db::index::index::sync()
+{
+  if (huge_pages_ != huge_page_mode::kAnonymous) {
+    return (msync(data_, filesize_, MS_SYNC) == 0);
+  }
+
+  // Write the whole index.
+  const uint8_t* data = static_cast<const uint8_t*>(data_);
+  uint64_t off = 0;
+  while (off < filesize_) {
+    ssize_t ret;
+    if ((ret = pwrite(fd_, data + off, filesize_ - off, off)) <= 0) {
+      return false;
+    }
+
+    off += ret;
+  }
+
+  return (fdatasync(fd_) == 0);
+}
+
+bool db::index::index::export_stats(const char* filename) const
+{
+  // The file is written next to its final name and renamed.
+  char tmpname[PATH_MAX];
+  if (snprintf(tmpname, sizeof(tmpname), "%s.tmp", filename) >=
+      static_cast<int>(sizeof(tmpname))) {
+    return false;
+  }
+
+  FILE* file;
+  if ((file = fopen(tmpname, "w")) == NULL) {
+    return false;
+  }
+
+  fprintf(file, "# HELP db_index_keys Number of keys.\n");
+  fprintf(file, "# TYPE db_index_keys gauge\n");
+  fprintf(file, "db_index_keys %lu\n", header_->nkeys);
+
+  statistics s = stats();
+
+  for (size_t i = 0; i < sizeof(kCounters) / sizeof(kCounters[0]); i++) {
+    fprintf(file,
+            "# HELP db_index_%s_total %s\n",
+            kCounters[i].name,
+            kCounters[i].help);
+    fprintf(file, "# TYPE db_index_%s_total counter\n", kCounters[i].name);
+    fprintf(file,
+            "db_index_%s_total %lu\n",
+            kCounters[i].name,
+            s.*kCounters[i].counter);
+  }
+
+  fprintf(file,
+          "# HELP db_index_latency_seconds Latency of the operations.\n");
+  fprintf(file, "# TYPE db_index_latency_seconds summary\n");
+
+  for (size_t i = 0; i < statistics::kOperations; i++) {
+    const char* name = statistics::name(static_cast<statistics::operation>(i));
+
+    latency_histogram h = latencies(static_cast<statistics::operation>(i));
+
+    for (size_t j = 0; j < sizeof(kQuantiles) / sizeof(kQuantiles[0]); j++) {
+      fprintf(file,
+              "db_index_latency_seconds{op=\"%s\",quantile=\"%g\"} %.9f\n",
+              name,
+              kQuantiles[j],
+              h.percentile(kQuantiles[j]) / 1e9);
+    }
+
+    fprintf(file,
+            "db_index_latency_seconds_sum{op=\"%s\"} %.9f\n",
+            name,
+            h.sum() / 1e9);
+    fprintf(file,
+            "db_index_latency_seconds_count{op=\"%s\"} %lu\n",
+            name,
+            h.count());
+  }
+
+  fprintf(file,
+          "# HELP db_index_slow_ops_total Operations slower than the "
+          "threshold.\n");
+  fprintf(file, "# TYPE db_index_slow_ops_total counter\n");
+  fprintf(file, "db_index_slow_ops_total %lu\n", trace_.count());
+
+  // Latest slow operations, with the work they did.
+  slow_op_trace::entry entries[slow_op_trace::kCapacity];
+  size_t n = trace_.get(entries, slow_op_trace::kCapacity);
+
+  fprintf(file,
+          "# HELP db_index_slow_op_seconds Latency of the latest slow "
+          "operations.\n");
+  fprintf(file, "# TYPE db_index_slow_op_seconds gauge\n");
+
+  for (size_t i = 0; i < n; i++) {
+    const statistics& c = entries[i].counters;
+
+    fprintf(file,
+            "db_index_slow_op_seconds{op=\"%s\",time=\"%lu\","
+            "descents=\"%lu\",node_visits=\"%lu\",leaf_splits=\"%lu\","
+            "inner_splits=\"%lu\",defrags=\"%lu\",remaps=\"%lu\","
+            "remapped_bytes=\"%lu\",buffer_flushes=\"%lu\"} %.9f\n",
+            statistics::name(entries[i].op),
+            entries[i].time,
+            c.descents,
+            c.node_visits,
+            c.leaf_splits,
+            c.inner_splits,
+            c.defrags,
+            c.remaps,
+            c.remapped_bytes,
+            c.buffer_flushes,
+            entries[i].latency / 1e9);
+  }
+
+  if ((fclose(file) != 0) || (rename(tmpname, filename) != 0)) {
+    unlink(tmpname);
+    return false;
+  }
+
+  return true;
+}
+
+bool db::index::index::advise(access_pattern access)
+{
+  int advice;
+  switch (access) {
+    case access_pattern::kRandom:
+      advice = MADV_RANDOM;
+      break;
+    case access_pattern::kSequential:
+      advice = MADV_SEQUENTIAL;
+      break;
+    default:
+      advice = MADV_NORMAL;
+  }
+
+  if (madvise(data_, filesize_, advice) == 0) {
+    access_ = access;
+    return true;
+  }
+
+  return false;
+}
+
+bool db::index::index::prefault(bool leaf_nodes, bool lock, unsigned nthreads)
+{
+  // If there is no root...
+  if (header_->root == 0) {
+    return true;
+  }
+
+  // Offsets of the nodes of the level.
+  size_t size = 1024;
+  uint64_t* nodes;
+  if ((nodes = static_cast<uint64_t*>(malloc(size * sizeof(uint64_t)))) ==
+      NULL) {
+    return false;
+  }
+
+  nodes[0] = header_->root;
+  size_t nnodes = 1;
+
+  size_t level = header_->height;
+
+  page_populator populator;
+
+  do {
+    // Load the nodes of the level, in file order (the pages of consecutive
+    // nodes are loaded together). The nodes above the leaf nodes are
+    // followed by their message buffers.
+    qsort(nodes, nnodes, sizeof(uint64_t), compare_offsets);
+
+    uint64_t npages = ((has_buffers_) && (level == 2)) ?
+                      1 + header_->buffer_pages :
+                      1;
+
+    populator.clear();
+    for (size_t i = 0; i < nnodes; i++) {
+      if (!populator.add(nodes[i] / kNodeSize, npages)) {
+        free(nodes);
+        return false;
+      }
+    }
+
+    if (!populator.populate(data_, filesize_, nthreads, lock)) {
+      free(nodes);
+      return false;
+    }
+
+    // If the last level requested has been loaded...
+    if ((level == 1) || ((level == 2) && (!leaf_nodes))) {
+      free(nodes);
+      return true;
+    }
+
+    // Children of the nodes of the level (in memory now).
+    uint64_t* children = NULL;
+    size_t nchildren = 0;
+    size_t children_size = 0;
+
+    for (size_t i = 0; i < nnodes; i++) {
+      const struct node* n;
+      if (((n = read_node(nodes[i])) == NULL) ||
+          (n->t != node::type::kInnerNode)) {
+        free(children);
+        free(nodes);
+        return false;
+      }
+
+      const struct inner_node* inner = static_cast<const struct inner_node*>(n);
+
+      // If the array is full...
+      if (nchildren + inner->nentries + 1 > children_size) {
+        children_size = (children_size > 0) ? children_size * 2 : size;
+        while (nchildren + inner->nentries + 1 > children_size) {
+          children_size *= 2;
+        }
+
+        uint64_t* tmp;
+        if ((tmp = static_cast<uint64_t*>(
+                     realloc(children, children_size * sizeof(uint64_t))
+                   )) == NULL) {
+          free(children);
+          free(nodes);
+          return false;
+        }
+
+        children = tmp;
+      }
+
+      for (nodeoff_t j = 0; j <= inner->nentries; j++) {
+        children[nchildren++] = inner->child(j);
+      }
+    }
+
+    free(nodes);
+
+    nodes = children;
+    nnodes = nchildren;
+
+    level--;
+  } while (true);
+}
+
+bool db::index::index::start_recording(const char* filename, bool hash_keys)
+{
+  stop_recording();
+
+  return (recording_ = recorder_.create(filename, hash_keys));
+}
+
+bool db::index::index::stop_recording()
+{
+  if (recording_) {
+    recording_ = false;
+    return recorder_.close();
+  }
+
+  return true;
+}
+
+db::index::index::operation_scope::operation_scope(const index* idx,
+                                                   statistics::operation op)
+  : op_(op)
+{
+  // If the thread is not doing another operation...
+  if (statistics::begin()) {
+    idx_ = idx;
+    start_ = now(CLOCK_MONOTONIC);
+  } else {
+    idx_ = NULL;
+  }
+}
+
+db::index::index::operation_scope::~operation_scope()
+{
+  if (idx_) {
+    uint64_t latency = now(CLOCK_MONOTONIC) - start_;
+
+    idx_->latencies_[static_cast<size_t>(op_)].record(latency);
+
+    if ((idx_->slow_op_threshold_ > 0) &&
+        (latency >= idx_->slow_op_threshold_)) {
+      idx_->trace_.record(op_,
+                          now(CLOCK_REALTIME) - latency,
+                          latency,
+                          *statistics::current());
+    }
+
+    statistics::end(idx_->stats_);
+  }
+}
+
+uint64_t now(clockid_t clock)
+{
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+
+  return (static_cast<uint64_t>(ts.tv_sec) * 1000000000ull) + ts.tv_nsec;
+}
+
+int compare_offsets(const void* p1, const void* p2)
+{
+  uint64_t off1 = *static_cast<const uint64_t*>(p1);
+  uint64_t off2 = *static_cast<const uint64_t*>(p2);
+
+  return (off1 < off2) ? -1 : (off1 > off2);
 }
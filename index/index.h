@@ -1,15 +1,156 @@
 #ifndef DB_INDEX_INDEX_H
 #define DB_INDEX_INDEX_H
 
+#include <limits.h>
 #include <sys/mman.h>
 #include "index/node.h"
 #include "index/leaf_node.h"
+#include "index/posting_node.h"
+#include "index/filter.h"
+#include "index/value_log.h"
+#include "index/write_batch.h"
+#include "index/write_ahead_log.h"
+#include "index/memtable.h"
+#include "index/message_buffer.h"
+#include "index/node_cache.h"
+#include "index/learned_model.h"
+#include "index/statistics.h"
+#include "index/analysis.h"
+#include "index/latency_histogram.h"
+#include "index/slow_op_trace.h"
+#include "index/probes.h"
+#include "index/operation_trace.h"
+#include "index/page_populator.h"
 #include "constants.h"
 
+#ifdef DB_INDEX_STATS
+  // Count the work and measure the latency of the operation until the end of
+  // the block (inside a member function of the index).
+  #define DB_INDEX_SCOPE(op)                                                 \
+    operation_scope scope_(this, statistics::operation::op)
+#else
+  #define DB_INDEX_SCOPE(op) do {} while (0)
+#endif
+
 namespace db {
   namespace index {
     class index {
       public:
+        // Expected access pattern of the pages of the index (passed to the
+        // kernel with madvise()).
+        enum class access_pattern : uint8_t {
+          kNormal,     // Default readahead.
+          kRandom,     // Point lookups: no readahead.
+          kSequential  // Full scans: aggressive readahead.
+        };
+
+        // Use of huge pages for the memory of the index.
+        enum class huge_page_mode : uint8_t {
+          kNone,
+
+          // Transparent huge pages for the mapping of the file
+          // (MADV_HUGEPAGE): used by the kernel for files on tmpfs (mounted
+          // with huge=advise or within_size) and on the filesystems whose
+          // page cache has large folios.
+          kFile,
+
+          // The index is copied into anonymous memory backed by transparent
+          // huge pages, for indexes which fit in memory. The file is only
+          // written by checkpoint() and close() (the whole index).
+          kAnonymous
+        };
+
+        // Options.
+        struct options {
+          // Bits per key of the filter for negative lookups (0: no filter,
+          // unless the index already has one). The filter is stored in the
+          // file `<filename>.flt`.
+          unsigned filter_bits_per_key;
+
+          // Number of keys for which the filter is sized when it is created.
+          uint64_t filter_keys;
+
+          // Size of the segments of the value log (0: no value log, unless
+          // the index already has one). Values longer than
+          // kInlineValueMaxLen are appended to the value log, stored in the
+          // files `<filename>.vlog` and `<filename>.vlog.<segment>`.
+          uint64_t value_log_segment_size;
+
+          // Log the write batches in the file `<filename>.wal` (once enabled,
+          // the log is always used for that index). The keys added with a
+          // data offset, the erased keys and the writes at an iterator are
+          // logged as batches of one operation; the other writes (values,
+          // postings and upserts) can't be logged, so they checkpoint the
+          // index first and the log never undoes them.
+          bool log_writes;
+
+          // Size of the memtable (0: no memtable). The keys added with a
+          // data offset and the erased keys are buffered in memory and
+          // applied to the tree in key order when the memtable is full.
+          uint64_t memtable_size;
+
+          // Number of pages of the message buffer of each inner node above
+          // the leaf nodes (0: no message buffers). Only used when the index
+          // is created: the keys added with a data offset and the erased
+          // keys are buffered in the inner nodes and pushed down to the leaf
+          // nodes in batches.
+          unsigned message_buffer_pages;
+
+          // Size of the in-memory copy of the upper levels of the tree (0: no
+          // copy). The lookups use it to skip the upper inner nodes; it is
+          // rebuilt after an inner node has been split.
+          uint64_t node_cache_size;
+
+          // Maximum error, in leaf nodes, of the learned model of the
+          // positions of the leaf nodes (0: no model). The model is fitted
+          // when the index is opened and by train_model(); find() uses it
+          // for the keys compared byte by byte (NULL comparator), e.g.
+          // encoded integers.
+          unsigned model_error;
+
+          // Latency (ns) above which the operations are recorded in the
+          // trace of slow operations (0: no trace). Only used when built with
+          // -DDB_INDEX_STATS.
+          uint64_t slow_op_threshold;
+
+          // Expected access pattern (see advise()).
+          access_pattern access;
+
+          // Load the inner nodes (and their message buffers) into memory
+          // when the index is opened (see prefault()), so that the first
+          // lookups after a restart don't fault them in one by one.
+          bool prefault_inner_nodes;
+
+          // Load also the leaf nodes.
+          bool prefault_leaf_nodes;
+
+          // Lock the nodes loaded in memory (mlock(), limited by
+          // RLIMIT_MEMLOCK).
+          bool lock_prefaulted;
+
+          // Number of threads which load the pages (0: one per CPU).
+          unsigned prefault_threads;
+
+          // Save the list of the pages of the index which are in memory to
+          // the file `<filename>.hot` when the index is closed, and load
+          // them when it is opened.
+          bool hot_pages;
+
+          // Use of huge pages. With huge pages, the mapping is aligned to
+          // the size of a huge page and the file grows by multiples of it,
+          // so the nodes allocated fill whole huge pages.
+          huge_page_mode huge_pages;
+
+          // Comparator of the keys, used to apply again the batches of the
+          // write-ahead log when the index is opened and to sort the
+          // memtable and the message buffers. Required by them: open()
+          // fails if it is NULL.
+          comparator_t comparator;
+
+          // Constructor.
+          options();
+        };
+
         // Constructor.
         index();
 
@@ -17,7 +158,7 @@ namespace db {
         ~index();
 
         // Open.
-        bool open(const char* filename);
+        bool open(const char* filename, const options& opts = options());
 
         // Close.
         void close();
@@ -28,22 +169,116 @@ namespace db {
                  uint64_t dataoff,
                  comparator_t comp);
 
+        // Add key with a value stored in the leaf node
+        // (valuelen <= kInlineValueMaxLen) or in the value log.
+        bool add(const void* key,
+                 keylen_t keylen,
+                 const void* value,
+                 uint32_t valuelen,
+                 comparator_t comp);
+
         // Erase key (marks the key as deleted).
         bool erase(const void* key, keylen_t keylen, comparator_t comp);
 
+        // Function which computes the data offset of the key from the
+        // current one (`found` is false if the key is not in the index).
+        typedef uint64_t (*update_function_t)(bool found,
+                                              uint64_t dataoff,
+                                              void* arg);
+
+        // Add key or update its data offset in a single descent of the tree.
+        // Fails if the value of the key is stored in the index.
+        bool upsert(const void* key,
+                    keylen_t keylen,
+                    update_function_t fn,
+                    void* arg,
+                    comparator_t comp);
+
+        // Add posting to the posting list of the key (the key is added if it
+        // is not in the index). The postings of a key are sorted and unique.
+        bool add_posting(const void* key,
+                         keylen_t keylen,
+                         uint64_t posting,
+                         comparator_t comp);
+
+        // Remove posting from the posting list of the key (the key is erased
+        // with its last posting).
+        bool remove_posting(const void* key,
+                            keylen_t keylen,
+                            uint64_t posting,
+                            comparator_t comp);
+
+        // Apply the operations of the batch together: with a write-ahead
+        // log, the batch is made durable with a single sync before being
+        // applied. The operations are sorted by key, so consecutive
+        // operations on the same leaf node don't search from the root.
+        bool write(write_batch& batch, comparator_t comp);
+
+        // Sync the index to disk and empty the write-ahead log.
+        bool checkpoint();
+
+        // Apply the operations buffered in the memtable and in the message
+        // buffers to the leaf nodes. The reads which don't search a data
+        // offset apply them when needed: those reads modify the tree like
+        // a write, invalidating the other iterators.
+        bool flush();
+
         // Find key.
         bool find(const void* key,
                   keylen_t keylen,
                   comparator_t comp,
                   uint64_t& dataoff) const;
 
-        // Get number of keys.
-        uint64_t size() const;
+        // Get number of keys. With buffered operations, they are applied
+        // first (see flush()).
+        bool size(uint64_t& nkeys) const;
+
+        // Get number of keys smaller than the key (applies the buffered
+        // operations first, see flush()).
+        bool rank(const void* key,
+                  keylen_t keylen,
+                  comparator_t comp,
+                  uint64_t& rank) const;
+
+        // Get number of keys in the range [key1, key2) (applies the buffered
+        // operations first, see flush()).
+        bool count(const void* key1,
+                   keylen_t keylen1,
+                   const void* key2,
+                   keylen_t keylen2,
+                   comparator_t comp,
+                   uint64_t& count) const;
+
+        // Reference to an entry (valid until the index is modified).
+        struct ref {
+          // Key.
+          const void* key;
+
+          // Key length.
+          keylen_t keylen;
+
+          // Value (NULL if the value is not stored in the index).
+          const void* value;
+
+          // Length of the value.
+          uint32_t valuelen;
+
+          // Data offset.
+          uint64_t dataoff;
+        };
 
         class iterator {
           friend class index;
 
           public:
+            // Constructor.
+            iterator();
+
+            // Read ahead the next `nleaves` leaf nodes, following the chain
+            // of leaf nodes, while the iterator moves forward (0: no read
+            // ahead, default).
+            void readahead(size_t nleaves);
+
             // Get key.
             const void* key() const;
 
@@ -53,16 +288,67 @@ namespace db {
             // Get data offset.
             uint64_t data_offset() const;
 
+            // Get value (NULL if the value is not stored in the index).
+            const void* value() const;
+
+            // Get length of the value.
+            uint32_t value_len() const;
+
           private:
+            const value_log* vlog_;
             uint64_t off_;
             const struct leaf_node* node_;
             nodeoff_t pos_;
+
+            // Number of leaf nodes to read ahead.
+            size_t readahead_;
+
+            // Leaf node of the iterator when the read ahead was last updated
+            // and its next leaf node.
+            uint64_t ahead_leaf_;
+            uint64_t ahead_next_;
+
+            // Last leaf node read ahead and number of leaf nodes read ahead
+            // of the leaf node of the iterator.
+            uint64_t ahead_off_;
+            size_t nahead_;
         };
 
-        // Begin.
+        // Iterator over a posting list (valid until the index is modified).
+        class posting_iterator {
+          friend class index;
+
+          public:
+            // Get number of postings.
+            uint64_t size() const;
+
+            // Get next posting.
+            bool next(uint64_t& posting);
+
+            // Get up to `max` postings. Returns the number of postings (0
+            // when there are no more postings).
+            size_t next_batch(uint64_t* postings, size_t max);
+
+          private:
+            const index* index_;
+            uint64_t size_;
+
+            // Postings stored in the leaf node.
+            const uint8_t* ptr_;
+            const uint8_t* end_;
+            uint64_t last_;
+
+            // Postings stored in posting nodes.
+            const struct posting_node* node_;
+            nodeoff_t pos_;
+        };
+
+        // Begin. The buffered operations are applied first (see flush()), so
+        // the other iterators might be invalidated; an iterator doesn't see
+        // the operations buffered after it was positioned.
         bool begin(iterator& it) const;
 
-        // End.
+        // End (applies the buffered operations first, like begin()).
         bool end(iterator& it) const;
 
         // Previous.
@@ -71,19 +357,188 @@ namespace db {
         // Next.
         bool next(iterator& it) const;
 
-        // Find.
+        // Next batch: fills `refs` with up to `max` entries, starting at the
+        // current position of the iterator and following the chain of leaf
+        // nodes. Returns the number of entries filled (0 when there are no
+        // more entries). Afterwards, the iterator points to the entry
+        // following the last one returned; once there are no more entries,
+        // the iterator is exhausted: next(), previous(), seek() and
+        // next_batch() fail, and it must be positioned again (begin(),
+        // find()...) before reading its entry.
+        size_t next_batch(iterator& it, ref* refs, size_t max) const;
+
+        // Find. The buffered operations of the key are applied first (see
+        // flush()), which might invalidate the other iterators.
         bool find(const void* key,
                   keylen_t keylen,
                   comparator_t comp,
                   iterator& it) const;
 
+        // Select the key at position `rank` (0: first key). Applies the
+        // buffered operations first, like begin().
+        bool select(uint64_t rank, iterator& it) const;
+
+        // Find the first key >= key (applies the buffered operations first,
+        // like begin()).
+        bool lower_bound(const void* key,
+                         keylen_t keylen,
+                         comparator_t comp,
+                         iterator& it) const;
+
+        // Move the iterator forward to the first key >= key. The leaf node
+        // of the iterator and the next one are checked (using their last
+        // key) before searching from the root.
+        bool seek(const void* key,
+                  keylen_t keylen,
+                  comparator_t comp,
+                  iterator& it) const;
+
+        // Find the posting list of the key (applies the buffered operations
+        // of the key first, like find()).
+        bool find_postings(const void* key,
+                           keylen_t keylen,
+                           comparator_t comp,
+                           posting_iterator& pit) const;
+
+        // Get the posting list of the key at the iterator.
+        bool postings(const iterator& it, posting_iterator& pit) const;
+
+        // Set the data offset of the key at the iterator (the value stored
+        // in the index, if any, is dropped). No search is performed: the
+        // buffered operations of the key, if any, are applied first.
+        bool update(iterator& it, uint64_t dataoff);
+
+        // Erase the key at the iterator (marks the key as deleted). No search
+        // is performed: the buffered operations of the key are applied in
+        // place and the counts of the ancestors are updated following the
+        // parent pointers. The iterator can still be moved with next() and
+        // previous().
+        bool erase(iterator& it);
+
         // Print.
         bool print() const;
 
+        // Analyze the structure of the tree: fill factor of the nodes per
+        // level, entries marked as deleted, fragmentation, order of the leaf
+        // nodes in the file and use of the pages. The subtrees are walked by
+        // `nthreads` threads (0: one per CPU).
+        bool analyze(analysis& a, unsigned nthreads = 0) const;
+
+        // Rebuild the filter with the keys of the index, sizing it for
+        // `nkeys` keys (0: the current number of keys).
+        bool rebuild_filter(uint64_t nkeys = 0);
+
+        // Get filter (NULL if the index has no filter).
+        const filter* key_filter() const;
+
+        // Garbage collect the segments of the value log in which the ratio
+        // of live bytes is below `threshold`: their live values are appended
+        // to the value log and the entries are updated in a single pass over
+        // the leaf nodes, then the segments are removed. A pass started by
+        // collect_garbage_step() is abandoned.
+        bool collect_garbage(double threshold = kGarbageThreshold);
+
+        // Do the same pass incrementally: each call visits at most
+        // `max_leaves` leaf nodes and `done` is set by the call which removes
+        // the segments. The segments are selected with `threshold` by the
+        // first call of the pass. The index is not thread-safe, so instead of
+        // running in its own thread, the collection is spread in bounded
+        // steps between the other operations (e.g. from the maintenance path
+        // of the application); the operations done between the steps are
+        // safe, as the leaf nodes only split to the right.
+        bool collect_garbage_step(size_t max_leaves,
+                                  bool& done,
+                                  double threshold = kGarbageThreshold);
+
+        // Get value log (NULL if the index has no value log).
+        const value_log* value_store() const;
+
+        // Fit the learned model to the current leaf nodes (e.g. after a bulk
+        // load). The keys added afterwards are still found through the tree.
+        bool train_model();
+
+        // Get learned model (NULL if the index has no model).
+        const learned_model* model() const;
+
+        // Get a snapshot of the counters of the work done by the index since
+        // it was opened (all zero unless built with -DDB_INDEX_STATS).
+        statistics stats() const;
+
+        // Get a snapshot of the histogram of the latencies of the operations
+        // of the type (empty unless built with -DDB_INDEX_STATS).
+        latency_histogram latencies(statistics::operation op) const;
+
+        // Get up to `max` of the latest slow operations (oldest first).
+        // Returns the number of operations.
+        size_t slow_ops(slow_op_trace::entry* entries, size_t max) const;
+
+        // Write the counters, the latencies and the slow operations to the
+        // file in the Prometheus text format (e.g. for the textfile
+        // collector of node_exporter). The file is replaced atomically.
+        bool export_stats(const char* filename) const;
+
+        // Tell the kernel how the pages of the index will be accessed: with
+        // kRandom, the point lookups don't read ahead pages which would
+        // pollute the page cache (the iterators can still read ahead the
+        // leaf nodes they are about to visit, see iterator::readahead()).
+        bool advise(access_pattern access);
+
+        // Load the inner nodes (and the leaf nodes if `leaf_nodes` is true)
+        // into memory, one level after another, with `nthreads` threads (0:
+        // one per CPU), and lock them in memory if `lock` is true.
+        bool prefault(bool leaf_nodes, bool lock, unsigned nthreads = 0);
+
+        // Start recording the operations (add, erase, find and iteration)
+        // in a trace (see operation_trace and replay.cpp), with the keys or
+        // only a hash of them.
+        bool start_recording(const char* filename, bool hash_keys = false);
+
+        // Stop recording the operations (also done by close()).
+        bool stop_recording();
+
       private:
         static const size_t kAllocate = 1024; // Number of nodes to allocate.
         static const uint8_t kMagic[8];
 
+        // Version of the format of the index (indexes with another version
+        // are not opened).
+        static const uint64_t kVersion = 2;
+
+        // Default bits per key of the filter.
+        static const unsigned kFilterBitsPerKey = 10;
+
+        // Default ratio of live bytes below which a segment of the value log
+        // is garbage collected.
+        static constexpr double kGarbageThreshold = 0.5;
+
+        // Default size of the segments of the value log.
+        static const uint64_t kValueLogSegmentSize = 64 * 1024 * 1024;
+
+        // Header flags.
+        static const uint64_t kFlagFilter = 1; // The index has a filter.
+        static const uint64_t kFlagValueLog = 2; // The index has a value log.
+        static const uint64_t kFlagWriteAheadLog = 8; // Write batches logged.
+        static const uint64_t kFlagMessageBuffers = 16; // Inner nodes above
+                                                        // the leaf nodes have
+                                                        // message buffers.
+
+        // Size of the write-ahead log above which a checkpoint is done.
+        static const uint64_t kCheckpointSize = 16 * 1024 * 1024;
+
+        static const uint8_t kHotPagesMagic[8];
+
+        // Size of a huge page.
+        static const uint64_t kHugePageSize = 2 * 1024 * 1024;
+
+        // Header of the list of hot pages (followed by the ranges of pages:
+        // first page and number of pages).
+        struct hot_pages_header {
+          uint8_t magic[8];
+
+          // Number of ranges.
+          uint64_t nranges;
+        };
+
         struct header {
           uint8_t magic[8];
 
@@ -91,8 +546,42 @@ namespace db {
           uint64_t nkeys;
 
           uint64_t root;
+
+          uint64_t flags;
+
+          // Offset of the first free posting node.
+          uint64_t free_posting_nodes;
+
+          // Number of levels of the tree (1: the root is a leaf node).
+          uint64_t height;
+
+          // Number of pages of the message buffers.
+          uint64_t buffer_pages;
+
+          // Version of the format (kVersion). Placed after the fields of the
+          // first format, which left it zeroed.
+          uint64_t version;
         };
 
+        // Format of the posting lists stored after the key.
+        static const uint8_t kPostingsInline = 0; // Varint deltas follow.
+        static const uint8_t kPostingsNodes = 1; // Stored in posting nodes.
+
+        // Posting list stored in posting nodes.
+        struct posting_list {
+          uint8_t format;
+
+          // Offset of the first posting node.
+          uint64_t first;
+
+          // Number of postings.
+          uint64_t count;
+        } __attribute__((packed));
+
+        // Number of postings below which a posting list stored in posting
+        // nodes is moved back to the leaf node.
+        static const uint64_t kInlinePostings = 16;
+
         int fd_;
         void* data_;
 
@@ -100,21 +589,421 @@ namespace db {
 
         header* header_;
 
+        // Filter for negative lookups.
+        filter filter_;
+        bool has_filter_;
+
+        // Log of the values longer than kInlineValueMaxLen.
+        value_log vlog_;
+        bool has_vlog_;
+
+        // Pass of garbage collection in progress: segments to collect (NULL
+        // if there is no pass in progress) and next leaf node to visit.
+        bool* gc_segments_;
+        uint32_t gc_nsegments_;
+        uint64_t gc_leaf_;
+
+        // Log of the write batches.
+        write_ahead_log wal_;
+        bool has_wal_;
+
+        // Buffer of the operations.
+        memtable memtable_;
+        bool has_memtable_;
+        uint64_t memtable_size_;
+
+        // Batch of a single operation (buffered in the memtable or logged).
+        write_batch single_;
+
+        // Do the inner nodes above the leaf nodes have message buffers?
+        bool has_buffers_;
+
+        // Might the message buffers hold messages (until flush_buffers())?
+        bool has_messages_;
+
+        // Comparator of the keys (options::comparator).
+        comparator_t comp_;
+
+        // Copy of the upper levels of the tree (built by the first lookup
+        // after a change).
+        mutable node_cache cache_;
+        bool has_cache_;
+        uint64_t cache_size_;
+
+        // Model of the positions of the leaf nodes.
+        learned_model model_;
+        bool has_model_;
+        unsigned model_error_;
+
+        // Counters of the work done (also by the const methods).
+        mutable statistics stats_;
+
+        // Latencies of the operations, by type.
+        mutable latency_histogram latencies_[statistics::kOperations];
+
+        // Operations slower than slow_op_threshold_.
+        mutable slow_op_trace trace_;
+        uint64_t slow_op_threshold_;
+
+        // Expected access pattern.
+        access_pattern access_;
+
+        // Path of the list of hot pages (empty if the list is not used).
+        char hot_pages_[PATH_MAX];
+
+        // Use of huge pages.
+        huge_page_mode huge_pages_;
+
+        // Trace of the operations being recorded.
+        mutable operation_trace recorder_;
+        bool recording_;
+
+        // Counts the work and measures the latency of an operation (a nested
+        // operation is part of the outer one).
+        class operation_scope {
+          public:
+            // Constructor.
+            operation_scope(const index* idx, statistics::operation op);
+
+            // Destructor.
+            ~operation_scope();
+
+          private:
+            // Index (NULL if the operation is nested).
+            const index* idx_;
+
+            statistics::operation op_;
+
+            // Start of the operation (monotonic clock, ns).
+            uint64_t start_;
+        };
+
+        // Position in an inner node (used when descending the tree).
+        struct level {
+          // Offset of the inner node.
+          uint64_t off;
+
+          // Index of the child.
+          nodeoff_t pos;
+        };
+
         // Get node.
         node* read_node(uint64_t off);
         const node* read_node(uint64_t off) const;
 
-        // Create node.
-        bool create_node(size_t depth, uint64_t& off);
+        // Get the node where the search of the key starts: the root node or
+        // the node returned by the cache of the upper levels (`level` is the
+        // level of the node, 1: leaf nodes).
+        uint64_t first_node(const void* key,
+                            keylen_t keylen,
+                            comparator_t comp,
+                            uint64_t& level) const;
+
+        // Add, erase and find keys and begin scans (the public functions
+        // fire the entry and return probes around these ones).
+        bool add_offset(const void* key,
+                        keylen_t keylen,
+                        uint64_t dataoff,
+                        comparator_t comp);
+
+        bool add_value(const void* key,
+                       keylen_t keylen,
+                       const void* value,
+                       uint32_t valuelen,
+                       comparator_t comp);
+
+        bool erase_key(const void* key, keylen_t keylen, comparator_t comp);
+
+        bool find_offset(const void* key,
+                         keylen_t keylen,
+                         comparator_t comp,
+                         uint64_t& dataoff) const;
+
+        bool find_key(const void* key,
+                      keylen_t keylen,
+                      comparator_t comp,
+                      iterator& it) const;
+
+        bool first(iterator& it) const;
+
+        // Append the operation to the trace (if recording).
+        void record(operation_trace::op_type type,
+                    bool result,
+                    const void* key = NULL,
+                    keylen_t keylen = 0,
+                    uint64_t arg = 0) const;
+
+        // Insert key.
+        bool insert(const void* key,
+                    keylen_t keylen,
+                    leaf_node::value_type type,
+                    const void* value,
+                    uint64_t dataoff,
+                    comparator_t comp,
+                    update_function_t fn = NULL,
+                    void* arg = NULL);
+
+        // Apply the operations of a sorted batch.
+        bool apply(const write_batch& batch, comparator_t comp);
+
+        // Apply operation (buffered in a message buffer if the index has
+        // them).
+        bool apply(write_batch::op_type type,
+                   const void* key,
+                   keylen_t keylen,
+                   uint64_t dataoff,
+                   comparator_t comp,
+                   uint64_t& off);
+
+        // Apply operation to the leaf node, starting at the leaf node `off`
+        // if the key is in its range (`off` is updated to the leaf node of
+        // the key, 0 if unknown).
+        bool apply_to_leaf(write_batch::op_type type,
+                           const void* key,
+                           keylen_t keylen,
+                           uint64_t dataoff,
+                           comparator_t comp,
+                           uint64_t& off);
+
+        // Apply the operations of the memtable.
+        bool drain_memtable();
+
+        // Append a batch of one operation to the write-ahead log (if any).
+        bool log_write(write_batch::op_type type,
+                       const void* key,
+                       keylen_t keylen,
+                       uint64_t dataoff);
+
+        // Checkpoint the index before a write which is not logged (if the
+        // log has batches), so that replaying the log doesn't undo it.
+        bool prepare_unlogged_write();
+
+        // Apply the buffered operations before a read which doesn't see them
+        // (iterators, rank(), select(), size()...), invalidating the
+        // iterators like a write.
+        bool prepare_read() const;
+
+        // Apply the buffered operation of the key (if any) before a read.
+        bool prepare_read(const void* key,
+                          keylen_t keylen,
+                          comparator_t comp) const;
+
+        // Apply the buffered operations of the key (if any), before writing
+        // the key without buffering. An operation on a key of the tree is
+        // applied in place.
+        bool apply_pending(const void* key, keylen_t keylen, comparator_t comp);
+
+        // Get message buffer of the inner node.
+        message_buffer* get_buffer(uint64_t off);
+        const message_buffer* get_buffer(uint64_t off) const;
+
+        // Search the inner node above the leaf nodes which might contain the
+        // key (the tree must have inner nodes).
+        uint64_t find_buffered_node(const void* key,
+                                    keylen_t keylen,
+                                    comparator_t comp) const;
+
+        // Find the buffered message of the key.
+        bool find_message(const void* key,
+                          keylen_t keylen,
+                          comparator_t comp,
+                          uint8_t& type,
+                          uint64_t& dataoff) const;
+
+        // Add message to the message buffer of the key.
+        bool buffer(write_batch::op_type type,
+                    const void* key,
+                    keylen_t keylen,
+                    uint64_t dataoff,
+                    comparator_t comp);
+
+        // Push the messages of the buffer of the inner node down to the leaf
+        // nodes. All of them are pushed at once: they are applied in key
+        // order, so each leaf node is visited once per flush.
+        bool flush_buffer(uint64_t off, comparator_t comp);
+
+        // Push all the messages down to the leaf nodes.
+        bool flush_buffers();
+
+        // Subtrees analyzed by the threads of analyze().
+        struct analyze_task {
+          const index* idx;
+
+          // Roots of the subtrees and their level.
+          const uint64_t* subtrees;
+          size_t nsubtrees;
+          size_t level;
+
+          // Next subtree to analyze.
+          size_t next;
+
+          // Has a node not been read?
+          bool failed;
+        };
+
+        // Thread of analyze().
+        struct analyze_worker {
+          analyze_task* task;
+
+          // Nodes analyzed by the thread.
+          analysis a;
+        };
+
+        // Analyze the subtrees of the task which are left (thread function,
+        // `arg` is an analyze_worker).
+        static void* analyze_subtrees(void* arg);
+
+        // Analyze node (`level` 1: leaf node).
+        bool analyze_node(uint64_t off, size_t level, analysis& a) const;
+
+        // Analyze the node and its descendants.
+        bool analyze_subtree(uint64_t off, size_t level, analysis& a) const;
+
+        // Search the leaf node which might contain the key (false if the
+        // index is empty).
+        bool find_leaf(const void* key,
+                       keylen_t keylen,
+                       comparator_t comp,
+                       uint64_t& off) const;
+
+        // Release the value stored in the value log (if any).
+        void release_value(struct leaf_node* leaf, nodeoff_t pos);
+
+        // Get value (NULL if the value is not stored in the index).
+        static const void* get_value(const value_log* vlog,
+                                     const struct leaf_node* leaf,
+                                     nodeoff_t pos,
+                                     uint32_t& len);
+
+        // Read ahead the leaf nodes which follow the leaf node of the
+        // iterator (at offset `off`), if the iterator has moved to it.
+        void read_ahead(iterator& it,
+                        uint64_t off,
+                        const struct leaf_node* leaf) const;
+
+        // Position the iterator at the first key not marked as deleted at
+        // position >= pos, following the chain of leaf nodes.
+        bool forward(uint64_t off,
+                     const struct leaf_node* leaf,
+                     nodeoff_t pos,
+                     iterator& it) const;
+
+        // Get the posting list of the key at position.
+        bool postings(const struct leaf_node* leaf,
+                      nodeoff_t pos,
+                      posting_iterator& pit) const;
+
+        // Store postings in new posting nodes.
+        bool write_postings(const uint64_t* postings,
+                            size_t count,
+                            uint64_t& first);
+
+        // Add posting to the posting nodes (`added` is false if the posting
+        // was already in the list).
+        bool add_posting(uint64_t first, uint64_t posting, bool& added);
+
+        // Remove posting from the posting nodes (`first` is updated if the
+        // first node becomes empty).
+        void remove_posting(uint64_t& first, uint64_t posting, bool& removed);
+
+        // Create posting node (reusing a free one if possible).
+        bool create_posting_node(uint64_t& off);
+
+        // Free the posting nodes of a posting list.
+        void free_postings(uint64_t first);
+
+        // Update the number of keys of the children in the path.
+        void update_counts(const struct level* levels,
+                           size_t depth,
+                           int64_t delta);
+
+        // Update the number of keys of the ancestors of the node, following
+        // the parent pointers.
+        void update_parent_counts(uint64_t off, int64_t delta);
+
+        // Open filter.
+        bool open_filter(const char* filename, const options& opts);
+
+        // Open value log.
+        bool open_value_log(const char* filename, const options& opts);
+
+        // Open write-ahead log (applies again the logged batches).
+        bool open_write_ahead_log(const char* filename, const options& opts);
+
+        // Map the file (`size` bytes) into memory.
+        bool map(uint64_t size);
+
+        // Grow the mapping to `size` bytes (the file has been grown).
+        bool remap(uint64_t size);
+
+        // Reserve `size` bytes of address space aligned to a huge page.
+        static void* reserve(uint64_t size);
+
+        // Write the mapping to disk.
+        bool sync();
+
+        // Load the nodes and the hot pages requested by the options.
+        bool warm_up(const char* filename, const options& opts);
+
+        // Load the list of hot pages (if it exists) and its pages.
+        bool load_hot_pages(unsigned nthreads);
+
+        // Save the list of the pages which are in memory.
+        bool save_hot_pages() const;
+
+        // Create node (`count` consecutive nodes), making sure that there are
+        // at least `reserve` free nodes first.
+        bool create_node(size_t reserve, uint64_t& off, size_t count = 1);
 
         // Allocate nodes.
         bool allocate(size_t count);
     };
 
+    inline index::options::options()
+      : filter_bits_per_key(0),
+        filter_keys(0),
+        value_log_segment_size(0),
+        log_writes(false),
+        memtable_size(0),
+        message_buffer_pages(0),
+        node_cache_size(0),
+        model_error(0),
+        slow_op_threshold(0),
+        access(access_pattern::kNormal),
+        prefault_inner_nodes(false),
+        prefault_leaf_nodes(false),
+        lock_prefaulted(false),
+        prefault_threads(0),
+        hot_pages(false),
+        huge_pages(huge_page_mode::kNone),
+        comparator(NULL)
+    {
+    }
+
     inline index::index()
       : fd_(-1),
-        data_(MAP_FAILED)
+        data_(MAP_FAILED),
+        has_filter_(false),
+        has_vlog_(false),
+        gc_segments_(NULL),
+        gc_nsegments_(0),
+        gc_leaf_(0),
+        has_wal_(false),
+        has_memtable_(false),
+        memtable_size_(0),
+        has_buffers_(false),
+        has_messages_(false),
+        comp_(NULL),
+        has_cache_(false),
+        cache_size_(0),
+        has_model_(false),
+        model_error_(0),
+        slow_op_threshold_(0),
+        access_(access_pattern::kNormal),
+        huge_pages_(huge_page_mode::kNone),
+        recording_(false)
     {
+      hot_pages_[0] = 0;
     }
 
     inline index::~index()
@@ -127,8 +1016,45 @@ namespace db {
                             comparator_t comp,
                             uint64_t& dataoff) const
     {
+      DB_INDEX_PROBE2(find_entry, key, keylen);
+
+      bool ret = find_offset(key, keylen, comp, dataoff);
+
+      DB_INDEX_PROBE1(find_return, ret);
+
+      record(operation_trace::op_type::kFind, ret, key, keylen);
+
+      return ret;
+    }
+
+    inline bool index::find_offset(const void* key,
+                                   keylen_t keylen,
+                                   comparator_t comp,
+                                   uint64_t& dataoff) const
+    {
+      DB_INDEX_SCOPE(kFind);
+
+      // The memtable has the latest operations.
+      const memtable::entry* e;
+      if ((has_memtable_) && ((e = memtable_.find(key, keylen)) != NULL)) {
+        if (e->type != static_cast<uint8_t>(write_batch::op_type::kAdd)) {
+          return false;
+        }
+
+        dataoff = e->dataoff;
+
+        return true;
+      }
+
+      // The message buffers have the operations which are not in the leaf
+      // nodes yet.
+      uint8_t type;
+      if ((has_buffers_) && (find_message(key, keylen, comp, type, dataoff))) {
+        return (type == static_cast<uint8_t>(write_batch::op_type::kAdd));
+      }
+
       iterator it;
-      if (find(key, keylen, comp, it)) {
+      if (find_key(key, keylen, comp, it)) {
         dataoff = it.data_offset();
 
         return true;
@@ -137,9 +1063,157 @@ namespace db {
       return false;
     }
 
-    inline uint64_t index::size() const
+    inline bool index::add(const void* key,
+                           keylen_t keylen,
+                           uint64_t dataoff,
+                           comparator_t comp)
     {
-      return header_->nkeys;
+      DB_INDEX_PROBE2(add_entry, key, keylen);
+
+      bool ret = add_offset(key, keylen, dataoff, comp);
+
+      DB_INDEX_PROBE1(add_return, ret);
+
+      record(operation_trace::op_type::kAdd, ret, key, keylen, dataoff);
+
+      return ret;
+    }
+
+    inline bool index::add_offset(const void* key,
+                                  keylen_t keylen,
+                                  uint64_t dataoff,
+                                  comparator_t comp)
+    {
+      DB_INDEX_SCOPE(kAdd);
+
+      // If there is a memtable, the operation is buffered; with a
+      // write-ahead log, it is logged.
+      if ((has_memtable_) || (has_wal_)) {
+        single_.clear();
+        return ((single_.add(key, keylen, dataoff)) && (write(single_, comp)));
+      }
+
+      // If there are message buffers...
+      if (has_buffers_) {
+        return buffer(write_batch::op_type::kAdd, key, keylen, dataoff, comp);
+      }
+
+      return insert(key,
+                    keylen,
+                    leaf_node::value_type::kExternal,
+                    NULL,
+                    dataoff,
+                    comp);
+    }
+
+    inline const learned_model* index::model() const
+    {
+      return has_model_ ? &model_ : NULL;
+    }
+
+    inline statistics index::stats() const
+    {
+      statistics s;
+      s.add(stats_);
+
+      return s;
+    }
+
+    inline latency_histogram index::latencies(statistics::operation op) const
+    {
+      latency_histogram h;
+      h.add(latencies_[static_cast<size_t>(op)]);
+
+      return h;
+    }
+
+    inline size_t index::slow_ops(slow_op_trace::entry* entries,
+                                  size_t max) const
+    {
+      return trace_.get(entries, max);
+    }
+
+    inline void index::record(operation_trace::op_type type,
+                              bool result,
+                              const void* key,
+                              keylen_t keylen,
+                              uint64_t arg) const
+    {
+      if (recording_) {
+        recorder_.append(type, result, key, keylen, arg);
+      }
+    }
+
+    inline message_buffer* index::get_buffer(uint64_t off)
+    {
+      return reinterpret_cast<message_buffer*>(
+               reinterpret_cast<uint8_t*>(data_) + off + kNodeSize
+             );
+    }
+
+    inline const message_buffer* index::get_buffer(uint64_t off) const
+    {
+      return reinterpret_cast<const message_buffer*>(
+               reinterpret_cast<const uint8_t*>(data_) + off + kNodeSize
+             );
+    }
+
+    inline bool index::size(uint64_t& nkeys) const
+    {
+      // Count the buffered operations too.
+      if (!prepare_read()) {
+        return false;
+      }
+
+      nkeys = header_->nkeys;
+
+      return true;
+    }
+
+    inline const filter* index::key_filter() const
+    {
+      return has_filter_ ? &filter_ : NULL;
+    }
+
+    inline const value_log* index::value_store() const
+    {
+      return has_vlog_ ? &vlog_ : NULL;
+    }
+
+    inline bool index::count(const void* key1,
+                             keylen_t keylen1,
+                             const void* key2,
+                             keylen_t keylen2,
+                             comparator_t comp,
+                             uint64_t& count) const
+    {
+      uint64_t rank1, rank2;
+      if ((rank(key1, keylen1, comp, rank1)) &&
+          (rank(key2, keylen2, comp, rank2))) {
+        count = (rank2 > rank1) ? rank2 - rank1 : 0;
+        return true;
+      }
+
+      return false;
+    }
+
+    inline index::iterator::iterator()
+      : vlog_(NULL),
+        off_(0),
+        node_(NULL),
+        pos_(0),
+        readahead_(0),
+        ahead_leaf_(0),
+        ahead_next_(0),
+        ahead_off_(0),
+        nahead_(0)
+    {
+    }
+
+    inline void index::iterator::readahead(size_t nleaves)
+    {
+      readahead_ = nleaves;
+      ahead_leaf_ = 0;
     }
 
     inline const void* index::iterator::key() const
@@ -157,8 +1231,76 @@ namespace db {
       return node_->data_offset(pos_);
     }
 
+    inline const void* index::iterator::value() const
+    {
+      uint32_t len;
+      return get_value(vlog_, node_, pos_, len);
+    }
+
+    inline uint32_t index::iterator::value_len() const
+    {
+      uint32_t len;
+      get_value(vlog_, node_, pos_, len);
+
+      return len;
+    }
+
+    inline uint64_t index::posting_iterator::size() const
+    {
+      return size_;
+    }
+
+    inline bool index::posting_iterator::next(uint64_t& posting)
+    {
+      // Postings stored in the leaf node?
+      if (!node_) {
+        if (posting_node::decode_next(ptr_, end_, last_)) {
+          posting = last_;
+          return true;
+        }
+
+        return false;
+      }
+
+      while (pos_ == node_->nentries) {
+        if ((node_ = static_cast<const struct posting_node*>(
+                       index_->read_node(node_->next)
+                     )) == NULL) {
+          return false;
+        }
+
+        pos_ = 0;
+      }
+
+      posting = node_->postings[pos_++];
+
+      return true;
+    }
+
+    inline const void* index::get_value(const value_log* vlog,
+                                        const struct leaf_node* leaf,
+                                        nodeoff_t pos,
+                                        uint32_t& len)
+    {
+      // If the value is in the value log...
+      if (leaf->type(pos) == leaf_node::value_type::kValueLog) {
+        value_log::pointer ptr;
+        memcpy(&ptr, leaf->value(pos), sizeof(value_log::pointer));
+
+        len = ptr.length;
+
+        return vlog->get(ptr);
+      }
+
+      len = leaf->value_length(pos);
+
+      return leaf->value(pos);
+    }
+
     inline node* index::read_node(uint64_t off)
     {
+      DB_INDEX_COUNT(node_visits, 1);
+
       return ((off > 0) &&
               (off + kNodeSize <= filesize_) &&
               ((off & (kNodeSize - 1)) == 0)) ?
@@ -170,6 +1312,8 @@ namespace db {
 
     inline const node* index::read_node(uint64_t off) const
     {
+      DB_INDEX_COUNT(node_visits, 1);
+
       return ((off > 0) &&
               (off + kNodeSize <= filesize_) &&
               ((off & (kNodeSize - 1)) == 0)) ?
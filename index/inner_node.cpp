@@ -6,6 +6,7 @@
 bool db::index::inner_node::add(const void* key,
                                keylen_t keylen,
                                uint64_t child,
+                               uint64_t count,
                                comparator_t comp)
 {
   // If the key is not too long...
@@ -13,9 +14,10 @@ bool db::index::inner_node::add(const void* key,
     // If the key is not in the node...
     nodeoff_t pos;
     if (!search(key, keylen, comp, pos)) {
-      return add(key, keylen, child, pos);
+      return add(key, keylen, child, count, pos);
     } else {
       entries[pos].child = child;
+      entries[pos].count = count;
       return true;
     }
   }
@@ -26,6 +28,7 @@ bool db::index::inner_node::add(const void* key,
 bool db::index::inner_node::add(const void* key,
                                keylen_t keylen,
                                uint64_t child,
+                               uint64_t count,
                                nodeoff_t pos)
 {
   // If the entry + key fits in the node...
@@ -46,6 +49,7 @@ bool db::index::inner_node::add(const void* key,
     entries[pos].keyoff = nextoff;
     entries[pos].keylen = keylen;
     entries[pos].child = child;
+    entries[pos].count = count;
 
     nentries++;
 
@@ -60,6 +64,7 @@ void db::index::inner_node::split(inner_node* right,
                                   const void* key,
                                   keylen_t keylen,
                                   uint64_t child,
+                                  uint64_t count,
                                   void* upkey,
                                   keylen_t& upkeylen)
 {
@@ -239,11 +244,12 @@ void db::index::inner_node::split(inner_node* right,
   if (pos > mid) {
     // Case 1.3: New key goes to the right node.
 
-    fill_right(right, mid + 1, pos - (mid + 1), key, keylen, child);
+    fill_right(right, mid + 1, pos - (mid + 1), key, keylen, child, count);
 
     const struct entry* midentry = entries + mid;
 
     right->left = midentry->child;
+    right->leftcount = midentry->count;
 
     // Fill key which goes to the parent.
     memcpy(upkey,
@@ -263,13 +269,15 @@ void db::index::inner_node::split(inner_node* right,
       const struct entry* midentry = entries + mid - 1;
 
       right->left = midentry->child;
+      right->leftcount = midentry->count;
 
       // Defragment current node and add key.
-      defrag(midentry, pos, key, keylen, child, upkey, upkeylen);
+      defrag(midentry, pos, key, keylen, child, count, upkey, upkeylen);
     } else {
       // Case 1.1: New key goes to the parent node.
 
       right->left = child;
+      right->leftcount = count;
 
       // Fill key which goes to the parent.
       memcpy(upkey, key, keylen);
@@ -292,10 +300,12 @@ bool db::index::inner_node::search(const void* key,
   while (i <= j) {
     int mid = (i + j) / 2;
 
-    int ret = comp(key,
-                   keylen,
-                   reinterpret_cast<const uint8_t*>(this) + entries[mid].keyoff,
-                   entries[mid].keylen);
+    const void* k = reinterpret_cast<const uint8_t*>(this) +
+                    entries[mid].keyoff;
+
+    int ret = compare(comp, key, keylen, k, entries[mid].keylen);
+
+    DB_INDEX_COUNT(comparisons, 1);
 
     if (ret < 0) {
       j = mid - 1;
@@ -316,15 +326,16 @@ void db::index::inner_node::print() const
 {
   printf("Index:\n");
 
-  printf("\tLeft: %lu.\n\n", left);
+  printf("\tLeft: %lu, count: %lu.\n\n", left, leftcount);
 
   for (nodeoff_t i = 0; i < nentries; i++) {
-    printf("\t[%03u] Length: %u, key: '%.*s', child: %lu.\n",
+    printf("\t[%03u] Length: %u, key: '%.*s', child: %lu, count: %lu.\n",
            i + 1,
            entries[i].keylen,
            entries[i].keylen,
            reinterpret_cast<const uint8_t*>(this) + entries[i].keyoff,
-           entries[i].child);
+           entries[i].child,
+           entries[i].count);
   }
 }
 
@@ -333,7 +344,8 @@ void db::index::inner_node::fill_right(inner_node* right,
                                        nodeoff_t pos,
                                        const void* key,
                                        keylen_t keylen,
-                                       uint64_t child)
+                                       uint64_t child,
+                                       uint64_t count)
 {
   // Number of entries in the right node.
   nodeoff_t n = nentries - mid + 1;
@@ -364,6 +376,7 @@ void db::index::inner_node::fill_right(inner_node* right,
     dest->keyoff = off;
     dest->keylen = len;
     dest->child = src->child;
+    dest->count = src->count;
   }
 
   // Copy key.
@@ -373,6 +386,7 @@ void db::index::inner_node::fill_right(inner_node* right,
   dest->keyoff = off;
   dest->keylen = keylen;
   dest->child = child;
+  dest->count = count;
 
   dest--;
 
@@ -389,6 +403,7 @@ void db::index::inner_node::fill_right(inner_node* right,
     dest->keyoff = off;
     dest->keylen = len;
     dest->child = src->child;
+    dest->count = src->count;
   }
 
   right->t = t;
@@ -430,6 +445,7 @@ void db::index::inner_node::fill_right(inner_node* right, nodeoff_t mid)
     dest->keyoff = off;
     dest->keylen = keylen;
     dest->child = src->child;
+    dest->count = src->count;
   }
 
   right->t = t;
@@ -445,6 +461,9 @@ void db::index::inner_node::fill_right(inner_node* right, nodeoff_t mid)
 
 void db::index::inner_node::defrag()
 {
+  DB_INDEX_COUNT(defrags, 1);
+  DB_INDEX_PROBE3(inner_defrag, this, parent, nentries);
+
   // Pointer to the current entry in the current node.
   struct entry* src = entries + (nentries - 1);
 
@@ -470,9 +489,13 @@ void db::index::inner_node::defrag(const struct entry* midentry,
                                    const void* key,
                                    keylen_t keylen,
                                    uint64_t child,
+                                   uint64_t count,
                                    void* upkey,
                                    keylen_t& upkeylen)
 {
+  DB_INDEX_COUNT(defrags, 1);
+  DB_INDEX_PROBE3(inner_defrag, this, parent, nentries);
+
   // Pointer to the entry where the key will be inserted in the current node.
   const struct entry* posentry = entries + pos;
 
@@ -499,6 +522,7 @@ void db::index::inner_node::defrag(const struct entry* midentry,
     dest->keyoff = nextoff;
     dest->keylen = len;
     dest->child = src->child;
+    dest->count = src->count;
   }
 
   // Copy key.
@@ -508,6 +532,7 @@ void db::index::inner_node::defrag(const struct entry* midentry,
   dest->keyoff = nextoff;
   dest->keylen = keylen;
   dest->child = child;
+  dest->count = count;
 
   dest--;
 
@@ -523,6 +548,7 @@ void db::index::inner_node::defrag(const struct entry* midentry,
     dest->keyoff = nextoff;
     dest->keylen = len;
     dest->child = src->child;
+    dest->count = src->count;
   }
 
   // Fill key which goes to the parent.
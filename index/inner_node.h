@@ -11,6 +11,10 @@ namespace db {
         // Offset of the first child with smaller keys.
         uint64_t left;
 
+        // Number of keys (not marked as deleted) in the subtree of the first
+        // child.
+        uint64_t leftcount;
+
         struct entry {
           // Offset of the key in the node.
           nodeoff_t keyoff;
@@ -20,6 +24,10 @@ namespace db {
 
           // Offset of the first child with keys greater than the key.
           uint64_t child;
+
+          // Number of keys (not marked as deleted) in the subtree of the
+          // child.
+          uint64_t count;
         } __attribute__((packed));
 
         // Dynamic array of entries.
@@ -31,11 +39,13 @@ namespace db {
         bool add(const void* key,
                  keylen_t keylen,
                  uint64_t child,
+                 uint64_t count,
                  comparator_t comp);
 
         bool add(const void* key,
                  keylen_t keylen,
                  uint64_t child,
+                 uint64_t count,
                  nodeoff_t pos);
 
         // Split.
@@ -44,6 +54,7 @@ namespace db {
                    const void* key,
                    keylen_t keylen,
                    uint64_t child,
+                   uint64_t count,
                    void* upkey,
                    keylen_t& upkeylen);
 
@@ -53,9 +64,34 @@ namespace db {
                     comparator_t comp,
                     nodeoff_t& pos) const;
 
+        // Search the child which might contain the key. Returns the index of
+        // the child (0: left, i > 0: entries[i - 1].child).
+        nodeoff_t search_child(const void* key,
+                               keylen_t keylen,
+                               comparator_t comp) const;
+
         // Print.
         void print() const;
 
+        // Get child at index.
+        uint64_t child(nodeoff_t idx) const;
+
+        // Get number of keys in the subtree of the child at index.
+        uint64_t child_count(nodeoff_t idx) const;
+
+        // Set number of keys in the subtree of the child at index.
+        void set_child_count(nodeoff_t idx, uint64_t count);
+
+        // Add to the number of keys in the subtree of the child at index.
+        void add_child_count(nodeoff_t idx, int64_t delta);
+
+        // Get number of keys in the subtrees of the children with index
+        // < idx.
+        uint64_t count_before(nodeoff_t idx) const;
+
+        // Get number of keys in the subtree.
+        uint64_t total_count() const;
+
       private:
         // Available space.
         nodeoff_t available() const;
@@ -66,7 +102,8 @@ namespace db {
                         nodeoff_t pos,
                         const void* key,
                         keylen_t keylen,
-                        uint64_t child);
+                        uint64_t child,
+                        uint64_t count);
 
         void fill_right(inner_node* right, nodeoff_t mid);
 
@@ -79,10 +116,62 @@ namespace db {
                     const void* key,
                     keylen_t keylen,
                     uint64_t child,
+                    uint64_t count,
                     void* upkey,
                     keylen_t& upkeylen);
     } __attribute__((packed));
 
+    inline nodeoff_t inner_node::search_child(const void* key,
+                                              keylen_t keylen,
+                                              comparator_t comp) const
+    {
+      nodeoff_t pos;
+      return search(key, keylen, comp, pos) ? pos + 1 : pos;
+    }
+
+    inline uint64_t inner_node::child(nodeoff_t idx) const
+    {
+      return (idx != 0) ? entries[idx - 1].child : left;
+    }
+
+    inline uint64_t inner_node::child_count(nodeoff_t idx) const
+    {
+      return (idx != 0) ? entries[idx - 1].count : leftcount;
+    }
+
+    inline void inner_node::set_child_count(nodeoff_t idx, uint64_t count)
+    {
+      if (idx != 0) {
+        entries[idx - 1].count = count;
+      } else {
+        leftcount = count;
+      }
+    }
+
+    inline void inner_node::add_child_count(nodeoff_t idx, int64_t delta)
+    {
+      if (idx != 0) {
+        entries[idx - 1].count += delta;
+      } else {
+        leftcount += delta;
+      }
+    }
+
+    inline uint64_t inner_node::count_before(nodeoff_t idx) const
+    {
+      uint64_t count = 0;
+      for (nodeoff_t i = 0; i < idx; i++) {
+        count += child_count(i);
+      }
+
+      return count;
+    }
+
+    inline uint64_t inner_node::total_count() const
+    {
+      return count_before(nentries + 1);
+    }
+
     inline nodeoff_t inner_node::available() const
     {
       return (nextoff -
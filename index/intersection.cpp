@@ -0,0 +1,67 @@
+#include <stdlib.h>
+#include "index/intersection.h"
+
+bool db::index::intersection::first()
+{
+  if (ninputs_ == 0) {
+    return false;
+  }
+
+  for (size_t i = 0; i < ninputs_; i++) {
+    if (!inputs_[i].idx->begin(inputs_[i].it)) {
+      return false;
+    }
+  }
+
+  return search();
+}
+
+bool db::index::intersection::next()
+{
+  // All the inputs are at the same key: move the first one.
+  return ((inputs_[0].idx->next(inputs_[0].it)) && (search()));
+}
+
+bool db::index::intersection::search()
+{
+  // Search the input with the greatest key.
+  size_t max = 0;
+  for (size_t i = 1; i < ninputs_; i++) {
+    if (compare(i, max) > 0) {
+      max = i;
+    }
+  }
+
+  // Number of consecutive inputs (ending at `max`) at the greatest key.
+  size_t count = 1;
+
+  size_t i = max;
+  while (count < ninputs_) {
+    if (++i == ninputs_) {
+      i = 0;
+    }
+
+    int ret;
+    if ((ret = compare(i, max)) < 0) {
+      // Seek to the greatest key.
+      if (!inputs_[i].idx->seek(inputs_[max].it.key(),
+                                inputs_[max].it.keylen(),
+                                comp_,
+                                inputs_[i].it)) {
+        return false;
+      }
+
+      ret = compare(i, max);
+    }
+
+    if (ret == 0) {
+      count++;
+    } else {
+      // New greatest key.
+      max = i;
+      count = 1;
+    }
+  }
+
+  return true;
+}
@@ -0,0 +1,109 @@
+#ifndef DB_INDEX_INTERSECTION_H
+#define DB_INDEX_INTERSECTION_H
+
+#include <stddef.h>
+#include "index/index.h"
+
+namespace db {
+  namespace index {
+    // Keys which are in all the inputs (leapfrog join): the input which is
+    // behind seeks to the greatest current key instead of stepping, so a
+    // selective intersection costs about the size of the smallest input.
+    //
+    // All the inputs must be sorted with the same comparator. The
+    // intersection is valid until one of the indexes is modified.
+    class intersection {
+      public:
+        // Maximum number of inputs.
+        static const size_t kMaxInputs = 16;
+
+        // Constructor.
+        intersection(comparator_t comp);
+
+        // Add input.
+        bool add(const index* idx);
+
+        // Position at the first key in all the inputs.
+        bool first();
+
+        // Position at the next key in all the inputs.
+        bool next();
+
+        // Get current key.
+        const void* key() const;
+
+        // Get current key length.
+        keylen_t keylen() const;
+
+        // Get the iterator of the input (positioned at the current key).
+        const index::iterator& input(size_t i) const;
+
+        // Get number of inputs.
+        size_t ninputs() const;
+
+      private:
+        struct cursor {
+          const index* idx;
+          index::iterator it;
+        };
+
+        comparator_t comp_;
+
+        cursor inputs_[kMaxInputs];
+        size_t ninputs_;
+
+        // Move the inputs forward until they are all at the same key.
+        bool search();
+
+        // Compare the current keys of two inputs.
+        int compare(size_t i, size_t j) const;
+    };
+
+    inline intersection::intersection(comparator_t comp)
+      : comp_(comp),
+        ninputs_(0)
+    {
+    }
+
+    inline bool intersection::add(const index* idx)
+    {
+      if (ninputs_ < kMaxInputs) {
+        inputs_[ninputs_++].idx = idx;
+        return true;
+      }
+
+      return false;
+    }
+
+    inline const void* intersection::key() const
+    {
+      return inputs_[0].it.key();
+    }
+
+    inline keylen_t intersection::keylen() const
+    {
+      return inputs_[0].it.keylen();
+    }
+
+    inline const index::iterator& intersection::input(size_t i) const
+    {
+      return inputs_[i].it;
+    }
+
+    inline size_t intersection::ninputs() const
+    {
+      return ninputs_;
+    }
+
+    inline int intersection::compare(size_t i, size_t j) const
+    {
+      return db::index::compare(comp_,
+                                inputs_[i].it.key(),
+                                inputs_[i].it.keylen(),
+                                inputs_[j].it.key(),
+                                inputs_[j].it.keylen());
+    }
+  }
+}
+
+#endif // DB_INDEX_INTERSECTION_H
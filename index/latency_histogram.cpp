@@ -0,0 +1,103 @@
+#include <string.h>
+#include "index/latency_histogram.h"
+
+void db::index::latency_histogram::record(uint64_t value)
+{
+  __atomic_fetch_add(&buckets_[bucket(value)], 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&count_, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&sum_, value, __ATOMIC_RELAXED);
+
+  uint64_t max = __atomic_load_n(&max_, __ATOMIC_RELAXED);
+  while ((value > max) &&
+         (!__atomic_compare_exchange_n(&max_,
+                                       &max,
+                                       value,
+                                       true,
+                                       __ATOMIC_RELAXED,
+                                       __ATOMIC_RELAXED)));
+}
+
+void db::index::latency_histogram::add(const latency_histogram& other)
+{
+  for (size_t i = 0; i < kBuckets; i++) {
+    uint64_t n;
+    if ((n = __atomic_load_n(&other.buckets_[i], __ATOMIC_RELAXED)) != 0) {
+      __atomic_fetch_add(&buckets_[i], n, __ATOMIC_RELAXED);
+    }
+  }
+
+  __atomic_fetch_add(&count_, other.count(), __ATOMIC_RELAXED);
+  __atomic_fetch_add(&sum_, other.sum(), __ATOMIC_RELAXED);
+
+  uint64_t value = other.max();
+  uint64_t max = __atomic_load_n(&max_, __ATOMIC_RELAXED);
+  while ((value > max) &&
+         (!__atomic_compare_exchange_n(&max_,
+                                       &max,
+                                       value,
+                                       true,
+                                       __ATOMIC_RELAXED,
+                                       __ATOMIC_RELAXED)));
+}
+
+void db::index::latency_histogram::clear()
+{
+  memset(buckets_, 0, sizeof(buckets_));
+
+  count_ = 0;
+  sum_ = 0;
+  max_ = 0;
+}
+
+uint64_t db::index::latency_histogram::percentile(double p) const
+{
+  uint64_t n;
+  if ((n = count()) == 0) {
+    return 0;
+  }
+
+  // Number of values up to the percentile (at least 1).
+  uint64_t target = static_cast<uint64_t>(p * n);
+  if (target == 0) {
+    target = 1;
+  }
+
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kBuckets - 1; i++) {
+    if ((seen += __atomic_load_n(&buckets_[i], __ATOMIC_RELAXED)) >= target) {
+      // Highest value of the bucket (but not above the maximum).
+      uint64_t value = lowest(i + 1) - 1;
+      return (value < max()) ? value : max();
+    }
+  }
+
+  return max();
+}
+
+size_t db::index::latency_histogram::bucket(uint64_t value)
+{
+  // Values which don't need to be grouped.
+  if (value < 2 * kSubBuckets) {
+    return static_cast<size_t>(value);
+  }
+
+  // Shift which leaves kSubBucketBits + 1 bits.
+  unsigned shift = (63 - __builtin_clzll(value)) - kSubBucketBits;
+
+  if (shift > kMaxBits - kSubBucketBits - 1) {
+    return kBuckets - 1;
+  }
+
+  return (shift * kSubBuckets) + static_cast<size_t>(value >> shift);
+}
+
+uint64_t db::index::latency_histogram::lowest(size_t bucket)
+{
+  if (bucket < 2 * kSubBuckets) {
+    return bucket;
+  }
+
+  unsigned shift = static_cast<unsigned>(bucket / kSubBuckets) - 1;
+
+  return static_cast<uint64_t>(bucket - (shift * kSubBuckets)) << shift;
+}
@@ -0,0 +1,86 @@
+#ifndef DB_INDEX_LATENCY_HISTOGRAM_H
+#define DB_INDEX_LATENCY_HISTOGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace db {
+  namespace index {
+    // Histogram of latencies (in ns) with a bounded relative error: the
+    // values are grouped by their power of 2, each one split into
+    // kSubBuckets buckets (an error of at most 1 / kSubBuckets).
+    class latency_histogram {
+      public:
+        // Constructor.
+        latency_histogram();
+
+        // Add value (relaxed atomic operations: the histogram can be added
+        // to and read by several threads).
+        void record(uint64_t value);
+
+        // Add the values of another histogram.
+        void add(const latency_histogram& other);
+
+        // Remove the values.
+        void clear();
+
+        // Get number of values.
+        uint64_t count() const;
+
+        // Get sum of the values.
+        uint64_t sum() const;
+
+        // Get maximum value.
+        uint64_t max() const;
+
+        // Get the value below which there are the fraction `p` (0 .. 1) of
+        // the values (0 if there are no values).
+        uint64_t percentile(double p) const;
+
+      private:
+        static const unsigned kSubBucketBits = 5;
+        static const uint64_t kSubBuckets = 1 << kSubBucketBits;
+
+        // Values up to 2^kMaxBits - 1 ns (68 s); the greater ones go to the
+        // last bucket.
+        static const unsigned kMaxBits = 36;
+
+        static const size_t kBuckets = (kMaxBits - kSubBucketBits + 1) *
+                                       kSubBuckets;
+
+        uint64_t buckets_[kBuckets];
+
+        uint64_t count_;
+        uint64_t sum_;
+        uint64_t max_;
+
+        // Get bucket of the value.
+        static size_t bucket(uint64_t value);
+
+        // Get smallest value of the bucket.
+        static uint64_t lowest(size_t bucket);
+    };
+
+    inline latency_histogram::latency_histogram()
+    {
+      clear();
+    }
+
+    inline uint64_t latency_histogram::count() const
+    {
+      return __atomic_load_n(&count_, __ATOMIC_RELAXED);
+    }
+
+    inline uint64_t latency_histogram::sum() const
+    {
+      return __atomic_load_n(&sum_, __ATOMIC_RELAXED);
+    }
+
+    inline uint64_t latency_histogram::max() const
+    {
+      return __atomic_load_n(&max_, __ATOMIC_RELAXED);
+    }
+  }
+}
+
+#endif // DB_INDEX_LATENCY_HISTOGRAM_H
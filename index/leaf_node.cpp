@@ -13,10 +13,15 @@ bool db::index::leaf_node::add(const void* key,
     // If the key is not in the node...
     nodeoff_t pos;
     if (!search(key, keylen, comp, pos)) {
-      return add(key, keylen, dataoff, pos);
+      return add(key, keylen, value_type::kExternal, NULL, dataoff, pos);
     } else {
-      entries[pos].dataoff = dataoff;
-      entries[pos].deleted = 0;
+      replace(pos, value_type::kExternal, NULL, dataoff);
+
+      // If the key had been deleted...
+      if (erased(pos)) {
+        entries[pos].deleted = 0;
+        nlive++;
+      }
 
       return true;
     }
@@ -27,15 +32,24 @@ bool db::index::leaf_node::add(const void* key,
 
 bool db::index::leaf_node::add(const void* key,
                                keylen_t keylen,
+                               value_type type,
+                               const void* value,
                                uint64_t dataoff,
                                nodeoff_t pos)
 {
-  // If the entry + key fits in the node...
-  if (sizeof(entry) + keylen <= available()) {
-    // Copy key.
-    memcpy(reinterpret_cast<uint8_t*>(this) + nextoff - keylen, key, keylen);
+  nodeoff_t len = size(keylen, type, dataoff);
+
+  // If the entry + key + value fits in the node...
+  if (reserve(sizeof(entry) + len)) {
+    // Copy key and value.
+    nextoff -= len;
 
-    nextoff -= keylen;
+    copy(reinterpret_cast<uint8_t*>(this) + nextoff,
+         key,
+         keylen,
+         type,
+         value,
+         dataoff);
 
     // If not the last position...
     if (pos < nentries) {
@@ -47,10 +61,12 @@ bool db::index::leaf_node::add(const void* key,
     // Fill entry.
     entries[pos].keyoff = nextoff;
     entries[pos].keylen = keylen;
+    entries[pos].type = static_cast<keylen_t>(type);
     entries[pos].dataoff = dataoff;
     entries[pos].deleted = 0;
 
     nentries++;
+    nlive++;
 
     return true;
   }
@@ -58,6 +74,61 @@ bool db::index::leaf_node::add(const void* key,
   return false;
 }
 
+bool db::index::leaf_node::replace(nodeoff_t pos,
+                                   value_type type,
+                                   const void* value,
+                                   uint64_t dataoff)
+{
+  struct entry* e = entries + pos;
+
+  nodeoff_t len = size(e->keylen, type, dataoff);
+
+  // If the new value doesn't fit in the place of the current one...
+  if (len > size(e)) {
+    // Make room for the key and the new value.
+    if (!reserve(len)) {
+      return false;
+    }
+
+    // Move key.
+    nextoff -= len;
+
+    memcpy(reinterpret_cast<uint8_t*>(this) + nextoff,
+           reinterpret_cast<const uint8_t*>(this) + e->keyoff,
+           e->keylen);
+
+    e->keyoff = nextoff;
+  }
+
+  // Copy value.
+  if (stored(type)) {
+    memcpy(reinterpret_cast<uint8_t*>(this) + e->keyoff + e->keylen,
+           value,
+           dataoff);
+  }
+
+  e->type = static_cast<keylen_t>(type);
+  e->dataoff = dataoff;
+
+  return true;
+}
+
+void db::index::leaf_node::remove(nodeoff_t pos)
+{
+  if (!erased(pos)) {
+    nlive--;
+  }
+
+  // If not the last position...
+  if (pos + 1 < nentries) {
+    memmove(&entries[pos],
+            &entries[pos + 1],
+            (nentries - pos - 1) * sizeof(entry));
+  }
+
+  nentries--;
+}
+
 bool db::index::leaf_node::erase(const void* key,
                                  keylen_t keylen,
                                  comparator_t comp)
@@ -69,6 +140,7 @@ bool db::index::leaf_node::erase(const void* key,
     if ((search(key, keylen, comp, pos)) && (!erased(pos))) {
       // Mark the key as deleted.
       entries[pos].deleted = 1;
+      nlive--;
 
       return true;
     }
@@ -83,8 +155,15 @@ void db::index::leaf_node::split(uint64_t leftoff,
                                  nodeoff_t pos,
                                  const void* key,
                                  keylen_t keylen,
+                                 value_type type,
+                                 const void* value,
                                  uint64_t dataoff)
 {
+  // `mid` is the number of entries (including the new one) which stay in
+  // the current node. It is chosen so that both nodes use about the same
+  // number of bytes; when all the entries have the same size,
+  // mid = (nentries + 1) / 2.
+  //
   // Case 1: Current number of entries is odd:
   //
   //      pos:    0    1    2    3   4
@@ -93,7 +172,7 @@ void db::index::leaf_node::split(uint64_t leftoff,
   //           +----+----+----+----+----+
   //
   //   nentries = 5
-  //   mid = (nentries + 1) / 2 = (5 + 1) / 2 = 6 / 2 = 3
+  //   mid = 3
   //
   //
   //   Case 1.1: Insert: 25 => pos = 2
@@ -146,7 +225,7 @@ void db::index::leaf_node::split(uint64_t leftoff,
   //           +----+----+----+----+
   //
   //   nentries = 4
-  //   mid = (nentries + 1) / 2 = (4 + 1) / 2 = 5 / 2 = 2
+  //   mid = 2
   //
   //
   //   Case 2.1: Insert: 25 => pos = 2
@@ -190,10 +269,50 @@ void db::index::leaf_node::split(uint64_t leftoff,
   //    Copy to right node from position mid - 1 (position 1)
   //
 
-  nodeoff_t mid = (nentries + 1) / 2;
+  nodeoff_t mid = 0;
+
+  // Calculate the number of bytes used by all the entries.
+  nodeoff_t newsize = sizeof(entry) + size(keylen, type, dataoff);
+
+  size_t total = newsize;
+  for (nodeoff_t i = 0; i < nentries; i++) {
+    total += sizeof(entry) + size(entries + i);
+  }
+
+  // Count the entries whose middle lies in the first half.
+  size_t left = 0;
+  for (nodeoff_t i = 0; i <= nentries; i++) {
+    nodeoff_t len = (i == pos) ? newsize :
+                    sizeof(entry) + size(entries + ((i < pos) ? i : i - 1));
+
+    if (2 * left + len > total) {
+      break;
+    }
+
+    left += len;
+    mid++;
+  }
+
+  if (mid == 0) {
+    mid = 1;
+  } else if (mid > nentries) {
+    mid = nentries;
+  }
+
+  // Number of entries not marked as deleted after the split.
+  nodeoff_t live = nlive + 1;
 
   if (pos >= mid) {
-    fill_right(leftoff, rightoff, right, mid, pos - mid, key, keylen, dataoff);
+    fill_right(leftoff,
+               rightoff,
+               right,
+               mid,
+               pos - mid,
+               key,
+               keylen,
+               type,
+               value,
+               dataoff);
 
     // Defragment current node.
     defrag();
@@ -201,8 +320,10 @@ void db::index::leaf_node::split(uint64_t leftoff,
     fill_right(leftoff, rightoff, right, mid - 1);
 
     // Defragment current node and add key.
-    defrag(pos, key, keylen, dataoff);
+    defrag(pos, key, keylen, type, value, dataoff);
   }
+
+  nlive = live - right->nlive;
 }
 
 bool db::index::leaf_node::search(const void* key,
@@ -216,10 +337,12 @@ bool db::index::leaf_node::search(const void* key,
   while (i <= j) {
     int mid = (i + j) / 2;
 
-    int ret = comp(key,
-                   keylen,
-                   reinterpret_cast<const uint8_t*>(this) + entries[mid].keyoff,
-                   entries[mid].keylen);
+    const void* k = reinterpret_cast<const uint8_t*>(this) +
+                    entries[mid].keyoff;
+
+    int ret = compare(comp, key, keylen, k, entries[mid].keylen);
+
+    DB_INDEX_COUNT(comparisons, 1);
 
     if (ret < 0) {
       j = mid - 1;
@@ -241,12 +364,37 @@ void db::index::leaf_node::print() const
   printf("Index:\n");
 
   for (nodeoff_t i = 0; i < nentries; i++) {
-    printf("\t[%03u] %sLength: %u, key: '%.*s'.\n",
-           i + 1,
-           erased(i) ? "[Deleted] " : "",
-           keylen(i),
-           keylen(i),
-           reinterpret_cast<const char*>(key(i)));
+    if (type(i) == value_type::kValueLog) {
+      printf("\t[%03u] %sLength: %u, key: '%.*s', value in the value log.\n",
+             i + 1,
+             erased(i) ? "[Deleted] " : "",
+             keylen(i),
+             keylen(i),
+             reinterpret_cast<const char*>(key(i)));
+    } else if (type(i) == value_type::kPostings) {
+      printf("\t[%03u] %sLength: %u, key: '%.*s', posting list.\n",
+             i + 1,
+             erased(i) ? "[Deleted] " : "",
+             keylen(i),
+             keylen(i),
+             reinterpret_cast<const char*>(key(i)));
+    } else if (stored(type(i))) {
+      printf("\t[%03u] %sLength: %u, key: '%.*s', value length: %u.\n",
+             i + 1,
+             erased(i) ? "[Deleted] " : "",
+             keylen(i),
+             keylen(i),
+             reinterpret_cast<const char*>(key(i)),
+             value_length(i));
+    } else {
+      printf("\t[%03u] %sLength: %u, key: '%.*s', data offset: %lu.\n",
+             i + 1,
+             erased(i) ? "[Deleted] " : "",
+             keylen(i),
+             keylen(i),
+             reinterpret_cast<const char*>(key(i)),
+             data_offset(i));
+    }
   }
 }
 
@@ -257,6 +405,8 @@ void db::index::leaf_node::fill_right(uint64_t leftoff,
                                       nodeoff_t pos,
                                       const void* key,
                                       keylen_t keylen,
+                                      value_type type,
+                                      const void* value,
                                       uint64_t dataoff)
 {
   // Number of entries in the right node.
@@ -274,11 +424,14 @@ void db::index::leaf_node::fill_right(uint64_t leftoff,
   // Pointer to the current entry in the right node.
   struct entry* dest = right->entries + (n - 1);
 
+  // Number of entries in the right node not marked as deleted.
+  nodeoff_t live = 0;
+
   // Copy keys from the current node to the right node in the range
   // [entries[mid + pos], entries[nentries]).
   nodeoff_t off;
   for (off = kNodeSize; src >= posentry; src--, dest--) {
-    keylen_t len = src->keylen;
+    nodeoff_t len = size(src);
     off -= len;
 
     memcpy(reinterpret_cast<uint8_t*>(right) + off,
@@ -286,26 +439,37 @@ void db::index::leaf_node::fill_right(uint64_t leftoff,
            len);
 
     dest->keyoff = off;
-    dest->keylen = len;
+    dest->keylen = src->keylen;
+    dest->type = src->type;
     dest->dataoff = src->dataoff;
     dest->deleted = src->deleted;
+
+    live += !src->deleted;
   }
 
-  // Copy key.
-  off -= keylen;
-  memcpy(reinterpret_cast<uint8_t*>(right) + off, key, keylen);
+  // Copy key and value.
+  off -= size(keylen, type, dataoff);
+  copy(reinterpret_cast<uint8_t*>(right) + off,
+       key,
+       keylen,
+       type,
+       value,
+       dataoff);
 
   dest->keyoff = off;
   dest->keylen = keylen;
+  dest->type = static_cast<keylen_t>(type);
   dest->dataoff = dataoff;
   dest->deleted = 0;
 
+  live++;
+
   dest--;
 
   // Copy keys from the current node to the right node in the range
   // [entries[mid], entries[mid + pos]).
   for (; src >= midentry; src--, dest--) {
-    keylen_t len = src->keylen;
+    nodeoff_t len = size(src);
     off -= len;
 
     memcpy(reinterpret_cast<uint8_t*>(right) + off,
@@ -313,9 +477,12 @@ void db::index::leaf_node::fill_right(uint64_t leftoff,
            len);
 
     dest->keyoff = off;
-    dest->keylen = len;
+    dest->keylen = src->keylen;
+    dest->type = src->type;
     dest->dataoff = src->dataoff;
     dest->deleted = src->deleted;
+
+    live += !src->deleted;
   }
 
   right->t = t;
@@ -327,6 +494,7 @@ void db::index::leaf_node::fill_right(uint64_t leftoff,
   right->nextoff = off;
 
   right->nentries = n;
+  right->nlive = live;
 
   nentries = mid;
 
@@ -350,21 +518,27 @@ void db::index::leaf_node::fill_right(uint64_t leftoff,
   // Pointer to the current entry in the right node.
   struct entry* dest = right->entries + (n - 1);
 
+  // Number of entries in the right node not marked as deleted.
+  nodeoff_t live = 0;
+
   // Copy keys from the current node to the right node in the range
   // [entries[mid], entries[nentries]).
   nodeoff_t off;
   for (off = kNodeSize; src >= midentry; src--, dest--) {
-    keylen_t keylen = src->keylen;
-    off -= keylen;
+    nodeoff_t len = size(src);
+    off -= len;
 
     memcpy(reinterpret_cast<uint8_t*>(right) + off,
            reinterpret_cast<const uint8_t*>(this) + src->keyoff,
-           keylen);
+           len);
 
     dest->keyoff = off;
-    dest->keylen = keylen;
+    dest->keylen = src->keylen;
+    dest->type = src->type;
     dest->dataoff = src->dataoff;
     dest->deleted = src->deleted;
+
+    live += !src->deleted;
   }
 
   right->t = t;
@@ -376,6 +550,7 @@ void db::index::leaf_node::fill_right(uint64_t leftoff,
   right->nextoff = off;
 
   right->nentries = n;
+  right->nlive = live;
 
   nentries -= n;
 
@@ -384,17 +559,20 @@ void db::index::leaf_node::fill_right(uint64_t leftoff,
 
 void db::index::leaf_node::defrag()
 {
+  DB_INDEX_COUNT(defrags, 1);
+  DB_INDEX_PROBE3(leaf_defrag, this, parent, nentries);
+
   // Pointer to the current entry in the current node.
   struct entry* src = entries + (nentries - 1);
 
   uint8_t data[kNodeSize];
   for (nextoff = kNodeSize; src >= entries; src--) {
-    keylen_t keylen = src->keylen;
-    nextoff -= keylen;
+    nodeoff_t len = size(src);
+    nextoff -= len;
 
     memcpy(data + nextoff,
            reinterpret_cast<const uint8_t*>(this) + src->keyoff,
-           keylen);
+           len);
 
     src->keyoff = nextoff;
   }
@@ -407,8 +585,13 @@ void db::index::leaf_node::defrag()
 void db::index::leaf_node::defrag(nodeoff_t pos,
                                   const void* key,
                                   keylen_t keylen,
+                                  value_type type,
+                                  const void* value,
                                   uint64_t dataoff)
 {
+  DB_INDEX_COUNT(defrags, 1);
+  DB_INDEX_PROBE3(leaf_defrag, this, parent, nentries);
+
   // Pointer to the entry where the key will be inserted in the current node.
   const struct entry* posentry = entries + pos;
 
@@ -421,7 +604,7 @@ void db::index::leaf_node::defrag(nodeoff_t pos,
   // Defragment keys in the range [entries[pos], entries[nentries]).
   uint8_t data[kNodeSize];
   for (nextoff = kNodeSize; src >= posentry; src--, dest--) {
-    keylen_t len = src->keylen;
+    nodeoff_t len = size(src);
     nextoff -= len;
 
     memcpy(data + nextoff,
@@ -429,17 +612,19 @@ void db::index::leaf_node::defrag(nodeoff_t pos,
            len);
 
     dest->keyoff = nextoff;
-    dest->keylen = len;
+    dest->keylen = src->keylen;
+    dest->type = src->type;
     dest->dataoff = src->dataoff;
     dest->deleted = src->deleted;
   }
 
-  // Copy key.
-  nextoff -= keylen;
-  memcpy(data + nextoff, key, keylen);
+  // Copy key and value.
+  nextoff -= size(keylen, type, dataoff);
+  copy(data + nextoff, key, keylen, type, value, dataoff);
 
   dest->keyoff = nextoff;
   dest->keylen = keylen;
+  dest->type = static_cast<keylen_t>(type);
   dest->dataoff = dataoff;
   dest->deleted = 0;
 
@@ -447,7 +632,7 @@ void db::index::leaf_node::defrag(nodeoff_t pos,
 
   // Defragment keys in the range [entries[0], entries[pos]).
   for (; src >= entries; src--, dest--) {
-    keylen_t len = src->keylen;
+    nodeoff_t len = size(src);
     nextoff -= len;
 
     memcpy(data + nextoff,
@@ -455,7 +640,8 @@ void db::index::leaf_node::defrag(nodeoff_t pos,
            len);
 
     dest->keyoff = nextoff;
-    dest->keylen = len;
+    dest->keylen = src->keylen;
+    dest->type = src->type;
     dest->dataoff = src->dataoff;
     dest->deleted = src->deleted;
   }
@@ -466,3 +652,29 @@ void db::index::leaf_node::defrag(nodeoff_t pos,
 
   nentries++;
 }
+
+nodeoff_t db::index::leaf_node::reclaimable() const
+{
+  nodeoff_t used = 0;
+  for (nodeoff_t i = 0; i < nentries; i++) {
+    used += size(entries + i);
+  }
+
+  return (kNodeSize - nextoff) - used;
+}
+
+bool db::index::leaf_node::reserve(nodeoff_t size)
+{
+  // If there is space enough...
+  if (size <= available()) {
+    return true;
+  }
+
+  // If defragmenting the node would make room...
+  if (size <= available() + reclaimable()) {
+    defrag();
+    return true;
+  }
+
+  return false;
+}
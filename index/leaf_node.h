@@ -2,6 +2,7 @@
 #define DB_INDEX_LEAF_NODE_H
 
 #include <stddef.h>
+#include <string.h>
 #include "node.h"
 
 namespace db {
@@ -14,24 +15,45 @@ namespace db {
         // Offset of the next node.
         uint64_t next;
 
+        // Number of entries which are not marked as deleted.
+        nodeoff_t nlive;
+
+        // Value type.
+        enum class value_type : uint8_t {
+          kExternal, // dataoff is the offset of the data (e.g. in a file).
+          kInline, // The value is stored after the key, dataoff is its length.
+          kValueLog, // A pointer to the value in the value log is stored
+                     // after the key, dataoff is the length of the pointer.
+          kPostings // A posting list (or a pointer to its posting nodes) is
+                    // stored after the key, dataoff is its length.
+        };
+
         struct entry {
           // Offset of the key in the node.
           nodeoff_t keyoff;
 
           // Length of the key.
-          keylen_t keylen:(sizeof(keylen_t) * 8) - 1;
+          keylen_t keylen:(sizeof(keylen_t) * 8) - 3;
+
+          // Value type.
+          keylen_t type:2;
 
           // Deleted?
           keylen_t deleted:1;
 
-          // Offset of the data.
+          // Offset of the data (value_type::kExternal) or length of what is
+          // stored after the key (other value types).
           uint64_t dataoff;
         } __attribute__((packed));
 
         // Dynamic array of entries.
         entry entries[1];
 
-        // The keys are stored starting from the end of the node.
+        // The keys (followed by the inline values) are stored starting from
+        // the end of the node.
+
+        // Constructor.
+        leaf_node();
 
         // Add.
         bool add(const void* key,
@@ -41,9 +63,21 @@ namespace db {
 
         bool add(const void* key,
                  keylen_t keylen,
+                 value_type type,
+                 const void* value,
                  uint64_t dataoff,
                  nodeoff_t pos);
 
+        // Replace the value at position (if it fits in the node).
+        bool replace(nodeoff_t pos,
+                     value_type type,
+                     const void* value,
+                     uint64_t dataoff);
+
+        // Remove the entry at position (the space used by the key and the
+        // value is reclaimed by the next defragmentation).
+        void remove(nodeoff_t pos);
+
         // Erase (marks the key as deleted).
         bool erase(const void* key, keylen_t keylen, comparator_t comp);
 
@@ -54,6 +88,8 @@ namespace db {
                    nodeoff_t pos,
                    const void* key,
                    keylen_t keylen,
+                   value_type type,
+                   const void* value,
                    uint64_t dataoff);
 
         // Search.
@@ -77,10 +113,57 @@ namespace db {
         // Get data offset.
         uint64_t data_offset(nodeoff_t pos) const;
 
+        // Get value type.
+        value_type type(nodeoff_t pos) const;
+
+        // Get what is stored after the key (the inline value or the pointer
+        // to the value log, NULL if nothing is stored).
+        const void* value(nodeoff_t pos) const;
+
+        // Get length of what is stored after the key.
+        nodeoff_t value_length(nodeoff_t pos) const;
+
+        // Get number of bytes which would be reclaimed by defragmenting the
+        // node.
+        nodeoff_t reclaimable() const;
+
+        // Find the first entry not marked as deleted at position >= pos.
+        bool next_live(nodeoff_t& pos) const;
+
+        // Find the last entry not marked as deleted at position < pos.
+        bool previous_live(nodeoff_t& pos) const;
+
+        // Get number of entries not marked as deleted at position < pos.
+        nodeoff_t count_live(nodeoff_t pos) const;
+
+        // Find the entry not marked as deleted at position `rank` among the
+        // entries not marked as deleted.
+        bool select_live(uint64_t rank, nodeoff_t& pos) const;
+
       private:
         // Available space.
         nodeoff_t available() const;
 
+        // Is something stored after the key?
+        static bool stored(value_type type);
+
+        // Get number of bytes used by the key and the value.
+        static nodeoff_t size(keylen_t keylen,
+                              value_type type,
+                              uint64_t dataoff);
+        static nodeoff_t size(const struct entry* e);
+
+        // Copy key and value to `dest`.
+        static void copy(uint8_t* dest,
+                         const void* key,
+                         keylen_t keylen,
+                         value_type type,
+                         const void* value,
+                         uint64_t dataoff);
+
+        // Make room for `size` bytes (defragmenting the node if needed).
+        bool reserve(nodeoff_t size);
+
         // Fill right node.
         void fill_right(uint64_t leftoff, // Offset of the node in disk.
                         uint64_t rightoff, // Offset of the right node in disk.
@@ -89,6 +172,8 @@ namespace db {
                         nodeoff_t pos,
                         const void* key,
                         keylen_t keylen,
+                        value_type type,
+                        const void* value,
                         uint64_t dataoff);
 
         void fill_right(uint64_t leftoff, // Offset of the node in disk.
@@ -103,9 +188,16 @@ namespace db {
         void defrag(nodeoff_t pos,
                     const void* key,
                     keylen_t keylen,
+                    value_type type,
+                    const void* value,
                     uint64_t dataoff);
     } __attribute__((packed));
 
+    inline leaf_node::leaf_node()
+      : nlive(0)
+    {
+    }
+
     inline const void* leaf_node::key(nodeoff_t pos) const
     {
       return reinterpret_cast<const uint8_t*>(this) + entries[pos].keyoff;
@@ -126,11 +218,152 @@ namespace db {
       return entries[pos].dataoff;
     }
 
+    inline leaf_node::value_type leaf_node::type(nodeoff_t pos) const
+    {
+      return static_cast<value_type>(entries[pos].type);
+    }
+
+    inline const void* leaf_node::value(nodeoff_t pos) const
+    {
+      return stored(type(pos)) ?
+               reinterpret_cast<const uint8_t*>(this) +
+               entries[pos].keyoff +
+               entries[pos].keylen :
+               NULL;
+    }
+
+    inline nodeoff_t leaf_node::value_length(nodeoff_t pos) const
+    {
+      return stored(type(pos)) ? static_cast<nodeoff_t>(entries[pos].dataoff) :
+                                 0;
+    }
+
+    inline bool leaf_node::next_live(nodeoff_t& pos) const
+    {
+      // If no entry is marked as deleted...
+      if (nlive == nentries) {
+        return (pos < nentries);
+      }
+
+      // If there are entries not marked as deleted...
+      if (nlive > 0) {
+        for (nodeoff_t i = pos; i < nentries; i++) {
+          if (!erased(i)) {
+            pos = i;
+            return true;
+          }
+
+          DB_INDEX_COUNT(deleted_skipped, 1);
+        }
+      } else if (pos < nentries) {
+        DB_INDEX_COUNT(deleted_skipped, nentries - pos);
+      }
+
+      return false;
+    }
+
+    inline bool leaf_node::previous_live(nodeoff_t& pos) const
+    {
+      // If no entry is marked as deleted...
+      if (nlive == nentries) {
+        if (pos > 0) {
+          pos--;
+          return true;
+        }
+
+        return false;
+      }
+
+      // If there are entries not marked as deleted...
+      if (nlive > 0) {
+        for (nodeoff_t i = pos; i > 0; i--) {
+          if (!erased(i - 1)) {
+            pos = i - 1;
+            return true;
+          }
+
+          DB_INDEX_COUNT(deleted_skipped, 1);
+        }
+      } else {
+        DB_INDEX_COUNT(deleted_skipped, pos);
+      }
+
+      return false;
+    }
+
+    inline nodeoff_t leaf_node::count_live(nodeoff_t pos) const
+    {
+      // If no entry is marked as deleted...
+      if (nlive == nentries) {
+        return pos;
+      }
+
+      nodeoff_t count = 0;
+      for (nodeoff_t i = 0; i < pos; i++) {
+        count += !erased(i);
+      }
+
+      return count;
+    }
+
+    inline bool leaf_node::select_live(uint64_t rank, nodeoff_t& pos) const
+    {
+      if (rank < nlive) {
+        // If no entry is marked as deleted...
+        if (nlive == nentries) {
+          pos = static_cast<nodeoff_t>(rank);
+          return true;
+        }
+
+        for (nodeoff_t i = 0; i < nentries; i++) {
+          if (!erased(i)) {
+            if (rank-- == 0) {
+              pos = i;
+              return true;
+            }
+          }
+        }
+      }
+
+      return false;
+    }
+
     inline nodeoff_t leaf_node::available() const
     {
       return (nextoff -
               (offsetof(leaf_node, entries) + (nentries * sizeof(entry))));
     }
+
+    inline bool leaf_node::stored(value_type type)
+    {
+      return (type != value_type::kExternal);
+    }
+
+    inline nodeoff_t leaf_node::size(keylen_t keylen,
+                                     value_type type,
+                                     uint64_t dataoff)
+    {
+      return stored(type) ? keylen + static_cast<nodeoff_t>(dataoff) : keylen;
+    }
+
+    inline nodeoff_t leaf_node::size(const struct entry* e)
+    {
+      return size(e->keylen, static_cast<value_type>(e->type), e->dataoff);
+    }
+
+    inline void leaf_node::copy(uint8_t* dest,
+                                const void* key,
+                                keylen_t keylen,
+                                value_type type,
+                                const void* value,
+                                uint64_t dataoff)
+    {
+      memcpy(dest, key, keylen);
+
+      if (stored(type)) {
+        memcpy(dest + keylen, value, dataoff);
+      }
+    }
   }
 }
 
@@ -0,0 +1,196 @@
+#include <stdlib.h>
+#include "index/learned_model.h"
+
+db::index::learned_model::learned_model()
+  : leaves_(NULL),
+    nleaves_(0),
+    leaves_size_(0),
+    segments_(NULL),
+    nsegments_(0),
+    error_(0)
+{
+}
+
+db::index::learned_model::~learned_model()
+{
+  clear();
+}
+
+bool db::index::learned_model::add(uint64_t key, uint64_t off)
+{
+  // If the array is full...
+  if (nleaves_ == leaves_size_) {
+    size_t size = (leaves_size_ > 0) ? leaves_size_ * 2 : 1024;
+
+    leaf* tmp;
+    if ((tmp = static_cast<leaf*>(realloc(leaves_, size * sizeof(leaf)))) ==
+        NULL) {
+      return false;
+    }
+
+    leaves_ = tmp;
+    leaves_size_ = size;
+  }
+
+  leaves_[nleaves_].key = key;
+  leaves_[nleaves_].off = off;
+
+  nleaves_++;
+
+  return true;
+}
+
+bool db::index::learned_model::fit(unsigned error)
+{
+  free(segments_);
+  segments_ = NULL;
+  nsegments_ = 0;
+
+  error_ = error;
+
+  if (nleaves_ == 0) {
+    return true;
+  }
+
+  size_t size = 0;
+
+  // Shrinking cone: a segment grows while there is a slope which keeps all
+  // its leaf nodes within `error` positions of the prediction.
+  size_t i = 0;
+  while (i < nleaves_) {
+    double lo = 0;
+    double hi = -1; // No upper bound yet.
+
+    size_t j;
+    for (j = i + 1; j < nleaves_; j++) {
+      double dx = static_cast<double>(leaves_[j].key - leaves_[i].key);
+      double dy = static_cast<double>(j - i);
+
+      // Same key as the first one of the segment?
+      if (dx == 0) {
+        if (dy > error) {
+          break;
+        }
+
+        continue;
+      }
+
+      double l = (dy - error) / dx;
+      double h = (dy + error) / dx;
+
+      if (l < lo) {
+        l = lo;
+      }
+
+      if ((hi >= 0) && (h > hi)) {
+        h = hi;
+      }
+
+      if (l > h) {
+        break;
+      }
+
+      lo = l;
+      hi = h;
+    }
+
+    // If the array is full...
+    if (nsegments_ == size) {
+      size = (size > 0) ? size * 2 : 64;
+
+      segment* tmp;
+      if ((tmp = static_cast<segment*>(
+                   realloc(segments_, size * sizeof(segment))
+                 )) == NULL) {
+        return false;
+      }
+
+      segments_ = tmp;
+    }
+
+    segments_[nsegments_].key = leaves_[i].key;
+    segments_[nsegments_].pos = i;
+    segments_[nsegments_].slope = (hi >= 0) ? (lo + hi) / 2 : 0;
+
+    nsegments_++;
+
+    i = j;
+  }
+
+  return true;
+}
+
+bool db::index::learned_model::find(uint64_t key, uint64_t& off) const
+{
+  if (nsegments_ == 0) {
+    return false;
+  }
+
+  // Search the last segment whose first key is <= key.
+  size_t i = 0;
+  size_t j = nsegments_;
+
+  while (i < j) {
+    size_t mid = (i + j) / 2;
+
+    if (key < segments_[mid].key) {
+      j = mid;
+    } else {
+      i = mid + 1;
+    }
+  }
+
+  // If the key is smaller than the first key...
+  if (i == 0) {
+    off = leaves_[0].off;
+    return true;
+  }
+
+  const segment& s = segments_[i - 1];
+
+  // Last position of the segment.
+  size_t last = (i < nsegments_) ? segments_[i].pos - 1 : nleaves_ - 1;
+
+  double p = s.pos + (s.slope * static_cast<double>(key - s.key));
+
+  size_t pos = (p >= last) ? last : static_cast<size_t>(p);
+
+  // Search the last leaf node whose first key is <= key in the window of the
+  // prediction.
+  size_t first = (pos > s.pos + error_ + 1) ? pos - error_ - 1 : s.pos;
+  size_t end = (pos + error_ + 2 <= last + 1) ? pos + error_ + 2 : last + 1;
+
+  i = first;
+  j = end;
+
+  while (i < j) {
+    size_t mid = (i + j) / 2;
+
+    if (key < leaves_[mid].key) {
+      j = mid;
+    } else {
+      i = mid + 1;
+    }
+  }
+
+  // If the leaf node might be out of the window...
+  if ((i == first) || ((i == end) && (end <= last))) {
+    return false;
+  }
+
+  off = leaves_[i - 1].off;
+
+  return true;
+}
+
+void db::index::learned_model::clear()
+{
+  free(leaves_);
+  leaves_ = NULL;
+  nleaves_ = 0;
+  leaves_size_ = 0;
+
+  free(segments_);
+  segments_ = NULL;
+  nsegments_ = 0;
+}
@@ -0,0 +1,91 @@
+#ifndef DB_INDEX_LEARNED_MODEL_H
+#define DB_INDEX_LEARNED_MODEL_H
+
+#include <stddef.h>
+#include "index/node.h"
+
+namespace db {
+  namespace index {
+    // Piecewise linear model of the position of the leaf nodes, given the
+    // first 8 bytes of their first key (as an integer). The position
+    // predicted for a key is at most `error` leaf nodes away from the leaf
+    // node which contains it (for the leaf nodes the model was fitted with).
+    class learned_model {
+      public:
+        // Constructor.
+        learned_model();
+
+        // Destructor.
+        ~learned_model();
+
+        // Add leaf node (in key order).
+        bool add(uint64_t key, uint64_t off);
+
+        // Fit the model to the leaf nodes added.
+        bool fit(unsigned error);
+
+        // Search the leaf node which might contain the key.
+        bool find(uint64_t key, uint64_t& off) const;
+
+        // Remove the leaf nodes and the segments.
+        void clear();
+
+        // Get number of leaf nodes.
+        size_t count() const;
+
+        // Get number of segments.
+        size_t segments() const;
+
+        // Get number of bytes allocated.
+        size_t memory() const;
+
+      private:
+        // Segment of the model.
+        struct segment {
+          // First key of the segment.
+          uint64_t key;
+
+          // Position of the first leaf node of the segment.
+          uint64_t pos;
+
+          // Leaf nodes per unit of key.
+          double slope;
+        };
+
+        // Leaf node.
+        struct leaf {
+          // First 8 bytes of the first key.
+          uint64_t key;
+
+          // Offset of the leaf node in the index.
+          uint64_t off;
+        };
+
+        leaf* leaves_;
+        size_t nleaves_;
+        size_t leaves_size_;
+
+        segment* segments_;
+        size_t nsegments_;
+
+        unsigned error_;
+    };
+
+    inline size_t learned_model::count() const
+    {
+      return nleaves_;
+    }
+
+    inline size_t learned_model::segments() const
+    {
+      return nsegments_;
+    }
+
+    inline size_t learned_model::memory() const
+    {
+      return (leaves_size_ * sizeof(leaf)) + (nsegments_ * sizeof(segment));
+    }
+  }
+}
+
+#endif // DB_INDEX_LEARNED_MODEL_H
@@ -0,0 +1,214 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "index/memtable.h"
+#include "constants.h"
+
+db::index::memtable::memtable()
+  : comp_(NULL),
+    head_(NULL),
+    height_(1),
+    count_(0),
+    blocks_(NULL),
+    memory_(0),
+    state_(88172645463325252ull)
+{
+}
+
+db::index::memtable::~memtable()
+{
+  clear();
+}
+
+const db::index::memtable::entry* db::index::memtable::find(
+                                    const void* key,
+                                    keylen_t keylen
+                                  ) const
+{
+  if (!head_) {
+    return NULL;
+  }
+
+  const entry* e = head_;
+
+  for (unsigned level = height_; level > 0; level--) {
+    const entry* next;
+    while (((next = e->next[level - 1]) != NULL) &&
+           (compare(comp_, next->key(), next->keylen, key, keylen) < 0)) {
+      e = next;
+    }
+  }
+
+  e = e->next[0];
+
+  return ((e) && (compare(comp_, e->key(), e->keylen, key, keylen) == 0)) ?
+           e :
+           NULL;
+}
+
+void db::index::memtable::remove(const void* key, keylen_t keylen)
+{
+  if (!head_) {
+    return;
+  }
+
+  // Unlink the entry at each level.
+  entry* e = head_;
+  entry* found = NULL;
+
+  for (unsigned level = height_; level > 0; level--) {
+    entry* next;
+    while (((next = e->next[level - 1]) != NULL) &&
+           (compare(comp_, next->key(), next->keylen, key, keylen) < 0)) {
+      e = next;
+    }
+
+    if ((next) &&
+        (compare(comp_, next->key(), next->keylen, key, keylen) == 0)) {
+      e->next[level - 1] = next->next[level - 1];
+      found = next;
+    }
+  }
+
+  if (found) {
+    count_--;
+  }
+}
+
+void db::index::memtable::clear()
+{
+  while (blocks_) {
+    block* prev = blocks_->prev;
+    free(blocks_);
+    blocks_ = prev;
+  }
+
+  head_ = NULL;
+  height_ = 1;
+  count_ = 0;
+  memory_ = 0;
+}
+
+bool db::index::memtable::put(write_batch::op_type type,
+                              const void* key,
+                              keylen_t keylen,
+                              uint64_t dataoff)
+{
+  // If the key is too short or too long...
+  if ((keylen < kKeyMinLen) || (keylen > kKeyMaxLen)) {
+    return false;
+  }
+
+  // Create the sentinel.
+  if ((!head_) && ((head_ = allocate(kMaxHeight, 0)) == NULL)) {
+    return false;
+  }
+
+  // Search the entries which precede the key at each level.
+  entry* prev[kMaxHeight];
+
+  entry* e = head_;
+
+  for (unsigned level = height_; level > 0; level--) {
+    entry* next;
+    while (((next = e->next[level - 1]) != NULL) &&
+           (compare(comp_, next->key(), next->keylen, key, keylen) < 0)) {
+      e = next;
+    }
+
+    prev[level - 1] = e;
+  }
+
+  // If the key is already in the memtable...
+  if (((e = e->next[0]) != NULL) &&
+      (compare(comp_, e->key(), e->keylen, key, keylen) == 0)) {
+    e->type = static_cast<uint8_t>(type);
+    e->dataoff = dataoff;
+
+    return true;
+  }
+
+  unsigned height = random_height();
+
+  if ((e = allocate(height, keylen)) == NULL) {
+    return false;
+  }
+
+  e->dataoff = dataoff;
+  e->type = static_cast<uint8_t>(type);
+
+  memcpy(const_cast<void*>(e->key()), key, keylen);
+
+  // New levels start at the sentinel.
+  for (; height_ < height; height_++) {
+    prev[height_] = head_;
+  }
+
+  for (unsigned level = 0; level < height; level++) {
+    e->next[level] = prev[level]->next[level];
+    prev[level]->next[level] = e;
+  }
+
+  count_++;
+
+  return true;
+}
+
+db::index::memtable::entry* db::index::memtable::allocate(unsigned height,
+                                                          keylen_t keylen)
+{
+  size_t size = offsetof(entry, next) + (height * sizeof(entry*)) + keylen;
+
+  // Align entries to 8 bytes.
+  size = (size + 7) & ~static_cast<size_t>(7);
+
+  // If the entry doesn't fit in the current block...
+  if ((!blocks_) || (blocks_->used + size > kBlockSize)) {
+    block* b;
+    if ((b = reinterpret_cast<block*>(
+               malloc(offsetof(block, data) + kBlockSize)
+             )) == NULL) {
+      return NULL;
+    }
+
+    b->prev = blocks_;
+    b->used = 0;
+
+    blocks_ = b;
+  }
+
+  entry* e = reinterpret_cast<entry*>(blocks_->data + blocks_->used);
+  blocks_->used += size;
+
+  // Count the entries, not the blocks (a memtable smaller than a block
+  // would be drained after every operation).
+  memory_ += size;
+
+  e->keylen = keylen;
+  e->height = height;
+
+  for (unsigned level = 0; level < height; level++) {
+    e->next[level] = NULL;
+  }
+
+  return e;
+}
+
+unsigned db::index::memtable::random_height()
+{
+  // xorshift64*.
+  state_ ^= state_ >> 12;
+  state_ ^= state_ << 25;
+  state_ ^= state_ >> 27;
+
+  uint64_t r = state_ * 2685821657736338717ull;
+
+  // Each level has 1/4 of the entries of the level below.
+  unsigned height = 1;
+  while ((height < kMaxHeight) && ((r & 3) == 0)) {
+    height++;
+    r >>= 2;
+  }
+
+  return height;
+}
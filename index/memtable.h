@@ -0,0 +1,157 @@
+#ifndef DB_INDEX_MEMTABLE_H
+#define DB_INDEX_MEMTABLE_H
+
+#include <stddef.h>
+#include "index/node.h"
+#include "index/write_batch.h"
+
+namespace db {
+  namespace index {
+    // Sorted in-memory buffer of add / erase operations (skiplist). It keeps
+    // the last operation of each key; the entries are allocated from an
+    // arena which is released by clear().
+    class memtable {
+      public:
+        // Entry (followed by the pointers to the next entries and the key).
+        struct entry {
+          uint64_t dataoff;
+          keylen_t keylen;
+
+          // Operation (add / erase).
+          uint8_t type;
+
+          // Number of levels.
+          uint8_t height;
+
+          // Next entry at each level.
+          entry* next[1];
+
+          // Get key.
+          const void* key() const;
+        };
+
+        // Constructor.
+        memtable();
+
+        // Destructor.
+        ~memtable();
+
+        // Get comparator.
+        comparator_t comparator() const;
+
+        // Set comparator (the memtable must be empty).
+        void comparator(comparator_t comp);
+
+        // Add key.
+        bool add(const void* key, keylen_t keylen, uint64_t dataoff);
+
+        // Erase key (adds a tombstone, which hides the key of the tree).
+        bool erase(const void* key, keylen_t keylen);
+
+        // Find key (the entry might be a tombstone).
+        const entry* find(const void* key, keylen_t keylen) const;
+
+        // Remove the entry of the key (its memory is released by clear()).
+        void remove(const void* key, keylen_t keylen);
+
+        // Get first entry (NULL if the memtable is empty).
+        const entry* first() const;
+
+        // Remove all the entries.
+        void clear();
+
+        // Get number of entries.
+        size_t count() const;
+
+        // Get number of bytes used by the entries.
+        size_t memory() const;
+
+      private:
+        // Maximum number of levels.
+        static const unsigned kMaxHeight = 12;
+
+        // Size of the blocks of the arena.
+        static const size_t kBlockSize = 1024 * 1024;
+
+        // Block of the arena.
+        struct block {
+          block* prev;
+          size_t used;
+          uint8_t data[1];
+        };
+
+        comparator_t comp_;
+
+        // Sentinel before the first entry.
+        entry* head_;
+
+        // Number of levels in use.
+        unsigned height_;
+
+        size_t count_;
+
+        // Arena.
+        block* blocks_;
+        size_t memory_;
+
+        // State of the random number generator.
+        uint64_t state_;
+
+        // Add or replace entry.
+        bool put(write_batch::op_type type,
+                 const void* key,
+                 keylen_t keylen,
+                 uint64_t dataoff);
+
+        // Allocate entry.
+        entry* allocate(unsigned height, keylen_t keylen);
+
+        // Pick the number of levels of a new entry.
+        unsigned random_height();
+    };
+
+    inline const void* memtable::entry::key() const
+    {
+      return reinterpret_cast<const uint8_t*>(next + height);
+    }
+
+    inline comparator_t memtable::comparator() const
+    {
+      return comp_;
+    }
+
+    inline void memtable::comparator(comparator_t comp)
+    {
+      comp_ = comp;
+    }
+
+    inline bool memtable::add(const void* key,
+                              keylen_t keylen,
+                              uint64_t dataoff)
+    {
+      return put(write_batch::op_type::kAdd, key, keylen, dataoff);
+    }
+
+    inline bool memtable::erase(const void* key, keylen_t keylen)
+    {
+      return put(write_batch::op_type::kErase, key, keylen, 0);
+    }
+
+    inline const memtable::entry* memtable::first() const
+    {
+      return head_ ? head_->next[0] : NULL;
+    }
+
+    inline size_t memtable::count() const
+    {
+      return count_;
+    }
+
+    inline size_t memtable::memory() const
+    {
+      return memory_;
+    }
+  }
+}
+
+#endif // DB_INDEX_MEMTABLE_H
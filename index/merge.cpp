@@ -0,0 +1,57 @@
+#include <stdlib.h>
+#include "index/merge.h"
+
+bool db::index::merge::first()
+{
+  for (size_t i = 0; i < ninputs_; i++) {
+    inputs_[i].valid = inputs_[i].idx->begin(inputs_[i].it);
+  }
+
+  return search();
+}
+
+bool db::index::merge::next()
+{
+  // Move the inputs at the current key.
+  for (size_t i = 0; i < ninputs_; i++) {
+    if (inputs_[i].current) {
+      inputs_[i].valid = inputs_[i].idx->next(inputs_[i].it);
+    }
+  }
+
+  return search();
+}
+
+bool db::index::merge::search()
+{
+  bool found = false;
+
+  for (size_t i = 0; i < ninputs_; i++) {
+    inputs_[i].current = false;
+
+    if (inputs_[i].valid) {
+      int ret = found ? compare(comp_,
+                                inputs_[i].it.key(),
+                                inputs_[i].it.keylen(),
+                                inputs_[min_].it.key(),
+                                inputs_[min_].it.keylen()) :
+                        -1;
+
+      if (ret < 0) {
+        // New smallest key: the previous inputs are not at it.
+        for (size_t j = 0; j < i; j++) {
+          inputs_[j].current = false;
+        }
+
+        min_ = i;
+        found = true;
+
+        inputs_[i].current = true;
+      } else if (ret == 0) {
+        inputs_[i].current = true;
+      }
+    }
+  }
+
+  return found;
+}
@@ -0,0 +1,119 @@
+#ifndef DB_INDEX_MERGE_H
+#define DB_INDEX_MERGE_H
+
+#include <stddef.h>
+#include "index/index.h"
+
+namespace db {
+  namespace index {
+    // Keys which are in any of the inputs, in order and without duplicates.
+    //
+    // All the inputs must be sorted with the same comparator. The merge is
+    // valid until one of the indexes is modified.
+    class merge {
+      public:
+        // Maximum number of inputs.
+        static const size_t kMaxInputs = 16;
+
+        // Constructor.
+        merge(comparator_t comp);
+
+        // Add input.
+        bool add(const index* idx);
+
+        // Position at the first key.
+        bool first();
+
+        // Position at the next key.
+        bool next();
+
+        // Get current key.
+        const void* key() const;
+
+        // Get current key length.
+        keylen_t keylen() const;
+
+        // Is the current key in the input?
+        bool contains(size_t i) const;
+
+        // Get the iterator of the input (positioned at the current key if
+        // the input contains it).
+        const index::iterator& input(size_t i) const;
+
+        // Get number of inputs.
+        size_t ninputs() const;
+
+      private:
+        struct cursor {
+          const index* idx;
+          index::iterator it;
+
+          // Has the input more keys?
+          bool valid;
+
+          // Is the input at the current key?
+          bool current;
+        };
+
+        comparator_t comp_;
+
+        cursor inputs_[kMaxInputs];
+        size_t ninputs_;
+
+        // Input at the current key.
+        size_t min_;
+
+        // Search the smallest key.
+        bool search();
+    };
+
+    inline merge::merge(comparator_t comp)
+      : comp_(comp),
+        ninputs_(0),
+        min_(0)
+    {
+    }
+
+    inline bool merge::add(const index* idx)
+    {
+      if (ninputs_ < kMaxInputs) {
+        inputs_[ninputs_].idx = idx;
+        inputs_[ninputs_].valid = false;
+        inputs_[ninputs_].current = false;
+
+        ninputs_++;
+
+        return true;
+      }
+
+      return false;
+    }
+
+    inline const void* merge::key() const
+    {
+      return inputs_[min_].it.key();
+    }
+
+    inline keylen_t merge::keylen() const
+    {
+      return inputs_[min_].it.keylen();
+    }
+
+    inline bool merge::contains(size_t i) const
+    {
+      return inputs_[i].current;
+    }
+
+    inline const index::iterator& merge::input(size_t i) const
+    {
+      return inputs_[i].it;
+    }
+
+    inline size_t merge::ninputs() const
+    {
+      return ninputs_;
+    }
+  }
+}
+
+#endif // DB_INDEX_MERGE_H
@@ -0,0 +1,147 @@
+#include <stdlib.h>
+#include <string.h>
+#include "index/message_buffer.h"
+
+bool db::index::message_buffer::search(const void* key,
+                                       keylen_t keylen,
+                                       comparator_t comp,
+                                       uint32_t& pos) const
+{
+  int64_t i = 0;
+  int64_t j = static_cast<int64_t>(nmessages) - 1;
+
+  while (i <= j) {
+    int64_t mid = (i + j) / 2;
+
+    int ret = compare(comp, key, keylen, this->key(mid), messages[mid].keylen);
+
+    if (ret < 0) {
+      j = mid - 1;
+    } else if (ret == 0) {
+      pos = static_cast<uint32_t>(mid);
+      return true;
+    } else {
+      i = mid + 1;
+    }
+  }
+
+  pos = static_cast<uint32_t>(i);
+
+  return false;
+}
+
+bool db::index::message_buffer::put(const void* key,
+                                    keylen_t keylen,
+                                    uint8_t type,
+                                    uint64_t dataoff,
+                                    comparator_t comp)
+{
+  // If there is already a message for the key...
+  uint32_t pos;
+  if (search(key, keylen, comp, pos)) {
+    // The new message replaces it.
+    messages[pos].type = type;
+    messages[pos].dataoff = dataoff;
+
+    return true;
+  }
+
+  uint32_t len = sizeof(message) + keylen;
+
+  // If there is no room for the message...
+  if (len > available()) {
+    if ((len > available() + garbage) || (!compact())) {
+      return false;
+    }
+  }
+
+  insert(pos, key, keylen, type, dataoff);
+
+  return true;
+}
+
+void db::index::message_buffer::remove(uint32_t pos, uint32_t count)
+{
+  for (uint32_t i = pos; i < pos + count; i++) {
+    garbage += messages[i].keylen;
+  }
+
+  memmove(&messages[pos],
+          &messages[pos + count],
+          (nmessages - pos - count) * sizeof(message));
+
+  nmessages -= count;
+
+  // Empty buffer?
+  if (nmessages == 0) {
+    nextoff = size;
+    garbage = 0;
+  }
+}
+
+void db::index::message_buffer::split(message_buffer* right,
+                                      const void* key,
+                                      keylen_t keylen,
+                                      comparator_t comp)
+{
+  uint32_t pos;
+  search(key, keylen, comp, pos);
+
+  for (uint32_t i = pos; i < nmessages; i++) {
+    right->insert(right->nmessages,
+                  this->key(i),
+                  messages[i].keylen,
+                  messages[i].type,
+                  messages[i].dataoff);
+  }
+
+  remove(pos, nmessages - pos);
+}
+
+void db::index::message_buffer::insert(uint32_t pos,
+                                       const void* key,
+                                       keylen_t keylen,
+                                       uint8_t type,
+                                       uint64_t dataoff)
+{
+  memmove(&messages[pos + 1],
+          &messages[pos],
+          (nmessages - pos) * sizeof(message));
+
+  nextoff -= keylen;
+
+  memcpy(reinterpret_cast<uint8_t*>(this) + nextoff, key, keylen);
+
+  messages[pos].keyoff = nextoff;
+  messages[pos].keylen = keylen;
+  messages[pos].type = type;
+  messages[pos].dataoff = dataoff;
+
+  nmessages++;
+}
+
+bool db::index::message_buffer::compact()
+{
+  uint8_t* keys;
+  if ((keys = reinterpret_cast<uint8_t*>(malloc(size))) == NULL) {
+    return false;
+  }
+
+  // Copy the keys of the messages to the end of a temporary buffer.
+  uint32_t off = size;
+  for (uint32_t i = 0; i < nmessages; i++) {
+    off -= messages[i].keylen;
+    memcpy(keys + off, key(i), messages[i].keylen);
+
+    messages[i].keyoff = off;
+  }
+
+  memcpy(reinterpret_cast<uint8_t*>(this) + off, keys + off, size - off);
+
+  nextoff = off;
+  garbage = 0;
+
+  free(keys);
+
+  return true;
+}
@@ -0,0 +1,112 @@
+#ifndef DB_INDEX_MESSAGE_BUFFER_H
+#define DB_INDEX_MESSAGE_BUFFER_H
+
+#include <stddef.h>
+#include "index/node.h"
+
+namespace db {
+  namespace index {
+    // Buffer of pending add / erase messages of an inner node (B-epsilon
+    // tree). It is stored in the pages which follow the inner node; the
+    // messages are sorted by key and there is at most one message per key.
+    struct message_buffer {
+      public:
+        struct message {
+          // Offset of the key in the buffer.
+          uint32_t keyoff;
+
+          // Length of the key.
+          keylen_t keylen;
+
+          // Operation (write_batch::op_type).
+          uint8_t type;
+
+          // Offset of the data (add).
+          uint64_t dataoff;
+        } __attribute__((packed));
+
+        // Size of the buffer.
+        uint32_t size;
+
+        // Number of messages.
+        uint32_t nmessages;
+
+        // Offset of the next key.
+        uint32_t nextoff;
+
+        // Number of bytes of the keys of the removed messages.
+        uint32_t garbage;
+
+        // Dynamic array of messages.
+        message messages[1];
+
+        // The keys are stored starting from the end of the buffer.
+
+        // Constructor.
+        message_buffer(uint32_t bufsize);
+
+        // Get key of the message at position.
+        const void* key(uint32_t pos) const;
+
+        // Search (if not found, `pos` is the position where the message would
+        // be inserted).
+        bool search(const void* key,
+                    keylen_t keylen,
+                    comparator_t comp,
+                    uint32_t& pos) const;
+
+        // Add message, replacing the message of the key (false if the buffer
+        // is full).
+        bool put(const void* key,
+                 keylen_t keylen,
+                 uint8_t type,
+                 uint64_t dataoff,
+                 comparator_t comp);
+
+        // Remove `count` messages starting at position.
+        void remove(uint32_t pos, uint32_t count);
+
+        // Move the messages whose key is >= key to the (empty) right buffer.
+        void split(message_buffer* right,
+                   const void* key,
+                   keylen_t keylen,
+                   comparator_t comp);
+
+      private:
+        // Get number of bytes available.
+        uint32_t available() const;
+
+        // Insert message at position (there must be room for it).
+        void insert(uint32_t pos,
+                    const void* key,
+                    keylen_t keylen,
+                    uint8_t type,
+                    uint64_t dataoff);
+
+        // Reclaim the space of the keys of the removed messages.
+        bool compact();
+    };
+
+    inline message_buffer::message_buffer(uint32_t bufsize)
+      : size(bufsize),
+        nmessages(0),
+        nextoff(bufsize),
+        garbage(0)
+    {
+    }
+
+    inline const void* message_buffer::key(uint32_t pos) const
+    {
+      return reinterpret_cast<const uint8_t*>(this) + messages[pos].keyoff;
+    }
+
+    inline uint32_t message_buffer::available() const
+    {
+      return nextoff -
+             (offsetof(message_buffer, messages) +
+              (nmessages * sizeof(message)));
+    }
+  }
+}
+
+#endif // DB_INDEX_MESSAGE_BUFFER_H
@@ -1,8 +1,11 @@
 #ifndef DB_INDEX_NODE_H
 #define DB_INDEX_NODE_H
 
+#include <string.h>
 #include "types.h"
 #include "constants.h"
+#include "index/statistics.h"
+#include "index/probes.h"
 
 namespace db {
   namespace index {
@@ -10,7 +13,8 @@ namespace db {
       // Node type.
       enum class type : uint8_t {
         kInnerNode,
-        kLeafNode
+        kLeafNode,
+        kPostingNode
       };
 
       type t;
@@ -28,11 +32,64 @@ namespace db {
       node();
     } __attribute__((packed));
 
+    // Compare keys byte by byte (used when the comparator is NULL).
+    int compare(const void* key1,
+                keylen_t keylen1,
+                const void* key2,
+                keylen_t keylen2);
+
+    // Compare keys with the comparator (byte by byte if it is NULL).
+    int compare(comparator_t comp,
+                const void* key1,
+                keylen_t keylen1,
+                const void* key2,
+                keylen_t keylen2);
+
+    // Get the first 8 bytes of the key as a big-endian integer (padded with
+    // zeros): it preserves the byte by byte order of the keys.
+    uint64_t key_prefix(const void* key, keylen_t keylen);
+
     inline node::node()
       : nentries(0),
         nextoff(kNodeSize)
     {
     }
+
+    inline int compare(const void* key1,
+                       keylen_t keylen1,
+                       const void* key2,
+                       keylen_t keylen2)
+    {
+      int ret;
+      if ((ret = memcmp(key1, key2, (keylen1 < keylen2) ? keylen1 : keylen2))
+          != 0) {
+        return ret;
+      }
+
+      return (keylen1 - keylen2);
+    }
+
+    inline int compare(comparator_t comp,
+                       const void* key1,
+                       keylen_t keylen1,
+                       const void* key2,
+                       keylen_t keylen2)
+    {
+      return comp ? comp(key1, keylen1, key2, keylen2) :
+                    compare(key1, keylen1, key2, keylen2);
+    }
+
+    inline uint64_t key_prefix(const void* key, keylen_t keylen)
+    {
+      const uint8_t* k = static_cast<const uint8_t*>(key);
+
+      uint64_t p = 0;
+      for (size_t i = 0; i < sizeof(uint64_t); i++) {
+        p = (p << 8) | ((i < keylen) ? k[i] : 0);
+      }
+
+      return p;
+    }
   }
 }
 
@@ -0,0 +1,269 @@
+#include <stdlib.h>
+#include <string.h>
+#include "index/node_cache.h"
+#include "index/inner_node.h"
+
+db::index::node_cache::node_cache()
+  : valid_(false),
+    levels_(0),
+    level_(0),
+    mem_(NULL),
+    memory_(0),
+    nodes_(NULL),
+    slots_(NULL),
+    children_(NULL),
+    keys_(NULL)
+{
+}
+
+db::index::node_cache::~node_cache()
+{
+  clear();
+}
+
+bool db::index::node_cache::build(const void* data,
+                                  uint64_t root,
+                                  uint64_t height,
+                                  size_t budget)
+{
+  clear();
+
+  // If the tree has no levels to cache...
+  if ((root == 0) || (height < 3)) {
+    valid_ = true;
+    return true;
+  }
+
+  const uint8_t* base = static_cast<const uint8_t*>(data);
+
+  // Offsets of the cached nodes (level by level) and of the nodes of the
+  // next level.
+  uint64_t* offs;
+  if ((offs = static_cast<uint64_t*>(malloc(sizeof(uint64_t)))) == NULL) {
+    return false;
+  }
+
+  offs[0] = root;
+
+  size_t nnodes = 0;
+  size_t nlevel = 1;
+  size_t nentries = 0;
+  size_t keybytes = 0;
+  size_t size = 0;
+
+  // Add levels while they fit in the budget.
+  while (levels_ < height - 2) {
+    size_t n = 0;
+    size_t k = 0;
+
+    for (size_t i = nnodes; i < nnodes + nlevel; i++) {
+      const struct inner_node* inner = reinterpret_cast<const inner_node*>(
+                                         base + offs[i]
+                                       );
+
+      // If the node is not an inner node...
+      if (inner->t != node::type::kInnerNode) {
+        free(offs);
+        return false;
+      }
+
+      n += inner->nentries;
+
+      for (nodeoff_t j = 0; j < inner->nentries; j++) {
+        k += inner->entries[j].keylen;
+      }
+    }
+
+    size_t s = align((nnodes + nlevel) * sizeof(cnode)) +
+               align((nentries + n) * sizeof(slot)) +
+               align((nentries + n + nnodes + nlevel) * sizeof(uint64_t)) +
+               align(keybytes + k);
+
+    if (s > budget) {
+      break;
+    }
+
+    size = s;
+
+    // The children of the level are the nodes of the next level.
+    uint64_t* tmp;
+    if ((tmp = static_cast<uint64_t*>(
+                 realloc(offs,
+                         (nnodes + nlevel + n + nlevel) * sizeof(uint64_t))
+               )) == NULL) {
+      free(offs);
+      return false;
+    }
+
+    offs = tmp;
+
+    size_t next = nnodes + nlevel;
+    for (size_t i = nnodes; i < nnodes + nlevel; i++) {
+      const struct inner_node* inner = reinterpret_cast<const inner_node*>(
+                                         base + offs[i]
+                                       );
+
+      for (nodeoff_t j = 0; j <= inner->nentries; j++) {
+        offs[next++] = inner->child(j);
+      }
+    }
+
+    nnodes += nlevel;
+    nentries += n;
+    keybytes += k;
+
+    nlevel = n + nlevel;
+
+    levels_++;
+  }
+
+  // If not even the root node fits...
+  if (levels_ == 0) {
+    free(offs);
+
+    valid_ = true;
+    return true;
+  }
+
+  if (posix_memalign(&mem_, kAlignment, size) != 0) {
+    mem_ = NULL;
+    levels_ = 0;
+
+    free(offs);
+    return false;
+  }
+
+  memory_ = size;
+
+  uint8_t* m = static_cast<uint8_t*>(mem_);
+
+  nodes_ = reinterpret_cast<cnode*>(m);
+  m += align(nnodes * sizeof(cnode));
+
+  slots_ = reinterpret_cast<slot*>(m);
+  m += align(nentries * sizeof(slot));
+
+  children_ = reinterpret_cast<uint64_t*>(m);
+  m += align((nentries + nnodes) * sizeof(uint64_t));
+
+  keys_ = m;
+
+  // Copy the nodes. The children of the nodes of the upper levels are the
+  // next nodes (in order); the children of the lowest cached level are
+  // offsets in the index.
+  uint32_t first = 0;
+  uint32_t keyoff = 0;
+  uint64_t next = 1;
+
+  for (size_t i = 0; i < nnodes; i++) {
+    const struct inner_node* inner = reinterpret_cast<const inner_node*>(
+                                       base + offs[i]
+                                     );
+
+    nodes_[i].first = first;
+    nodes_[i].nentries = inner->nentries;
+
+    for (nodeoff_t j = 0; j < inner->nentries; j++) {
+      const void* key = reinterpret_cast<const uint8_t*>(inner) +
+                        inner->entries[j].keyoff;
+
+      keylen_t keylen = inner->entries[j].keylen;
+
+      slots_[first + j].prefix = key_prefix(key, keylen);
+      slots_[first + j].keyoff = keyoff;
+      slots_[first + j].keylen = keylen;
+
+      memcpy(keys_ + keyoff, key, keylen);
+      keyoff += keylen;
+    }
+
+    for (nodeoff_t j = 0; j <= inner->nentries; j++) {
+      children_[first + i + j] = (next < nnodes) ? next++ : inner->child(j);
+    }
+
+    first += inner->nentries;
+  }
+
+  free(offs);
+
+  level_ = height - levels_;
+
+  valid_ = true;
+
+  return true;
+}
+
+bool db::index::node_cache::find(const void* key,
+                                 keylen_t keylen,
+                                 comparator_t comp,
+                                 uint64_t& off,
+                                 uint64_t& level) const
+{
+  if (levels_ == 0) {
+    return false;
+  }
+
+  uint64_t p = comp ? 0 : key_prefix(key, keylen);
+
+  uint64_t n = 0;
+
+  for (uint64_t l = 1; ; l++) {
+    const cnode& c = nodes_[n];
+
+    // Number of separators <= key.
+    uint32_t i = 0;
+    uint32_t j = c.nentries;
+
+    while (i < j) {
+      uint32_t mid = (i + j) / 2;
+
+      const slot& s = slots_[c.first + mid];
+
+      int ret;
+      if (comp) {
+        ret = comp(key, keylen, keys_ + s.keyoff, s.keylen);
+      } else if (p != s.prefix) {
+        ret = (p < s.prefix) ? -1 : +1;
+      } else {
+        ret = compare(key, keylen, keys_ + s.keyoff, s.keylen);
+      }
+
+      if (ret < 0) {
+        j = mid;
+      } else {
+        i = mid + 1;
+      }
+    }
+
+    uint64_t child = children_[c.first + n + i];
+
+    if (l == levels_) {
+      off = child;
+      level = level_;
+
+      return true;
+    }
+
+    n = child;
+  }
+}
+
+void db::index::node_cache::clear()
+{
+  if (mem_) {
+    free(mem_);
+    mem_ = NULL;
+  }
+
+  memory_ = 0;
+
+  nodes_ = NULL;
+  slots_ = NULL;
+  children_ = NULL;
+  keys_ = NULL;
+
+  levels_ = 0;
+  level_ = 0;
+
+  valid_ = false;
+}
@@ -0,0 +1,123 @@
+#ifndef DB_INDEX_NODE_CACHE_H
+#define DB_INDEX_NODE_CACHE_H
+
+#include <stddef.h>
+#include "index/node.h"
+
+namespace db {
+  namespace index {
+    // In-memory copy of the upper levels of the tree (separator keys and
+    // children), stored in aligned arrays. It maps a key to the node of the
+    // first level which is not cached. Only the inner nodes above the two
+    // lowest levels are cached: leaf splits don't change them.
+    class node_cache {
+      public:
+        // Constructor.
+        node_cache();
+
+        // Destructor.
+        ~node_cache();
+
+        // Build the cache of the tree (`data` is the memory of the index),
+        // using at most `budget` bytes.
+        bool build(const void* data,
+                   uint64_t root,
+                   uint64_t height,
+                   size_t budget);
+
+        // Is the cache up to date?
+        bool valid() const;
+
+        // Mark the cache as out of date (an inner node of the cached levels
+        // has changed).
+        void invalidate();
+
+        // Search the node of the first level which is not cached which might
+        // contain the key. Returns false if the cache is empty; `level` is
+        // the level of the node (1: leaf nodes).
+        bool find(const void* key,
+                  keylen_t keylen,
+                  comparator_t comp,
+                  uint64_t& off,
+                  uint64_t& level) const;
+
+        // Remove all the nodes.
+        void clear();
+
+        // Get number of bytes allocated.
+        size_t memory() const;
+
+      private:
+        // Cached inner node.
+        struct cnode {
+          // Index of the first separator (the index of the first child is
+          // `first` + the index of the node).
+          uint32_t first;
+
+          // Number of separators.
+          uint32_t nentries;
+        };
+
+        // Separator key.
+        struct slot {
+          // First bytes of the key (big-endian, padded with zeros).
+          uint64_t prefix;
+
+          // Offset of the key in the arena of keys.
+          uint32_t keyoff;
+
+          // Length of the key.
+          keylen_t keylen;
+        };
+
+        // Alignment of the arrays (cache line).
+        static const size_t kAlignment = 64;
+
+        bool valid_;
+
+        // Number of cached levels.
+        uint64_t levels_;
+
+        // Level of the nodes below the cached levels.
+        uint64_t level_;
+
+        // Memory block of the arrays.
+        void* mem_;
+        size_t memory_;
+
+        cnode* nodes_;
+        slot* slots_;
+
+        // Children: index of the node for the upper levels, offset of the
+        // node in the index for the lowest cached level.
+        uint64_t* children_;
+
+        uint8_t* keys_;
+
+        // Round up to the alignment.
+        static size_t align(size_t size);
+    };
+
+    inline bool node_cache::valid() const
+    {
+      return valid_;
+    }
+
+    inline void node_cache::invalidate()
+    {
+      valid_ = false;
+    }
+
+    inline size_t node_cache::memory() const
+    {
+      return memory_;
+    }
+
+    inline size_t node_cache::align(size_t size)
+    {
+      return (size + kAlignment - 1) & ~(kAlignment - 1);
+    }
+  }
+}
+
+#endif // DB_INDEX_NODE_CACHE_H
@@ -0,0 +1,314 @@
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "index/operation_trace.h"
+
+const uint8_t db::index::operation_trace::kMagic[8] = {
+  'O',
+  'P',
+  'S',
+  'T',
+  'R',
+  'A',
+  'C',
+  'E'
+};
+
+bool db::index::operation_trace::create(const char* filename, bool hash_keys)
+{
+  close();
+
+  if ((fd_ = ::open(filename, O_CREAT | O_TRUNC | O_WRONLY, 0644)) == -1) {
+    return false;
+  }
+
+  header h;
+  memcpy(h.magic, kMagic, sizeof(kMagic));
+  h.flags = hash_keys ? kHashedKeys : 0;
+
+  if (::write(fd_, &h, sizeof(header)) !=
+      static_cast<ssize_t>(sizeof(header))) {
+    ::close(fd_);
+    fd_ = -1;
+
+    return false;
+  }
+
+  writing_ = true;
+  hash_keys_ = hash_keys;
+
+  start_ = now();
+  last_ = start_;
+
+  return true;
+}
+
+bool db::index::operation_trace::open(const char* filename)
+{
+  close();
+
+  if ((fd_ = ::open(filename, O_RDONLY)) == -1) {
+    return false;
+  }
+
+  header h;
+  if ((::read(fd_, &h, sizeof(header)) !=
+       static_cast<ssize_t>(sizeof(header))) ||
+      (memcmp(h.magic, kMagic, sizeof(kMagic)) != 0)) {
+    ::close(fd_);
+    fd_ = -1;
+
+    return false;
+  }
+
+  hash_keys_ = ((h.flags & kHashedKeys) != 0);
+
+  return true;
+}
+
+bool db::index::operation_trace::close()
+{
+  bool ret = true;
+
+  if (fd_ != -1) {
+    if (writing_) {
+      ret = flush();
+    }
+
+    ::close(fd_);
+    fd_ = -1;
+  }
+
+  writing_ = false;
+  hash_keys_ = false;
+
+  used_ = 0;
+  pos_ = 0;
+
+  start_ = 0;
+  last_ = 0;
+
+  count_ = 0;
+
+  return ret;
+}
+
+bool db::index::operation_trace::append(op_type type,
+                                        bool result,
+                                        const void* key,
+                                        keylen_t keylen,
+                                        uint64_t arg)
+{
+  // If the record might not fit in the buffer...
+  if ((used_ + kMaxRecordSize > kBufferSize) && (!flush())) {
+    return false;
+  }
+
+  uint8_t* ptr = buf_ + used_;
+
+  *ptr++ = static_cast<uint8_t>(type) | (result ? 0x80 : 0);
+
+  uint64_t t = now();
+  ptr += encode(t - last_, ptr);
+  last_ = t;
+
+  if ((type != op_type::kBegin) && (type != op_type::kNext)) {
+    if (keylen > kKeyMaxLen + 1) {
+      keylen = kKeyMaxLen + 1;
+    }
+
+    ptr += encode(keylen, ptr);
+
+    if (hash_keys_) {
+      uint64_t h = hash(key, keylen);
+
+      size_t len = (keylen < sizeof(uint64_t)) ? keylen : sizeof(uint64_t);
+      memcpy(ptr, &h, len);
+      ptr += len;
+    } else {
+      memcpy(ptr, key, keylen);
+      ptr += keylen;
+    }
+
+    if ((type == op_type::kAdd) || (type == op_type::kAddValue)) {
+      ptr += encode(arg, ptr);
+    }
+  }
+
+  used_ = ptr - buf_;
+
+  count_++;
+
+  return true;
+}
+
+bool db::index::operation_trace::read(record& r)
+{
+  // If the next record might not be complete in the buffer...
+  if ((used_ - pos_ < kMaxRecordSize) && (!fill())) {
+    return false;
+  }
+
+  const uint8_t* ptr = buf_ + pos_;
+  const uint8_t* end = buf_ + used_;
+
+  if (ptr == end) {
+    return false;
+  }
+
+  uint8_t b = *ptr++;
+  if ((b & 0x7f) > static_cast<uint8_t>(op_type::kNext)) {
+    return false;
+  }
+
+  r.type = static_cast<op_type>(b & 0x7f);
+  r.result = ((b & 0x80) != 0);
+
+  uint64_t delta;
+  if (!decode(ptr, end, delta)) {
+    return false;
+  }
+
+  last_ += delta;
+  r.time = last_;
+
+  r.keylen = 0;
+  r.arg = 0;
+
+  if ((r.type != op_type::kBegin) && (r.type != op_type::kNext)) {
+    uint64_t keylen;
+    if ((!decode(ptr, end, keylen)) || (keylen > kKeyMaxLen + 1)) {
+      return false;
+    }
+
+    r.keylen = static_cast<keylen_t>(keylen);
+
+    size_t len = r.keylen;
+    if ((hash_keys_) && (len > sizeof(uint64_t))) {
+      len = sizeof(uint64_t);
+    }
+
+    if (static_cast<size_t>(end - ptr) < len) {
+      return false;
+    }
+
+    memcpy(r.key, ptr, len);
+    memset(r.key + len, 0, r.keylen - len);
+    ptr += len;
+
+    if (((r.type == op_type::kAdd) || (r.type == op_type::kAddValue)) &&
+        (!decode(ptr, end, r.arg))) {
+      return false;
+    }
+  }
+
+  pos_ = ptr - buf_;
+
+  count_++;
+
+  return true;
+}
+
+bool db::index::operation_trace::flush()
+{
+  const uint8_t* ptr = buf_;
+  size_t left = used_;
+
+  while (left > 0) {
+    ssize_t ret;
+    if ((ret = ::write(fd_, ptr, left)) <= 0) {
+      return false;
+    }
+
+    ptr += ret;
+    left -= ret;
+  }
+
+  used_ = 0;
+
+  return true;
+}
+
+bool db::index::operation_trace::fill()
+{
+  // Move the unread bytes to the beginning of the buffer.
+  memmove(buf_, buf_ + pos_, used_ - pos_);
+  used_ -= pos_;
+  pos_ = 0;
+
+  while (used_ < kBufferSize) {
+    ssize_t ret;
+    if ((ret = ::read(fd_, buf_ + used_, kBufferSize - used_)) < 0) {
+      return false;
+    } else if (ret == 0) {
+      break;
+    }
+
+    used_ += ret;
+  }
+
+  return true;
+}
+
+size_t db::index::operation_trace::encode(uint64_t n, uint8_t* buf)
+{
+  size_t len = 0;
+
+  do {
+    uint8_t b = n & 0x7f;
+    n >>= 7;
+
+    buf[len++] = (n != 0) ? (b | 0x80) : b;
+  } while (n != 0);
+
+  return len;
+}
+
+bool db::index::operation_trace::decode(const uint8_t*& ptr,
+                                        const uint8_t* end,
+                                        uint64_t& n)
+{
+  n = 0;
+
+  for (unsigned shift = 0; (ptr < end) && (shift < 64); shift += 7) {
+    uint8_t b = *ptr++;
+    n |= static_cast<uint64_t>(b & 0x7f) << shift;
+
+    if ((b & 0x80) == 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+uint64_t db::index::operation_trace::hash(const void* key, keylen_t keylen)
+{
+  // FNV-1a, followed by the finalizer of MurmurHash3 (so that the first
+  // bytes of the hash of short keys are well mixed).
+  uint64_t h = 0xcbf29ce484222325ull;
+
+  const uint8_t* ptr = reinterpret_cast<const uint8_t*>(key);
+  const uint8_t* end = ptr + keylen;
+
+  for (; ptr < end; ptr++) {
+    h = (h ^ *ptr) * 0x100000001b3ull;
+  }
+
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 33;
+
+  return h;
+}
+
+uint64_t db::index::operation_trace::now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (static_cast<uint64_t>(ts.tv_sec) * 1000000000ull) + ts.tv_nsec;
+}
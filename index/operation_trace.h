@@ -0,0 +1,164 @@
+#ifndef DB_INDEX_OPERATION_TRACE_H
+#define DB_INDEX_OPERATION_TRACE_H
+
+#include <stddef.h>
+#include "types.h"
+#include "constants.h"
+
+namespace db {
+  namespace index {
+    // Trace of the operations of an index (add, erase, find and iteration),
+    // with their results and timing, to be replayed against another index
+    // (see replay.cpp). The keys can be replaced by a hash of them.
+    //
+    // Format: header, followed by one record per operation: type (and
+    // result in the high bit), ns since the previous record (varint) and,
+    // depending on the type, key length (varint), key (or min(8, length)
+    // bytes of its hash) and data offset or value length (varint).
+    class operation_trace {
+      public:
+        // Type of operation.
+        enum class op_type : uint8_t {
+          kAdd,      // Add key with a data offset.
+          kAddValue, // Add key with a value.
+          kErase,
+          kFind,
+          kBegin,
+          kNext
+        };
+
+        // Operation read from the trace.
+        struct record {
+          op_type type;
+
+          // Result of the operation.
+          bool result;
+
+          // Time of the operation (ns since the trace was created).
+          uint64_t time;
+
+          // Key (if the keys are hashed, the hash followed by zeros up to
+          // the key length; the keys longer than kKeyMaxLen, which the index
+          // rejects, are truncated to kKeyMaxLen + 1 bytes).
+          uint8_t key[kKeyMaxLen + 1];
+          keylen_t keylen;
+
+          // Data offset (kAdd) or value length (kAddValue).
+          uint64_t arg;
+        };
+
+        // Constructor.
+        operation_trace();
+
+        // Destructor.
+        ~operation_trace();
+
+        // Create a trace (truncates the file if it exists).
+        bool create(const char* filename, bool hash_keys);
+
+        // Open a trace for reading.
+        bool open(const char* filename);
+
+        // Close (writes the buffered records).
+        bool close();
+
+        // Append operation.
+        bool append(op_type type,
+                    bool result,
+                    const void* key = NULL,
+                    keylen_t keylen = 0,
+                    uint64_t arg = 0);
+
+        // Read the next operation. Returns false at the end of the trace or
+        // if the record is incomplete.
+        bool read(record& r);
+
+        // Are the keys hashed?
+        bool hashed_keys() const;
+
+        // Get number of operations appended or read.
+        uint64_t count() const;
+
+      private:
+        static const uint8_t kMagic[8];
+
+        // Size of the buffer.
+        static const size_t kBufferSize = 64 * 1024;
+
+        // Maximum size of a record.
+        static const size_t kMaxRecordSize = 1 + 10 + 10 +
+                                             (kKeyMaxLen + 1) + 10;
+
+        // Flags of the header.
+        static const uint64_t kHashedKeys = 1;
+
+        struct header {
+          uint8_t magic[8];
+          uint64_t flags;
+        };
+
+        int fd_;
+        bool writing_;
+        bool hash_keys_;
+
+        uint8_t buf_[kBufferSize];
+        size_t used_;
+
+        // Position of the next record in the buffer (reading).
+        size_t pos_;
+
+        // Time when the trace was created and of the last record.
+        uint64_t start_;
+        uint64_t last_;
+
+        uint64_t count_;
+
+        // Write the buffered records.
+        bool flush();
+
+        // Fill the buffer with the next records (reading).
+        bool fill();
+
+        // Encode / decode varint.
+        static size_t encode(uint64_t n, uint8_t* buf);
+        static bool decode(const uint8_t*& ptr,
+                           const uint8_t* end,
+                           uint64_t& n);
+
+        // Hash key.
+        static uint64_t hash(const void* key, keylen_t keylen);
+
+        // Get current time (ns, monotonic).
+        static uint64_t now();
+    };
+
+    inline operation_trace::operation_trace()
+      : fd_(-1),
+        writing_(false),
+        hash_keys_(false),
+        used_(0),
+        pos_(0),
+        start_(0),
+        last_(0),
+        count_(0)
+    {
+    }
+
+    inline operation_trace::~operation_trace()
+    {
+      close();
+    }
+
+    inline bool operation_trace::hashed_keys() const
+    {
+      return hash_keys_;
+    }
+
+    inline uint64_t operation_trace::count() const
+    {
+      return count_;
+    }
+  }
+}
+
+#endif // DB_INDEX_OPERATION_TRACE_H
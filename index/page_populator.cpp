@@ -0,0 +1,185 @@
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "index/page_populator.h"
+#include "constants.h"
+
+// Linux >= 5.14.
+#ifndef MADV_POPULATE_READ
+  #define MADV_POPULATE_READ 22
+#endif
+
+db::index::page_populator::~page_populator()
+{
+  free(ranges_);
+}
+
+bool db::index::page_populator::add(uint64_t page, uint64_t count)
+{
+  if (count == 0) {
+    return true;
+  }
+
+  // If the pages follow the last ones...
+  if ((used_ > 0) &&
+      (ranges_[used_ - 1].page + ranges_[used_ - 1].count == page)) {
+    ranges_[used_ - 1].count += count;
+    count_ += count;
+
+    return true;
+  }
+
+  // If the array is full...
+  if (used_ == size_) {
+    size_t size = (size_ > 0) ? size_ * 2 : 256;
+
+    range* ranges;
+    if ((ranges = static_cast<range*>(realloc(ranges_,
+                                              size * sizeof(range)))) ==
+        NULL) {
+      return false;
+    }
+
+    ranges_ = ranges;
+    size_ = size;
+  }
+
+  ranges_[used_].page = page;
+  ranges_[used_].count = count;
+  used_++;
+
+  count_ += count;
+
+  return true;
+}
+
+bool db::index::page_populator::populate(void* data,
+                                         uint64_t size,
+                                         unsigned nthreads,
+                                         bool lock) const
+{
+  uint64_t npages = size / kNodeSize;
+
+  // Split the ranges into chunks, so that the threads share large ranges.
+  size_t nchunks = 0;
+  for (size_t i = 0; i < used_; i++) {
+    nchunks += (ranges_[i].count + kChunkPages - 1) / kChunkPages;
+  }
+
+  if (nchunks == 0) {
+    return true;
+  }
+
+  range* chunks;
+  if ((chunks = static_cast<range*>(malloc(nchunks * sizeof(range)))) ==
+      NULL) {
+    return false;
+  }
+
+  nchunks = 0;
+  for (size_t i = 0; i < used_; i++) {
+    uint64_t end = ranges_[i].page + ranges_[i].count;
+    if (end > npages) {
+      end = npages;
+    }
+
+    for (uint64_t page = ranges_[i].page; page < end; page += kChunkPages) {
+      chunks[nchunks].page = page;
+      chunks[nchunks].count = (end - page < kChunkPages) ? end - page :
+                                                           kChunkPages;
+      nchunks++;
+    }
+  }
+
+  task t;
+  t.data = static_cast<uint8_t*>(data);
+  t.chunks = chunks;
+  t.nchunks = nchunks;
+  t.lock = lock;
+  t.next = 0;
+  t.failed = false;
+
+  if (nthreads == 0) {
+    long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    nthreads = (ncpus > 0) ? static_cast<unsigned>(ncpus) : 1;
+  }
+
+  if (nthreads > nchunks) {
+    nthreads = static_cast<unsigned>(nchunks);
+  }
+
+  pthread_t* threads = NULL;
+  if ((nthreads > 1) &&
+      ((threads = static_cast<pthread_t*>(
+                    malloc(nthreads * sizeof(pthread_t))
+                  )) == NULL)) {
+    free(chunks);
+    return false;
+  }
+
+  // The calling thread is the first one (if a thread cannot be created, the
+  // chunks are shared by the threads which are running).
+  unsigned nstarted;
+  for (nstarted = 1; nstarted < nthreads; nstarted++) {
+    if (pthread_create(&threads[nstarted], NULL, populate_chunks, &t) != 0) {
+      break;
+    }
+  }
+
+  populate_chunks(&t);
+
+  for (unsigned i = 1; i < nstarted; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  free(threads);
+  free(chunks);
+
+  return !t.failed;
+}
+
+void* db::index::page_populator::populate_chunks(void* arg)
+{
+  task* t = static_cast<task*>(arg);
+
+  do {
+    size_t i = __atomic_fetch_add(&t->next, 1, __ATOMIC_RELAXED);
+    if (i >= t->nchunks) {
+      return NULL;
+    }
+
+    if (!populate(t->data + (t->chunks[i].page * kNodeSize),
+                  t->chunks[i].count * kNodeSize,
+                  t->lock)) {
+      __atomic_store_n(&t->failed, true, __ATOMIC_RELAXED);
+    }
+  } while (true);
+}
+
+bool db::index::page_populator::populate(uint8_t* data,
+                                         uint64_t len,
+                                         bool lock)
+{
+  // mlock() loads the pages.
+  if (lock) {
+    return (mlock(data, len) == 0);
+  }
+
+  if (madvise(data, len, MADV_POPULATE_READ) == 0) {
+    return true;
+  }
+
+  // If the kernel doesn't support MADV_POPULATE_READ...
+  if (errno == EINVAL) {
+    const uint8_t* end = data + len;
+    for (const volatile uint8_t* ptr = data; ptr < end; ptr += kNodeSize) {
+      *ptr;
+    }
+
+    return true;
+  }
+
+  return false;
+}
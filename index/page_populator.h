@@ -0,0 +1,101 @@
+#ifndef DB_INDEX_PAGE_POPULATOR_H
+#define DB_INDEX_PAGE_POPULATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace db {
+  namespace index {
+    // Loads pages of a mapping into memory with several threads
+    // (MADV_POPULATE_READ, which reads the pages and maps them without a
+    // page fault each; on older kernels, a byte of each page is read), and
+    // optionally locks them in memory.
+    class page_populator {
+      public:
+        // Constructor.
+        page_populator();
+
+        // Destructor.
+        ~page_populator();
+
+        // Add the pages [page, page + count) (pages of kNodeSize bytes; if
+        // they follow the last pages added, they are merged with them).
+        bool add(uint64_t page, uint64_t count);
+
+        // Remove the pages.
+        void clear();
+
+        // Get number of pages.
+        uint64_t count() const;
+
+        // Load the pages of the mapping (`data`, `size` bytes) with
+        // `nthreads` threads (0: one per CPU), locking them (mlock()) if
+        // `lock` is true. The pages beyond the mapping are ignored.
+        bool populate(void* data,
+                      uint64_t size,
+                      unsigned nthreads,
+                      bool lock) const;
+
+      private:
+        // Maximum number of pages loaded at once by a thread.
+        static const uint64_t kChunkPages = 64;
+
+        // Pages [page, page + count).
+        struct range {
+          uint64_t page;
+          uint64_t count;
+        };
+
+        range* ranges_;
+        size_t size_;
+        size_t used_;
+
+        uint64_t count_;
+
+        // Chunks loaded by the threads of populate().
+        struct task {
+          uint8_t* data;
+
+          // Chunks (at most kChunkPages pages each).
+          const range* chunks;
+          size_t nchunks;
+
+          bool lock;
+
+          // Next chunk to load.
+          size_t next;
+
+          // Has a chunk not been loaded?
+          bool failed;
+        };
+
+        // Load the chunks of the task which are left (thread function,
+        // `arg` is a task).
+        static void* populate_chunks(void* arg);
+
+        // Load pages.
+        static bool populate(uint8_t* data, uint64_t len, bool lock);
+    };
+
+    inline page_populator::page_populator()
+      : ranges_(NULL),
+        size_(0),
+        used_(0),
+        count_(0)
+    {
+    }
+
+    inline void page_populator::clear()
+    {
+      used_ = 0;
+      count_ = 0;
+    }
+
+    inline uint64_t page_populator::count() const
+    {
+      return count_;
+    }
+  }
+}
+
+#endif // DB_INDEX_PAGE_POPULATOR_H
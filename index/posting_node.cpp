@@ -0,0 +1,125 @@
+#include <stdlib.h>
+#include <string.h>
+#include "index/posting_node.h"
+
+bool db::index::posting_node::search(uint64_t posting, nodeoff_t& pos) const
+{
+  size_t i = 0;
+  size_t j = nentries;
+
+  while (i < j) {
+    size_t mid = (i + j) / 2;
+
+    if (postings[mid] < posting) {
+      i = mid + 1;
+    } else {
+      j = mid;
+    }
+  }
+
+  pos = static_cast<nodeoff_t>(i);
+
+  return ((i < nentries) && (postings[i] == posting));
+}
+
+bool db::index::posting_node::add(uint64_t posting, nodeoff_t pos)
+{
+  // If the node is not full...
+  if (nentries < capacity()) {
+    // If not the last position...
+    if (pos < nentries) {
+      memmove(&postings[pos + 1],
+              &postings[pos],
+              (nentries - pos) * sizeof(uint64_t));
+    }
+
+    postings[pos] = posting;
+
+    nentries++;
+
+    return true;
+  }
+
+  return false;
+}
+
+void db::index::posting_node::remove(nodeoff_t pos)
+{
+  // If not the last position...
+  if (pos + 1 < nentries) {
+    memmove(&postings[pos],
+            &postings[pos + 1],
+            (nentries - pos - 1) * sizeof(uint64_t));
+  }
+
+  nentries--;
+}
+
+void db::index::posting_node::split(uint64_t rightoff, posting_node* right)
+{
+  nodeoff_t mid = nentries / 2;
+
+  memcpy(right->postings,
+         &postings[mid],
+         (nentries - mid) * sizeof(uint64_t));
+
+  right->nentries = nentries - mid;
+  nentries = mid;
+
+  right->next = next;
+  next = rightoff;
+}
+
+size_t db::index::posting_node::encode(const uint64_t* postings,
+                                       size_t count,
+                                       uint8_t* buf,
+                                       size_t size)
+{
+  size_t len = 0;
+  uint64_t last = 0;
+
+  for (size_t i = 0; i < count; i++) {
+    uint64_t delta = postings[i] - last;
+    last = postings[i];
+
+    do {
+      if (len == size) {
+        return 0;
+      }
+
+      uint8_t b = delta & 0x7f;
+      delta >>= 7;
+
+      buf[len++] = (delta != 0) ? (b | 0x80) : b;
+    } while (delta != 0);
+  }
+
+  return len;
+}
+
+size_t db::index::posting_node::decode(const uint8_t* buf,
+                                       size_t len,
+                                       uint64_t* postings,
+                                       size_t max)
+{
+  const uint8_t* end = buf + len;
+  uint64_t last = 0;
+
+  size_t count = 0;
+  while ((count < max) && (decode_next(buf, end, last))) {
+    postings[count++] = last;
+  }
+
+  return count;
+}
+
+size_t db::index::posting_node::count(const uint8_t* buf, size_t len)
+{
+  // Each posting ends in a byte without the continuation bit.
+  size_t count = 0;
+  for (size_t i = 0; i < len; i++) {
+    count += ((buf[i] & 0x80) == 0);
+  }
+
+  return count;
+}
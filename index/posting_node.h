@@ -0,0 +1,105 @@
+#ifndef DB_INDEX_POSTING_NODE_H
+#define DB_INDEX_POSTING_NODE_H
+
+#include <stddef.h>
+#include "node.h"
+
+namespace db {
+  namespace index {
+    // Node of a posting list which doesn't fit in the leaf node (the nodes of
+    // a posting list are chained and their postings are sorted).
+    //
+    // Small posting lists are stored in the leaf node, after the key, as a
+    // sequence of varints: the difference between each posting and the
+    // previous one (the first one is stored as is).
+    struct posting_node : public node {
+      public:
+        // Offset of the next node of the posting list.
+        uint64_t next;
+
+        // Dynamic array of postings.
+        uint64_t postings[1];
+
+        // Constructor.
+        posting_node();
+
+        // Get maximum number of postings in a node.
+        static nodeoff_t capacity();
+
+        // Search (pos is the position of the first posting >= posting).
+        bool search(uint64_t posting, nodeoff_t& pos) const;
+
+        // Add posting at position (if the node is not full).
+        bool add(uint64_t posting, nodeoff_t pos);
+
+        // Remove posting at position.
+        void remove(nodeoff_t pos);
+
+        // Split: moves the upper half of the postings to the right node and
+        // links it after this node.
+        void split(uint64_t rightoff, posting_node* right);
+
+        // Get last posting.
+        uint64_t last() const;
+
+        // Encode postings as varint deltas. Returns the number of bytes used
+        // (0 if they don't fit in `size` bytes).
+        static size_t encode(const uint64_t* postings,
+                             size_t count,
+                             uint8_t* buf,
+                             size_t size);
+
+        // Decode up to `max` postings. Returns the number of postings.
+        static size_t decode(const uint8_t* buf,
+                             size_t len,
+                             uint64_t* postings,
+                             size_t max);
+
+        // Decode the posting following `last`.
+        static bool decode_next(const uint8_t*& ptr,
+                                const uint8_t* end,
+                                uint64_t& last);
+
+        // Get number of postings encoded.
+        static size_t count(const uint8_t* buf, size_t len);
+    } __attribute__((packed));
+
+    inline posting_node::posting_node()
+      : next(0)
+    {
+      t = type::kPostingNode;
+      parent = 0;
+    }
+
+    inline nodeoff_t posting_node::capacity()
+    {
+      return (kNodeSize - offsetof(posting_node, postings)) / sizeof(uint64_t);
+    }
+
+    inline uint64_t posting_node::last() const
+    {
+      return postings[nentries - 1];
+    }
+
+    inline bool posting_node::decode_next(const uint8_t*& ptr,
+                                          const uint8_t* end,
+                                          uint64_t& last)
+    {
+      uint64_t delta = 0;
+      for (unsigned shift = 0; (ptr < end) && (shift < 64); shift += 7) {
+        uint8_t b = *ptr++;
+
+        delta |= static_cast<uint64_t>(b & 0x7f) << shift;
+
+        if ((b & 0x80) == 0) {
+          last += delta;
+          return true;
+        }
+      }
+
+      return false;
+    }
+  }
+}
+
+#endif // DB_INDEX_POSTING_NODE_H
@@ -0,0 +1,28 @@
+#ifndef DB_INDEX_PROBES_H
+#define DB_INDEX_PROBES_H
+
+// Static tracepoints (USDT, provider `db_index`) for perf and bpftrace, e.g.:
+//   bpftrace -e 'usdt:./testindex:db_index:leaf_split { @[arg2] = count(); }'
+// They are built in when <sys/sdt.h> is available (systemtap-sdt-dev on
+// Debian), unless DB_INDEX_NO_PROBES is defined. A probe which is not
+// attached is a single nop instruction; otherwise the macros expand to
+// nothing.
+#if (!defined(DB_INDEX_NO_PROBES)) && (defined(__has_include))
+  #if __has_include(<sys/sdt.h>)
+    #include <sys/sdt.h>
+    #define DB_INDEX_HAVE_PROBES 1
+  #endif
+#endif
+
+#ifdef DB_INDEX_HAVE_PROBES
+  #define DB_INDEX_PROBE1(name, a1) DTRACE_PROBE1(db_index, name, a1)
+  #define DB_INDEX_PROBE2(name, a1, a2) DTRACE_PROBE2(db_index, name, a1, a2)
+  #define DB_INDEX_PROBE3(name, a1, a2, a3)                                  \
+    DTRACE_PROBE3(db_index, name, a1, a2, a3)
+#else
+  #define DB_INDEX_PROBE1(name, a1) do {} while (0)
+  #define DB_INDEX_PROBE2(name, a1, a2) do {} while (0)
+  #define DB_INDEX_PROBE3(name, a1, a2, a3) do {} while (0)
+#endif
+
+#endif // DB_INDEX_PROBES_H
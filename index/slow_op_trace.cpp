@@ -0,0 +1,64 @@
+#include "index/slow_op_trace.h"
+
+db::index::slow_op_trace::slow_op_trace()
+  : count_(0)
+{
+  pthread_mutex_init(&mutex_, NULL);
+}
+
+db::index::slow_op_trace::~slow_op_trace()
+{
+  pthread_mutex_destroy(&mutex_);
+}
+
+void db::index::slow_op_trace::record(statistics::operation op,
+                                      uint64_t time,
+                                      uint64_t latency,
+                                      const statistics& counters)
+{
+  pthread_mutex_lock(&mutex_);
+
+  entry& e = entries_[count_ % kCapacity];
+  e.op = op;
+  e.time = time;
+  e.latency = latency;
+  e.counters = counters;
+
+  count_++;
+
+  pthread_mutex_unlock(&mutex_);
+}
+
+size_t db::index::slow_op_trace::get(entry* entries, size_t max) const
+{
+  pthread_mutex_lock(&mutex_);
+
+  uint64_t n = (count_ < kCapacity) ? count_ : kCapacity;
+  if (n > max) {
+    n = max;
+  }
+
+  for (uint64_t i = 0; i < n; i++) {
+    entries[i] = entries_[(count_ - n + i) % kCapacity];
+  }
+
+  pthread_mutex_unlock(&mutex_);
+
+  return static_cast<size_t>(n);
+}
+
+uint64_t db::index::slow_op_trace::count() const
+{
+  pthread_mutex_lock(&mutex_);
+  uint64_t n = count_;
+  pthread_mutex_unlock(&mutex_);
+
+  return n;
+}
+
+void db::index::slow_op_trace::clear()
+{
+  pthread_mutex_lock(&mutex_);
+  count_ = 0;
+  pthread_mutex_unlock(&mutex_);
+}
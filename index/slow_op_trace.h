@@ -0,0 +1,66 @@
+#ifndef DB_INDEX_SLOW_OP_TRACE_H
+#define DB_INDEX_SLOW_OP_TRACE_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include "index/statistics.h"
+
+namespace db {
+  namespace index {
+    // Trace of the slowest operations: the latest kCapacity operations
+    // whose latency was above a threshold, with the work they did.
+    class slow_op_trace {
+      public:
+        static const size_t kCapacity = 64;
+
+        // Slow operation.
+        struct entry {
+          // Operation type.
+          statistics::operation op;
+
+          // Start of the operation (ns since the epoch).
+          uint64_t time;
+
+          // Latency (ns).
+          uint64_t latency;
+
+          // Work done by the operation: depth walked (descents and nodes
+          // read), splits, defragmentations, remaps and growth of the file,
+          // flushes of the message buffers...
+          statistics counters;
+        };
+
+        // Constructor.
+        slow_op_trace();
+
+        // Destructor.
+        ~slow_op_trace();
+
+        // Add operation.
+        void record(statistics::operation op,
+                    uint64_t time,
+                    uint64_t latency,
+                    const statistics& counters);
+
+        // Get up to `max` operations (the latest ones, oldest first).
+        // Returns the number of operations.
+        size_t get(entry* entries, size_t max) const;
+
+        // Get number of operations recorded.
+        uint64_t count() const;
+
+        // Remove the operations.
+        void clear();
+
+      private:
+        entry entries_[kCapacity];
+
+        // Number of operations recorded.
+        uint64_t count_;
+
+        mutable pthread_mutex_t mutex_;
+    };
+  }
+}
+
+#endif // DB_INDEX_SLOW_OP_TRACE_H
@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <string.h>
+#include "index/statistics.h"
+
+thread_local db::index::statistics* db::index::statistics::current_ = NULL;
+
+// Counters of the current operation of the thread.
+static thread_local db::index::statistics block;
+
+// Add to a counter which might be read or added to by other threads.
+static void add_counter(uint64_t& counter, const uint64_t& n);
+
+bool db::index::statistics::begin()
+{
+  // If the thread is counting another operation...
+  if (current_) {
+    return false;
+  }
+
+  block.clear();
+  current_ = &block;
+
+  return true;
+}
+
+void db::index::statistics::end(statistics& stats)
+{
+  stats.add(block);
+  current_ = NULL;
+}
+
+const char* db::index::statistics::name(operation op)
+{
+  switch (op) {
+    case operation::kAdd:
+      return "add";
+    case operation::kFind:
+      return "find";
+    case operation::kErase:
+      return "erase";
+    case operation::kUpdate:
+      return "update";
+    case operation::kPosting:
+      return "posting";
+    case operation::kWrite:
+      return "write";
+    case operation::kFlush:
+      return "flush";
+    case operation::kScan:
+      return "scan";
+    case operation::kMaintenance:
+      return "maintenance";
+  }
+
+  return "unknown";
+}
+
+void db::index::statistics::clear()
+{
+  memset(this, 0, sizeof(statistics));
+}
+
+void db::index::statistics::add(const statistics& other)
+{
+  add_counter(lookups, other.lookups);
+  add_counter(descents, other.descents);
+  add_counter(node_visits, other.node_visits);
+  add_counter(comparisons, other.comparisons);
+  add_counter(cache_hits, other.cache_hits);
+  add_counter(model_hits, other.model_hits);
+  add_counter(leaf_splits, other.leaf_splits);
+  add_counter(inner_splits, other.inner_splits);
+  add_counter(defrags, other.defrags);
+  add_counter(remaps, other.remaps);
+  add_counter(remapped_bytes, other.remapped_bytes);
+  add_counter(deleted_skipped, other.deleted_skipped);
+  add_counter(buffer_flushes, other.buffer_flushes);
+}
+
+void db::index::statistics::print() const
+{
+  printf("Lookups: %lu.\n", lookups);
+  printf("Descents: %lu.\n", descents);
+  printf("Node visits: %lu (%.2f per descent).\n",
+         node_visits,
+         (descents > 0) ? static_cast<double>(node_visits) / descents : 0);
+  printf("Comparisons: %lu (%.2f per descent).\n",
+         comparisons,
+         (descents > 0) ? static_cast<double>(comparisons) / descents : 0);
+  printf("Cache hits: %lu.\n", cache_hits);
+  printf("Model hits: %lu.\n", model_hits);
+  printf("Leaf splits: %lu.\n", leaf_splits);
+  printf("Inner splits: %lu.\n", inner_splits);
+  printf("Defragmentations: %lu.\n", defrags);
+  printf("Remaps: %lu (%lu bytes).\n", remaps, remapped_bytes);
+  printf("Deleted entries skipped: %lu.\n", deleted_skipped);
+  printf("Message buffer flushes: %lu.\n", buffer_flushes);
+}
+
+void add_counter(uint64_t& counter, const uint64_t& n)
+{
+  uint64_t value;
+  if ((value = __atomic_load_n(&n, __ATOMIC_RELAXED)) != 0) {
+    __atomic_fetch_add(&counter, value, __ATOMIC_RELAXED);
+  }
+}
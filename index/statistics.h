@@ -0,0 +1,125 @@
+#ifndef DB_INDEX_STATISTICS_H
+#define DB_INDEX_STATISTICS_H
+
+#include <stdint.h>
+
+// The counters are only maintained when the library is built with
+// -DDB_INDEX_STATS (make STATS=1): otherwise the macros below expand to
+// nothing and the counters stay at zero.
+#ifdef DB_INDEX_STATS
+  // Add `n` to the counter of the current operation of the thread (if any).
+  #define DB_INDEX_COUNT(counter, n)                                         \
+    do {                                                                     \
+      db::index::statistics* s_ = db::index::statistics::current();         \
+      if (s_) {                                                              \
+        s_->counter += (n);                                                  \
+      }                                                                      \
+    } while (0)
+#else
+  #define DB_INDEX_COUNT(counter, n) do {} while (0)
+#endif
+
+namespace db {
+  namespace index {
+    // Counters of the work done by an index.
+    struct statistics {
+      // Lookups of a key in the tree (find()).
+      uint64_t lookups;
+
+      // Searches of a leaf node from the root or from the cache of the
+      // upper levels.
+      uint64_t descents;
+
+      // Nodes read (inner, leaf and posting nodes).
+      uint64_t node_visits;
+
+      // Key comparisons in the leaf and inner nodes.
+      uint64_t comparisons;
+
+      // Descents which started at a node of the cache of the upper levels.
+      uint64_t cache_hits;
+
+      // Lookups answered by the learned model.
+      uint64_t model_hits;
+
+      // Splits of leaf and inner nodes.
+      uint64_t leaf_splits;
+      uint64_t inner_splits;
+
+      // Defragmentations of leaf and inner nodes.
+      uint64_t defrags;
+
+      // Remappings of the file when it grows, and size of the mappings
+      // which were remapped.
+      uint64_t remaps;
+      uint64_t remapped_bytes;
+
+      // Entries marked as deleted skipped by the iterators.
+      uint64_t deleted_skipped;
+
+      // Message buffers pushed down to the leaf nodes.
+      uint64_t buffer_flushes;
+
+      // Operation types (for the latencies).
+      enum class operation : uint8_t {
+        kAdd,
+        kFind, // Also rank() and select().
+        kErase,
+        kUpdate, // upsert() and update().
+        kPosting,
+        kWrite,
+        kFlush, // Also checkpoint().
+        kScan, // Iterators.
+        kMaintenance // Rebuild of the filter, garbage collection, training
+                     // of the learned model.
+      };
+
+      // Number of operation types.
+      static const size_t kOperations = 9;
+
+      // Constructor.
+      statistics();
+
+      // Reset the counters.
+      void clear();
+
+      // Add the counters of `other` (relaxed atomic operations: the
+      // counters can be added and read by several threads).
+      void add(const statistics& other);
+
+      // Print.
+      void print() const;
+
+      // Get the counters of the current operation of the thread (NULL if
+      // there is none).
+      static statistics* current();
+
+      // Start counting an operation of the thread, in a block of the thread
+      // (no atomic operations). Returns false if the thread is already
+      // counting an operation (the nested operation is part of it).
+      static bool begin();
+
+      // Stop counting the operation of the thread, adding its counters to
+      // `stats`.
+      static void end(statistics& stats);
+
+      // Get name of the operation type.
+      static const char* name(operation op);
+
+      private:
+        static thread_local statistics* current_;
+    };
+
+    inline statistics::statistics()
+    {
+      clear();
+    }
+
+    inline statistics* statistics::current()
+    {
+      return current_;
+    }
+  }
+}
+
+#endif // DB_INDEX_STATISTICS_H
@@ -0,0 +1,291 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "index/value_log.h"
+
+const uint8_t db::index::value_log::kMagic[8] = {
+  'V',
+  'A',
+  'L',
+  'U',
+  'E',
+  'L',
+  'O',
+  'G'
+};
+
+bool db::index::value_log::open(const char* filename, uint64_t segment_size)
+{
+  if ((segment_size <= kHeaderSize) ||
+      ((filename_ = strdup(filename)) == NULL)) {
+    return false;
+  }
+
+  // If the file exists...
+  struct stat sbuf;
+  if (stat(filename, &sbuf) == 0) {
+    if (static_cast<uint64_t>(sbuf.st_size) != kHeaderSize) {
+      return false;
+    }
+
+    // Open file for reading/writing.
+    if ((fd_ = ::open(filename, O_RDWR)) == -1) {
+      return false;
+    }
+  } else {
+    // Create file.
+    if (((fd_ = ::open(filename, O_CREAT | O_RDWR, 0644)) == -1) ||
+        (ftruncate(fd_, kHeaderSize) != 0)) {
+      return false;
+    }
+  }
+
+  if ((data_ = mmap(NULL,
+                    kHeaderSize,
+                    PROT_READ | PROT_WRITE,
+                    MAP_SHARED,
+                    fd_,
+                    0)) == MAP_FAILED) {
+    return false;
+  }
+
+  header_ = reinterpret_cast<header*>(data_);
+
+  // New log?
+  if (header_->nsegments == 0) {
+    memcpy(header_->magic, kMagic, sizeof(kMagic));
+    header_->segment_size = segment_size;
+
+    // Create first segment.
+    return open_segment(0, true);
+  } else if (memcmp(header_->magic, kMagic, sizeof(kMagic)) != 0) {
+    return false;
+  }
+
+  // Open segments (the ones which have been garbage collected don't exist
+  // anymore).
+  for (uint32_t i = 0; i < header_->nsegments; i++) {
+    if ((!open_segment(i, false)) && (i + 1 == header_->nsegments)) {
+      // The last segment must exist.
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void db::index::value_log::close()
+{
+  if (segments_) {
+    for (uint32_t i = 0; i < size_; i++) {
+      close_segment(i);
+    }
+
+    free(segments_);
+    segments_ = NULL;
+  }
+
+  size_ = 0;
+
+  if (data_ != MAP_FAILED) {
+    munmap(data_, kHeaderSize);
+    data_ = MAP_FAILED;
+  }
+
+  if (fd_ != -1) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+
+  if (filename_) {
+    free(filename_);
+    filename_ = NULL;
+  }
+}
+
+bool db::index::value_log::append(const void* value,
+                                  uint32_t len,
+                                  pointer& ptr)
+{
+  // The value must fit in a segment.
+  if (kHeaderSize + len > header_->segment_size) {
+    return false;
+  }
+
+  uint32_t n = header_->nsegments - 1;
+
+  segment_header* s = get_segment(n);
+
+  // If the value doesn't fit in the last segment...
+  if (s->used + len > header_->segment_size) {
+    // Create a new segment.
+    if (!open_segment(++n, true)) {
+      return false;
+    }
+
+    s = get_segment(n);
+  }
+
+  memcpy(reinterpret_cast<uint8_t*>(s) + s->used, value, len);
+
+  ptr.segment = n;
+  ptr.length = len;
+  ptr.offset = s->used;
+
+  s->used += len;
+  s->live += len;
+
+  return true;
+}
+
+void db::index::value_log::release(const pointer& ptr)
+{
+  segment_header* s;
+  if ((s = get_segment(ptr.segment)) != NULL) {
+    s->live -= ptr.length;
+  }
+}
+
+bool db::index::value_log::collectable(uint32_t segment,
+                                       double threshold) const
+{
+  const segment_header* s;
+  if ((segment + 1 < header_->nsegments) &&
+      ((s = get_segment(segment)) != NULL)) {
+    return (s->live < threshold * (s->used - kHeaderSize));
+  }
+
+  return false;
+}
+
+bool db::index::value_log::remove(uint32_t segment)
+{
+  // The last segment cannot be removed.
+  if ((segment + 1 < header_->nsegments) && (get_segment(segment))) {
+    close_segment(segment);
+
+    char path[PATH_MAX];
+    return ((segment_filename(segment, path, sizeof(path))) &&
+            (unlink(path) == 0));
+  }
+
+  return false;
+}
+
+void db::index::value_log::usage(uint64_t& used, uint64_t& live) const
+{
+  used = 0;
+  live = 0;
+
+  for (uint32_t i = 0; i < size_; i++) {
+    const segment_header* s;
+    if ((s = get_segment(i)) != NULL) {
+      used += s->used - kHeaderSize;
+      live += s->live;
+    }
+  }
+}
+
+bool db::index::value_log::open_segment(uint32_t n, bool create)
+{
+  // Make room for the segment.
+  if (n >= size_) {
+    uint32_t size = (size_ == 0) ? 16 : size_;
+    while (size <= n) {
+      size *= 2;
+    }
+
+    segment* segments;
+    if ((segments = reinterpret_cast<segment*>(
+                      realloc(segments_, size * sizeof(segment))
+                    )) == NULL) {
+      return false;
+    }
+
+    for (uint32_t i = size_; i < size; i++) {
+      segments[i].fd = -1;
+      segments[i].data = MAP_FAILED;
+    }
+
+    segments_ = segments;
+    size_ = size;
+  }
+
+  char path[PATH_MAX];
+  if (!segment_filename(n, path, sizeof(path))) {
+    return false;
+  }
+
+  segment* s = segments_ + n;
+
+  if (create) {
+    // The segment is a sparse file, the values are appended to the mapping.
+    if (((s->fd = ::open(path, O_CREAT | O_TRUNC | O_RDWR, 0644)) == -1) ||
+        (ftruncate(s->fd, header_->segment_size) != 0)) {
+      close_segment(n);
+      return false;
+    }
+  } else {
+    struct stat sbuf;
+    if (((s->fd = ::open(path, O_RDWR)) == -1) ||
+        (fstat(s->fd, &sbuf) != 0) ||
+        (static_cast<uint64_t>(sbuf.st_size) != header_->segment_size)) {
+      close_segment(n);
+      return false;
+    }
+  }
+
+  if ((s->data = mmap(NULL,
+                      header_->segment_size,
+                      PROT_READ | PROT_WRITE,
+                      MAP_SHARED,
+                      s->fd,
+                      0)) == MAP_FAILED) {
+    close_segment(n);
+    return false;
+  }
+
+  segment_header* h = reinterpret_cast<segment_header*>(s->data);
+
+  if (create) {
+    memcpy(h->magic, kMagic, sizeof(kMagic));
+    h->used = kHeaderSize;
+    h->live = 0;
+
+    header_->nsegments = n + 1;
+  } else if ((memcmp(h->magic, kMagic, sizeof(kMagic)) != 0) ||
+             (h->used < kHeaderSize) ||
+             (h->used > header_->segment_size)) {
+    close_segment(n);
+    return false;
+  }
+
+  return true;
+}
+
+void db::index::value_log::close_segment(uint32_t n)
+{
+  segment* s = segments_ + n;
+
+  if (s->data != MAP_FAILED) {
+    munmap(s->data, header_->segment_size);
+    s->data = MAP_FAILED;
+  }
+
+  if (s->fd != -1) {
+    ::close(s->fd);
+    s->fd = -1;
+  }
+}
+
+bool db::index::value_log::segment_filename(uint32_t n,
+                                            char* path,
+                                            size_t size) const
+{
+  return (static_cast<size_t>(snprintf(path, size, "%s.%u", filename_, n)) <
+          size);
+}
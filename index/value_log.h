@@ -0,0 +1,158 @@
+#ifndef DB_INDEX_VALUE_LOG_H
+#define DB_INDEX_VALUE_LOG_H
+
+#include <stddef.h>
+#include <sys/mman.h>
+#include "types.h"
+
+namespace db {
+  namespace index {
+    // Log of values, split in segments (files `<filename>.<segment>`).
+    // Values are appended to the last segment; segments with few live values
+    // are garbage collected by moving their live values to the last segment.
+    class value_log {
+      public:
+        // Location of a value in the log.
+        struct pointer {
+          // Segment.
+          uint32_t segment;
+
+          // Length of the value.
+          uint32_t length;
+
+          // Offset of the value in the segment.
+          uint64_t offset;
+        } __attribute__((packed));
+
+        // Constructor.
+        value_log();
+
+        // Destructor.
+        ~value_log();
+
+        // Open (creates the log if it doesn't exist).
+        bool open(const char* filename, uint64_t segment_size);
+
+        // Close.
+        void close();
+
+        // Append value.
+        bool append(const void* value, uint32_t len, pointer& ptr);
+
+        // Get value (NULL if the pointer is not valid).
+        const void* get(const pointer& ptr) const;
+
+        // Mark the value as no longer referenced.
+        void release(const pointer& ptr);
+
+        // Get number of segments (including the removed ones).
+        uint32_t nsegments() const;
+
+        // Should the segment be garbage collected (it is not the last one and
+        // the ratio of live bytes is below the threshold)?
+        bool collectable(uint32_t segment, double threshold) const;
+
+        // Remove segment.
+        bool remove(uint32_t segment);
+
+        // Get number of bytes used by the segments / by the live values.
+        void usage(uint64_t& used, uint64_t& live) const;
+
+      private:
+        static const uint8_t kMagic[8];
+
+        // Size of the header of the segments and of the log file.
+        static const uint64_t kHeaderSize = 64;
+
+        // Header of the log file.
+        struct header {
+          uint8_t magic[8];
+
+          // Number of segments.
+          uint32_t nsegments;
+
+          uint32_t reserved;
+
+          // Maximum size of a segment.
+          uint64_t segment_size;
+        };
+
+        // Header of a segment.
+        struct segment_header {
+          uint8_t magic[8];
+
+          // Number of bytes used (offset where the next value is appended).
+          uint64_t used;
+
+          // Number of bytes used by the values which are still referenced.
+          uint64_t live;
+        };
+
+        struct segment {
+          int fd;
+          void* data;
+        };
+
+        char* filename_;
+
+        int fd_;
+        void* data_;
+
+        header* header_;
+
+        segment* segments_;
+        uint32_t size_;
+
+        // Open segment.
+        bool open_segment(uint32_t n, bool create);
+
+        // Close segment.
+        void close_segment(uint32_t n);
+
+        // Get segment header (NULL if the segment doesn't exist).
+        segment_header* get_segment(uint32_t n) const;
+
+        // Build segment filename.
+        bool segment_filename(uint32_t n, char* path, size_t size) const;
+    };
+
+    inline value_log::value_log()
+      : filename_(NULL),
+        fd_(-1),
+        data_(MAP_FAILED),
+        segments_(NULL),
+        size_(0)
+    {
+    }
+
+    inline value_log::~value_log()
+    {
+      close();
+    }
+
+    inline const void* value_log::get(const pointer& ptr) const
+    {
+      const segment_header* s;
+      if (((s = get_segment(ptr.segment)) != NULL) &&
+          (ptr.offset + ptr.length <= s->used)) {
+        return reinterpret_cast<const uint8_t*>(s) + ptr.offset;
+      }
+
+      return NULL;
+    }
+
+    inline uint32_t value_log::nsegments() const
+    {
+      return header_->nsegments;
+    }
+
+    inline value_log::segment_header* value_log::get_segment(uint32_t n) const
+    {
+      return ((n < size_) && (segments_[n].data != MAP_FAILED)) ?
+               reinterpret_cast<segment_header*>(segments_[n].data) :
+               NULL;
+    }
+  }
+}
+
+#endif // DB_INDEX_VALUE_LOG_H
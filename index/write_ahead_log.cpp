@@ -0,0 +1,132 @@
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "index/write_ahead_log.h"
+
+const uint8_t db::index::write_ahead_log::kMagic[8] = {
+  'W',
+  'R',
+  'I',
+  'T',
+  'E',
+  'L',
+  'O',
+  'G'
+};
+
+bool db::index::write_ahead_log::open(const char* filename)
+{
+  if ((fd_ = ::open(filename, O_CREAT | O_RDWR, 0644)) == -1) {
+    return false;
+  }
+
+  struct stat sbuf;
+  if (fstat(fd_, &sbuf) != 0) {
+    return false;
+  }
+
+  size_ = sbuf.st_size;
+
+  return true;
+}
+
+void db::index::write_ahead_log::close()
+{
+  if (fd_ != -1) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+
+  size_ = 0;
+}
+
+bool db::index::write_ahead_log::append(const write_batch& batch)
+{
+  batch_header header;
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.size = batch.size();
+  header.checksum = checksum(batch.data(), batch.size());
+
+  struct iovec iov[2];
+  iov[0].iov_base = &header;
+  iov[0].iov_len = sizeof(batch_header);
+  iov[1].iov_base = const_cast<void*>(batch.data());
+  iov[1].iov_len = batch.size();
+
+  uint64_t len = sizeof(batch_header) + batch.size();
+
+  // Write the batch after the last one and make it durable (on failure,
+  // the next batch overwrites what might have been written).
+  if ((pwritev(fd_, iov, 2, size_) == static_cast<ssize_t>(len)) &&
+      (fdatasync(fd_) == 0)) {
+    size_ += len;
+    return true;
+  }
+
+  return false;
+}
+
+bool db::index::write_ahead_log::read(uint64_t& off, write_batch& batch) const
+{
+  // If the header is incomplete...
+  batch_header header;
+  if ((off + sizeof(batch_header) > size_) ||
+      (pread(fd_, &header, sizeof(batch_header), off) !=
+       static_cast<ssize_t>(sizeof(batch_header))) ||
+      (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) ||
+      (header.size > size_ - off - sizeof(batch_header))) {
+    return false;
+  }
+
+  void* data;
+  if ((data = malloc(header.size + 1)) == NULL) {
+    return false;
+  }
+
+  bool ret = ((pread(fd_, data, header.size, off + sizeof(batch_header)) ==
+               static_cast<ssize_t>(header.size)) &&
+              (checksum(data, header.size) == header.checksum) &&
+              (batch.load(data, header.size)));
+
+  free(data);
+
+  if (ret) {
+    off += sizeof(batch_header) + header.size;
+  }
+
+  return ret;
+}
+
+bool db::index::write_ahead_log::truncate()
+{
+  if ((ftruncate(fd_, 0) == 0) && (fdatasync(fd_) == 0)) {
+    size_ = 0;
+    return true;
+  }
+
+  return false;
+}
+
+uint64_t db::index::write_ahead_log::checksum(const void* data, uint64_t size)
+{
+  // FNV-1a of the size and of the data.
+  static const uint64_t kPrime = 0x100000001b3ull;
+
+  uint64_t h = 0xcbf29ce484222325ull;
+
+  for (unsigned i = 0; i < sizeof(uint64_t); i++) {
+    h = (h ^ ((size >> (i * 8)) & 0xff)) * kPrime;
+  }
+
+  const uint8_t* ptr = reinterpret_cast<const uint8_t*>(data);
+  const uint8_t* end = ptr + size;
+
+  for (; ptr < end; ptr++) {
+    h = (h ^ *ptr) * kPrime;
+  }
+
+  return h;
+}
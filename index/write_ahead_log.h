@@ -0,0 +1,79 @@
+#ifndef DB_INDEX_WRITE_AHEAD_LOG_H
+#define DB_INDEX_WRITE_AHEAD_LOG_H
+
+#include <stddef.h>
+#include "index/write_batch.h"
+
+namespace db {
+  namespace index {
+    // Log of write batches. A batch is durable once it has been appended;
+    // a batch which was being appended when the process crashed is detected
+    // by its checksum and ignored.
+    class write_ahead_log {
+      public:
+        // Constructor.
+        write_ahead_log();
+
+        // Destructor.
+        ~write_ahead_log();
+
+        // Open (creates the log if it doesn't exist).
+        bool open(const char* filename);
+
+        // Close.
+        void close();
+
+        // Append the operations of the batch and sync them to disk.
+        bool append(const write_batch& batch);
+
+        // Read the batch at offset `off` (0: first batch) and move `off` to
+        // the next batch. Returns false at the end of the log or if the batch
+        // is incomplete.
+        bool read(uint64_t& off, write_batch& batch) const;
+
+        // Remove all the batches.
+        bool truncate();
+
+        // Get size of the log.
+        uint64_t size() const;
+
+      private:
+        static const uint8_t kMagic[8];
+
+        // Header of a batch (followed by the operations).
+        struct batch_header {
+          uint8_t magic[8];
+
+          // Size of the operations.
+          uint64_t size;
+
+          // Checksum of the size and of the operations.
+          uint64_t checksum;
+        };
+
+        int fd_;
+        uint64_t size_;
+
+        // Compute checksum.
+        static uint64_t checksum(const void* data, uint64_t size);
+    };
+
+    inline write_ahead_log::write_ahead_log()
+      : fd_(-1),
+        size_(0)
+    {
+    }
+
+    inline write_ahead_log::~write_ahead_log()
+    {
+      close();
+    }
+
+    inline uint64_t write_ahead_log::size() const
+    {
+      return size_;
+    }
+  }
+}
+
+#endif // DB_INDEX_WRITE_AHEAD_LOG_H
@@ -0,0 +1,136 @@
+#include <stdlib.h>
+#include <string.h>
+#include "index/write_batch.h"
+#include "index/node.h"
+#include "constants.h"
+
+db::index::write_batch::~write_batch()
+{
+  if (data_) {
+    free(data_);
+  }
+
+  if (records_) {
+    free(records_);
+  }
+}
+
+bool db::index::write_batch::append(op_type type,
+                                    const void* key,
+                                    keylen_t keylen,
+                                    uint64_t dataoff)
+{
+  // If the key is too short or too long...
+  if ((keylen < kKeyMinLen) || (keylen > kKeyMaxLen)) {
+    return false;
+  }
+
+  // Make room for the operation.
+  size_t len = sizeof(record) + keylen;
+  if (used_ + len > size_) {
+    size_t size = (size_ > 0) ? size_ : kInitialSize;
+    while (used_ + len > size) {
+      size *= 2;
+    }
+
+    uint8_t* data;
+    if ((data = reinterpret_cast<uint8_t*>(realloc(data_, size))) == NULL) {
+      return false;
+    }
+
+    data_ = data;
+    size_ = size;
+  }
+
+  if (count_ == capacity_) {
+    size_t capacity = (capacity_ > 0) ? capacity_ * 2 : kInitialCount;
+
+    size_t* records;
+    if ((records = reinterpret_cast<size_t*>(
+                     realloc(records_, capacity * sizeof(size_t))
+                   )) == NULL) {
+      return false;
+    }
+
+    records_ = records;
+    capacity_ = capacity;
+  }
+
+  record* r = reinterpret_cast<record*>(data_ + used_);
+  r->dataoff = dataoff;
+  r->keylen = keylen;
+  r->type = static_cast<uint8_t>(type);
+
+  memcpy(data_ + used_ + sizeof(record), key, keylen);
+
+  records_[count_++] = used_;
+  used_ += len;
+
+  return true;
+}
+
+void db::index::write_batch::sort(comparator_t comp)
+{
+  comp_ = comp;
+
+  qsort_r(records_, count_, sizeof(size_t), compare_records, this);
+}
+
+bool db::index::write_batch::load(const void* data, size_t size)
+{
+  clear();
+
+  const uint8_t* ptr = reinterpret_cast<const uint8_t*>(data);
+  const uint8_t* end = ptr + size;
+
+  while (ptr < end) {
+    // If the operation is truncated...
+    if (static_cast<size_t>(end - ptr) < sizeof(record)) {
+      return false;
+    }
+
+    record r;
+    memcpy(&r, ptr, sizeof(record));
+
+    ptr += sizeof(record);
+
+    if ((static_cast<size_t>(end - ptr) < r.keylen) ||
+        (r.type > static_cast<uint8_t>(op_type::kErase))) {
+      return false;
+    }
+
+    if (!append(static_cast<op_type>(r.type), ptr, r.keylen, r.dataoff)) {
+      return false;
+    }
+
+    ptr += r.keylen;
+  }
+
+  return true;
+}
+
+int db::index::write_batch::compare_records(const void* r1,
+                                            const void* r2,
+                                            void* arg)
+{
+  const write_batch* batch = reinterpret_cast<const write_batch*>(arg);
+
+  size_t off1 = *reinterpret_cast<const size_t*>(r1);
+  size_t off2 = *reinterpret_cast<const size_t*>(r2);
+
+  const uint8_t* data = batch->data_;
+
+  int ret;
+  if ((ret = db::index::compare(
+               batch->comp_,
+               data + off1 + sizeof(record),
+               reinterpret_cast<const record*>(data + off1)->keylen,
+               data + off2 + sizeof(record),
+               reinterpret_cast<const record*>(data + off2)->keylen
+             )) != 0) {
+    return ret;
+  }
+
+  // Same key: keep the order in which the operations were added.
+  return (off1 < off2) ? -1 : ((off1 > off2) ? 1 : 0);
+}
@@ -0,0 +1,174 @@
+#ifndef DB_INDEX_WRITE_BATCH_H
+#define DB_INDEX_WRITE_BATCH_H
+
+#include <stddef.h>
+#include "types.h"
+
+namespace db {
+  namespace index {
+    // Operations (add / erase) which are applied to an index together (see
+    // index::write()). If a key appears several times, the last operation
+    // wins.
+    class write_batch {
+      public:
+        // Type of operation.
+        enum class op_type : uint8_t {
+          kAdd,
+          kErase
+        };
+
+        // Constructor.
+        write_batch();
+
+        // Destructor.
+        ~write_batch();
+
+        // Add key.
+        bool add(const void* key, keylen_t keylen, uint64_t dataoff);
+
+        // Erase key.
+        bool erase(const void* key, keylen_t keylen);
+
+        // Remove all the operations.
+        void clear();
+
+        // Get number of operations.
+        size_t count() const;
+
+        // Get type of the operation at index.
+        op_type type(size_t i) const;
+
+        // Get key of the operation at index.
+        const void* key(size_t i) const;
+
+        // Get key length of the operation at index.
+        keylen_t keylen(size_t i) const;
+
+        // Get data offset of the operation at index.
+        uint64_t data_offset(size_t i) const;
+
+        // Sort the operations by key (the operations on the same key keep
+        // their order).
+        void sort(comparator_t comp);
+
+        // Get the serialized operations.
+        const void* data() const;
+
+        // Get size of the serialized operations.
+        size_t size() const;
+
+        // Replace the operations with serialized ones.
+        bool load(const void* data, size_t size);
+
+      private:
+        // Initial size of the buffer.
+        static const size_t kInitialSize = 4 * 1024;
+
+        // Initial number of operations.
+        static const size_t kInitialCount = 64;
+
+        // Operation (followed by the key).
+        struct record {
+          uint64_t dataoff;
+          keylen_t keylen;
+          uint8_t type;
+        } __attribute__((packed));
+
+        // Serialized operations.
+        uint8_t* data_;
+        size_t size_;
+        size_t used_;
+
+        // Offsets of the operations in `data_` (in order of application).
+        size_t* records_;
+        size_t capacity_;
+        size_t count_;
+
+        // Comparator used while sorting.
+        comparator_t comp_;
+
+        // Append operation.
+        bool append(op_type type,
+                    const void* key,
+                    keylen_t keylen,
+                    uint64_t dataoff);
+
+        // Get operation at index.
+        const record* get(size_t i) const;
+
+        // Compare two operations (`arg` is the batch).
+        static int compare_records(const void* r1, const void* r2, void* arg);
+    };
+
+    inline write_batch::write_batch()
+      : data_(NULL),
+        size_(0),
+        used_(0),
+        records_(NULL),
+        capacity_(0),
+        count_(0),
+        comp_(NULL)
+    {
+    }
+
+    inline bool write_batch::add(const void* key,
+                                 keylen_t keylen,
+                                 uint64_t dataoff)
+    {
+      return append(op_type::kAdd, key, keylen, dataoff);
+    }
+
+    inline bool write_batch::erase(const void* key, keylen_t keylen)
+    {
+      return append(op_type::kErase, key, keylen, 0);
+    }
+
+    inline void write_batch::clear()
+    {
+      used_ = 0;
+      count_ = 0;
+    }
+
+    inline size_t write_batch::count() const
+    {
+      return count_;
+    }
+
+    inline const write_batch::record* write_batch::get(size_t i) const
+    {
+      return reinterpret_cast<const record*>(data_ + records_[i]);
+    }
+
+    inline write_batch::op_type write_batch::type(size_t i) const
+    {
+      return static_cast<op_type>(get(i)->type);
+    }
+
+    inline const void* write_batch::key(size_t i) const
+    {
+      return data_ + records_[i] + sizeof(record);
+    }
+
+    inline keylen_t write_batch::keylen(size_t i) const
+    {
+      return get(i)->keylen;
+    }
+
+    inline uint64_t write_batch::data_offset(size_t i) const
+    {
+      return get(i)->dataoff;
+    }
+
+    inline const void* write_batch::data() const
+    {
+      return data_;
+    }
+
+    inline size_t write_batch::size() const
+    {
+      return used_;
+    }
+  }
+}
+
+#endif // DB_INDEX_WRITE_BATCH_H
@@ -0,0 +1,89 @@
+#include <stdlib.h>
+#include <string.h>
+#include "key/decoder.h"
+
+bool db::key::decoder::get_double(double& d, order o)
+{
+  uint64_t n;
+  if (get(n, o)) {
+    // Undo the flipping of the bits.
+    n = ((n & 0x8000000000000000ull) != 0) ? n ^ 0x8000000000000000ull : ~n;
+
+    memcpy(&d, &n, sizeof(double));
+
+    return true;
+  }
+
+  return false;
+}
+
+bool db::key::decoder::get_string(void* s,
+                                  size_t size,
+                                  size_t& len,
+                                  order o)
+{
+  uint8_t mask = (o == order::kAscending) ? 0x00 : 0xff;
+
+  if ((pos_ == keylen_) || ((key_[pos_] ^ mask) != encoder::kValue)) {
+    return false;
+  }
+
+  uint8_t* str = reinterpret_cast<uint8_t*>(s);
+
+  len = 0;
+
+  for (keylen_t i = pos_ + 1; i < keylen_; i++) {
+    uint8_t c = key_[i] ^ mask;
+
+    if (c == 0x00) {
+      if (i + 1 == keylen_) {
+        return false;
+      }
+
+      uint8_t next = key_[i + 1] ^ mask;
+
+      // Terminator?
+      if (next == 0x01) {
+        pos_ = i + 2;
+        return true;
+      } else if (next != 0xff) {
+        return false;
+      }
+
+      // Escaped 0x00.
+      i++;
+    }
+
+    if (len < size) {
+      str[len] = c;
+    }
+
+    len++;
+  }
+
+  return false;
+}
+
+bool db::key::decoder::get(uint64_t& n, order o)
+{
+  if (pos_ + 1 + sizeof(uint64_t) > keylen_) {
+    return false;
+  }
+
+  uint8_t mask = (o == order::kAscending) ? 0x00 : 0xff;
+
+  const uint8_t* p = key_ + pos_;
+
+  if ((p[0] ^ mask) != encoder::kValue) {
+    return false;
+  }
+
+  n = 0;
+  for (size_t i = 1; i <= sizeof(uint64_t); i++) {
+    n = (n << 8) | static_cast<uint8_t>(p[i] ^ mask);
+  }
+
+  pos_ += 1 + sizeof(uint64_t);
+
+  return true;
+}
@@ -0,0 +1,93 @@
+#ifndef DB_KEY_DECODER_H
+#define DB_KEY_DECODER_H
+
+#include <stddef.h>
+#include "key/encoder.h"
+
+namespace db {
+  namespace key {
+    // Decodes keys built by the encoder (the columns have to be read in the
+    // same order and with the same types and orders they were added).
+    class decoder {
+      public:
+        // Constructor.
+        decoder(const void* key, keylen_t keylen);
+
+        // Is the next column null? (if so, it is skipped).
+        bool null(order o = order::kAscending);
+
+        // Get unsigned integer.
+        bool get_uint(uint64_t& n, order o = order::kAscending);
+
+        // Get signed integer.
+        bool get_int(int64_t& n, order o = order::kAscending);
+
+        // Get double.
+        bool get_double(double& d, order o = order::kAscending);
+
+        // Get string (`len` is the length of the string, only the first
+        // `size` bytes are copied).
+        bool get_string(void* s,
+                        size_t size,
+                        size_t& len,
+                        order o = order::kAscending);
+
+        // Has the whole key been decoded?
+        bool end() const;
+
+      private:
+        const uint8_t* key_;
+        keylen_t keylen_;
+
+        keylen_t pos_;
+
+        // Get tag and 64-bit big endian number.
+        bool get(uint64_t& n, order o);
+    };
+
+    inline decoder::decoder(const void* key, keylen_t keylen)
+      : key_(reinterpret_cast<const uint8_t*>(key)),
+        keylen_(keylen),
+        pos_(0)
+    {
+    }
+
+    inline bool decoder::null(order o)
+    {
+      uint8_t tag = (o == order::kAscending) ? encoder::kNull :
+                                               static_cast<uint8_t>(
+                                                 ~encoder::kNull
+                                               );
+
+      if ((pos_ < keylen_) && (key_[pos_] == tag)) {
+        pos_++;
+        return true;
+      }
+
+      return false;
+    }
+
+    inline bool decoder::get_uint(uint64_t& n, order o)
+    {
+      return get(n, o);
+    }
+
+    inline bool decoder::get_int(int64_t& n, order o)
+    {
+      uint64_t u;
+      if (get(u, o)) {
+        n = static_cast<int64_t>(u ^ (static_cast<uint64_t>(1) << 63));
+        return true;
+      }
+
+      return false;
+    }
+
+    inline bool decoder::end() const
+    {
+      return (pos_ == keylen_);
+    }
+  }
+}
+
+#endif // DB_KEY_DECODER_H
@@ -0,0 +1,91 @@
+#include <stdlib.h>
+#include <string.h>
+#include "key/encoder.h"
+
+bool db::key::encoder::add_double(double d, order o)
+{
+  uint64_t n;
+
+  if (d != d) {
+    // NaN.
+    n = 0x7ff8000000000000ull;
+  } else {
+    // -0.0 == 0.0.
+    if (d == 0.0) {
+      d = 0.0;
+    }
+
+    memcpy(&n, &d, sizeof(uint64_t));
+  }
+
+  // Negative numbers: flip all the bits, positive numbers: flip the sign bit.
+  n = ((n & 0x8000000000000000ull) != 0) ? ~n : n ^ 0x8000000000000000ull;
+
+  return add(n, o);
+}
+
+bool db::key::encoder::add_string(const void* s, size_t len, order o)
+{
+  const uint8_t* str = reinterpret_cast<const uint8_t*>(s);
+
+  // Tag + string + terminator (without escaping).
+  if (len_ + 1 + len + 2 > size_) {
+    return false;
+  }
+
+  size_t start = len_;
+
+  buf_[len_++] = kValue;
+
+  for (size_t i = 0; i < len; i++) {
+    buf_[len_++] = str[i];
+
+    // Escape 0x00.
+    if (str[i] == 0x00) {
+      if (len_ + (len - i - 1) + 3 > size_) {
+        len_ = start;
+        return false;
+      }
+
+      buf_[len_++] = 0xff;
+    }
+  }
+
+  // Terminator.
+  buf_[len_++] = 0x00;
+  buf_[len_++] = 0x01;
+
+  if (o == order::kDescending) {
+    for (size_t i = start; i < len_; i++) {
+      buf_[i] = ~buf_[i];
+    }
+  }
+
+  return true;
+}
+
+bool db::key::encoder::add(uint64_t n, order o)
+{
+  if (len_ + 1 + sizeof(uint64_t) > size_) {
+    return false;
+  }
+
+  uint8_t* p = buf_ + len_;
+
+  p[0] = kValue;
+
+  for (size_t i = sizeof(uint64_t); i > 0; i--) {
+    p[i] = static_cast<uint8_t>(n);
+    n >>= 8;
+  }
+
+  if (o == order::kDescending) {
+    for (size_t i = 0; i <= sizeof(uint64_t); i++) {
+      p[i] = ~p[i];
+    }
+  }
+
+  len_ += 1 + sizeof(uint64_t);
+
+  return true;
+}
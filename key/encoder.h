@@ -0,0 +1,118 @@
+#ifndef DB_KEY_ENCODER_H
+#define DB_KEY_ENCODER_H
+
+#include <stddef.h>
+#include "types.h"
+
+namespace db {
+  namespace key {
+    // Order of a column.
+    enum class order : uint8_t {
+      kAscending,
+      kDescending
+    };
+
+    // Encodes tuples into keys whose byte order (memcmp, the shorter key first
+    // if it is a prefix of the other) is the order of the tuples, so the
+    // index can compare them without a comparator.
+    //
+    // Each column starts with a tag (nulls sort before the values):
+    // * Unsigned integer: 8 bytes, big endian.
+    // * Signed integer: 8 bytes, big endian, with the sign bit flipped.
+    // * Double: 8 bytes, big endian; the sign bit is flipped for positive
+    //   numbers and all the bits for negative ones.
+    // * String: the bytes, with 0x00 escaped as 0x00 0xff, followed by the
+    //   terminator 0x00 0x01.
+    // The bytes of the descending columns (tag included) are inverted.
+    class encoder {
+      public:
+        // Tags.
+        static const uint8_t kNull = 0x01;
+        static const uint8_t kValue = 0x02;
+
+        // Constructor.
+        encoder(void* buf, size_t size);
+
+        // Start a new key.
+        void reset();
+
+        // Add null.
+        bool add_null(order o = order::kAscending);
+
+        // Add unsigned integer.
+        bool add_uint(uint64_t n, order o = order::kAscending);
+
+        // Add signed integer.
+        bool add_int(int64_t n, order o = order::kAscending);
+
+        // Add double (-0.0 is encoded as 0.0 and all the NaNs are encoded
+        // as the same value, greater than +infinity).
+        bool add_double(double d, order o = order::kAscending);
+
+        // Add string.
+        bool add_string(const void* s, size_t len, order o = order::kAscending);
+
+        // Get key.
+        const void* data() const;
+
+        // Get key length.
+        keylen_t length() const;
+
+      private:
+        uint8_t* buf_;
+        size_t size_;
+
+        size_t len_;
+
+        // Add tag and 64-bit big endian number.
+        bool add(uint64_t n, order o);
+    };
+
+    inline encoder::encoder(void* buf, size_t size)
+      : buf_(reinterpret_cast<uint8_t*>(buf)),
+        size_(size),
+        len_(0)
+    {
+    }
+
+    inline void encoder::reset()
+    {
+      len_ = 0;
+    }
+
+    inline bool encoder::add_null(order o)
+    {
+      if (len_ < size_) {
+        buf_[len_++] = (o == order::kAscending) ? kNull :
+                                                  static_cast<uint8_t>(~kNull);
+
+        return true;
+      }
+
+      return false;
+    }
+
+    inline bool encoder::add_uint(uint64_t n, order o)
+    {
+      return add(n, o);
+    }
+
+    inline bool encoder::add_int(int64_t n, order o)
+    {
+      return add(static_cast<uint64_t>(n) ^ (static_cast<uint64_t>(1) << 63),
+                 o);
+    }
+
+    inline const void* encoder::data() const
+    {
+      return buf_;
+    }
+
+    inline keylen_t encoder::length() const
+    {
+      return static_cast<keylen_t>(len_);
+    }
+  }
+}
+
+#endif // DB_KEY_ENCODER_H
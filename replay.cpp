@@ -0,0 +1,189 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "index/index.h"
+
+// Size of the segments of the value log of a new index.
+static const uint64_t kValueLogSegmentSize = 64 * 1024 * 1024;
+
+static const char* kOperations[] = {
+  "add",
+  "add (value)",
+  "erase",
+  "find",
+  "begin",
+  "next"
+};
+
+static const size_t kNumberOperations =
+  sizeof(kOperations) / sizeof(kOperations[0]);
+
+static void usage(const char* program);
+
+static uint64_t now();
+
+int main(int argc, const char** argv)
+{
+  if ((argc < 3) || (argc > 4)) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  bool timed = false;
+  if (argc == 4) {
+    if (strcasecmp(argv[3], "timed") == 0) {
+      timed = true;
+    } else if (strcasecmp(argv[3], "fast") != 0) {
+      usage(argv[0]);
+      return -1;
+    }
+  }
+
+  db::index::operation_trace trace;
+  if (!trace.open(argv[2])) {
+    fprintf(stderr, "Error opening trace '%s'.\n", argv[2]);
+    return -1;
+  }
+
+  // The trace is replayed against a copy of the index it was recorded
+  // with or against a new index.
+  db::index::index::options opts;
+  if (access(argv[1], F_OK) != 0) {
+    opts.value_log_segment_size = kValueLogSegmentSize;
+  }
+
+  db::index::index index;
+  if (!index.open(argv[1], opts)) {
+    fprintf(stderr, "Error opening index '%s'.\n", argv[1]);
+    return -1;
+  }
+
+  uint8_t* value = NULL;
+  uint64_t valuelen = 0;
+
+  db::index::index::iterator it;
+  bool valid = false;
+
+  uint64_t count[kNumberOperations] = {0};
+  uint64_t diverged[kNumberOperations] = {0};
+
+  uint64_t start = now();
+
+  db::index::operation_trace::record r;
+  while (trace.read(r)) {
+    // Wait until the time of the operation.
+    if (timed) {
+      uint64_t t = start + r.time;
+
+      struct timespec ts;
+      ts.tv_sec = t / 1000000000ull;
+      ts.tv_nsec = t % 1000000000ull;
+
+      while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0);
+    }
+
+    bool result;
+    uint64_t dataoff;
+
+    switch (r.type) {
+      case db::index::operation_trace::op_type::kAdd:
+        result = index.add(r.key, r.keylen, r.arg, NULL);
+        break;
+      case db::index::operation_trace::op_type::kAddValue:
+        // Values of the recorded length (their contents are not recorded).
+        if (r.arg > valuelen) {
+          uint8_t* tmp;
+          if ((tmp = static_cast<uint8_t*>(realloc(value, r.arg))) == NULL) {
+            fprintf(stderr, "Error allocating memory.\n");
+
+            free(value);
+            return -1;
+          }
+
+          memset(tmp + valuelen, 'v', r.arg - valuelen);
+
+          value = tmp;
+          valuelen = r.arg;
+        }
+
+        result = index.add(r.key,
+                           r.keylen,
+                           value,
+                           static_cast<uint32_t>(r.arg),
+                           NULL);
+
+        break;
+      case db::index::operation_trace::op_type::kErase:
+        result = index.erase(r.key, r.keylen, NULL);
+        break;
+      case db::index::operation_trace::op_type::kFind:
+        result = index.find(r.key, r.keylen, NULL, dataoff);
+        break;
+      case db::index::operation_trace::op_type::kBegin:
+        result = (valid = index.begin(it));
+        break;
+      case db::index::operation_trace::op_type::kNext:
+        result = (valid = ((valid) && (index.next(it))));
+        break;
+      default:
+        result = false;
+    }
+
+    size_t type = static_cast<size_t>(r.type);
+
+    count[type]++;
+    if (result != r.result) {
+      diverged[type]++;
+    }
+  }
+
+  uint64_t elapsed = now() - start;
+
+  free(value);
+
+  printf("Trace '%s'%s.\n",
+         argv[2],
+         trace.hashed_keys() ? " (hashed keys)" : "");
+
+  uint64_t total = 0;
+  uint64_t totaldiverged = 0;
+  for (size_t i = 0; i < kNumberOperations; i++) {
+    if (count[i] > 0) {
+      printf("  %-12s %10lu operations, %lu with a different result.\n",
+             kOperations[i],
+             count[i],
+             diverged[i]);
+
+      total += count[i];
+      totaldiverged += diverged[i];
+    }
+  }
+
+  printf("Replayed %lu operations in %.3f s (%.0f operations/s).\n",
+         total,
+         elapsed / 1e9,
+         (elapsed > 0) ? (total * 1e9) / elapsed : 0.0);
+
+  // The results only match if the index had the same keys as the recorded
+  // one when the trace started.
+  return (totaldiverged == 0) ? 0 : 1;
+}
+
+void usage(const char* program)
+{
+  printf("Usage: %s <index-filename> <trace-filename> [fast|timed]\n",
+         program);
+  printf("The index is created if it doesn't exist. \"fast\" (default) "
+         "replays the\noperations one after the other, \"timed\" with the "
+         "recorded timing.\n");
+}
+
+uint64_t now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (static_cast<uint64_t>(ts.tv_sec) * 1000000000ull) + ts.tv_nsec;
+}
@@ -2,17 +2,206 @@
 #include <string.h>
 #include <stdio.h>
 #include <limits.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <glob.h>
+#include <sys/wait.h>
 #include "index/index.h"
+#include "index/intersection.h"
+#include "index/merge.h"
 
 static const keylen_t kKeyMinLength = 20;
+static const char* kFilename = "index.idx";
+static const size_t kBatchSize = 256;
+static const uint64_t kValueLogSegmentSize = 1024 * 1024;
+
+// Number of leaf nodes visited by each step of the garbage collection.
+static const size_t kGarbageLeaves = 16;
+static const uint64_t kPostingKeys = 100;
+
+// Number of postings and maximum number of long keys added after them
+// (posting lists moved back to full leaf nodes).
+static const uint64_t kLongPostings = 40;
+static const uint64_t kFillKeys = 64;
+static const keylen_t kFillKeyLength = 100;
+static const uint64_t kMemtableSize = 256 * 1024;
+
+// Number of pages of the message buffers.
+static const unsigned kMessageBufferPages = 4;
+
+// Number of pages of large message buffers, and number and length of the
+// keys added with them (enough for splits above the buffered level).
+static const unsigned kLargeMessageBufferPages = 400;
+static const uint64_t kLargeBufferKeys = 5000;
+static const keylen_t kLargeBufferKeyLength = kKeyMaxLen;
+
+// Size of the copy of the upper levels of the tree.
+static const uint64_t kNodeCacheSize = 1024 * 1024;
+
+// Maximum error of the learned model (in leaf nodes).
+static const unsigned kModelError = 4;
+
+// Number of leaf nodes read ahead by the iterator (access pattern test).
+static const size_t kReadaheadLeaves = 4;
+
+// Prime used to add the keys in pseudo-random order.
+static const uint64_t kPrime = 1000003;
 
 static void usage(const char* program);
 
+static uint64_t now();
+
+static uint32_t fill_value(const char* key,
+                           keylen_t keylen,
+                           uint64_t i,
+                           uint8_t* value);
+
+static bool check_postings(const db::index::index& index,
+                           keylen_t keylen,
+                           uint64_t nkeys,
+                           uint64_t step);
+
+// Argument of the upsert function.
+struct upsert_arg {
+  // Data offset to set.
+  uint64_t dataoff;
+
+  // Number of keys which were in the index.
+  uint64_t found;
+};
+
+static uint64_t upsert_offset(bool found, uint64_t dataoff, void* arg);
+
 static int comp(const void* key1,
                 keylen_t keylen1,
                 const void* key2,
                 keylen_t keylen2);
 
+static bool replay(const char* tracename,
+                   const char* filename,
+                   uint64_t& count);
+
+// Remove the index and its files (filter, value log, write-ahead log, list
+// of hot pages...).
+static void remove_index(const char* filename);
+
+// Tests on the same index (each one starts from the keys left by the
+// previous one).
+static bool test_index(const char* filename,
+                       uint64_t nkeys,
+                       keylen_t keylen,
+                       bool forward);
+
+static bool test_add(db::index::index& index,
+                     uint64_t nkeys,
+                     keylen_t keylen,
+                     bool forward);
+
+static bool test_statistics(db::index::index& index,
+                            const char* filename,
+                            uint64_t nkeys);
+
+static bool test_analysis(db::index::index& index,
+                          uint64_t nkeys,
+                          keylen_t keylen);
+
+static bool test_iterators(db::index::index& index,
+                           uint64_t nkeys,
+                           keylen_t keylen);
+
+static bool test_search(db::index::index& index,
+                        uint64_t nkeys,
+                        keylen_t keylen);
+
+static bool test_erase(db::index::index& index,
+                       uint64_t nkeys,
+                       keylen_t keylen);
+
+static bool test_update(db::index::index& index,
+                        uint64_t nkeys,
+                        keylen_t keylen);
+
+static bool test_values(db::index::index& index,
+                        uint64_t nkeys,
+                        keylen_t keylen);
+
+static bool test_value_log(db::index::index& index,
+                           const char* filename,
+                           uint64_t nkeys,
+                           keylen_t keylen);
+
+static bool test_postings(db::index::index& index,
+                          uint64_t nkeys,
+                          keylen_t keylen);
+
+static bool test_multiples(const db::index::index& index,
+                           const char* filename,
+                           uint64_t nkeys,
+                           keylen_t keylen);
+
+// Tests with their own index.
+static bool test_version(const char* filename,
+                         uint64_t nkeys,
+                         keylen_t keylen);
+
+static bool test_full_leaf_postings(const char* filename,
+                                    uint64_t nkeys,
+                                    keylen_t keylen);
+
+static bool test_write_ahead_log(const char* filename,
+                                 uint64_t nkeys,
+                                 keylen_t keylen);
+
+static bool test_logged_writes(const char* filename,
+                               uint64_t nkeys,
+                               keylen_t keylen);
+
+static bool test_memtable(const char* filename,
+                          uint64_t nkeys,
+                          keylen_t keylen);
+
+static bool test_message_buffers(const char* filename,
+                                 uint64_t nkeys,
+                                 keylen_t keylen);
+
+static bool test_large_message_buffers(const char* filename,
+                                       uint64_t nkeys,
+                                       keylen_t keylen);
+
+static bool test_node_cache(const char* filename,
+                            uint64_t nkeys,
+                            keylen_t keylen);
+
+static bool test_hot_pages(const char* filename,
+                           uint64_t nkeys,
+                           keylen_t keylen);
+
+static bool test_recording(const char* filename,
+                           uint64_t nkeys,
+                           keylen_t keylen);
+
+static bool test_huge_pages(const char* filename,
+                            uint64_t nkeys,
+                            keylen_t keylen);
+
+static const struct {
+  const char* filename;
+  bool (*test)(const char* filename, uint64_t nkeys, keylen_t keylen);
+} kTests[] = {
+  {"index.idx.old", test_version},
+  {"index.idx.post", test_full_leaf_postings},
+  {"index.idx.wal", test_write_ahead_log},
+  {"index.idx.log", test_logged_writes},
+  {"index.idx.mem", test_memtable},
+  {"index.idx.buf", test_message_buffers},
+  {"index.idx.large", test_large_message_buffers},
+  {"index.idx.cache", test_node_cache},
+  {"index.idx.hot", test_hot_pages},
+  {"index.idx.rec", test_recording},
+  {"index.idx.huge", test_huge_pages}
+};
+
 int main(int argc, const char** argv)
 {
   if (argc != 4) {
@@ -45,13 +234,59 @@ int main(int argc, const char** argv)
 
   keylen_t keylen = static_cast<keylen_t>(n);
 
+  // The files left by a previous run are removed.
+  remove_index(kFilename);
+  bool ret = test_index(kFilename, nkeys, keylen, forward);
+  remove_index(kFilename);
+
+  for (size_t i = 0; (ret) && (i < sizeof(kTests) / sizeof(kTests[0])); i++) {
+    remove_index(kTests[i].filename);
+    ret = kTests[i].test(kTests[i].filename, nkeys, keylen);
+    remove_index(kTests[i].filename);
+  }
+
+  return ret ? 0 : -1;
+}
+
+void usage(const char* program)
+{
+  printf("Usage: %s <number-keys> <key-length> --add-forward | "
+         "--add-backward\n",
+         program);
+
+  printf("<number-keys> ::= 1 .. %llu\n", ULLONG_MAX);
+  printf("<key-length> ::= %u .. %u\n", kKeyMinLength, kKeyMaxLen);
+}
+
+bool test_index(const char* filename,
+                uint64_t nkeys,
+                keylen_t keylen,
+                bool forward)
+{
   db::index::index index;
-  if (!index.open("index.idx")) {
+  if (!index.open(filename)) {
     fprintf(stderr, "Error opening index.\n");
-    return -1;
+    return false;
   }
 
-  // Add keys.
+  return (test_add(index, nkeys, keylen, forward)) &&
+         (test_statistics(index, filename, nkeys)) &&
+         (test_analysis(index, nkeys, keylen)) &&
+         (test_iterators(index, nkeys, keylen)) &&
+         (test_search(index, nkeys, keylen)) &&
+         (test_erase(index, nkeys, keylen)) &&
+         (test_update(index, nkeys, keylen)) &&
+         (test_values(index, nkeys, keylen)) &&
+         (test_value_log(index, filename, nkeys, keylen)) &&
+         (test_postings(index, nkeys, keylen)) &&
+         (test_multiples(index, filename, nkeys, keylen));
+}
+
+bool test_add(db::index::index& index,
+              uint64_t nkeys,
+              keylen_t keylen,
+              bool forward)
+{
   if (forward) {
     printf("Adding keys (forward)...\n");
     for (uint64_t i = 0; i < nkeys; i++) {
@@ -60,7 +295,7 @@ int main(int argc, const char** argv)
 
       if (!index.add(key, len, i, comp)) {
         fprintf(stderr, "Error adding key '%s'.\n", key);
-        return -1;
+        return false;
       }
     }
   } else {
@@ -71,7 +306,7 @@ int main(int argc, const char** argv)
 
       if (!index.add(key, len, i - 1, comp)) {
         fprintf(stderr, "Error adding key '%s'.\n", key);
-        return -1;
+        return false;
       }
     }
   }
@@ -85,7 +320,7 @@ int main(int argc, const char** argv)
     uint64_t dataoff;
     if (!index.find(key, len, comp, dataoff)) {
       fprintf(stderr, "Error finding key '%s'.\n", key);
-      return -1;
+      return false;
     }
 
     if (dataoff != i) {
@@ -94,13 +329,92 @@ int main(int argc, const char** argv)
               dataoff,
               i);
 
-      return -1;
+      return false;
     }
   }
 
+  return true;
+}
+
+bool test_statistics(db::index::index& index,
+                     const char* filename,
+                     uint64_t nkeys)
+{
+#ifdef DB_INDEX_STATS
+  // Each key has been added (but the first one) and looked up searching from
+  // the root.
+  db::index::statistics stats = index.stats();
+  if ((stats.lookups != nkeys) ||
+      (stats.descents < (2 * nkeys) - 1) ||
+      (stats.node_visits < stats.descents) ||
+      (stats.comparisons < nkeys)) {
+    fprintf(stderr, "Unexpected counters.\n");
+    stats.print();
+    return false;
+  }
+
+  // Each operation has a latency.
+  db::index::latency_histogram add =
+    index.latencies(db::index::statistics::operation::kAdd);
+  db::index::latency_histogram find =
+    index.latencies(db::index::statistics::operation::kFind);
+
+  if ((add.count() != nkeys) ||
+      (find.count() != nkeys) ||
+      (find.percentile(0.5) > find.percentile(0.99)) ||
+      (find.percentile(0.99) > find.max())) {
+    fprintf(stderr, "Unexpected latencies.\n");
+    return false;
+  }
+
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s.prom", filename);
+
+  if (!index.export_stats(path)) {
+    fprintf(stderr, "Error exporting the counters.\n");
+    return false;
+  }
+#endif
+
+  return true;
+}
+
+bool test_analysis(db::index::index& index,
+                   uint64_t nkeys,
+                   keylen_t keylen)
+{
+  // Analyze the tree with one and with several threads.
+  printf("Analyzing the tree...\n");
+
+  db::index::analysis a1, a4;
+  if ((!index.analyze(a1, 1)) || (!index.analyze(a4, 4))) {
+    fprintf(stderr, "Error analyzing the tree.\n");
+    return false;
+  }
+
+  if ((a1.levels[0].entries != nkeys) ||
+      (a4.levels[0].entries != nkeys) ||
+      (a1.levels[0].key_bytes != nkeys * keylen) ||
+      (a1.deleted != 0) ||
+      (a1.height != a4.height) ||
+      (memcmp(a1.levels, a4.levels, sizeof(a1.levels)) != 0)) {
+    fprintf(stderr, "Unexpected analysis.\n");
+    a1.print();
+    a4.print();
+    return false;
+  }
+
+  return true;
+}
+
+bool test_iterators(db::index::index& index,
+                    uint64_t nkeys,
+                    keylen_t keylen)
+{
+  db::index::index::iterator it;
+
   // Iterate keys (forward).
   printf("Iterating keys (forward)...\n");
-  db::index::index::iterator it;
   if (index.begin(it)) {
     uint64_t i = 0;
 
@@ -112,7 +426,7 @@ int main(int argc, const char** argv)
         fprintf(stderr,
                 "Unexpected length %u of key '%s'.\n", it.keylen(), key);
 
-        return -1;
+        return false;
       }
 
       if (memcmp(it.key(), key, len) != 0) {
@@ -122,7 +436,7 @@ int main(int argc, const char** argv)
                 reinterpret_cast<const char*>(it.key()),
                 key);
 
-        return -1;
+        return false;
       }
 
       if (it.data_offset() != i) {
@@ -131,7 +445,7 @@ int main(int argc, const char** argv)
                 it.data_offset(),
                 i);
 
-        return -1;
+        return false;
       }
 
       i++;
@@ -143,11 +457,11 @@ int main(int argc, const char** argv)
               i,
               nkeys);
 
-      return -1;
+      return false;
     }
   } else {
     fprintf(stderr, "Error getting first key.\n");
-    return -1;
+    return false;
   }
 
   // Iterate keys (backward).
@@ -163,7 +477,7 @@ int main(int argc, const char** argv)
         fprintf(stderr,
                 "Unexpected length %u of key '%s'.\n", it.keylen(), key);
 
-        return -1;
+        return false;
       }
 
       if (memcmp(it.key(), key, len) != 0) {
@@ -173,7 +487,7 @@ int main(int argc, const char** argv)
                 reinterpret_cast<const char*>(it.key()),
                 key);
 
-        return -1;
+        return false;
       }
 
       if (it.data_offset() != i - 1) {
@@ -182,7 +496,7 @@ int main(int argc, const char** argv)
                 it.data_offset(),
                 i);
 
-        return -1;
+        return false;
       }
 
       i--;
@@ -194,13 +508,114 @@ int main(int argc, const char** argv)
               nkeys - i,
               nkeys);
 
-      return -1;
+      return false;
     }
   } else {
     fprintf(stderr, "Error getting last key.\n");
-    return -1;
+    return false;
+  }
+
+  // Iterate keys (batch).
+  printf("Iterating keys (batch)...\n");
+  if (index.begin(it)) {
+    db::index::index::ref refs[kBatchSize];
+    uint64_t i = 0;
+
+    size_t count;
+    while ((count = index.next_batch(it, refs, kBatchSize)) > 0) {
+      for (size_t j = 0; j < count; j++, i++) {
+        char key[kKeyMaxLen + 1];
+        keylen_t len = snprintf(key, sizeof(key), "%0*zu", keylen, i);
+
+        if ((refs[j].keylen != len) || (memcmp(refs[j].key, key, len) != 0)) {
+          fprintf(stderr,
+                  "Keys differ (key: '%.*s', expected: '%s').\n",
+                  refs[j].keylen,
+                  reinterpret_cast<const char*>(refs[j].key),
+                  key);
+
+          return false;
+        }
+
+        if (refs[j].dataoff != i) {
+          fprintf(stderr,
+                  "Unexpected data offset %lu, expected %lu.\n",
+                  refs[j].dataoff,
+                  i);
+
+          return false;
+        }
+      }
+    }
+
+    if (i != nkeys) {
+      fprintf(stderr,
+              "Keys are missing (# keys: %lu, expected: %lu).\n",
+              i,
+              nkeys);
+
+      return false;
+    }
+
+    // The iterator is exhausted.
+    if ((index.next(it)) || (index.previous(it))) {
+      fprintf(stderr, "Moved an exhausted iterator.\n");
+      return false;
+    }
+  } else {
+    fprintf(stderr, "Error getting first key.\n");
+    return false;
+  }
+
+  // Scan benchmark (next() vs next_batch()).
+  printf("Scanning keys...\n");
+  if (index.begin(it)) {
+    uint64_t sum1 = 0;
+
+    uint64_t start = now();
+
+    do {
+      sum1 += it.keylen() + it.data_offset();
+    } while (index.next(it));
+
+    uint64_t elapsed1 = now() - start;
+
+    index.begin(it);
+
+    uint64_t sum2 = 0;
+
+    db::index::index::ref refs[kBatchSize];
+
+    start = now();
+
+    size_t count;
+    while ((count = index.next_batch(it, refs, kBatchSize)) > 0) {
+      for (size_t j = 0; j < count; j++) {
+        sum2 += refs[j].keylen + refs[j].dataoff;
+      }
+    }
+
+    uint64_t elapsed2 = now() - start;
+
+    if (sum1 != sum2) {
+      fprintf(stderr, "Scans differ (%lu, %lu).\n", sum1, sum2);
+      return false;
+    }
+
+    printf("\tnext(): %lu us, next_batch(): %lu us.\n",
+           elapsed1 / 1000,
+           elapsed2 / 1000);
   }
 
+  return true;
+}
+
+bool test_search(db::index::index& index,
+                 uint64_t nkeys,
+                 keylen_t keylen)
+{
+  db::index::index::iterator it;
+
   // Search keys.
   printf("Searching keys...\n");
   for (uint64_t i = 0; i < nkeys; i++) {
@@ -209,7 +624,7 @@ int main(int argc, const char** argv)
 
     if (!index.find(key, len, comp, it)) {
       fprintf(stderr, "Error finding key '%s'.\n", key);
-      return -1;
+      return false;
     }
 
     if (it.data_offset() != i) {
@@ -218,10 +633,37 @@ int main(int argc, const char** argv)
               it.data_offset(),
               i);
 
-      return -1;
+      return false;
+    }
+  }
+
+  // Rank keys.
+  printf("Ranking keys...\n");
+  for (uint64_t i = 0; i < nkeys; i++) {
+    char key[kKeyMaxLen + 1];
+    keylen_t len = snprintf(key, sizeof(key), "%0*zu", keylen, i);
+
+    uint64_t rank;
+    if ((!index.rank(key, len, comp, rank)) || (rank != i)) {
+      fprintf(stderr, "Unexpected rank of key '%s'.\n", key);
+      return false;
+    }
+
+    if ((!index.select(i, it)) || (it.data_offset() != i)) {
+      fprintf(stderr, "Error selecting key '%s'.\n", key);
+      return false;
     }
   }
 
+  return true;
+}
+
+bool test_erase(db::index::index& index,
+                uint64_t nkeys,
+                keylen_t keylen)
+{
+  db::index::index::iterator it;
+
   uint64_t to_delete = nkeys / 4;
 
   // Erase keys at the beginning.
@@ -232,7 +674,7 @@ int main(int argc, const char** argv)
 
     if (!index.erase(key, len, comp)) {
       fprintf(stderr, "Error erasing key '%s'.\n", key);
-      return -1;
+      return false;
     }
   }
 
@@ -244,11 +686,19 @@ int main(int argc, const char** argv)
 
     if (!index.erase(key, len, comp)) {
       fprintf(stderr, "Error erasing key '%s'.\n", key);
-      return -1;
+      return false;
     }
   }
 
+  // The point lookups don't read ahead, the scan does.
   printf("Iterating keys (forward)...\n");
+  if (!index.advise(db::index::index::access_pattern::kRandom)) {
+    fprintf(stderr, "Error advising the access pattern.\n");
+    return false;
+  }
+
+  it.readahead(kReadaheadLeaves);
+
   if (index.begin(it)) {
     uint64_t i = to_delete;
 
@@ -260,7 +710,7 @@ int main(int argc, const char** argv)
         fprintf(stderr,
                 "Unexpected length %u of key '%s'.\n", it.keylen(), key);
 
-        return -1;
+        return false;
       }
 
       if (memcmp(it.key(), key, len) != 0) {
@@ -270,7 +720,7 @@ int main(int argc, const char** argv)
                 reinterpret_cast<const char*>(it.key()),
                 key);
 
-        return -1;
+        return false;
       }
 
       if (it.data_offset() != i) {
@@ -279,7 +729,7 @@ int main(int argc, const char** argv)
                 it.data_offset(),
                 i);
 
-        return -1;
+        return false;
       }
 
       i++;
@@ -292,11 +742,94 @@ int main(int argc, const char** argv)
               i,
               nkeys - to_delete);
 
-      return -1;
+      return false;
     }
   } else {
     fprintf(stderr, "Error getting first key.\n");
-    return -1;
+    return false;
+  }
+
+  printf("Iterating keys (backward)...\n");
+  if (index.end(it)) {
+    uint64_t i = nkeys - to_delete;
+
+    do {
+      char key[kKeyMaxLen + 1];
+      keylen_t len = snprintf(key, sizeof(key), "%0*zu", keylen, i - 1);
+
+      if ((it.keylen() != len) || (memcmp(it.key(), key, len) != 0)) {
+        fprintf(stderr,
+                "Keys differ (key: '%.*s', expected: '%s').\n",
+                it.keylen(),
+                reinterpret_cast<const char*>(it.key()),
+                key);
+
+        return false;
+      }
+
+      i--;
+    } while (index.previous(it));
+
+    if (i != to_delete) {
+      fprintf(stderr,
+              "Keys are missing (stopped at position: %lu, expected "
+              "position: %lu).\n",
+              i,
+              to_delete);
+
+      return false;
+    }
+  } else {
+    fprintf(stderr, "Error getting last key.\n");
+    return false;
+  }
+
+  uint64_t size = 0;
+  if ((!index.size(size)) || (size != nkeys - (2 * to_delete))) {
+    fprintf(stderr,
+            "Unexpected number of keys %lu, expected %lu.\n",
+            size,
+            nkeys - (2 * to_delete));
+
+    return false;
+  }
+
+  // Rank keys.
+  printf("Ranking keys...\n");
+  for (uint64_t i = to_delete; i < nkeys - to_delete; i++) {
+    char key[kKeyMaxLen + 1];
+    keylen_t len = snprintf(key, sizeof(key), "%0*zu", keylen, i);
+
+    uint64_t rank;
+    if ((!index.rank(key, len, comp, rank)) || (rank != i - to_delete)) {
+      fprintf(stderr, "Unexpected rank of key '%s'.\n", key);
+      return false;
+    }
+
+    if ((!index.select(i - to_delete, it)) || (it.data_offset() != i)) {
+      fprintf(stderr, "Error selecting key '%s'.\n", key);
+      return false;
+    }
+  }
+
+  // Count keys in a range.
+  {
+    char key1[kKeyMaxLen + 1];
+    keylen_t len1 = snprintf(key1,
+                             sizeof(key1),
+                             "%0*zu",
+                             keylen,
+                             static_cast<uint64_t>(0));
+
+    char key2[kKeyMaxLen + 1];
+    keylen_t len2 = snprintf(key2, sizeof(key2), "%0*zu", keylen, nkeys / 2);
+
+    uint64_t count;
+    if ((!index.count(key1, len1, key2, len2, comp, count)) ||
+        (count != (nkeys / 2) - to_delete)) {
+      fprintf(stderr, "Unexpected number of keys in range.\n");
+      return false;
+    }
   }
 
   // Search keys.
@@ -315,21 +848,1651 @@ int main(int argc, const char** argv)
               key,
               ((i < to_delete) || (i >= nkeys - to_delete)) ? "n't" : "");
 
-      return -1;
+      return false;
     }
   }
 
-  return 0;
+  return true;
 }
 
-void usage(const char* program)
+bool test_update(db::index::index& index,
+                 uint64_t nkeys,
+                 keylen_t keylen)
 {
-  printf("Usage: %s <number-keys> <key-length> --add-forward | "
-         "--add-backward\n",
-         program);
+  db::index::index::iterator it;
 
-  printf("<number-keys> ::= 1 .. %llu\n", ULLONG_MAX);
-  printf("<key-length> ::= %u .. %u\n", kKeyMinLength, kKeyMaxLen);
+  uint64_t to_delete = nkeys / 4;
+
+  // Update the data offsets through the iterator.
+  printf("Updating keys through the iterator...\n");
+  if (index.begin(it)) {
+    do {
+      if (!index.update(it, it.data_offset() + nkeys)) {
+        fprintf(stderr, "Error updating key through the iterator.\n");
+        return false;
+      }
+    } while (index.next(it));
+  }
+
+  // Upsert all the keys (the erased keys are added again).
+  printf("Upserting keys...\n");
+  struct upsert_arg arg;
+  arg.found = 0;
+
+  for (uint64_t i = 0; i < nkeys; i++) {
+    char key[kKeyMaxLen + 1];
+    keylen_t len = snprintf(key, sizeof(key), "%0*zu", keylen, i);
+
+    arg.dataoff = i;
+
+    if (!index.upsert(key, len, upsert_offset, &arg, comp)) {
+      fprintf(stderr, "Error upserting key '%s'.\n", key);
+      return false;
+    }
+  }
+
+  uint64_t size = 0;
+  if ((arg.found != nkeys - (2 * to_delete)) ||
+      (!index.size(size)) ||
+      (size != nkeys)) {
+    fprintf(stderr,
+            "Unexpected number of keys after upserting (found: %lu, "
+            "size: %lu).\n",
+            arg.found,
+            size);
+
+    return false;
+  }
+
+  // Erase again the keys at the beginning and at the end through the
+  // iterator.
+  printf("Erasing keys through the iterator...\n");
+  if (index.begin(it)) {
+    for (uint64_t i = 0; i < to_delete; i++) {
+      if ((it.data_offset() != i) || (!index.erase(it))) {
+        fprintf(stderr, "Error erasing key through the iterator.\n");
+        return false;
+      }
+
+      index.next(it);
+    }
+  }
+
+  if (index.end(it)) {
+    for (uint64_t i = nkeys; i > nkeys - to_delete; i--) {
+      if ((it.data_offset() != i - 1) || (!index.erase(it))) {
+        fprintf(stderr, "Error erasing key through the iterator.\n");
+        return false;
+      }
+
+      index.previous(it);
+    }
+  }
+
+  if ((!index.size(size)) || (size != nkeys - (2 * to_delete))) {
+    fprintf(stderr,
+            "Unexpected number of keys %lu, expected %lu.\n",
+            size,
+            nkeys - (2 * to_delete));
+
+    return false;
+  }
+
+  // The counts of the inner nodes have been updated through the parent
+  // pointers.
+  for (uint64_t i = to_delete; i < nkeys - to_delete; i++) {
+    char key[kKeyMaxLen + 1];
+    keylen_t len = snprintf(key, sizeof(key), "%0*zu", keylen, i);
+
+    uint64_t rank;
+    if ((!index.rank(key, len, comp, rank)) || (rank != i - to_delete)) {
+      fprintf(stderr, "Unexpected rank of key '%s'.\n", key);
+      return false;
+    }
+
+    if ((!index.select(i - to_delete, it)) || (it.data_offset() != i)) {
+      fprintf(stderr, "Error selecting key '%s'.\n", key);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool test_values(db::index::index& index,
+                 uint64_t nkeys,
+                 keylen_t keylen)
+{
+  db::index::index::iterator it;
+
+  // Add inline values (the value is the key itself).
+  printf("Adding values...\n");
+  for (uint64_t i = 0; i < nkeys; i++) {
+    char key[kKeyMaxLen + 1];
+    keylen_t len = snprintf(key, sizeof(key), "%0*zu", keylen, i);
+
+    nodeoff_t valuelen = (len < kInlineValueMaxLen) ? len : kInlineValueMaxLen;
+
+    if (!index.add(key, len, key, valuelen, comp)) {
+      fprintf(stderr, "Error adding value of key '%s'.\n", key);
+      return false;
+    }
+  }
+
+  // Search values.
+  printf("Searching values...\n");
+  for (uint64_t i = 0; i < nkeys; i++) {
+    char key[kKeyMaxLen + 1];
+    keylen_t len = snprintf(key, sizeof(key), "%0*zu", keylen, i);
+
+    nodeoff_t valuelen = (len < kInlineValueMaxLen) ? len : kInlineValueMaxLen;
+
+    if (!index.find(key, len, comp, it)) {
+      fprintf(stderr, "Error finding key '%s'.\n", key);
+      return false;
+    }
+
+    if ((it.value_len() != valuelen) ||
+        (memcmp(it.value(), key, valuelen) != 0)) {
+      fprintf(stderr, "Unexpected value of key '%s'.\n", key);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool test_value_log(db::index::index& index,
+                    const char* filename,
+                    uint64_t nkeys,
+                    keylen_t keylen)
+{
+  db::index::index::iterator it;
+
+  // Reopen the index with a value log.
+  index.close();
+
+  db::index::index::options opts;
+  opts.value_log_segment_size = kValueLogSegmentSize;
+
+  if (!index.open(filename, opts)) {
+    fprintf(stderr, "Error opening index.\n");
+    return false;
+  }
+
+  // Add values which don't fit in the leaf nodes (twice for the odd keys, so
+  // half of the values of the first segments are garbage).
+  printf("Adding values (value log)...\n");
+  for (uint64_t step = 1; step <= 2; step++) {
+    for (uint64_t i = step - 1; i < nkeys; i += step) {
+      char key[kKeyMaxLen + 1];
+      keylen_t len = snprintf(key, sizeof(key), "%0*zu", keylen, i);
+
+      uint8_t value[2 * kInlineValueMaxLen];
+      uint32_t valuelen = fill_value(key, len, i, value);
+
+      if (!index.add(key, len, value, valuelen, comp)) {
+        fprintf(stderr, "Error adding value of key '%s'.\n", key);
+        return false;
+      }
+    }
+  }
+
+  // Garbage collect the value log, a few leaf nodes at a time.
+  printf("Collecting garbage...\n");
+
+  uint64_t used1, used2, live1, live2;
+  index.value_store()->usage(used1, live1);
+
+  uint64_t nsteps = 0;
+  bool done;
+  do {
+    if (!index.collect_garbage_step(kGarbageLeaves, done, 0.75)) {
+      fprintf(stderr, "Error collecting garbage.\n");
+      return false;
+    }
+
+    nsteps++;
+  } while (!done);
+
+  index.value_store()->usage(used2, live2);
+
+  if ((live1 != live2) || (used2 > used1)) {
+    fprintf(stderr,
+            "Unexpected usage of the value log (used: %lu -> %lu, "
+            "live: %lu -> %lu).\n",
+            used1,
+            used2,
+            live1,
+            live2);
+
+    return false;
+  }
+
+  printf("Value log: %lu bytes used before and %lu bytes after, "
+         "%lu bytes live (%lu steps).\n",
+         used1,
+         used2,
+         live2,
+         nsteps);
+
+  // Search values.
+  printf("Searching values (value log)...\n");
+  for (uint64_t i = 0; i < nkeys; i++) {
+    char key[kKeyMaxLen + 1];
+    keylen_t len = snprintf(key, sizeof(key), "%0*zu", keylen, i);
+
+    uint8_t value[2 * kInlineValueMaxLen];
+    uint32_t valuelen = fill_value(key, len, i, value);
+
+    if (!index.find(key, len, comp, it)) {
+      fprintf(stderr, "Error finding key '%s'.\n", key);
+      return false;
+    }
+
+    if ((it.value_len() != valuelen) ||
+        (memcmp(it.value(), value, valuelen) != 0)) {
+      fprintf(stderr, "Unexpected value of key '%s'.\n", key);
+      return false;
+    }
+  }
+
+  uint64_t size = 0;
+  if ((!index.size(size)) || (size != nkeys)) {
+    fprintf(stderr,
+            "Unexpected number of keys %lu, expected %lu.\n",
+            size,
+            nkeys);
+
+    return false;
+  }
+
+  return true;
+}
+
+bool test_postings(db::index::index& index,
+                   uint64_t nkeys,
+                   keylen_t keylen)
+{
+  // Add postings (posting i goes to the key 'p<i % kPostingKeys>', the even
+  // postings forward and the odd ones backward).
+  printf("Adding postings...\n");
+  for (uint64_t i = 0; i < nkeys; i++) {
+    uint64_t posting = (i < (nkeys + 1) / 2) ? 2 * i :
+                                               (2 * (nkeys - i - 1)) + 1;
+
+    char key[kKeyMaxLen + 1];
+    keylen_t len = snprintf(key,
+                            sizeof(key),
+                            "p%0*zu",
+                            keylen - 1,
+                            posting % kPostingKeys);
+
+    if (!index.add_posting(key, len, posting, comp)) {
+      fprintf(stderr, "Error adding posting %lu of key '%s'.\n", posting, key);
+      return false;
+    }
+  }
+
+  printf("Searching postings...\n");
+  if (!check_postings(index, keylen, nkeys, 1)) {
+    return false;
+  }
+
+  // Remove the postings which are not multiple of 3.
+  printf("Removing postings...\n");
+  for (uint64_t i = 0; i < nkeys; i++) {
+    if ((i % 3) != 0) {
+      char key[kKeyMaxLen + 1];
+      keylen_t len = snprintf(key,
+                              sizeof(key),
+                              "p%0*zu",
+                              keylen - 1,
+                              i % kPostingKeys);
+
+      if (!index.remove_posting(key, len, i, comp)) {
+        fprintf(stderr, "Error removing posting %lu of key '%s'.\n", i, key);
+        return false;
+      }
+    }
+  }
+
+  printf("Searching postings...\n");
+  if (!check_postings(index, keylen, nkeys, 3)) {
+    return false;
+  }
+
+  return true;
+}
+
+bool test_multiples(const db::index::index& index,
+                    const char* filename,
+                    uint64_t nkeys,
+                    keylen_t keylen)
+{
+  db::index::index::iterator it;
+
+  // Indexes with the multiples of 3 and of 5.
+  printf("Adding multiples...\n");
+
+  db::index::index multiples[2];
+  static const uint64_t kFactors[2] = { 3, 5 };
+
+  for (size_t m = 0; m < 2; m++) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s.%lu", filename, kFactors[m]);
+
+    if (!multiples[m].open(path)) {
+      fprintf(stderr, "Error opening index.\n");
+      return false;
+    }
+
+    for (uint64_t i = 0; i < nkeys; i += kFactors[m]) {
+      char key[kKeyMaxLen + 1];
+      keylen_t len = snprintf(key, sizeof(key), "%0*zu", keylen, i);
+
+      if (!multiples[m].add(key, len, i, comp)) {
+        fprintf(stderr, "Error adding key '%s'.\n", key);
+        return false;
+      }
+    }
+  }
+
+  // Search the first multiple of 3 >= i.
+  printf("Searching lower bounds...\n");
+  for (uint64_t i = 0; i < nkeys; i++) {
+    char key[kKeyMaxLen + 1];
+    keylen_t len = snprintf(key, sizeof(key), "%0*zu", keylen, i);
+
+    uint64_t expected = ((i + 2) / 3) * 3;
+
+    if (multiples[0].lower_bound(key, len, comp, it) != (expected < nkeys)) {
+      fprintf(stderr, "Error searching lower bound of key '%s'.\n", key);
+      return false;
+    }
+
+    if ((expected < nkeys) && (it.data_offset() != expected)) {
+      fprintf(stderr,
+              "Unexpected lower bound %lu of key '%s', expected %lu.\n",
+              it.data_offset(),
+              key,
+              expected);
+
+      return false;
+    }
+  }
+
+  // Intersection: multiples of 15.
+  printf("Intersecting indexes...\n");
+
+  db::index::intersection intersection(comp);
+  intersection.add(&index);
+  intersection.add(&multiples[0]);
+  intersection.add(&multiples[1]);
+
+  uint64_t expected = 0;
+
+  if (intersection.first()) {
+    do {
+      if (intersection.input(1).data_offset() != expected) {
+        fprintf(stderr,
+                "Unexpected key '%.*s' in the intersection.\n",
+                intersection.keylen(),
+                reinterpret_cast<const char*>(intersection.key()));
+
+        return false;
+      }
+
+      expected += 15;
+    } while (intersection.next());
+  }
+
+  if (expected < nkeys) {
+    fprintf(stderr, "Keys are missing in the intersection.\n");
+    return false;
+  }
+
+  // Merge: multiples of 3 or of 5.
+  printf("Merging indexes...\n");
+
+  db::index::merge merge(comp);
+  merge.add(&multiples[0]);
+  merge.add(&multiples[1]);
+
+  expected = 0;
+
+  if (merge.first()) {
+    do {
+      if ((memcmp(merge.key(),
+                  merge.contains(0) ? merge.input(0).key() :
+                                      merge.input(1).key(),
+                  merge.keylen()) != 0) ||
+          (merge.contains(0) != ((expected % 3) == 0)) ||
+          (merge.contains(1) != ((expected % 5) == 0))) {
+        fprintf(stderr,
+                "Unexpected key '%.*s' in the merge.\n",
+                merge.keylen(),
+                reinterpret_cast<const char*>(merge.key()));
+
+        return false;
+      }
+
+      char key[kKeyMaxLen + 1];
+      snprintf(key, sizeof(key), "%0*zu", keylen, expected);
+
+      if (memcmp(merge.key(), key, keylen) != 0) {
+        fprintf(stderr,
+                "Unexpected key '%.*s' in the merge, expected '%s'.\n",
+                merge.keylen(),
+                reinterpret_cast<const char*>(merge.key()),
+                key);
+
+        return false;
+      }
+
+      // Next multiple of 3 or 5.
+      do {
+        expected++;
+      } while (((expected % 3) != 0) && ((expected % 5) != 0));
+    } while (merge.next());
+  }
+
+  if (expected < nkeys) {
+    fprintf(stderr, "Keys are missing in the merge.\n");
+    return false;
+  }
+
+  return true;
+}
+
+bool test_version(const char* filename,
+                  uint64_t nkeys,
+                  keylen_t keylen)
+{
+  // An index of the first format (without version) is not opened.
+  printf("Opening an index of another version...\n");
+
+  uint8_t data[kNodeSize];
+  memset(data, 0, sizeof(data));
+  memcpy(data, "INDEXIDX", 8);
+
+  int fd;
+  if (((fd = open(filename, O_CREAT | O_WRONLY, 0644)) == -1) ||
+      (write(fd, data, sizeof(data)) != sizeof(data))) {
+    fprintf(stderr, "Error creating index of another version.\n");
+
+    if (fd != -1) {
+      close(fd);
+    }
+
+    return false;
+  }
+
+  close(fd);
+
+  db::index::index index;
+  if (index.open(filename)) {
+    fprintf(stderr, "An index of another version has been opened.\n");
+    return false;
+  }
+
+  return true;
+}
+
+bool test_full_leaf_postings(const char* filename,
+                             uint64_t nkeys,
+                             keylen_t keylen)
+{
+  // The postings moved back from the posting nodes are longer than the
+  // posting list: with more and more long keys after the key, its leaf node
+  // is eventually too full to replace the value in place.
+  printf("Removing postings (full leaf nodes)...\n");
+
+  char key[kKeyMaxLen + 1];
+  keylen_t len = snprintf(key,
+                          sizeof(key),
+                          "%0*zu",
+                          keylen,
+                          static_cast<uint64_t>(0));
+
+  for (uint64_t nfill = 0; nfill < kFillKeys; nfill++) {
+    remove_index(filename);
+
+    db::index::index index;
+    if (!index.open(filename)) {
+      fprintf(stderr, "Error opening index.\n");
+      return false;
+    }
+
+    // The postings are far apart (long varints), so that they are stored in
+    // posting nodes.
+    for (uint64_t i = 1; i <= kLongPostings; i++) {
+      if (!index.add_posting(key, len, i << 56, comp)) {
+        fprintf(stderr, "Error adding posting %lu.\n", i << 56);
+        return false;
+      }
+    }
+
+    for (uint64_t i = 1; i <= nfill; i++) {
+      char fill[kKeyMaxLen + 1];
+      keylen_t filllen = snprintf(fill,
+                                  sizeof(fill),
+                                  "%0*zu",
+                                  kFillKeyLength,
+                                  i);
+
+      if (!index.add(fill, filllen, i, comp)) {
+        fprintf(stderr, "Error adding key '%s'.\n", fill);
+        return false;
+      }
+    }
+
+    // Remove the postings one by one, checking the remaining ones.
+    for (uint64_t i = 1; i <= kLongPostings; i++) {
+      if (!index.remove_posting(key, len, i << 56, comp)) {
+        fprintf(stderr, "Error removing posting %lu.\n", i << 56);
+        return false;
+      }
+
+      db::index::index::posting_iterator pit;
+      if (index.find_postings(key, len, comp, pit) != (i < kLongPostings)) {
+        fprintf(stderr, "Unexpected result searching the postings.\n");
+        return false;
+      }
+
+      uint64_t expected = i + 1;
+      uint64_t posting;
+      while ((i < kLongPostings) && (pit.next(posting))) {
+        if (posting != (expected << 56)) {
+          fprintf(stderr,
+                  "Unexpected posting %lu, expected %lu.\n",
+                  posting,
+                  expected << 56);
+
+          return false;
+        }
+
+        expected++;
+      }
+
+      if ((i < kLongPostings) && (expected != kLongPostings + 1)) {
+        fprintf(stderr, "Postings are missing.\n");
+        return false;
+      }
+
+      uint64_t size = 0;
+      uint64_t nexpected = nfill + ((i < kLongPostings) ? 1 : 0);
+      if ((!index.size(size)) || (size != nexpected)) {
+        fprintf(stderr,
+                "Unexpected number of keys %lu, expected %lu.\n",
+                size,
+                nexpected);
+
+        return false;
+      }
+    }
+
+    // The keys after the postings are still there.
+    for (uint64_t i = 1; i <= nfill; i++) {
+      char fill[kKeyMaxLen + 1];
+      keylen_t filllen = snprintf(fill,
+                                  sizeof(fill),
+                                  "%0*zu",
+                                  kFillKeyLength,
+                                  i);
+
+      uint64_t dataoff;
+      if ((!index.find(fill, filllen, comp, dataoff)) || (dataoff != i)) {
+        fprintf(stderr, "Error finding key '%s'.\n", fill);
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+bool test_write_ahead_log(const char* filename,
+                          uint64_t nkeys,
+                          keylen_t keylen)
+{
+  db::index::index::iterator it;
+
+  // Write batches with a write-ahead log in a child process, which exits
+  // without closing the index.
+  printf("Writing batches...\n");
+
+  // First key of the last batch.
+  uint64_t last = ((nkeys - 1) / kBatchSize) * kBatchSize;
+
+  db::index::index::options opts;
+
+  pid_t pid;
+  if ((pid = fork()) == 0) {
+    db::index::index batches;
+
+    opts.log_writes = true;
+    opts.comparator = comp;
+
+    if (!batches.open(filename, opts)) {
+      _exit(1);
+    }
+
+    db::index::write_batch batch;
+
+    for (uint64_t i = 0; i < nkeys; i += kBatchSize) {
+      batch.clear();
+
+      // Add the keys in reverse order, twice (the last operation wins).
+      uint64_t end = (i + kBatchSize < nkeys) ? i + kBatchSize : nkeys;
+      for (uint64_t j = end; j > i; j--) {
+        char key[kKeyMaxLen + 1];
+        keylen_t len = snprintf(key, sizeof(key), "%0*zu", keylen, j - 1);
+
+        if ((!batch.add(key, len, j)) || (!batch.add(key, len, j - 1))) {
+          _exit(1);
+        }
+      }
+
+      // Erase the multiples of 4 of the previous batch.
+      for (uint64_t j = (i > 0) ? i - kBatchSize : i; j < i; j += 4) {
+        char key[kKeyMaxLen + 1];
+        keylen_t len = snprintf(key, sizeof(key), "%0*zu", keylen, j);
+
+        if (!batch.erase(key, len)) {
+          _exit(1);
+        }
+      }
+
+      if (!batches.write(batch, comp)) {
+        _exit(1);
+      }
+    }
+
+    _exit(0);
+  }
+
+  int status;
+  if ((pid == -1) ||
+      (waitpid(pid, &status, 0) != pid) ||
+      (!WIFEXITED(status)) ||
+      (WEXITSTATUS(status) != 0)) {
+    fprintf(stderr, "Error writing batches.\n");
+    return false;
+  }
+
+  // Append an incomplete batch to the log.
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s.wal", filename);
+
+  int fd;
+  if (((fd = open(path, O_WRONLY | O_APPEND)) == -1) ||
+      (write(fd, "WRITELOG", 8) != 8)) {
+    fprintf(stderr, "Error appending to the write-ahead log.\n");
+    return false;
+  }
+
+  close(fd);
+
+  // Reopen the index: the batches of the log are applied again and the
+  // incomplete one is dropped.
+  printf("Recovering batches...\n");
+
+  db::index::index batches;
+
+  opts = db::index::index::options();
+  opts.comparator = comp;
+
+  if (!batches.open(filename, opts)) {
+    fprintf(stderr, "Error opening index.\n");
+    return false;
+  }
+
+  uint64_t rank = 0;
+  for (uint64_t i = 0; i < nkeys; i++) {
+    char key[kKeyMaxLen + 1];
+    keylen_t len = snprintf(key, sizeof(key), "%0*zu", keylen, i);
+
+    bool erased = (((i % 4) == 0) && (i < last));
+
+    if (batches.find(key, len, comp, it) == erased) {
+      fprintf(stderr,
+              "Key '%s' should%s have been found.\n",
+              key,
+              erased ? "n't" : "");
+
+      return false;
+    }
+
+    if (!erased) {
+      if (it.data_offset() != i) {
+        fprintf(stderr, "Unexpected data offset of key '%s'.\n", key);
+        return false;
+      }
+
+      if ((!batches.select(rank, it)) || (it.data_offset() != i)) {
+        fprintf(stderr, "Error selecting key '%s'.\n", key);
+        return false;
+      }
+
+      rank++;
+    }
+  }
+
+  uint64_t size = 0;
+  if ((!batches.size(size)) || (size != rank)) {
+    fprintf(stderr,
+            "Unexpected number of keys %lu, expected %lu.\n",
+            size,
+            rank);
+
+    return false;
+  }
+
+  return true;
+}
+
+bool test_logged_writes(const char* filename,
+                        uint64_t nkeys,
+                        keylen_t keylen)
+{
+  // Write batches and then overwrite their keys without batches in a child
+  // process, which exits without closing the index: the log must not undo
+  // the later writes when the index is opened.
+  printf("Writing keys after batches...\n");
+
+  char keys[3][kKeyMaxLen + 1];
+  keylen_t lens[3];
+  for (size_t i = 0; i < 3; i++) {
+    lens[i] = snprintf(keys[i], sizeof(keys[i]), "%0*zu", keylen, i);
+  }
+
+  // The value of the key 1 is the key itself.
+  nodeoff_t valuelen = (lens[1] < kInlineValueMaxLen) ? lens[1] :
+                                                        kInlineValueMaxLen;
+
+  db::index::index::options opts;
+  opts.comparator = comp;
+
+  pid_t pid;
+  if ((pid = fork()) == 0) {
+    db::index::index index;
+
+    opts.log_writes = true;
+
+    if (!index.open(filename, opts)) {
+      _exit(1);
+    }
+
+    db::index::write_batch batch;
+
+    for (size_t i = 0; i < 3; i++) {
+      batch.clear();
+
+      if ((!batch.add(keys[i], lens[i], 1)) || (!index.write(batch, comp))) {
+        _exit(1);
+      }
+    }
+
+    // Key 0: data offset (logged), key 1: value (not logged), key 2: erased
+    // (logged).
+    if ((!index.add(keys[0], lens[0], 2, comp)) ||
+        (!index.add(keys[1], lens[1], keys[1], valuelen, comp)) ||
+        (!index.erase(keys[2], lens[2], comp))) {
+      _exit(1);
+    }
+
+    _exit(0);
+  }
+
+  int status;
+  if ((pid == -1) ||
+      (waitpid(pid, &status, 0) != pid) ||
+      (!WIFEXITED(status)) ||
+      (WEXITSTATUS(status) != 0)) {
+    fprintf(stderr, "Error writing keys.\n");
+    return false;
+  }
+
+  db::index::index index;
+  if (!index.open(filename, opts)) {
+    fprintf(stderr, "Error opening index.\n");
+    return false;
+  }
+
+  db::index::index::iterator it;
+  uint64_t size = 0;
+  if ((!index.find(keys[0], lens[0], comp, it)) ||
+      (it.data_offset() != 2) ||
+      (!index.find(keys[1], lens[1], comp, it)) ||
+      (it.value_len() != valuelen) ||
+      (memcmp(it.value(), keys[1], valuelen) != 0) ||
+      (index.find(keys[2], lens[2], comp, it)) ||
+      (!index.size(size)) ||
+      (size != 2)) {
+    fprintf(stderr, "The log has undone the writes after the batches.\n");
+    return false;
+  }
+
+  return true;
+}
+
+bool test_memtable(const char* filename,
+                   uint64_t nkeys,
+                   keylen_t keylen)
+{
+  db::index::index::iterator it;
+
+  // Add keys in pseudo-random order through a memtable.
+  printf("Adding keys (memtable)...\n");
+
+  db::index::index buffered;
+
+  db::index::index::options opts;
+  opts.memtable_size = kMemtableSize;
+  opts.comparator = comp;
+
+  if (!buffered.open(filename, opts)) {
+    fprintf(stderr, "Error opening index.\n");
+    return false;
+  }
+
+  for (uint64_t i = 0; i < nkeys; i++) {
+    uint64_t n = (i * kPrime) % nkeys;
+
+    char key[kKeyMaxLen + 1];
+    keylen_t len = snprintf(key, sizeof(key), "%0*zu", keylen, n);
+
+    if (!buffered.add(key, len, n, comp)) {
+      fprintf(stderr, "Error adding key '%s'.\n", key);
+      return false;
+    }
+  }
+
+  // Erase the multiples of 7 (some of them are in the memtable, the others
+  // have been applied to the tree).
+  for (uint64_t i = 0; i < nkeys; i += 7) {
+    char key[kKeyMaxLen + 1];
+    keylen_t len = snprintf(key, sizeof(key), "%0*zu", keylen, i);
+
+    if (!buffered.erase(key, len, comp)) {
+      fprintf(stderr, "Error erasing key '%s'.\n", key);
+      return false;
+    }
+  }
+
+  printf("Searching keys (memtable)...\n");
+  for (uint64_t i = 0; i < nkeys; i++) {
+    char key[kKeyMaxLen + 1];
+    keylen_t len = snprintf(key, sizeof(key), "%0*zu", keylen, i);
+
+    uint64_t dataoff;
+    bool found = buffered.find(key, len, comp, dataoff);
+
+    if ((found != ((i % 7) != 0)) || ((found) && (dataoff != i))) {
+      fprintf(stderr, "Unexpected result searching key '%s'.\n", key);
+      return false;
+    }
+  }
+
+  // The reads which don't search a data offset apply the memtable first.
+  uint64_t count = nkeys - ((nkeys + 6) / 7);
+  uint64_t size = 0;
+  if ((!buffered.size(size)) || (size != count)) {
+    fprintf(stderr,
+            "Unexpected number of keys %lu, expected %lu.\n",
+            size,
+            count);
+
+    return false;
+  }
+
+  // Add the key 0 again and search it with an iterator.
+  char key[kKeyMaxLen + 1];
+  keylen_t len = snprintf(key, sizeof(key), "%0*u", keylen, 0);
+
+  if ((!buffered.add(key, len, 0, comp)) ||
+      (!buffered.find(key, len, comp, it)) ||
+      (it.data_offset() != 0)) {
+    fprintf(stderr, "Error searching key '%s' added again.\n", key);
+    return false;
+  }
+
+  count++;
+
+  // Buffer another data offset of the key 0 and the erasure of the key 1,
+  // then update the key 0 through the iterator: its buffered operation is
+  // applied first, so the update is not overwritten.
+  char key1[kKeyMaxLen + 1];
+  keylen_t len1 = snprintf(key1, sizeof(key1), "%0*u", keylen, 1);
+
+  uint64_t dataoff;
+  if ((!buffered.add(key, len, nkeys, comp)) ||
+      (!buffered.erase(key1, len1, comp)) ||
+      (!buffered.update(it, 0)) ||
+      (!buffered.find(key, len, comp, dataoff)) ||
+      (dataoff != 0)) {
+    fprintf(stderr, "Error updating key '%s' through the iterator.\n", key);
+    return false;
+  }
+
+  count--;
+
+  printf("Iterating keys (memtable)...\n");
+  uint64_t n = 0;
+  if (buffered.begin(it)) {
+    do {
+      n++;
+    } while (buffered.next(it));
+  }
+
+  if (n != count) {
+    fprintf(stderr, "Iterated over %lu keys, expected %lu.\n", n, count);
+    return false;
+  }
+
+  uint64_t rank = 0;
+  for (uint64_t i = 0; i < nkeys; i++) {
+    if ((((i % 7) != 0) || (i == 0)) && (i != 1)) {
+      if ((!buffered.select(rank, it)) || (it.data_offset() != i)) {
+        fprintf(stderr, "Error selecting key at position %lu.\n", rank);
+        return false;
+      }
+
+      rank++;
+    }
+  }
+
+  // The memtable needs the comparator.
+  db::index::index index;
+  opts.comparator = NULL;
+
+  if (index.open(filename, opts)) {
+    fprintf(stderr, "Opened an index with a memtable and no comparator.\n");
+    return false;
+  }
+
+  return true;
+}
+
+bool test_message_buffers(const char* filename,
+                          uint64_t nkeys,
+                          keylen_t keylen)
+{
+  db::index::index::iterator it;
+
+  // Add keys in pseudo-random order through message buffers.
+  printf("Adding keys (message buffers)...\n");
+
+  db::index::index messages;
+
+  db::index::index::options opts;
+  opts.message_buffer_pages = kMessageBufferPages;
+  opts.comparator = comp;
+
+  if (!messages.open(filename, opts)) {
+    fprintf(stderr, "Error opening index.\n");
+    return false;
+  }
+
+  for (uint64_t i = 0; i < nkeys; i++) {
+    uint64_t n = (i * kPrime) % nkeys;
+
+    char key[kKeyMaxLen + 1];
+    keylen_t len = snprintf(key, sizeof(key), "%0*zu", keylen, n);
+
+    if (!messages.add(key, len, n, comp)) {
+      fprintf(stderr, "Error adding key '%s'.\n", key);
+      return false;
+    }
+  }
+
+  for (uint64_t i = 0; i < nkeys; i += 7) {
+    char key[kKeyMaxLen + 1];
+    keylen_t len = snprintf(key, sizeof(key), "%0*zu", keylen, i);
+
+    if (!messages.erase(key, len, comp)) {
+      fprintf(stderr, "Error erasing key '%s'.\n", key);
+      return false;
+    }
+  }
+
+  // The pending messages are stored in the index.
+  messages.close();
+
+  if (!messages.open(filename, opts)) {
+    fprintf(stderr, "Error opening index.\n");
+    return false;
+  }
+
+  printf("Searching keys (message buffers)...\n");
+  for (uint64_t i = 0; i < nkeys; i++) {
+    char key[kKeyMaxLen + 1];
+    keylen_t len = snprintf(key, sizeof(key), "%0*zu", keylen, i);
+
+    uint64_t dataoff;
+    bool found = messages.find(key, len, comp, dataoff);
+
+    if ((found != ((i % 7) != 0)) || ((found) && (dataoff != i))) {
+      fprintf(stderr, "Unexpected result searching key '%s'.\n", key);
+      return false;
+    }
+  }
+
+  // The reads which don't search a data offset apply the messages first.
+  char key[kKeyMaxLen + 1];
+  keylen_t len = snprintf(key, sizeof(key), "%0*u", keylen, 1);
+
+  if ((!messages.find(key, len, comp, it)) || (it.data_offset() != 1)) {
+    fprintf(stderr, "Error searching key '%s' with an iterator.\n", key);
+    return false;
+  }
+
+  // Buffer the erasure of the key 2 and another data offset of the key 3,
+  // then write them through iterators: the message of the key is applied
+  // first, so the erased key can't be updated and the new data offset of
+  // the key 3 is not overwritten.
+  len = snprintf(key, sizeof(key), "%0*u", keylen, 2);
+
+  if ((!messages.find(key, len, comp, it)) ||
+      (!messages.erase(key, len, comp)) ||
+      (messages.update(it, 2)) ||
+      (!messages.erase(it))) {
+    fprintf(stderr, "Error erasing key '%s' through the iterator.\n", key);
+    return false;
+  }
+
+  len = snprintf(key, sizeof(key), "%0*u", keylen, 3);
+
+  uint64_t dataoff;
+  if ((!messages.find(key, len, comp, it)) ||
+      (!messages.add(key, len, nkeys, comp)) ||
+      (!messages.update(it, 3)) ||
+      (!messages.find(key, len, comp, dataoff)) ||
+      (dataoff != 3)) {
+    fprintf(stderr, "Error updating key '%s' through the iterator.\n", key);
+    return false;
+  }
+
+  uint64_t count = nkeys - ((nkeys + 6) / 7) - 1;
+  uint64_t size = 0;
+  if ((!messages.size(size)) || (size != count)) {
+    fprintf(stderr,
+            "Unexpected number of keys %lu, expected %lu.\n",
+            size,
+            count);
+
+    return false;
+  }
+
+  printf("Iterating keys (message buffers)...\n");
+  uint64_t n = 0;
+  if (messages.begin(it)) {
+    do {
+      n++;
+    } while (messages.next(it));
+  }
+
+  if (n != count) {
+    fprintf(stderr, "Iterated over %lu keys, expected %lu.\n", n, count);
+    return false;
+  }
+
+  uint64_t rank = 0;
+  for (uint64_t i = 0; i < nkeys; i++) {
+    if (((i % 7) != 0) && (i != 2)) {
+      if ((!messages.select(rank, it)) || (it.data_offset() != i)) {
+        fprintf(stderr, "Error selecting key at position %lu.\n", rank);
+        return false;
+      }
+
+      rank++;
+    }
+  }
+
+  messages.close();
+
+  // The message buffers need the comparator.
+  opts.comparator = NULL;
+
+  if (messages.open(filename, opts)) {
+    fprintf(stderr, "Opened an index with message buffers and no "
+                    "comparator.\n");
+
+    return false;
+  }
+
+  return true;
+}
+
+bool test_large_message_buffers(const char* filename,
+                                uint64_t nkeys,
+                                keylen_t keylen)
+{
+  // Add long keys in pseudo-random order, so that the nodes with a message
+  // buffer and the nodes above them are split by the same insert.
+  printf("Adding keys (large message buffers)...\n");
+
+  db::index::index messages;
+
+  db::index::index::options opts;
+  opts.message_buffer_pages = kLargeMessageBufferPages;
+  opts.comparator = comp;
+
+  if (!messages.open(filename, opts)) {
+    fprintf(stderr, "Error opening index.\n");
+    return false;
+  }
+
+  for (uint64_t i = 0; i < kLargeBufferKeys; i++) {
+    uint64_t n = (i * kPrime) % kLargeBufferKeys;
+
+    char key[kKeyMaxLen + 1];
+    keylen_t len = snprintf(key,
+                            sizeof(key),
+                            "%0*zu",
+                            kLargeBufferKeyLength,
+                            n);
+
+    if (!messages.add(key, len, n, comp)) {
+      fprintf(stderr, "Error adding key '%s'.\n", key);
+      return false;
+    }
+  }
+
+  printf("Searching keys (large message buffers)...\n");
+  for (uint64_t i = 0; i < kLargeBufferKeys; i++) {
+    char key[kKeyMaxLen + 1];
+    keylen_t len = snprintf(key,
+                            sizeof(key),
+                            "%0*zu",
+                            kLargeBufferKeyLength,
+                            i);
+
+    uint64_t dataoff;
+    if ((!messages.find(key, len, comp, dataoff)) || (dataoff != i)) {
+      fprintf(stderr, "Error searching key '%s'.\n", key);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool test_node_cache(const char* filename,
+                     uint64_t nkeys,
+                     keylen_t keylen)
+{
+  // Add keys in pseudo-random order and search them with the copy of the
+  // upper levels (which is rebuilt after the splits of inner nodes) and the
+  // learned model (fitted when half of the keys have been added).
+  printf("Adding and searching keys (node cache, learned model)...\n");
+
+  db::index::index cached;
+
+  db::index::index::options opts;
+  opts.node_cache_size = kNodeCacheSize;
+  opts.model_error = kModelError;
+
+  if (!cached.open(filename, opts)) {
+    fprintf(stderr, "Error opening index.\n");
+    return false;
+  }
+
+  for (uint64_t i = 0; i < nkeys; i++) {
+    uint64_t n = (i * kPrime) % nkeys;
+
+    char key[kKeyMaxLen + 1];
+    keylen_t len = snprintf(key, sizeof(key), "%0*zu", keylen, n);
+
+    if (!cached.add(key, len, n, NULL)) {
+      fprintf(stderr, "Error adding key '%s'.\n", key);
+      return false;
+    }
+
+    // Search the key and a key added before.
+    uint64_t m = ((i / 2) * kPrime) % nkeys;
+
+    char key2[kKeyMaxLen + 1];
+    keylen_t len2 = snprintf(key2, sizeof(key2), "%0*zu", keylen, m);
+
+    uint64_t dataoff, dataoff2;
+    if ((!cached.find(key, len, NULL, dataoff)) ||
+        (dataoff != n) ||
+        (!cached.find(key2, len2, NULL, dataoff2)) ||
+        (dataoff2 != m)) {
+      fprintf(stderr, "Error finding key '%s'.\n", key);
+      return false;
+    }
+
+    if ((i == nkeys / 2) && (!cached.train_model())) {
+      fprintf(stderr, "Error fitting the learned model.\n");
+      return false;
+    }
+  }
+
+  for (uint64_t i = 0; i < nkeys; i++) {
+    char key[kKeyMaxLen + 1];
+    keylen_t len = snprintf(key, sizeof(key), "%0*zu", keylen, i);
+
+    uint64_t dataoff;
+    if ((!cached.find(key, len, NULL, dataoff)) || (dataoff != i)) {
+      fprintf(stderr, "Error finding key '%s'.\n", key);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool test_hot_pages(const char* filename,
+                    uint64_t nkeys,
+                    keylen_t keylen)
+{
+  db::index::index cached;
+  if (!cached.open(filename)) {
+    fprintf(stderr, "Error opening index.\n");
+    return false;
+  }
+
+  for (uint64_t i = 0; i < nkeys; i++) {
+    uint64_t n = (i * kPrime) % nkeys;
+
+    char key[kKeyMaxLen + 1];
+    keylen_t len = snprintf(key, sizeof(key), "%0*zu", keylen, n);
+
+    if (!cached.add(key, len, n, NULL)) {
+      fprintf(stderr, "Error adding key '%s'.\n", key);
+      return false;
+    }
+  }
+
+  cached.close();
+
+  // Reopen the index loading all its nodes and saving the list of the pages
+  // in memory, then loading that list.
+  printf("Loading the nodes and the hot pages...\n");
+
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s.hot", filename);
+
+  db::index::index::options opts;
+  opts.prefault_inner_nodes = true;
+  opts.prefault_leaf_nodes = true;
+  opts.hot_pages = true;
+
+  for (unsigned pass = 0; pass < 2; pass++) {
+    if (!cached.open(filename, opts)) {
+      fprintf(stderr, "Error opening index.\n");
+      return false;
+    }
+
+    for (uint64_t i = 0; i < nkeys; i++) {
+      char key[kKeyMaxLen + 1];
+      keylen_t len = snprintf(key, sizeof(key), "%0*zu", keylen, i);
+
+      uint64_t dataoff;
+      if ((!cached.find(key, len, NULL, dataoff)) || (dataoff != i)) {
+        fprintf(stderr, "Error finding key '%s'.\n", key);
+        return false;
+      }
+    }
+
+    cached.close();
+
+    if (access(path, R_OK) != 0) {
+      fprintf(stderr, "The list of hot pages has not been saved.\n");
+      return false;
+    }
+
+    opts.prefault_inner_nodes = false;
+    opts.prefault_leaf_nodes = false;
+  }
+
+  return true;
+}
+
+bool test_recording(const char* filename,
+                    uint64_t nkeys,
+                    keylen_t keylen)
+{
+  db::index::index::iterator it;
+
+  char tracename[PATH_MAX];
+  snprintf(tracename, sizeof(tracename), "%s.trace", filename);
+
+  char replayname[PATH_MAX];
+  snprintf(replayname, sizeof(replayname), "%s.replay", filename);
+
+  // Record the operations on an index, with the keys and with their hashes,
+  // and replay them against a new index: the results must be the same.
+  for (unsigned hashed = 0; hashed <= 1; hashed++) {
+    printf("Recording and replaying operations%s...\n",
+           hashed ? " (hashed keys)" : "");
+
+    remove_index(filename);
+
+    db::index::index recorded;
+    if ((!recorded.open(filename)) ||
+        (!recorded.start_recording(tracename, hashed))) {
+      fprintf(stderr, "Error opening index.\n");
+      return false;
+    }
+
+    uint64_t noperations = 0;
+
+    for (uint64_t i = 0; i < nkeys; i++) {
+      uint64_t n = (i * kPrime) % nkeys;
+
+      char key[kKeyMaxLen + 1];
+      keylen_t len = snprintf(key, sizeof(key), "%0*zu", keylen, n);
+
+      // Every other key has an inline value (the key itself).
+      nodeoff_t valuelen = (len < kInlineValueMaxLen) ? len :
+                                                        kInlineValueMaxLen;
+
+      if ((((n % 2) == 0) && (!recorded.add(key, len, n, NULL))) ||
+          (((n % 2) != 0) && (!recorded.add(key, len, key, valuelen, NULL)))) {
+        fprintf(stderr, "Error adding key '%s'.\n", key);
+        return false;
+      }
+
+      noperations++;
+    }
+
+    for (uint64_t i = 0; i < nkeys; i += 3) {
+      char key[kKeyMaxLen + 1];
+      keylen_t len = snprintf(key, sizeof(key), "%0*zu", keylen, i);
+
+      recorded.erase(key, len, NULL);
+
+      // Search the key and a key which is not in the index.
+      uint64_t dataoff;
+      recorded.find(key, len, NULL, dataoff);
+      recorded.find(key, len - 1, NULL, dataoff);
+
+      noperations += 3;
+    }
+
+    noperations++;
+    if (recorded.begin(it)) {
+      do {
+        noperations++;
+      } while (recorded.next(it));
+    }
+
+    if (!recorded.stop_recording()) {
+      fprintf(stderr, "Error writing the trace.\n");
+      return false;
+    }
+
+    uint64_t count;
+    if (!replay(tracename, replayname, count)) {
+      return false;
+    }
+
+    if (count != noperations) {
+      fprintf(stderr,
+              "Unexpected number of operations %lu, expected %lu.\n",
+              count,
+              noperations);
+
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool test_huge_pages(const char* filename,
+                     uint64_t nkeys,
+                     keylen_t keylen)
+{
+  // Build an index with huge pages, then search the keys with huge pages
+  // and with the file mapped as usual.
+  static const db::index::index::huge_page_mode kHugePageModes[] = {
+    db::index::index::huge_page_mode::kFile,
+    db::index::index::huge_page_mode::kAnonymous
+  };
+
+  for (const db::index::index::huge_page_mode mode : kHugePageModes) {
+    printf("Using huge pages (%s)...\n",
+           (mode == db::index::index::huge_page_mode::kFile) ? "file" :
+                                                               "anonymous");
+
+    remove_index(filename);
+
+    db::index::index::options opts;
+    opts.huge_pages = mode;
+
+    db::index::index huge;
+    if (!huge.open(filename, opts)) {
+      fprintf(stderr, "Error opening index.\n");
+      return false;
+    }
+
+    for (uint64_t i = 0; i < nkeys; i++) {
+      uint64_t n = (i * kPrime) % nkeys;
+
+      char key[kKeyMaxLen + 1];
+      keylen_t len = snprintf(key, sizeof(key), "%0*zu", keylen, n);
+
+      if (!huge.add(key, len, n, NULL)) {
+        fprintf(stderr, "Error adding key '%s'.\n", key);
+        return false;
+      }
+    }
+
+    for (unsigned pass = 0; pass < 2; pass++) {
+      huge.close();
+
+      if (!huge.open(filename, opts)) {
+        fprintf(stderr, "Error opening index.\n");
+        return false;
+      }
+
+      for (uint64_t i = 0; i < nkeys; i++) {
+        char key[kKeyMaxLen + 1];
+        keylen_t len = snprintf(key, sizeof(key), "%0*zu", keylen, i);
+
+        uint64_t dataoff;
+        if ((!huge.find(key, len, NULL, dataoff)) || (dataoff != i)) {
+          fprintf(stderr, "Error finding key '%s'.\n", key);
+          return false;
+        }
+      }
+
+      opts.huge_pages = db::index::index::huge_page_mode::kNone;
+    }
+  }
+
+  return true;
+}
+
+uint64_t now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (static_cast<uint64_t>(ts.tv_sec) * 1000000000ull) + ts.tv_nsec;
+}
+
+uint32_t fill_value(const char* key,
+                    keylen_t keylen,
+                    uint64_t i,
+                    uint8_t* value)
+{
+  // The value is the key repeated.
+  uint32_t valuelen = kInlineValueMaxLen + 1 + (i % kInlineValueMaxLen);
+
+  for (uint32_t off = 0; off < valuelen; off += keylen) {
+    memcpy(value + off,
+           key,
+           (valuelen - off < keylen) ? valuelen - off : keylen);
+  }
+
+  return valuelen;
+}
+
+uint64_t upsert_offset(bool found, uint64_t dataoff, void* arg)
+{
+  struct upsert_arg* a = static_cast<struct upsert_arg*>(arg);
+
+  if (found) {
+    a->found++;
+  }
+
+  return a->dataoff;
+}
+
+bool check_postings(const db::index::index& index,
+                    keylen_t keylen,
+                    uint64_t nkeys,
+                    uint64_t step)
+{
+  uint64_t nposting_keys = 0;
+
+  for (uint64_t k = 0; k < kPostingKeys; k++) {
+    char key[kKeyMaxLen + 1];
+    keylen_t len = snprintf(key, sizeof(key), "p%0*zu", keylen - 1, k);
+
+    // Expected postings: i % kPostingKeys == k and i % step == 0.
+    uint64_t expected = k;
+    while ((expected < nkeys) && ((expected % step) != 0)) {
+      expected += kPostingKeys;
+    }
+
+    db::index::index::posting_iterator pit;
+    if (!index.find_postings(key, len, comp, pit)) {
+      if (expected < nkeys) {
+        fprintf(stderr, "Error finding postings of key '%s'.\n", key);
+        return false;
+      }
+
+      continue;
+    }
+
+    nposting_keys++;
+
+    uint64_t count = 0;
+    uint64_t posting;
+    while (pit.next(posting)) {
+      if (posting != expected) {
+        fprintf(stderr,
+                "Unexpected posting %lu of key '%s', expected %lu.\n",
+                posting,
+                key,
+                expected);
+
+        return false;
+      }
+
+      count++;
+
+      do {
+        expected += kPostingKeys;
+      } while ((expected < nkeys) && ((expected % step) != 0));
+    }
+
+    if ((expected < nkeys) || (count != pit.size())) {
+      fprintf(stderr, "Postings of key '%s' are missing.\n", key);
+      return false;
+    }
+  }
+
+  uint64_t size = 0;
+  if ((!index.size(size)) || (size != nkeys + nposting_keys)) {
+    fprintf(stderr,
+            "Unexpected number of keys %lu, expected %lu.\n",
+            size,
+            nkeys + nposting_keys);
+
+    return false;
+  }
+
+  return true;
+}
+
+bool replay(const char* tracename, const char* filename, uint64_t& count)
+{
+  db::index::operation_trace trace;
+  if (!trace.open(tracename)) {
+    fprintf(stderr, "Error opening trace '%s'.\n", tracename);
+    return false;
+  }
+
+  db::index::index index;
+  if (!index.open(filename)) {
+    fprintf(stderr, "Error opening index.\n");
+    return false;
+  }
+
+  db::index::index::iterator it;
+  bool valid = false;
+
+  uint8_t value[kInlineValueMaxLen];
+  memset(value, 'v', sizeof(value));
+
+  db::index::operation_trace::record r;
+  for (count = 0; trace.read(r); count++) {
+    bool result;
+    uint64_t dataoff;
+
+    switch (r.type) {
+      case db::index::operation_trace::op_type::kAdd:
+        result = index.add(r.key, r.keylen, r.arg, NULL);
+        break;
+      case db::index::operation_trace::op_type::kAddValue:
+        result = index.add(r.key,
+                           r.keylen,
+                           value,
+                           static_cast<uint32_t>(r.arg),
+                           NULL);
+
+        break;
+      case db::index::operation_trace::op_type::kErase:
+        result = index.erase(r.key, r.keylen, NULL);
+        break;
+      case db::index::operation_trace::op_type::kFind:
+        result = index.find(r.key, r.keylen, NULL, dataoff);
+        break;
+      case db::index::operation_trace::op_type::kBegin:
+        result = (valid = index.begin(it));
+        break;
+      case db::index::operation_trace::op_type::kNext:
+        result = (valid = ((valid) && (index.next(it))));
+        break;
+      default:
+        result = !r.result;
+    }
+
+    if (result != r.result) {
+      fprintf(stderr,
+              "Unexpected result of the operation %lu of the trace.\n",
+              count);
+
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void remove_index(const char* filename)
+{
+  unlink(filename);
+
+  char pattern[PATH_MAX];
+  snprintf(pattern, sizeof(pattern), "%s.*", filename);
+
+  glob_t g;
+  if (glob(pattern, 0, NULL, &g) == 0) {
+    for (size_t i = 0; i < g.gl_pathc; i++) {
+      unlink(g.gl_pathv[i]);
+    }
+
+    globfree(&g);
+  }
 }
 
 int comp(const void* key1,
@@ -0,0 +1,294 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <limits.h>
+#include <math.h>
+#include <unistd.h>
+#include "key/encoder.h"
+#include "key/decoder.h"
+#include "index/index.h"
+
+static const char* kFilename = "testkey.idx";
+static const size_t kStringMaxLen = 16;
+
+// Tuple (a: signed integer, b: nullable string in descending order, c: double).
+struct tuple {
+  int64_t a;
+
+  bool bnull;
+  char b[kStringMaxLen];
+  size_t blen;
+
+  double c;
+};
+
+static void usage(const char* program);
+
+static uint64_t random_number(uint64_t& state);
+
+static void random_tuple(uint64_t& state, struct tuple& t);
+
+static keylen_t encode(const struct tuple& t, uint8_t* key);
+
+static bool decode(const void* key, keylen_t keylen, struct tuple& t);
+
+static int compare(const struct tuple& t1, const struct tuple& t2);
+
+static int sign(int n);
+
+int main(int argc, const char** argv)
+{
+  if (argc != 2) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  char* endptr;
+  uint64_t ntuples = strtoull(argv[1], &endptr, 10);
+  if ((*endptr) || (ntuples == 0)) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  struct tuple* tuples;
+  if ((tuples = reinterpret_cast<struct tuple*>(
+                  malloc(ntuples * sizeof(struct tuple))
+                )) == NULL) {
+    fprintf(stderr, "Error allocating memory.\n");
+    return -1;
+  }
+
+  uint64_t state = 88172645463325252ull;
+
+  for (uint64_t i = 0; i < ntuples; i++) {
+    random_tuple(state, tuples[i]);
+  }
+
+  // Decode the encoded tuples.
+  printf("Encoding / decoding tuples...\n");
+  for (uint64_t i = 0; i < ntuples; i++) {
+    uint8_t key[kKeyMaxLen];
+    keylen_t keylen = encode(tuples[i], key);
+
+    struct tuple t;
+    if ((!decode(key, keylen, t)) || (compare(t, tuples[i]) != 0)) {
+      fprintf(stderr, "Error decoding tuple %lu.\n", i);
+      return -1;
+    }
+  }
+
+  // The byte order of the keys must be the order of the tuples.
+  printf("Comparing keys...\n");
+  for (uint64_t i = 0; i < ntuples; i++) {
+    uint64_t j = random_number(state) % ntuples;
+
+    uint8_t key1[kKeyMaxLen], key2[kKeyMaxLen];
+    keylen_t keylen1 = encode(tuples[i], key1);
+    keylen_t keylen2 = encode(tuples[j], key2);
+
+    if (sign(db::index::compare(key1, keylen1, key2, keylen2)) !=
+        sign(compare(tuples[i], tuples[j]))) {
+      fprintf(stderr, "Unexpected order of the tuples %lu and %lu.\n", i, j);
+      return -1;
+    }
+  }
+
+  // Add keys to an index without comparator.
+  unlink(kFilename);
+
+  db::index::index index;
+  if (!index.open(kFilename)) {
+    fprintf(stderr, "Error opening index.\n");
+    return -1;
+  }
+
+  printf("Adding keys...\n");
+  for (uint64_t i = 0; i < ntuples; i++) {
+    uint8_t key[kKeyMaxLen];
+    keylen_t keylen = encode(tuples[i], key);
+
+    if (!index.add(key, keylen, i, NULL)) {
+      fprintf(stderr, "Error adding tuple %lu.\n", i);
+      return -1;
+    }
+  }
+
+  // The keys are iterated in the order of the tuples.
+  printf("Iterating keys...\n");
+  db::index::index::iterator it;
+  if (index.begin(it)) {
+    struct tuple prev;
+    uint64_t count = 0;
+
+    do {
+      struct tuple t;
+      if (!decode(it.key(), it.keylen(), t)) {
+        fprintf(stderr, "Error decoding key.\n");
+        return -1;
+      }
+
+      if (((count > 0) && (compare(prev, t) >= 0)) ||
+          (compare(t, tuples[it.data_offset()]) != 0)) {
+        fprintf(stderr, "Unexpected tuple %lu.\n", it.data_offset());
+        return -1;
+      }
+
+      prev = t;
+      count++;
+    } while (index.next(it));
+
+    uint64_t size = 0;
+    if ((!index.size(size)) || (count != size)) {
+      fprintf(stderr,
+              "Unexpected number of keys %lu, expected %lu.\n",
+              count,
+              size);
+
+      return -1;
+    }
+  }
+
+  // Search keys.
+  printf("Searching keys...\n");
+  for (uint64_t i = 0; i < ntuples; i++) {
+    uint8_t key[kKeyMaxLen];
+    keylen_t keylen = encode(tuples[i], key);
+
+    uint64_t dataoff;
+    if ((!index.find(key, keylen, NULL, dataoff)) ||
+        (compare(tuples[dataoff], tuples[i]) != 0)) {
+      fprintf(stderr, "Error finding tuple %lu.\n", i);
+      return -1;
+    }
+  }
+
+  index.close();
+
+  unlink(kFilename);
+
+  free(tuples);
+
+  return 0;
+}
+
+void usage(const char* program)
+{
+  printf("Usage: %s <number-tuples>\n", program);
+  printf("<number-tuples> ::= 1 .. %llu\n", ULLONG_MAX);
+}
+
+uint64_t random_number(uint64_t& state)
+{
+  // xorshift64*.
+  state ^= state >> 12;
+  state ^= state << 25;
+  state ^= state >> 27;
+
+  return state * 0x2545f4914f6cdd1dull;
+}
+
+void random_tuple(uint64_t& state, struct tuple& t)
+{
+  // Few distinct values, so that the next columns are compared too.
+  t.a = static_cast<int64_t>(random_number(state) % 64) - 32;
+  if ((random_number(state) % 4) == 0) {
+    t.a *= 0x100000000000000ll;
+  }
+
+  if ((t.bnull = ((random_number(state) % 8) == 0)) == false) {
+    t.blen = random_number(state) % (kStringMaxLen + 1);
+
+    // Small alphabet with 0x00 and 0xff.
+    static const char kAlphabet[] = { '\0', '\1', 'a', 'b', '\xff' };
+
+    for (size_t i = 0; i < t.blen; i++) {
+      t.b[i] = kAlphabet[random_number(state) % sizeof(kAlphabet)];
+    }
+  } else {
+    t.blen = 0;
+  }
+
+  switch (random_number(state) % 8) {
+    case 0: t.c = 0.0; break;
+    case 1: t.c = INFINITY; break;
+    case 2: t.c = -INFINITY; break;
+    default:
+      t.c = (static_cast<double>(random_number(state) % 2001) - 1000.0) / 8.0;
+  }
+}
+
+keylen_t encode(const struct tuple& t, uint8_t* key)
+{
+  db::key::encoder encoder(key, kKeyMaxLen);
+
+  encoder.add_int(t.a);
+
+  if (t.bnull) {
+    encoder.add_null(db::key::order::kDescending);
+  } else {
+    encoder.add_string(t.b, t.blen, db::key::order::kDescending);
+  }
+
+  encoder.add_double(t.c);
+
+  return encoder.length();
+}
+
+bool decode(const void* key, keylen_t keylen, struct tuple& t)
+{
+  db::key::decoder decoder(key, keylen);
+
+  if (!decoder.get_int(t.a)) {
+    return false;
+  }
+
+  if ((t.bnull = decoder.null(db::key::order::kDescending)) == false) {
+    if ((!decoder.get_string(t.b,
+                             sizeof(t.b),
+                             t.blen,
+                             db::key::order::kDescending)) ||
+        (t.blen > sizeof(t.b))) {
+      return false;
+    }
+  } else {
+    t.blen = 0;
+  }
+
+  return ((decoder.get_double(t.c)) && (decoder.end()));
+}
+
+int compare(const struct tuple& t1, const struct tuple& t2)
+{
+  if (t1.a != t2.a) {
+    return (t1.a < t2.a) ? -1 : +1;
+  }
+
+  // Descending, nulls last.
+  if (t1.bnull != t2.bnull) {
+    return t1.bnull ? +1 : -1;
+  }
+
+  if (!t1.bnull) {
+    size_t len = (t1.blen < t2.blen) ? t1.blen : t2.blen;
+
+    int ret;
+    if ((ret = memcmp(t1.b, t2.b, len)) != 0) {
+      return (ret < 0) ? +1 : -1;
+    }
+
+    if (t1.blen != t2.blen) {
+      return (t1.blen < t2.blen) ? +1 : -1;
+    }
+  }
+
+  if (t1.c != t2.c) {
+    return (t1.c < t2.c) ? -1 : +1;
+  }
+
+  return 0;
+}
+
+int sign(int n)
+{
+  return (n > 0) - (n < 0);
+}
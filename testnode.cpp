@@ -17,12 +17,23 @@ static bool test2();
 static bool test3();
 static bool test4();
 
-int main()
+int main(int argc, const char** argv)
 {
-  return test1() ? 0 : -1;
-  //return test2() ? 0 : -1;
-  //return test3() ? 0 : -1;
-  //return test4() ? 0 : -1;
+  // Test to run (1: leaf node, 2: splits of leaf nodes, 3: inner node,
+  // 4: splits of inner nodes).
+  switch ((argc > 1) ? atoi(argv[1]) : 1) {
+    case 1:
+      return test1() ? 0 : -1;
+    case 2:
+      return test2() ? 0 : -1;
+    case 3:
+      return test3() ? 0 : -1;
+    case 4:
+      return test4() ? 0 : -1;
+    default:
+      printf("Usage: %s [1 | 2 | 3 | 4]\n", argv[0]);
+      return -1;
+  }
 }
 
 bool test1()
@@ -140,7 +151,15 @@ bool test2()
     db::index::leaf_node* right = new (data2) db::index::leaf_node();
 
     // Split node and add key.
-    node->split(kNodeSize, 2 * kNodeSize, right, pos, key, keylen, 0);
+    node->split(kNodeSize,
+                2 * kNodeSize,
+                right,
+                pos,
+                key,
+                keylen,
+                db::index::leaf_node::value_type::kExternal,
+                NULL,
+                0);
 
     printf("Key which produces the split is '%s'.\n\n", key);
 
@@ -172,7 +191,7 @@ bool test3()
     char key[kKeyLength + 1];
     keylen_t keylen = snprintf(key, sizeof(key), "%0*u", kKeyLength, count);
 
-    if (!node->add(key, keylen, count + 1, comp)) {
+    if (!node->add(key, keylen, count + 1, 0, comp)) {
       break;
     }
 
@@ -224,7 +243,7 @@ bool test4()
     char key[kKeyLength + 1];
     keylen_t keylen = snprintf(key, sizeof(key), "%0*u", kKeyLength, nentries);
 
-    if (!node->add(key, keylen, 0, comp)) {
+    if (!node->add(key, keylen, 0, 0, comp)) {
       break;
     }
   }
@@ -245,7 +264,7 @@ bool test4()
       char key[kKeyLength + 1];
       keylen_t keylen = snprintf(key, sizeof(key), "%0*u", kKeyLength, count2);
 
-      if (!node->add(key, keylen, count2 + 1, comp)) {
+      if (!node->add(key, keylen, count2 + 1, 0, comp)) {
         fprintf(stderr, "Error adding key '%s'.\n", key);
         return false;
       }
@@ -269,7 +288,7 @@ bool test4()
     db::index::inner_node* right = new (data2) db::index::inner_node();
 
     // Split node and add key.
-    node->split(right, pos, key, keylen, count1 + 1, upkey, upkeylen);
+    node->split(right, pos, key, keylen, count1 + 1, 0, upkey, upkeylen);
 
     printf("Key which produces the split is '%s'.\n", key);
     printf("Key which goes up '%.*s'.\n\n",